@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mock_vulkan_device.h"
+#include "range_allocator.h"
+#include "vulkan_memory.h"
+
+namespace {
+
+void check(bool condition, const std::string& message) {
+	if (!condition)
+		throw std::runtime_error(message);
+}
+
+//Ranges of the same memory, or of the same TLSF allocator, must not overlap
+struct Range {
+	uint64_t offset;
+	uint64_t size;
+};
+
+void checkNoOverlap(std::vector<Range>& ranges, const std::string& message) {
+	std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.offset < b.offset; });
+	for (size_t i = 1; i < ranges.size(); i++)
+		check(ranges[i - 1].offset + ranges[i - 1].size <= ranges[i].offset, message);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Random allocations and frees of mixed sizes and alignments. Ranges stay aligned, inside the
+// allocator and apart, the counters follow the live ranges and freeing everything merges the free
+// ranges back into one.
+//
+void testTlsfAllocator(std::mt19937_64& rng) {
+	struct TlsfRange {
+		uint32_t handle;
+		Range range;
+	};
+
+	for (int round = 0; round < 10; round++) {
+		TlsfAllocator tlsf;
+		uint64_t size = (64ull << 20) + round * 12345;
+		tlsf.init(size);
+
+		std::vector<TlsfRange> live;
+		size_t failedCount = 0;
+		for (int i = 0; i < 200000; i++) {
+			if (live.empty() || rng() % 100 < 55) {
+				uint64_t rangeSize = rng() % 4 == 0 ? rng() % (2 << 20) + 1 : rng() % 4096 + 1;
+				uint64_t alignment = 1ull << (rng() % 13);
+				uint64_t offset = 0;
+				uint32_t handle = tlsf.allocate(rangeSize, alignment, offset);
+				if (handle == TlsfAllocator::invalidHandle) {
+					failedCount++;
+					continue;
+				}
+				check(offset % alignment == 0, "TLSF range is not aligned!");
+				check(offset + rangeSize <= size, "TLSF range is out of the allocator!");
+				live.push_back({ handle, { offset, rangeSize } });
+			}
+			else {
+				size_t index = rng() % live.size();
+				tlsf.free(live[index].handle);
+				live[index] = live.back();
+				live.pop_back();
+			}
+
+			if (i % 20000 == 0) {
+				std::vector<Range> ranges;
+				for (const TlsfRange& range : live)
+					ranges.push_back(range.range);
+				checkNoOverlap(ranges, "TLSF ranges overlap!");
+			}
+		}
+
+		uint64_t usedBytes = 0;
+		for (const TlsfRange& range : live)
+			usedBytes += range.range.size;
+		check(tlsf.m_usedBytes == usedBytes && tlsf.m_allocationCount == live.size(), "TLSF counters do not match the live ranges!");
+		for (const TlsfRange& range : live)
+			tlsf.free(range.handle);
+		check(tlsf.empty() && tlsf.m_usedBytes == 0, "TLSF allocator is not empty after freeing every range!");
+		check(tlsf.largestFreeRange() == size, "TLSF free ranges were not merged back!");
+		std::cout << "tlsf round " << round << ": " << failedCount << " allocations did not fit" << std::endl;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Bump allocation with alignment, rewinding once every range is freed
+//
+void testLinearAllocator() {
+	LinearAllocator linear;
+	linear.init(1000);
+	uint64_t offset = 0;
+	check(linear.allocate(100, 64, offset) && offset == 0, "linear allocation is not at the head!");
+	check(linear.allocate(100, 64, offset) && offset == 128, "linear allocation is not aligned!");
+	check(!linear.allocate(900, 1, offset), "linear allocation past the end succeeded!");
+	linear.free(100);
+	check(linear.m_head == 228 && !linear.empty(), "linear allocator rewound with a live range!");
+	linear.free(100);
+	check(linear.m_head == 0 && linear.empty() && linear.m_usedBytes == 0, "linear allocator did not rewind!");
+	check(linear.allocate(1000, 1, offset) && offset == 0, "rewound linear allocator is not whole!");
+}
+
+//--------------------------------------------------------------------------------------------------
+// Every slot is handed out once until it is freed
+//
+void testSlotAllocator(std::mt19937_64& rng) {
+	SlotAllocator slots;
+	slots.init(256, 64);
+	check(slots.empty() && !slots.full(), "new slot allocator is not empty!");
+
+	std::vector<uint64_t> live;
+	uint64_t offset = 0;
+	for (int i = 0; i < 64; i++) {
+		check(slots.allocate(offset), "slot allocation failed before the allocator was full!");
+		check(offset % 256 == 0 && offset < 64 * 256, "slot offset is not a slot!");
+		live.push_back(offset);
+	}
+	check(slots.full() && !slots.allocate(offset), "full slot allocator handed out a slot!");
+	std::sort(live.begin(), live.end());
+	check(std::adjacent_find(live.begin(), live.end()) == live.end(), "slot handed out twice!");
+
+	for (int i = 0; i < 10000; i++) {
+		size_t index = rng() % live.size();
+		slots.free(live[index]);
+		check(slots.allocate(offset) && offset == live[index], "freed slot was not reused!");
+	}
+	for (uint64_t slot : live)
+		slots.free(slot);
+	check(slots.empty(), "slot allocator is not empty after freeing every slot!");
+}
+
+//--------------------------------------------------------------------------------------------------
+// A device local heap and a small host visible heap, with a bufferImageGranularity that splits
+// buffers and optimal images into separate pools
+//
+void setupMockDevice(uint32_t maxMemoryAllocationCount) {
+	MockVulkanDevice& device = mockDevice();
+	device.reset();
+	device.memoryProperties.memoryHeapCount = 2;
+	device.memoryProperties.memoryHeaps[0] = { 8ull << 30, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT };
+	device.memoryProperties.memoryHeaps[1] = { 256ull << 20, 0 };
+	device.memoryProperties.memoryTypeCount = 2;
+	device.memoryProperties.memoryTypes[0] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 };
+	device.memoryProperties.memoryTypes[1] = { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1 };
+	device.bufferImageGranularity = 1024;
+	device.maxMemoryAllocationCount = maxMemoryAllocationCount;
+	device.budgetSupported = true;
+}
+
+struct LiveAllocation {
+	vkimpl::MemoryAllocation allocation;
+	VkDeviceSize alignment;
+	bool optimalImage;
+};
+
+//--------------------------------------------------------------------------------------------------
+// The allocations agree with the device and the counters of the allocator and its tracker agree
+// with the live allocations and the live device memories
+//
+void checkMemoryAllocator(vkimpl::VulkanMemoryAllocator& allocator, const std::vector<LiveAllocation>& live) {
+	MockVulkanDevice& device = mockDevice();
+	check(device.errors.empty(), device.errors.empty() ? std::string() : "device misuse: " + device.errors.front() + "!");
+
+	std::map<VkDeviceMemory, std::vector<Range>> rangesByMemory;
+	std::map<VkDeviceMemory, bool> optimalByMemory;
+	VkDeviceSize usedBytes = 0;
+	for (const LiveAllocation& live : live) {
+		const vkimpl::MemoryAllocation& allocation = live.allocation;
+		rangesByMemory[allocation.memory].push_back({ allocation.offset, allocation.size });
+		usedBytes += allocation.size;
+		if (allocation.strategy != vkimpl::MemoryStrategy::Dedicated) {
+			auto optimal = optimalByMemory.emplace(allocation.memory, live.optimalImage);
+			check(optimal.first->second == live.optimalImage, "buffer and optimal image share a block!");
+		}
+	}
+	for (auto& ranges : rangesByMemory)
+		checkNoOverlap(ranges.second, "allocations of a memory overlap!");
+
+	VkDeviceSize heapReservedBytes[2] = {};
+	VkDeviceSize reservedBytes = 0;
+	for (const auto& memory : device.memories) {
+		heapReservedBytes[device.memoryProperties.memoryTypes[memory.second.memoryTypeIndex].heapIndex] += memory.second.size;
+		reservedBytes += memory.second.size;
+	}
+
+	vkimpl::MemoryAllocatorStats stats = allocator.getStats();
+	check(stats.allocationCount() == live.size(), "allocation counters do not match the live allocations!");
+	check(stats.usedBytes == usedBytes, "used bytes do not match the live allocations!");
+	check(stats.deviceMemoryCount == device.memories.size(), "device memory count does not match the device!");
+	check(stats.reservedBytes == reservedBytes, "reserved bytes do not match the device!");
+	check(stats.deviceMemoryCount == stats.blockCount + stats.dedicatedCount, "device memories are neither blocks nor dedicated!");
+
+	vkimpl::MemoryReport report = allocator.m_tracker.getReport();
+	VkDeviceSize trackedBytes = 0;
+	for (size_t i = 0; i < report.heaps.size(); i++) {
+		check(report.heaps[i].reservedBytes == heapReservedBytes[i], "tracked reserved bytes do not match the device!");
+		check(report.heaps[i].usage == heapReservedBytes[i], "heap usage does not match the device!");
+		trackedBytes += report.heaps[i].trackedBytes;
+	}
+	check(trackedBytes == usedBytes && report.allocations.size() == live.size(), "tracked allocations do not match the live allocations!");
+}
+
+//--------------------------------------------------------------------------------------------------
+// Random allocations of every strategy: uniform buffers in slabs, geometry buffers and textures in
+// TLSF blocks, staging buffers in linear blocks and large or driver preferred resources in dedicated
+// memory. Every allocation is checked against the device, the whole state is checked periodically.
+// Freeing everything must leave no allocation, and destroy no device memory.
+//
+void testMemoryAllocator(std::mt19937_64& rng) {
+	setupMockDevice(4096);
+	MockVulkanDevice& device = mockDevice();
+	vkimpl::VulkanMemoryAllocator allocator;
+	allocator.init(reinterpret_cast<VkPhysicalDevice>(1), reinterpret_cast<VkDevice>(1));
+
+	std::vector<LiveAllocation> live;
+	uint64_t nextResource = 1;
+	for (int i = 0; i < 200000; i++) {
+		bool allocate = live.empty() || rng() % 100 < (live.size() < 1000 ? 60u : 40u);
+		if (!allocate) {
+			size_t index = rng() % live.size();
+			allocator.free(live[index].allocation);
+			check(live[index].allocation.memory == VK_NULL_HANDLE, "freed allocation was not cleared!");
+			live[index] = live.back();
+			live.pop_back();
+		}
+		else {
+			uint32_t kind = rng() % 100;
+			VkDeviceSize alignment = 1ull << (rng() % 9 + 4);
+			VkDeviceSize size = 0;
+			VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			device.prefersDedicated = rng() % 50 == 0;
+
+			LiveAllocation allocation{};
+			allocation.alignment = alignment;
+			if (kind < 40) {
+				size = rng() % (16 * 1024) + 1;
+				properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+				device.requirements = { size, alignment, 0x3 };
+				allocation.allocation = allocator.allocateBufferMemory(reinterpret_cast<VkBuffer>(nextResource++), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, properties);
+			}
+			else if (kind < 65) {
+				size = rng() % (4 << 20) + 1;
+				device.requirements = { size, alignment, 0x3 };
+				allocation.allocation = allocator.allocateBufferMemory(reinterpret_cast<VkBuffer>(nextResource++), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties);
+			}
+			else if (kind < 80) {
+				size = rng() % (1 << 20) + 1;
+				properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+				device.requirements = { size, alignment, 0x3 };
+				allocation.allocation = allocator.allocateBufferMemory(reinterpret_cast<VkBuffer>(nextResource++), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, properties);
+			}
+			else if (kind < 98) {
+				size = rng() % (8 << 20) + 1;
+				device.requirements = { size, alignment, 0x3 };
+				allocation.optimalImage = true;
+				allocation.allocation = allocator.allocateImageMemory(reinterpret_cast<VkImage>(nextResource++), VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, properties);
+			}
+			else {
+				size = rng() % (40 << 20) + 1;
+				device.prefersDedicated = false;
+				VkMemoryRequirements requirements{ size, alignment, 0x3 };
+				allocation.allocation = allocator.allocateSharedMemory(requirements, properties, vkimpl::MemoryCategory::Attachments, nextResource++);
+			}
+
+			const vkimpl::MemoryAllocation& memoryAllocation = allocation.allocation;
+			auto memory = device.memories.find(memoryAllocation.memory);
+			check(memory != device.memories.end(), "allocation is not in a live device memory!");
+			check(memoryAllocation.offset % alignment == 0, "allocation is not aligned!");
+			check(memoryAllocation.size >= size, "allocation is smaller than its requirements!");
+			check(memoryAllocation.offset + memoryAllocation.size <= memory->second.size, "allocation is out of its device memory!");
+			VkMemoryPropertyFlags memoryProperties = device.memoryProperties.memoryTypes[memory->second.memoryTypeIndex].propertyFlags;
+			check((memoryProperties & properties) == properties && memoryAllocation.memoryTypeIndex == memory->second.memoryTypeIndex, "allocation is in a memory type without its properties!");
+			bool hostVisible = memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+			check(memoryAllocation.mapped == (hostVisible ? memory->second.data + memoryAllocation.offset : nullptr), "mapped pointer is not at the offset of the allocation!");
+			check(!device.prefersDedicated || memoryAllocation.strategy == vkimpl::MemoryStrategy::Dedicated, "driver preferred dedicated memory was suballocated!");
+			check((memoryAllocation.strategy == vkimpl::MemoryStrategy::Dedicated) == memory->second.dedicated || kind >= 98, "dedicated allocation info does not match the strategy!");
+			live.push_back(allocation);
+		}
+
+		if (i % 10000 == 0) {
+			checkMemoryAllocator(allocator, live);
+			vkimpl::MemoryAllocatorStats stats = allocator.getStats();
+			std::cout << "memory allocator op " << i << ": " << live.size() << " allocations in " << stats.deviceMemoryCount << " memories ("
+				<< stats.blockCount << " blocks, " << stats.dedicatedCount << " dedicated)" << std::endl;
+		}
+	}
+
+	checkMemoryAllocator(allocator, live);
+	for (LiveAllocation& allocation : live)
+		allocator.free(allocation.allocation);
+	live.clear();
+	checkMemoryAllocator(allocator, live);
+	check(allocator.getStats().dedicatedCount == 0, "dedicated memory outlived its allocation!");
+
+	allocator.destroy();
+	check(device.memories.empty(), "device memory is still alive after destroy!");
+	check(device.errors.empty(), "device was misused during destroy!");
+}
+
+//--------------------------------------------------------------------------------------------------
+// The allocator refuses to allocate past maxMemoryAllocationCount instead of letting the driver fail
+//
+void testMaxMemoryAllocationCount() {
+	setupMockDevice(8);
+	MockVulkanDevice& device = mockDevice();
+	vkimpl::VulkanMemoryAllocator allocator;
+	allocator.init(reinterpret_cast<VkPhysicalDevice>(1), reinterpret_cast<VkDevice>(1));
+
+	std::vector<vkimpl::MemoryAllocation> allocations;
+	bool refused = false;
+	device.prefersDedicated = true;
+	device.requirements = { 1024, 256, 0x3 };
+	for (uint64_t resource = 1; resource <= 9 && !refused; resource++) {
+		try {
+			allocations.push_back(allocator.allocateBufferMemory(reinterpret_cast<VkBuffer>(resource), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 0));
+		}
+		catch (const std::runtime_error&) {
+			refused = true;
+		}
+	}
+	check(refused && allocations.size() == 8, "allocation past maxMemoryAllocationCount was not refused!");
+	check(device.errors.empty(), "device saw more memories than maxMemoryAllocationCount!");
+
+	for (vkimpl::MemoryAllocation& allocation : allocations)
+		allocator.free(allocation);
+	allocator.destroy();
+	check(device.memories.empty() && device.errors.empty(), "device memory is still alive after destroy!");
+}
+
+}
+
+int main(int argc, char* argv[]) {
+	uint64_t seed = argc > 1 ? std::stoull(argv[1]) : 7;
+	std::mt19937_64 rng(seed);
+	try {
+		testTlsfAllocator(rng);
+		testLinearAllocator();
+		testSlotAllocator(rng);
+		testMemoryAllocator(rng);
+		testMaxMemoryAllocationCount();
+	}
+	catch (const std::exception& e) {
+		std::cerr << "seed " << seed << ": " << e.what() << std::endl;
+		return 1;
+	}
+	std::cout << "all allocator invariants hold" << std::endl;
+	return 0;
+}
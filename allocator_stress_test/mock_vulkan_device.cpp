@@ -0,0 +1,153 @@
+#include "mock_vulkan_device.h"
+
+#include <cstdlib>
+#include <cstring>
+
+/**
+* The implementation of struct MockVulkanDevice
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Forget the state of the previous test, memories still alive are leaked on purpose
+//
+void MockVulkanDevice::reset() {
+	*this = MockVulkanDevice();
+}
+
+MockVulkanDevice& mockDevice() {
+	static MockVulkanDevice device;
+	return device;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Requirements of a buffer or an image, the allocator asks for the dedicated requirements in pNext
+//
+static void getMemoryRequirements(const void* resource, VkMemoryRequirements2* pMemoryRequirements) {
+	MockVulkanDevice& device = mockDevice();
+	if (resource == nullptr)
+		device.errors.push_back("memory requirements of a null resource");
+	pMemoryRequirements->memoryRequirements = device.requirements;
+
+	auto dedicatedRequirements = static_cast<VkMemoryDedicatedRequirements*>(pMemoryRequirements->pNext);
+	if (dedicatedRequirements == nullptr || dedicatedRequirements->sType != VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS) {
+		device.errors.push_back("memory requirements queried without VkMemoryDedicatedRequirements");
+		return;
+	}
+	dedicatedRequirements->prefersDedicatedAllocation = device.prefersDedicated;
+	dedicatedRequirements->requiresDedicatedAllocation = VK_FALSE;
+}
+
+/**
+* The vk entry points
+*/
+
+extern "C" {
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice physicalDevice, VkPhysicalDeviceMemoryProperties* pMemoryProperties) {
+	*pMemoryProperties = mockDevice().memoryProperties;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceMemoryProperties2* pMemoryProperties) {
+	MockVulkanDevice& device = mockDevice();
+	pMemoryProperties->memoryProperties = device.memoryProperties;
+	auto budgetProperties = static_cast<VkPhysicalDeviceMemoryBudgetPropertiesEXT*>(pMemoryProperties->pNext);
+	if (budgetProperties == nullptr)
+		return;
+	if (!device.budgetSupported)
+		device.errors.push_back("memory budget queried without VK_EXT_memory_budget");
+	for (uint32_t i = 0; i < device.memoryProperties.memoryHeapCount; i++) {
+		budgetProperties->heapBudget[i] = device.memoryProperties.memoryHeaps[i].size;
+		budgetProperties->heapUsage[i] = 0;
+	}
+	for (const auto& memory : device.memories)
+		budgetProperties->heapUsage[device.memoryProperties.memoryTypes[memory.second.memoryTypeIndex].heapIndex] += memory.second.size;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties* pProperties) {
+	MockVulkanDevice& device = mockDevice();
+	std::memset(pProperties, 0, sizeof(VkPhysicalDeviceProperties));
+	pProperties->limits.bufferImageGranularity = device.bufferImageGranularity;
+	pProperties->limits.maxMemoryAllocationCount = device.maxMemoryAllocationCount;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(VkPhysicalDevice physicalDevice, const char* pLayerName, uint32_t* pPropertyCount, VkExtensionProperties* pProperties) {
+	uint32_t count = mockDevice().budgetSupported ? 1 : 0;
+	if (pProperties == nullptr) {
+		*pPropertyCount = count;
+		return VK_SUCCESS;
+	}
+	if (count > 0 && *pPropertyCount > 0) {
+		std::memset(&pProperties[0], 0, sizeof(VkExtensionProperties));
+		std::strcpy(pProperties[0].extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+	*pPropertyCount = count < *pPropertyCount ? count : *pPropertyCount;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements2(VkDevice device, const VkBufferMemoryRequirementsInfo2* pInfo, VkMemoryRequirements2* pMemoryRequirements) {
+	getMemoryRequirements(pInfo->buffer, pMemoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements2(VkDevice device, const VkImageMemoryRequirementsInfo2* pInfo, VkMemoryRequirements2* pMemoryRequirements) {
+	getMemoryRequirements(pInfo->image, pMemoryRequirements);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice device, const VkMemoryAllocateInfo* pAllocateInfo, const VkAllocationCallbacks* pAllocator, VkDeviceMemory* pMemory) {
+	MockVulkanDevice& mock = mockDevice();
+	if (pAllocateInfo->memoryTypeIndex >= mock.memoryProperties.memoryTypeCount) {
+		mock.errors.push_back("allocation of an unknown memory type");
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	}
+	if (mock.memories.size() >= mock.maxMemoryAllocationCount) {
+		mock.errors.push_back("more memories than maxMemoryAllocationCount");
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	}
+	bool dedicated = false;
+	auto dedicatedInfo = static_cast<const VkMemoryDedicatedAllocateInfo*>(pAllocateInfo->pNext);
+	if (dedicatedInfo != nullptr) {
+		dedicated = true;
+		if (dedicatedInfo->sType != VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO || (dedicatedInfo->buffer == VK_NULL_HANDLE) == (dedicatedInfo->image == VK_NULL_HANDLE))
+			mock.errors.push_back("dedicated allocation without exactly one resource");
+	}
+
+	//Pages are only touched through mapped pointers, so large blocks stay cheap
+	char* data = static_cast<char*>(std::malloc(static_cast<size_t>(pAllocateInfo->allocationSize)));
+	if (data == nullptr)
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	*pMemory = reinterpret_cast<VkDeviceMemory>(data);
+	mock.memories[*pMemory] = { pAllocateInfo->allocationSize, pAllocateInfo->memoryTypeIndex, dedicated, data, false };
+	mock.allocateCount++;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* pAllocator) {
+	MockVulkanDevice& mock = mockDevice();
+	if (memory == VK_NULL_HANDLE)
+		return;
+	auto it = mock.memories.find(memory);
+	if (it == mock.memories.end()) {
+		mock.errors.push_back("free of a memory that is not alive");
+		return;
+	}
+	std::free(it->second.data);
+	mock.memories.erase(it);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, VkMemoryMapFlags flags, void** ppData) {
+	MockVulkanDevice& mock = mockDevice();
+	auto it = mock.memories.find(memory);
+	if (it == mock.memories.end()) {
+		mock.errors.push_back("map of a memory that is not alive");
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	}
+	MockDeviceMemory& deviceMemory = it->second;
+	if (deviceMemory.mapped)
+		mock.errors.push_back("map of a memory already mapped");
+	if (!(mock.memoryProperties.memoryTypes[deviceMemory.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+		mock.errors.push_back("map of a memory that is not host visible");
+	deviceMemory.mapped = true;
+	*ppData = deviceMemory.data + offset;
+	return VK_SUCCESS;
+}
+
+}
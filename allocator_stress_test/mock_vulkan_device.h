@@ -0,0 +1,42 @@
+#ifndef MOCK_VULKAN_DEVICE
+#define MOCK_VULKAN_DEVICE
+
+#include <vulkan/vulkan_core.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Device behind the vk entry points used by vkimpl::VulkanMemoryAllocator and its tracker.
+// Memory types, limits and the requirements returned for the next buffer or image are set by the
+// test, device memory is plain host memory so mapped pointers can be checked. Misuse of the API is
+// recorded in errors instead of crashing, the test fails if any is left.
+//
+struct MockDeviceMemory {
+	VkDeviceSize size;
+	uint32_t memoryTypeIndex;
+	bool dedicated;
+	char* data;
+	bool mapped;
+};
+
+struct MockVulkanDevice {
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	VkDeviceSize bufferImageGranularity{ 1 };
+	uint32_t maxMemoryAllocationCount{ 4096 };
+	bool budgetSupported{ false };
+
+	//Returned by the next vkGet*MemoryRequirements2
+	VkMemoryRequirements requirements{};
+	bool prefersDedicated{ false };
+
+	std::unordered_map<VkDeviceMemory, MockDeviceMemory> memories;
+	uint64_t allocateCount{ 0 };
+	std::vector<std::string> errors;
+
+	void reset();
+};
+
+MockVulkanDevice& mockDevice();
+#endif // !MOCK_VULKAN_DEVICE
@@ -40,6 +40,7 @@ endfunction()
 # VULKAN_TARGET : to define the vulkan target i.e vulkan1.2 (default vulkan1.1)
 # HEADER ON: if ON, will generate headers instead of binary Spir-V files
 # DEPENDENCY : ON|OFF will create the list of dependencies for the GLSL source file
+# VALIDATE ON: if ON, the generated Spir-V is checked by the Spir-V validator (--spirv-val)
 # 
 # compile_glsl(
 #   SOURCES_FILES foo.vert foo.frag
@@ -48,7 +49,7 @@ endfunction()
 # )
 #
 function(compile_glsl)
-  set(oneValueArgs DST VULKAN_TARGET HEADER DEPENDENCY FLAGS)
+  set(oneValueArgs DST VULKAN_TARGET HEADER DEPENDENCY FLAGS VALIDATE)
   set(multiValueArgs SHADER_SOURCE_FILES SHADER_HEADER_FILES)
   cmake_parse_arguments(COMPILE  "${options}" "${oneValueArgs}" "${multiValueArgs}" ${ARGN} )
 
@@ -98,6 +99,11 @@ function(compile_glsl)
     # Default compiler command, always adding debug information (Add and option to opt-out?)
     set(COMPILE_CMD  ${_FLG} --target-env ${COMPILE_VULKAN_TARGET})
 
+    # The validator flag is not passed to the dependency search, glslc does not know it
+    if(COMPILE_VALIDATE)
+        list(APPEND COMPILE_CMD --spirv-val)
+    endif()
+
     # Compilation to headers need a variable name, the output will be a .h
     get_filename_component(FILE_NAME ${GLSL_SRC} NAME)
     if(COMPILE_HEADER)           
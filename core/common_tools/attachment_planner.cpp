@@ -0,0 +1,81 @@
+#include "attachment_planner.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+inline uint64_t alignUp(uint64_t offset, uint64_t alignment) {
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+inline bool passesOverlap(const AttachmentRequest& a, const AttachmentRequest& b) {
+	return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+}
+
+}
+
+//--------------------------------------------------------------------------------------------------
+// Place the attachments in groups of memory, the largest first
+//
+AttachmentPlan planAttachmentMemory(const std::vector<AttachmentRequest>& attachments) {
+	AttachmentPlan plan;
+	plan.attachmentGroups.resize(attachments.size());
+	plan.attachmentOffsets.resize(attachments.size());
+	std::vector<size_t> order(attachments.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return attachments[a].size > attachments[b].size; });
+
+	std::vector<std::vector<size_t>> groupAttachments;
+	for (size_t i : order) {
+		const AttachmentRequest& attachment = attachments[i];
+		plan.requestedBytes += attachment.size;
+		bool placed = false;
+		for (size_t g = 0; g < plan.groups.size() && !placed; g++) {
+			AttachmentPlan::Group& group = plan.groups[g];
+			if (group.lazy != attachment.lazy || (group.memoryTypeBits & attachment.memoryTypeBits) == 0)
+				continue;
+
+			//Ranges taken by the attachments of the group in use in the same passes, by offset
+			std::vector<std::pair<uint64_t, uint64_t>> taken;
+			for (size_t j : groupAttachments[g]) {
+				if (passesOverlap(attachment, attachments[j]))
+					taken.push_back({ plan.attachmentOffsets[j], plan.attachmentOffsets[j] + attachments[j].size });
+			}
+			std::sort(taken.begin(), taken.end());
+			uint64_t offset = 0;
+			for (const auto& range : taken) {
+				if (alignUp(offset, attachment.alignment) + attachment.size <= range.first)
+					break;
+				offset = std::max(offset, range.second);
+			}
+			offset = alignUp(offset, attachment.alignment);
+			if (offset + attachment.size > group.size)
+				continue;
+
+			group.memoryTypeBits &= attachment.memoryTypeBits;
+			group.alignment = std::max(group.alignment, attachment.alignment);
+			groupAttachments[g].push_back(i);
+			plan.attachmentGroups[i] = static_cast<uint32_t>(g);
+			plan.attachmentOffsets[i] = offset;
+			placed = true;
+		}
+		if (placed)
+			continue;
+
+		AttachmentPlan::Group group;
+		group.size = attachment.size;
+		group.alignment = attachment.alignment;
+		group.memoryTypeBits = attachment.memoryTypeBits;
+		group.lazy = attachment.lazy;
+		plan.groups.push_back(group);
+		groupAttachments.push_back({ i });
+		plan.attachmentGroups[i] = static_cast<uint32_t>(plan.groups.size() - 1);
+		plan.attachmentOffsets[i] = 0;
+	}
+	for (const AttachmentPlan::Group& group : plan.groups) {
+		plan.plannedBytes += group.size;
+		plan.lazyBytes += group.lazy ? group.size : 0;
+	}
+	return plan;
+}
@@ -0,0 +1,41 @@
+#ifndef ATTACHMENT_PLANNER_COMMON
+#define ATTACHMENT_PLANNER_COMMON
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+//Render target of a frame. Passes are numbered in their order in the frame, the attachment is in use
+//from firstPass to lastPass included.
+struct AttachmentRequest {
+	uint64_t size{ 0 };
+	uint64_t alignment{ 1 };
+	uint32_t memoryTypeBits{ 0 };   //Memory types the attachment can be bound to
+	uint32_t firstPass{ 0 };
+	uint32_t lastPass{ 0 };
+	bool lazy{ false };             //Never leaves the render passes, may live in lazily allocated memory
+};
+
+//Memory of the attachments: groups of memory shared by attachments whose passes never overlap
+struct AttachmentPlan {
+	struct Group {
+		uint64_t size{ 0 };
+		uint64_t alignment{ 1 };
+		uint32_t memoryTypeBits{ 0 };
+		bool lazy{ false };
+	};
+	std::vector<Group> groups;
+	std::vector<uint32_t> attachmentGroups;    //Group of every attachment
+	std::vector<uint64_t> attachmentOffsets;   //Offset of every attachment in its group
+	uint64_t requestedBytes{ 0 };   //Attachments in memory of their own
+	uint64_t plannedBytes{ 0 };     //Groups, lazy ones included
+	uint64_t lazyBytes{ 0 };        //Lazy groups
+};
+
+//--------------------------------------------------------------------------------------------------
+// Place the attachments in groups of memory, the largest first. An attachment takes the lowest
+// offset of the first group where it overlaps no attachment in use in the same passes, a new group
+// is added if none has room. Groups only hold attachments that are all lazy or all not, and share a
+// memory type.
+//
+AttachmentPlan planAttachmentMemory(const std::vector<AttachmentRequest>& attachments);
+#endif // !ATTACHMENT_PLANNER_COMMON
@@ -0,0 +1,343 @@
+#include "binary_cache.h"
+#include "tools.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+const char cacheMagic[8] = { 'V', 'M', 'V', 'C', 'A', 'C', 'H', 'E' };
+const uint32_t cacheFormatVersion = 1;
+const uint64_t sectionAlignment = 64;
+const size_t hashBlockSize = 4 << 20;
+
+struct CacheHeader {
+	char magic[8];
+	uint32_t formatVersion;
+	uint32_t contentVersion;
+	uint32_t dependencyCount;
+	uint32_t sectionCount;
+	uint64_t dependencyOffset;
+	uint64_t sectionTableOffset;
+};
+
+struct DependencyEntry {
+	FileStamp stamp;
+	uint64_t pathLength;
+};
+
+struct SectionTableEntry {
+	uint32_t id;
+	uint32_t reserved;
+	uint64_t offset;
+	uint64_t size;
+};
+
+inline uint64_t alignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+inline uint64_t mix64(uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Hash one block of the file, four independent lanes keep the multiplier busy
+//
+uint64_t hashBlock(const char* data, size_t size, uint64_t seed) {
+	uint64_t lanes[4] = { seed, seed ^ 0x9E3779B97F4A7C15ull, seed ^ 0xC2B2AE3D27D4EB4Full, seed ^ 0x165667B19E3779F9ull };
+	size_t wordCount = size / sizeof(uint64_t);
+	for (size_t i = 0; i < wordCount; i++) {
+		uint64_t word;
+		std::memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+		uint64_t& lane = lanes[i % 4];
+		lane = (lane ^ word) * 0x9FB21C651E98DF25ull;
+		lane = lane << 31 | lane >> 33;
+	}
+	uint64_t tail = 0;
+	std::memcpy(&tail, data + wordCount * sizeof(uint64_t), size % sizeof(uint64_t));
+	return mix64(lanes[0] ^ mix64(lanes[1]) ^ mix64(lanes[2] + 1) ^ mix64(lanes[3] + 2) ^ mix64(tail + size));
+}
+
+int64_t getModifiedTime(const std::string& path) {
+	return static_cast<int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Hash the contents of a file, blocks are hashed in parallel and combined in order
+//
+uint64_t hashFileContents(const std::string& path) {
+	MappedFile file(path);
+	size_t blockCount = (file.size() + hashBlockSize - 1) / hashBlockSize;
+	std::vector<uint64_t> blockHashes(blockCount);
+	parallel_for(blockCount, [&](size_t block) {
+		size_t offset = block * hashBlockSize;
+		blockHashes[block] = hashBlock(file.data() + offset, std::min(hashBlockSize, file.size() - offset), block);
+	});
+
+	uint64_t hash = mix64(file.size());
+	for (uint64_t blockHash : blockHashes)
+		hash = mix64(hash ^ blockHash) * 0x9E3779B97F4A7C15ull;
+	return hash;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Hash the contents of a file like hashFileContents, but on the calling thread from reads of one
+// block at a time. For callers that already hash many files in parallel.
+//
+uint64_t hashFileStream(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open file " + path + "!");
+	}
+	std::vector<char> buffer(hashBlockSize);
+	uint64_t size = 0;
+	std::vector<uint64_t> blockHashes;
+	for (uint64_t block = 0; file; block++) {
+		file.read(buffer.data(), buffer.size());
+		size_t readSize = static_cast<size_t>(file.gcount());
+		if (readSize == 0)
+			break;
+		blockHashes.push_back(hashBlock(buffer.data(), readSize, block));
+		size += readSize;
+	}
+	if (file.bad()) {
+		throw std::runtime_error("failed to read file " + path + "!");
+	}
+
+	uint64_t hash = mix64(size);
+	for (uint64_t blockHash : blockHashes)
+		hash = mix64(hash ^ blockHash) * 0x9E3779B97F4A7C15ull;
+	return hash;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Compare two files byte by byte, one block at a time on the calling thread. Throws if one can't be
+// read.
+//
+bool sameFileContents(const std::string& path0, const std::string& path1) {
+	if (path0 == path1)
+		return true;
+	std::ifstream file0(path0, std::ios::binary), file1(path1, std::ios::binary);
+	if (!file0.is_open() || !file1.is_open()) {
+		throw std::runtime_error("failed to open file " + (file0.is_open() ? path1 : path0) + "!");
+	}
+	if (std::filesystem::file_size(path0) != std::filesystem::file_size(path1))
+		return false;
+
+	std::vector<char> buffer0(hashBlockSize), buffer1(hashBlockSize);
+	while (file0 && file1) {
+		file0.read(buffer0.data(), buffer0.size());
+		file1.read(buffer1.data(), buffer1.size());
+		if (file0.gcount() != file1.gcount() || std::memcmp(buffer0.data(), buffer1.data(), static_cast<size_t>(file0.gcount())) != 0)
+			return false;
+	}
+	if (file0.bad() || file1.bad()) {
+		throw std::runtime_error("failed to read file " + (file0.bad() ? path0 : path1) + "!");
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Get size, modification time and optionally the content hash of a file
+//
+FileStamp getFileStamp(const std::string& path, bool hashContent) {
+	FileStamp stamp{};
+	stamp.size = std::filesystem::file_size(path);
+	stamp.modifiedTime = getModifiedTime(path);
+	if (hashContent)
+		stamp.contentHash = hashFileContents(path);
+	return stamp;
+}
+
+/**
+* The implementation of class BinaryCacheWriter
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Record a source file, the cache becomes stale when it changes
+//
+void BinaryCacheWriter::addDependency(const std::string& path) {
+	m_dependencies.push_back({ path, getFileStamp(path) });
+}
+
+//--------------------------------------------------------------------------------------------------
+// Add a section, the data has to stay alive until write() returns
+//
+void BinaryCacheWriter::addSection(uint32_t id, const void* data, size_t size) {
+	m_sections.push_back({ id, data, size });
+}
+
+//--------------------------------------------------------------------------------------------------
+// Write the cache to a temporary file and move it over the destination
+//
+void BinaryCacheWriter::write(const std::string& path) {
+	//Lay out header, dependencies, section table and the aligned sections
+	CacheHeader header{};
+	std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.formatVersion = cacheFormatVersion;
+	header.contentVersion = m_contentVersion;
+	header.dependencyCount = static_cast<uint32_t>(m_dependencies.size());
+	header.sectionCount = static_cast<uint32_t>(m_sections.size());
+	header.dependencyOffset = sizeof(CacheHeader);
+
+	uint64_t offset = header.dependencyOffset;
+	for (const auto& dependency : m_dependencies)
+		offset += alignUp(sizeof(DependencyEntry) + dependency.first.size(), 8);
+	header.sectionTableOffset = offset;
+	offset += sizeof(SectionTableEntry) * m_sections.size();
+
+	std::vector<SectionTableEntry> sectionTable;
+	for (const Section& section : m_sections) {
+		offset = alignUp(offset, sectionAlignment);
+		sectionTable.push_back({ section.id, 0, offset, section.size });
+		offset += section.size;
+	}
+
+	//Write everything
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open cache file for writing!");
+		}
+		const char padding[sectionAlignment] = {};
+		auto padTo = [&](uint64_t position) {
+			uint64_t current = static_cast<uint64_t>(file.tellp());
+			if (position > current)
+				file.write(padding, std::streamsize(position - current));
+		};
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (const auto& dependency : m_dependencies) {
+			DependencyEntry entry{ dependency.second, dependency.first.size() };
+			uint64_t entryEnd = static_cast<uint64_t>(file.tellp()) + alignUp(sizeof(DependencyEntry) + dependency.first.size(), 8);
+			file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+			file.write(dependency.first.data(), std::streamsize(dependency.first.size()));
+			padTo(entryEnd);
+		}
+		file.write(reinterpret_cast<const char*>(sectionTable.data()), std::streamsize(sizeof(SectionTableEntry) * sectionTable.size()));
+		for (size_t i = 0; i < m_sections.size(); i++) {
+			padTo(sectionTable[i].offset);
+			file.write(static_cast<const char*>(m_sections[i].data), std::streamsize(m_sections[i].size));
+		}
+		if (!file.good()) {
+			file.close();
+			std::filesystem::remove(tempPath);
+			throw std::runtime_error("failed to write cache file!");
+		}
+	}
+	std::filesystem::rename(tempPath, path);
+}
+
+/**
+* The implementation of class BinaryCacheReader
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Map a cache file and check it against its version and source files.
+// Returns false with m_rejectReason set if the cache can't be used.
+//
+bool BinaryCacheReader::open(const std::string& path, uint32_t contentVersion) {
+	close();
+	auto reject = [&](const std::string& reason) {
+		m_rejectReason = reason;
+		close();
+		return false;
+	};
+
+	std::error_code errorCode;
+	if (!std::filesystem::exists(path, errorCode))
+		return reject("no cache file");
+	try {
+		m_file.open(path);
+	}
+	catch (const std::runtime_error& e) {
+		return reject(e.what());
+	}
+
+	//Header
+	const char* data = m_file.data();
+	uint64_t size = m_file.size();
+	CacheHeader header;
+	if (size < sizeof(header))
+		return reject("truncated header");
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0)
+		return reject("not a cache file");
+	if (header.formatVersion != cacheFormatVersion || header.contentVersion != contentVersion)
+		return reject("version mismatch");
+
+	//Dependencies
+	uint64_t offset = header.dependencyOffset;
+	for (uint32_t i = 0; i < header.dependencyCount; i++) {
+		DependencyEntry entry;
+		if (offset + sizeof(entry) > size)
+			return reject("truncated dependency table");
+		std::memcpy(&entry, data + offset, sizeof(entry));
+		if (offset + sizeof(entry) + entry.pathLength > size)
+			return reject("truncated dependency table");
+		std::string dependencyPath(data + offset + sizeof(entry), entry.pathLength);
+		offset += alignUp(sizeof(entry) + entry.pathLength, 8);
+
+		if (!std::filesystem::exists(dependencyPath, errorCode))
+			return reject("missing source " + dependencyPath);
+		FileStamp current = getFileStamp(dependencyPath, false);
+		if (current.size != entry.stamp.size)
+			return reject("source changed " + dependencyPath);
+		if (current.modifiedTime != entry.stamp.modifiedTime && hashFileContents(dependencyPath) != entry.stamp.contentHash)
+			return reject("source changed " + dependencyPath);
+	}
+
+	//Sections
+	if (header.sectionTableOffset + sizeof(SectionEntry) * uint64_t(header.sectionCount) > size)
+		return reject("truncated section table");
+	m_sections.resize(header.sectionCount);
+	std::memcpy(m_sections.data(), data + header.sectionTableOffset, sizeof(SectionEntry) * header.sectionCount);
+	for (const SectionEntry& section : m_sections) {
+		if (section.offset > size || section.size > size - section.offset)
+			return reject("truncated section");
+	}
+
+	m_rejectReason.clear();
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Unmap the cache file
+//
+void BinaryCacheReader::close() {
+	m_file.close();
+	m_sections.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Get the mapped data of a section, nullptr if the section does not exist
+//
+const void* BinaryCacheReader::sectionData(uint32_t id, size_t& size) const {
+	for (const SectionEntry& section : m_sections) {
+		if (section.id == id) {
+			size = static_cast<size_t>(section.size);
+			return m_file.data() + section.offset;
+		}
+	}
+	size = 0;
+	return nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Check if a section exists
+//
+bool BinaryCacheReader::hasSection(uint32_t id) const {
+	size_t size;
+	return sectionData(id, size) != nullptr;
+}
@@ -0,0 +1,81 @@
+#ifndef BINARY_CACHE_COMMON
+#define BINARY_CACHE_COMMON
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "mapped_file.h"
+
+//Identity of a source file the cache was built from
+struct FileStamp {
+	uint64_t size{ 0 };
+	int64_t modifiedTime{ 0 };
+	uint64_t contentHash{ 0 };
+};
+
+FileStamp getFileStamp(const std::string& path, bool hashContent = true);
+uint64_t hashFileContents(const std::string& path);
+uint64_t hashFileStream(const std::string& path);
+bool sameFileContents(const std::string& path0, const std::string& path1);
+
+//--------------------------------------------------------------------------------------------------
+// Writer of versioned binary cache files made of raw, 64 byte aligned sections.
+// The section data is only referenced until write() is called.
+//
+class BinaryCacheWriter {
+public:
+	BinaryCacheWriter(uint32_t contentVersion = 0) : m_contentVersion(contentVersion) {};
+
+	void addDependency(const std::string& path);
+	void addSection(uint32_t id, const void* data, size_t size);
+	template <typename T>
+	void addSection(uint32_t id, const T* data, size_t count) {
+		addSection(id, static_cast<const void*>(data), count * sizeof(T));
+	}
+	void write(const std::string& path);
+
+	uint32_t m_contentVersion;
+
+private:
+	struct Section {
+		uint32_t id;
+		const void* data;
+		size_t size;
+	};
+	std::vector<std::pair<std::string, FileStamp>> m_dependencies;
+	std::vector<Section> m_sections;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Memory mapped reader of files written by BinaryCacheWriter.
+// A cache is rejected if its version differs or any dependency changed: a different size, or a
+// different modification time together with a different content hash.
+//
+class BinaryCacheReader {
+public:
+	bool open(const std::string& path, uint32_t contentVersion);
+	void close();
+
+	const void* sectionData(uint32_t id, size_t& size) const;
+	template <typename T>
+	const T* sectionArray(uint32_t id, size_t& count) const {
+		size_t size = 0;
+		const void* data = sectionData(id, size);
+		count = size / sizeof(T);
+		return static_cast<const T*>(data);
+	}
+	bool hasSection(uint32_t id) const;
+
+	std::string m_rejectReason;
+
+private:
+	struct SectionEntry {
+		uint32_t id;
+		uint32_t reserved;
+		uint64_t offset;
+		uint64_t size;
+	};
+	MappedFile m_file;
+	std::vector<SectionEntry> m_sections;
+};
+#endif // !BINARY_CACHE_COMMON
@@ -0,0 +1,233 @@
+#include "ktx2_file.h"
+#include "tools.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+const uint8_t ktx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+struct Ktx2Header {
+	uint8_t identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+
+struct Ktx2LevelEntry {
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+//Data format descriptor values of khr_df.h
+const uint32_t dfdPrimariesBT709 = 1;
+const uint32_t dfdTransferLinear = 1;
+const uint32_t dfdTransferSrgb = 2;
+const uint32_t dfdSampleLinear = 0x10;
+const uint32_t dfdChannelAlpha = 15;
+
+inline uint64_t levelSize(uint32_t width, uint32_t height, uint32_t level, TextureBlockFormat format) {
+	uint64_t levelWidth = std::max(width >> level, 1u), levelHeight = std::max(height >> level, 1u);
+	return (levelWidth + 3) / 4 * ((levelHeight + 3) / 4) * textureBlockBytes(format);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Basic data format descriptor of a block format, preceded by its total size
+//
+std::vector<uint32_t> dataFormatDescriptor(TextureBlockFormat format, bool srgb) {
+	struct Sample {
+		uint32_t bitOffset;
+		uint32_t bitLength;
+		uint32_t channel;
+	};
+	uint32_t colorModel = 0;
+	std::vector<Sample> samples;
+	switch (format) {
+	case TextureBlockFormat::BC1:
+		colorModel = 128;
+		samples = { { 0, 64, 0 } };
+		break;
+	case TextureBlockFormat::BC3:
+		colorModel = 130;
+		samples = { { 0, 64, dfdChannelAlpha | (srgb ? dfdSampleLinear : 0) }, { 64, 64, 0 } };
+		break;
+	case TextureBlockFormat::BC5:
+		colorModel = 132;
+		samples = { { 0, 64, 0 }, { 64, 64, 1 } };
+		break;
+	case TextureBlockFormat::BC7:
+		colorModel = 134;
+		samples = { { 0, 128, 0 } };
+		break;
+	}
+
+	uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+	std::vector<uint32_t> words = {
+		blockSize + 4,
+		0,
+		2 | blockSize << 16,
+		colorModel | dfdPrimariesBT709 << 8 | (srgb ? dfdTransferSrgb : dfdTransferLinear) << 16,
+		3 | 3 << 8,
+		static_cast<uint32_t>(textureBlockBytes(format)),
+		0
+	};
+	for (const Sample& sample : samples) {
+		words.push_back(sample.bitOffset | (sample.bitLength - 1) << 16 | sample.channel << 24);
+		words.push_back(0);
+		words.push_back(0);
+		words.push_back(0xFFFFFFFFu);
+	}
+	return words;
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Write the texture to a temporary file and move it over the destination
+//
+void writeKtx2File(const std::string& path, const CompressedTexture& texture) {
+	bool srgb = texture.srgb && texture.format != TextureBlockFormat::BC5;
+	std::vector<uint32_t> dfd = dataFormatDescriptor(texture.format, srgb);
+	uint32_t levelCount = static_cast<uint32_t>(texture.levels.size());
+
+	Ktx2Header header{};
+	std::memcpy(header.identifier, ktx2Identifier, sizeof(ktx2Identifier));
+	header.vkFormat = textureBlockVkFormat(texture.format, srgb);
+	header.typeSize = 1;
+	header.pixelWidth = texture.width;
+	header.pixelHeight = texture.height;
+	header.faceCount = 1;
+	header.levelCount = levelCount;
+	header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + sizeof(Ktx2LevelEntry) * levelCount);
+	header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+	//Level data starts behind the descriptor, smallest level first, every level aligned to its block size
+	uint64_t alignment = textureBlockBytes(texture.format);
+	std::vector<Ktx2LevelEntry> levelIndex(levelCount);
+	uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+	for (uint32_t level = levelCount; level-- > 0;) {
+		offset = align_up(offset, alignment);
+		levelIndex[level] = { offset, texture.levels[level].size(), texture.levels[level].size() };
+		offset += texture.levels[level].size();
+	}
+
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open texture file for writing!");
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(levelIndex.data()), std::streamsize(sizeof(Ktx2LevelEntry) * levelIndex.size()));
+		file.write(reinterpret_cast<const char*>(dfd.data()), std::streamsize(header.dfdByteLength));
+		const char padding[16] = {};
+		for (uint32_t level = levelCount; level-- > 0;) {
+			uint64_t current = static_cast<uint64_t>(file.tellp());
+			file.write(padding, std::streamsize(levelIndex[level].byteOffset - current));
+			file.write(reinterpret_cast<const char*>(texture.levels[level].data()), std::streamsize(texture.levels[level].size()));
+		}
+		if (!file.good()) {
+			file.close();
+			std::filesystem::remove(tempPath);
+			throw std::runtime_error("failed to write texture file!");
+		}
+	}
+	std::filesystem::rename(tempPath, path);
+}
+
+/**
+* The implementation of class Ktx2Reader
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Map a KTX2 file and validate its header and level index.
+// Returns false with m_rejectReason set if the file can't be used.
+//
+bool Ktx2Reader::open(const std::string& path) {
+	close();
+	auto reject = [&](const std::string& reason) {
+		m_rejectReason = reason;
+		close();
+		return false;
+	};
+	try {
+		m_file.open(path);
+	}
+	catch (const std::runtime_error& e) {
+		return reject(e.what());
+	}
+
+	const char* data = m_file.data();
+	uint64_t size = m_file.size();
+	Ktx2Header header;
+	if (size < sizeof(header))
+		return reject("truncated header");
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.identifier, ktx2Identifier, sizeof(ktx2Identifier)) != 0)
+		return reject("not a KTX2 file");
+	if (header.supercompressionScheme != 0)
+		return reject("supercompressed");
+	if (header.pixelDepth != 0 || header.layerCount != 0 || header.faceCount != 1 || header.pixelWidth == 0 || header.pixelHeight == 0)
+		return reject("not a 2D texture");
+	if (!findTextureBlockFormat(header.vkFormat, m_format, m_srgb))
+		return reject("unsupported format " + std::to_string(header.vkFormat));
+	uint32_t maxLevels = 1;
+	while ((std::max(header.pixelWidth, header.pixelHeight) >> maxLevels) > 0)
+		maxLevels++;
+	if (header.levelCount == 0 || header.levelCount > maxLevels)
+		return reject("invalid level count");
+
+	if (sizeof(header) + sizeof(LevelEntry) * uint64_t(header.levelCount) > size)
+		return reject("truncated level index");
+	m_levels.resize(header.levelCount);
+	std::memcpy(m_levels.data(), data + sizeof(header), sizeof(LevelEntry) * header.levelCount);
+	for (uint32_t level = 0; level < header.levelCount; level++) {
+		const LevelEntry& entry = m_levels[level];
+		if (entry.offset > size || entry.size > size - entry.offset)
+			return reject("truncated level");
+		if (entry.size != levelSize(header.pixelWidth, header.pixelHeight, level, m_format))
+			return reject("level size mismatch");
+	}
+
+	m_vkFormat = header.vkFormat;
+	m_width = header.pixelWidth;
+	m_height = header.pixelHeight;
+	m_rejectReason.clear();
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Unmap the file
+//
+void Ktx2Reader::close() {
+	m_file.close();
+	m_levels.clear();
+	m_vkFormat = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Get the mapped blocks of a mip level, level 0 is the full size
+//
+const uint8_t* Ktx2Reader::levelData(uint32_t level, size_t& size) const {
+	size = static_cast<size_t>(m_levels[level].size);
+	return reinterpret_cast<const uint8_t*>(m_file.data() + m_levels[level].offset);
+}
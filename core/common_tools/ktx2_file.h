@@ -0,0 +1,50 @@
+#ifndef KTX2_FILE_COMMON
+#define KTX2_FILE_COMMON
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "mapped_file.h"
+#include "texture_compression.h"
+
+//--------------------------------------------------------------------------------------------------
+// Write a block compressed texture as a KTX2 file without supercompression. The mip levels are
+// stored smallest first with a basic data format descriptor, throws if the file can't be written.
+//
+void writeKtx2File(const std::string& path, const CompressedTexture& texture);
+
+//--------------------------------------------------------------------------------------------------
+// Memory mapped reader of 2D KTX2 files in one of the cooked block formats.
+// A file is rejected if it is supercompressed, not a single 2D image, has no stored mip levels or
+// a level size that doesn't match its format.
+//
+class Ktx2Reader {
+public:
+	bool open(const std::string& path);
+	void close();
+
+	uint32_t vkFormat() const { return m_vkFormat; }
+	TextureBlockFormat format() const { return m_format; }
+	bool isSrgb() const { return m_srgb; }
+	uint32_t width() const { return m_width; }
+	uint32_t height() const { return m_height; }
+	uint32_t levelCount() const { return static_cast<uint32_t>(m_levels.size()); }
+	const uint8_t* levelData(uint32_t level, size_t& size) const;
+
+	std::string m_rejectReason;
+
+private:
+	struct LevelEntry {
+		uint64_t offset;
+		uint64_t size;
+		uint64_t uncompressedSize;
+	};
+	MappedFile m_file;
+	uint32_t m_vkFormat{ 0 };
+	TextureBlockFormat m_format{ TextureBlockFormat::BC1 };
+	bool m_srgb{ false };
+	uint32_t m_width{ 0 };
+	uint32_t m_height{ 0 };
+	std::vector<LevelEntry> m_levels;
+};
+#endif // !KTX2_FILE_COMMON
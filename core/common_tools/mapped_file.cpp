@@ -0,0 +1,150 @@
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Move constructor, the source no longer owns the mapping
+//
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+	*this = std::move(other);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Move assignment, the source no longer owns the mapping
+//
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		close();
+		std::swap(m_data, other.m_data);
+		std::swap(m_size, other.m_size);
+		std::swap(m_isEmpty, other.m_isEmpty);
+#ifdef _WIN32
+		std::swap(m_fileHandle, other.m_fileHandle);
+		std::swap(m_mappingHandle, other.m_mappingHandle);
+#else
+		std::swap(m_fd, other.m_fd);
+#endif
+	}
+	return *this;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Map the whole file into the address space for reading
+//
+void MappedFile::open(const std::string& filename) {
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("failed to open file!");
+	}
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		throw std::runtime_error("failed to query file size!");
+	}
+	m_fileHandle = file;
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+	if (m_size == 0) {
+		m_isEmpty = true;
+		return;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		close();
+		throw std::runtime_error("failed to map file!");
+	}
+	m_mappingHandle = mapping;
+	m_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr) {
+		close();
+		throw std::runtime_error("failed to map file!");
+	}
+#else
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("failed to open file!");
+	}
+	struct stat st {};
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		throw std::runtime_error("failed to query file size!");
+	}
+	m_fd = fd;
+	m_size = static_cast<size_t>(st.st_size);
+	if (m_size == 0) {
+		m_isEmpty = true;
+		return;
+	}
+	void* ptr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (ptr == MAP_FAILED) {
+		close();
+		throw std::runtime_error("failed to map file!");
+	}
+	madvise(ptr, m_size, MADV_WILLNEED);
+	m_data = static_cast<const char*>(ptr);
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+// Release the mapping and the file handle
+//
+void MappedFile::close() {
+#ifdef _WIN32
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mappingHandle)
+		CloseHandle(m_mappingHandle);
+	if (m_fileHandle)
+		CloseHandle(m_fileHandle);
+	m_mappingHandle = nullptr;
+	m_fileHandle = nullptr;
+#else
+	if (m_data)
+		munmap(const_cast<char*>(m_data), m_size);
+	if (m_fd >= 0)
+		::close(m_fd);
+	m_fd = -1;
+#endif
+	m_data = nullptr;
+	m_size = 0;
+	m_isEmpty = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Drop the resident pages of [offset, offset + size) from the process, they are read back from the
+// file on the next access. Used to keep the working set bounded while streaming through big files.
+//
+void MappedFile::evict(size_t offset, size_t size) const {
+	if (m_data == nullptr || offset >= m_size)
+		return;
+	size = std::min(size, m_size - offset);
+#ifdef _WIN32
+	//VirtualUnlock on pages that are not locked removes them from the working set
+	VirtualUnlock(const_cast<char*>(m_data + offset), size);
+#else
+	//Only whole pages inside the range can be dropped
+	size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t begin = (offset + pageSize - 1) / pageSize * pageSize;
+	size_t end = offset + size == m_size ? m_size : (offset + size) / pageSize * pageSize;
+	if (end > begin)
+		madvise(const_cast<char*>(m_data + begin), end - begin, MADV_DONTNEED);
+#endif
+}
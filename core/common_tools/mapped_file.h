@@ -0,0 +1,41 @@
+#ifndef MAPPED_FILE_COMMON
+#define MAPPED_FILE_COMMON
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+//--------------------------------------------------------------------------------------------------
+// Read-only memory mapping of a whole file. Uses CreateFileMapping on Windows and mmap elsewhere.
+// The mapping lives as long as the object, the object is movable but not copyable.
+//
+class MappedFile {
+public:
+	MappedFile() = default;
+	explicit MappedFile(const std::string& filename) { open(filename); }
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	void open(const std::string& filename);
+	void close();
+	void evict(size_t offset, size_t size) const;
+
+	bool isOpen() const { return m_data != nullptr || m_isEmpty; }
+	const char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	const char* m_data{ nullptr };
+	size_t m_size{ 0 };
+	bool m_isEmpty{ false };
+#ifdef _WIN32
+	void* m_fileHandle{ nullptr };
+	void* m_mappingHandle{ nullptr };
+#else
+	int m_fd{ -1 };
+#endif
+};
+#endif // !MAPPED_FILE_COMMON
@@ -0,0 +1,211 @@
+#ifndef MESH_BUILDER_COMMON
+#define MESH_BUILDER_COMMON
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+// Hash the raw bytes of a trivially copyable value.
+// Every 64 bit word is multiplied independently before the lanes are folded, so the loop has no
+// serial dependency and vectorizes; the result is finished with a murmur3 style avalanche.
+template <typename T>
+uint64_t hash_bytes(const T& value) {
+	static_assert(std::is_trivially_copyable_v<T>, "hash_bytes needs a trivially copyable type");
+	static_assert(sizeof(T) % sizeof(uint32_t) == 0, "hash_bytes needs a size multiple of 4 bytes");
+	constexpr uint64_t laneKeys[4] = { 0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0xD6E8FEB86659FD93ull };
+	constexpr size_t wordCount = sizeof(T) / sizeof(uint64_t);
+
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+	uint64_t lanes[4] = { 0, 0, 0, 0 };
+	for (size_t i = 0; i < wordCount; i++) {
+		uint64_t word;
+		std::memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+		lanes[i % 4] += (word ^ (word >> 29)) * laneKeys[i % 4];
+	}
+	if constexpr (sizeof(T) % sizeof(uint64_t) != 0) {
+		uint32_t tail;
+		std::memcpy(&tail, bytes + wordCount * sizeof(uint64_t), sizeof(uint32_t));
+		lanes[wordCount % 4] += uint64_t(tail) * laneKeys[(wordCount + 1) % 4];
+	}
+
+	uint64_t h = lanes[0] ^ (lanes[1] << 1 | lanes[1] >> 63) ^ (lanes[2] << 2 | lanes[2] >> 62) ^ (lanes[3] << 3 | lanes[3] >> 61);
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Single pass indexed mesh builder.
+// Vertices are deduplicated on all of their bytes through an open addressing (linear probing) table,
+// and the triangles of a shape are bucketed by material with a counting sort, so building a mesh
+// does not allocate per index once reserve() has been called with the corner count.
+// Groups come out in ascending material id order.
+//
+template <typename VertexT>
+class MeshBuilder {
+public:
+	struct Group {
+		uint32_t indexBase;
+		uint32_t indexCount;
+		int materialId;
+	};
+
+	MeshBuilder(std::vector<VertexT>& vertices, std::vector<uint32_t>& indices)
+		: m_vertices(vertices), m_indices(indices) {};
+
+	void reserve(size_t cornerCount, size_t materialCount);
+	void clear();
+	void beginShape();
+	void addTriangle(const VertexT (&corners)[3], int materialId);
+	void endShape(std::vector<Group>& groups);
+
+	uint32_t findOrInsert(const VertexT& vertex);
+
+	std::vector<VertexT>& m_vertices;
+	std::vector<uint32_t>& m_indices;
+
+private:
+	struct Slot {
+		uint32_t hash;
+		uint32_t index;
+	};
+	static constexpr uint32_t emptySlot = UINT32_MAX;
+
+	void rehash(size_t slotCount);
+
+	std::vector<Slot> m_slots;
+	size_t m_slotMask{ 0 };
+
+	//Scratch of the current shape, reused between shapes
+	std::vector<uint32_t> m_shapeIndices;
+	std::vector<int> m_faceMaterials;
+	std::vector<uint32_t> m_materialCounts;
+	std::vector<int> m_usedMaterials;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Size the hash table, the output arrays and the per shape scratch up front
+//
+template <typename VertexT>
+void MeshBuilder<VertexT>::reserve(size_t cornerCount, size_t materialCount) {
+	//Closed meshes have about one unique vertex per six corners, a third leaves room for seams
+	size_t expectedVertices = cornerCount / 3 + 1;
+	m_vertices.reserve(m_vertices.size() + expectedVertices);
+	m_indices.reserve(m_indices.size() + cornerCount);
+	size_t slotCount = 16;
+	while (slotCount < (m_vertices.size() + expectedVertices) * 2)
+		slotCount <<= 1;
+	if (slotCount > m_slots.size())
+		rehash(slotCount);
+
+	m_shapeIndices.reserve(cornerCount);
+	m_faceMaterials.reserve(cornerCount / 3);
+	if (m_materialCounts.size() < materialCount + 1)
+		m_materialCounts.resize(materialCount + 1, 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Drop all vertices and indices to build an independent mesh, allocations are kept
+//
+template <typename VertexT>
+void MeshBuilder<VertexT>::clear() {
+	m_vertices.clear();
+	m_indices.clear();
+	std::fill(m_slots.begin(), m_slots.end(), Slot{ 0, emptySlot });
+}
+
+//--------------------------------------------------------------------------------------------------
+// Start collecting the triangles of a new shape
+//
+template <typename VertexT>
+void MeshBuilder<VertexT>::beginShape() {
+	m_shapeIndices.clear();
+	m_faceMaterials.clear();
+	m_usedMaterials.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Add one triangle of the current shape, materialId must be non-negative
+//
+template <typename VertexT>
+void MeshBuilder<VertexT>::addTriangle(const VertexT (&corners)[3], int materialId) {
+	for (const VertexT& corner : corners)
+		m_shapeIndices.push_back(findOrInsert(corner));
+	m_faceMaterials.push_back(materialId);
+
+	if (size_t(materialId) >= m_materialCounts.size())
+		m_materialCounts.resize(size_t(materialId) + 1, 0);
+	if (m_materialCounts[materialId]++ == 0)
+		m_usedMaterials.push_back(materialId);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Append the triangles of the current shape to the index array grouped by material
+//
+template <typename VertexT>
+void MeshBuilder<VertexT>::endShape(std::vector<Group>& groups) {
+	groups.clear();
+	std::sort(m_usedMaterials.begin(), m_usedMaterials.end());
+
+	//Turn the per material face counts into write offsets
+	uint32_t offset = static_cast<uint32_t>(m_indices.size());
+	for (int materialId : m_usedMaterials) {
+		uint32_t indexCount = m_materialCounts[materialId] * 3;
+		groups.push_back({ offset, indexCount, materialId });
+		m_materialCounts[materialId] = offset;
+		offset += indexCount;
+	}
+
+	//Scatter the faces, then clear the counters touched by this shape
+	m_indices.resize(offset);
+	for (size_t face = 0; face < m_faceMaterials.size(); face++) {
+		uint32_t& writeOffset = m_materialCounts[m_faceMaterials[face]];
+		std::copy_n(&m_shapeIndices[face * 3], 3, &m_indices[writeOffset]);
+		writeOffset += 3;
+	}
+	for (int materialId : m_usedMaterials)
+		m_materialCounts[materialId] = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Return the index of an identical vertex, or append the vertex and return its new index
+//
+template <typename VertexT>
+uint32_t MeshBuilder<VertexT>::findOrInsert(const VertexT& vertex) {
+	if ((m_vertices.size() + 1) * 2 > m_slots.size())
+		rehash(std::max<size_t>(16, m_slots.size() * 2));
+
+	uint64_t hash = hash_bytes(vertex);
+	uint32_t tag = static_cast<uint32_t>(hash >> 32);
+	for (size_t slot = size_t(hash) & m_slotMask;; slot = (slot + 1) & m_slotMask) {
+		Slot& entry = m_slots[slot];
+		if (entry.index == emptySlot) {
+			entry = { tag, static_cast<uint32_t>(m_vertices.size()) };
+			m_vertices.push_back(vertex);
+			return entry.index;
+		}
+		if (entry.hash == tag && std::memcmp(&m_vertices[entry.index], &vertex, sizeof(VertexT)) == 0)
+			return entry.index;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Rebuild the table with slotCount slots (a power of two) from the stored vertices
+//
+template <typename VertexT>
+void MeshBuilder<VertexT>::rehash(size_t slotCount) {
+	m_slots.assign(slotCount, { 0, emptySlot });
+	m_slotMask = slotCount - 1;
+	for (uint32_t index = 0; index < m_vertices.size(); index++) {
+		uint64_t hash = hash_bytes(m_vertices[index]);
+		size_t slot = size_t(hash) & m_slotMask;
+		while (m_slots[slot].index != emptySlot)
+			slot = (slot + 1) & m_slotMask;
+		m_slots[slot] = { static_cast<uint32_t>(hash >> 32), index };
+	}
+}
+#endif // !MESH_BUILDER_COMMON
@@ -0,0 +1,296 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+/**
+* Forsyth scoring constants, from the paper
+*/
+
+const int forsythCacheSize = 32;
+const float cacheDecayPower = 1.5f;
+const float lastTriangleScore = 0.75f;
+const float valenceBoostScale = 2.0f;
+const float valenceBoostPower = 0.5f;
+const unsigned valenceTableSize = 64;
+
+struct ForsythTables {
+	float cache[forsythCacheSize];
+	float valence[valenceTableSize];
+
+	ForsythTables() {
+		for (int i = 0; i < forsythCacheSize; i++) {
+			//The three vertices of the last triangle get a fixed score, so no order among them is preferred
+			cache[i] = i < 3 ? lastTriangleScore : std::pow(1.0f - float(i - 3) / float(forsythCacheSize - 3), cacheDecayPower);
+		}
+		valence[0] = 0.0f;
+		for (unsigned i = 1; i < valenceTableSize; i++)
+			valence[i] = valenceBoostScale * std::pow(float(i), -valenceBoostPower);
+	}
+};
+
+const ForsythTables forsythTables;
+
+//Score of a vertex from its cache position (-1 if not cached) and its number of remaining triangles
+inline float vertexScore(int cachePosition, unsigned remainingTriangles) {
+	if (remainingTriangles == 0)
+		return -1.0f;
+	float score = cachePosition >= 0 ? forsythTables.cache[cachePosition] : 0.0f;
+	score += remainingTriangles < valenceTableSize ? forsythTables.valence[remainingTriangles]
+		: valenceBoostScale * std::pow(float(remainingTriangles), -valenceBoostPower);
+	return score;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Fixed size FIFO cache, the model used for the statistics and the overdraw clusters
+//
+class FifoCache {
+public:
+	explicit FifoCache(unsigned size) : m_entries(size, UINT32_MAX) {};
+
+	void clear() {
+		std::fill(m_entries.begin(), m_entries.end(), UINT32_MAX);
+		m_head = 0;
+	}
+
+	//Returns 1 on a miss, 0 on a hit
+	unsigned access(uint32_t vertex) {
+		if (std::find(m_entries.begin(), m_entries.end(), vertex) != m_entries.end())
+			return 0;
+		m_entries[m_head] = vertex;
+		m_head = (m_head + 1) % m_entries.size();
+		return 1;
+	}
+
+	unsigned accessTriangle(const uint32_t* triangle) {
+		return access(triangle[0]) + access(triangle[1]) + access(triangle[2]);
+	}
+
+private:
+	std::vector<uint32_t> m_entries;
+	size_t m_head{ 0 };
+};
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Count the cache misses and the distinct vertices of a triangle list
+//
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize) {
+	VertexCacheStats stats{};
+	stats.triangleCount = indexCount / 3;
+	FifoCache cache(cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+	for (size_t i = 0; i < stats.triangleCount * 3; i++) {
+		stats.missCount += cache.access(indices[i]);
+		if (!referenced[indices[i]]) {
+			referenced[indices[i]] = true;
+			stats.vertexCount++;
+		}
+	}
+	return stats;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Greedily emit the triangle with the best score among those touching the cache
+//
+void optimizeVertexCache(uint32_t* indices, size_t indexCount) {
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+
+	//Compact the vertex ids of the list so the working arrays only cover the vertices in use
+	std::vector<uint32_t> vertexIds(indices, indices + triangleCount * 3);
+	std::sort(vertexIds.begin(), vertexIds.end());
+	vertexIds.erase(std::unique(vertexIds.begin(), vertexIds.end()), vertexIds.end());
+	size_t vertexCount = vertexIds.size();
+	std::vector<uint32_t> localIndices(triangleCount * 3);
+	for (size_t i = 0; i < localIndices.size(); i++)
+		localIndices[i] = static_cast<uint32_t>(std::lower_bound(vertexIds.begin(), vertexIds.end(), indices[i]) - vertexIds.begin());
+
+	//Triangles adjacent to every vertex, emitted triangles are swapped out of the remaining range
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t vertex : localIndices)
+		remaining[vertex]++;
+	std::vector<size_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+	std::vector<uint32_t> adjacency(localIndices.size());
+	std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < localIndices.size(); i++)
+		adjacency[fill[localIndices[i]]++] = static_cast<uint32_t>(i / 3);
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScores[v] = vertexScore(-1, remaining[v]);
+	std::vector<float> triangleScores(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+		triangleScores[t] = vertexScores[localIndices[t * 3]] + vertexScores[localIndices[t * 3 + 1]] + vertexScores[localIndices[t * 3 + 2]];
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<uint32_t> cache, newCache;
+	cache.reserve(forsythCacheSize + 3);
+	newCache.reserve(forsythCacheSize + 3);
+	std::vector<uint32_t> order;
+	order.reserve(triangleCount);
+
+	size_t best = std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+	size_t deadEndCursor = 0;
+	while (order.size() < triangleCount) {
+		//Dead end, continue with the next triangle in input order
+		if (best == SIZE_MAX) {
+			while (emitted[deadEndCursor])
+				deadEndCursor++;
+			best = deadEndCursor;
+		}
+
+		order.push_back(static_cast<uint32_t>(best));
+		emitted[best] = true;
+		const uint32_t* triangle = &localIndices[best * 3];
+		for (int k = 0; k < 3; k++) {
+			uint32_t vertex = triangle[k];
+			uint32_t* begin = &adjacency[adjacencyOffsets[vertex]];
+			uint32_t* end = begin + remaining[vertex];
+			std::iter_swap(std::find(begin, end, uint32_t(best)), end - 1);
+			remaining[vertex]--;
+		}
+
+		//The emitted triangle moves to the front of the cache, vertices past its size fall out
+		newCache.assign(triangle, triangle + 3);
+		for (uint32_t vertex : cache) {
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+				newCache.push_back(vertex);
+		}
+		for (size_t i = 0; i < newCache.size(); i++)
+			cachePositions[newCache[i]] = i < size_t(forsythCacheSize) ? int(i) : -1;
+
+		//Rescore the touched vertices and their remaining triangles, then pick the best of them
+		for (uint32_t vertex : newCache) {
+			float score = vertexScore(cachePositions[vertex], remaining[vertex]);
+			float delta = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+			const uint32_t* adjacent = &adjacency[adjacencyOffsets[vertex]];
+			for (uint32_t i = 0; i < remaining[vertex]; i++)
+				triangleScores[adjacent[i]] += delta;
+		}
+		best = SIZE_MAX;
+		float bestScore = -1.0f;
+		for (uint32_t vertex : newCache) {
+			const uint32_t* adjacent = &adjacency[adjacencyOffsets[vertex]];
+			for (uint32_t i = 0; i < remaining[vertex]; i++) {
+				if (triangleScores[adjacent[i]] > bestScore) {
+					bestScore = triangleScores[adjacent[i]];
+					best = adjacent[i];
+				}
+			}
+		}
+		if (newCache.size() > size_t(forsythCacheSize))
+			newCache.resize(forsythCacheSize);
+		cache.swap(newCache);
+	}
+
+	for (size_t i = 0; i < triangleCount; i++) {
+		for (int k = 0; k < 3; k++)
+			indices[i * 3 + k] = vertexIds[localIndices[order[i] * 3 + k]];
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Cut the list into clusters and sort them by their occlusion potential
+//
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, float threshold) {
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+	auto position = [&](uint32_t vertex) {
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + size_t(vertex) * positionStride);
+	};
+
+	//Hard boundaries where the cache restarts, every vertex of the triangle misses
+	FifoCache cache(16);
+	std::vector<size_t> hardBoundaries;
+	for (size_t t = 0; t < triangleCount; t++) {
+		if (cache.accessTriangle(&indices[t * 3]) == 3)
+			hardBoundaries.push_back(t);
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	//Soft boundaries as soon as a cluster rendered alone is within the threshold of its ACMR
+	std::vector<size_t> clusters;
+	for (size_t h = 0; h + 1 < hardBoundaries.size(); h++) {
+		size_t begin = hardBoundaries[h], end = hardBoundaries[h + 1];
+		cache.clear();
+		size_t misses = 0;
+		for (size_t t = begin; t < end; t++)
+			misses += cache.accessTriangle(&indices[t * 3]);
+		float clusterThreshold = threshold * float(misses) / float(end - begin);
+
+		cache.clear();
+		clusters.push_back(begin);
+		size_t runningMisses = 0, runningTriangles = 0;
+		for (size_t t = begin; t < end; t++) {
+			runningMisses += cache.accessTriangle(&indices[t * 3]);
+			runningTriangles++;
+			if (t + 1 < end && float(runningMisses) / float(runningTriangles) <= clusterThreshold) {
+				clusters.push_back(t + 1);
+				cache.clear();
+				runningMisses = runningTriangles = 0;
+			}
+		}
+	}
+	size_t clusterCount = clusters.size();
+	clusters.push_back(triangleCount);
+	if (clusterCount < 2)
+		return;
+
+	//Clusters far out from the center and facing outwards are likely to occlude the others
+	double meshCenter[3] = { 0.0, 0.0, 0.0 };
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		const float* p = position(indices[i]);
+		for (int k = 0; k < 3; k++)
+			meshCenter[k] += p[k];
+	}
+	for (int k = 0; k < 3; k++)
+		meshCenter[k] /= double(triangleCount * 3);
+
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++) {
+		double center[3] = { 0.0, 0.0, 0.0 };
+		double normal[3] = { 0.0, 0.0, 0.0 };
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+			const float* p0 = position(indices[t * 3 + 0]);
+			const float* p1 = position(indices[t * 3 + 1]);
+			const float* p2 = position(indices[t * 3 + 2]);
+			double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			//Area weighted normal
+			normal[0] += e1[1] * e2[2] - e1[2] * e2[1];
+			normal[1] += e1[2] * e2[0] - e1[0] * e2[2];
+			normal[2] += e1[0] * e2[1] - e1[1] * e2[0];
+			for (int k = 0; k < 3; k++)
+				center[k] += p0[k] + p1[k] + p2[k];
+		}
+		double cornerCount = double(clusters[c + 1] - clusters[c]) * 3.0;
+		double normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		double key = 0.0;
+		if (normalLength > 0.0) {
+			for (int k = 0; k < 3; k++)
+				key += (center[k] / cornerCount - meshCenter[k]) * normal[k] / normalLength;
+		}
+		sortKeys[c] = float(key);
+	}
+
+	std::vector<uint32_t> clusterOrder(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+		clusterOrder[c] = static_cast<uint32_t>(c);
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> reordered;
+	reordered.reserve(triangleCount * 3);
+	for (uint32_t c : clusterOrder)
+		reordered.insert(reordered.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+	std::copy(reordered.begin(), reordered.end(), indices);
+}
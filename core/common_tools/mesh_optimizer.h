@@ -0,0 +1,63 @@
+#ifndef MESH_OPTIMIZER_COMMON
+#define MESH_OPTIMIZER_COMMON
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+//Post-transform vertex cache statistics of a triangle list, summable over independent ranges
+struct VertexCacheStats {
+	size_t triangleCount{ 0 };
+	size_t vertexCount{ 0 };   //Distinct vertices referenced
+	size_t missCount{ 0 };
+
+	//Average cache miss ratio, vertex shader invocations per triangle
+	double acmr() const { return triangleCount > 0 ? double(missCount) / double(triangleCount) : 0.0; }
+	//Average transform to vertex ratio, 1.0 is optimal
+	double atvr() const { return vertexCount > 0 ? double(missCount) / double(vertexCount) : 0.0; }
+
+	VertexCacheStats& operator+=(const VertexCacheStats& other) {
+		triangleCount += other.triangleCount;
+		vertexCount += other.vertexCount;
+		missCount += other.missCount;
+		return *this;
+	}
+};
+
+//Simulate a FIFO post-transform cache, vertexCount bounds the indices
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = 16);
+
+//--------------------------------------------------------------------------------------------------
+// Reorder the triangles of a triangle list for vertex cache locality, with Tom Forsyth's
+// "Linear-Speed Vertex Cache Optimisation" scoring. Indices may address any vertex array.
+//
+void optimizeVertexCache(uint32_t* indices, size_t indexCount);
+
+//--------------------------------------------------------------------------------------------------
+// Reorder cache optimized triangles to reduce overdraw (Sander et al., "Fast Triangle Reordering
+// for Vertex Locality and Reduced Overdraw"). The list is cut into clusters at cache restarts and
+// where the cluster ACMR stays within threshold times the original, then clusters facing away
+// from the mesh center are drawn first. positions points at the first vertex position (three
+// floats) and positionStride is the byte distance between vertices.
+//
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, float threshold = 1.05f);
+
+//--------------------------------------------------------------------------------------------------
+// Reorder vertices by first use in the index list and remap the indices, so vertex fetches walk
+// memory forward. Vertices no index refers to are dropped.
+//
+template <typename VertexT>
+void optimizeVertexFetch(std::vector<VertexT>& vertices, uint32_t* indices, size_t indexCount) {
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+	std::vector<VertexT> reordered;
+	reordered.reserve(vertices.size());
+	for (size_t i = 0; i < indexCount; i++) {
+		uint32_t& newIndex = remap[indices[i]];
+		if (newIndex == UINT32_MAX) {
+			newIndex = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[indices[i]]);
+		}
+		indices[i] = newIndex;
+	}
+	vertices.swap(reordered);
+}
+#endif // !MESH_OPTIMIZER_COMMON
@@ -0,0 +1,367 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+//Share of the cheapest candidate edges collapsed per pass, the rest waits for updated costs
+const size_t passCandidateDivisor = 3;
+//Smallest cosine between a triangle normal before and after a collapse
+const double maxNormalChange = 0.25;
+
+//Symmetric 4x4 quadric summing the squared distances to a set of planes, weighted by triangle area
+struct Quadric {
+	double a2{ 0 }, ab{ 0 }, ac{ 0 }, ad{ 0 }, b2{ 0 }, bc{ 0 }, bd{ 0 }, c2{ 0 }, cd{ 0 }, d2{ 0 };
+	double weight{ 0 };
+
+	void addPlane(double a, double b, double c, double d, double w) {
+		a2 += w * a * a; ab += w * a * b; ac += w * a * c; ad += w * a * d;
+		b2 += w * b * b; bc += w * b * c; bd += w * b * d;
+		c2 += w * c * c; cd += w * c * d;
+		d2 += w * d * d;
+		weight += w;
+	}
+
+	Quadric& operator+=(const Quadric& other) {
+		a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+		b2 += other.b2; bc += other.bc; bd += other.bd;
+		c2 += other.c2; cd += other.cd;
+		d2 += other.d2;
+		weight += other.weight;
+		return *this;
+	}
+
+	//Area weighted squared distance of p to the planes
+	double error(const float* p) const {
+		double x = p[0], y = p[1], z = p[2];
+		return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+			+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+			+ c2 * z * z + 2 * cd * z
+			+ d2;
+	}
+};
+
+struct Collapse {
+	float cost;
+	uint32_t from;
+	uint32_t to;
+};
+
+inline void subtract(const float* a, const float* b, double* result) {
+	result[0] = double(a[0]) - b[0];
+	result[1] = double(a[1]) - b[1];
+	result[2] = double(a[2]) - b[2];
+}
+
+inline void cross(const double* a, const double* b, double* result) {
+	result[0] = a[1] * b[2] - a[2] * b[1];
+	result[1] = a[2] * b[0] - a[0] * b[2];
+	result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+inline double dot(const double* a, const double* b) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+//Unnormalized normal of a triangle
+inline void triangleNormal(const float* p0, const float* p1, const float* p2, double* normal) {
+	double e1[3], e2[3];
+	subtract(p1, p0, e1);
+	subtract(p2, p0, e2);
+	cross(e1, e2, normal);
+}
+
+//Edge between two welded positions, the smaller one first
+inline uint64_t edgeKey(uint32_t a, uint32_t b) {
+	return a < b ? uint64_t(a) << 32 | b : uint64_t(b) << 32 | a;
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Collapse the cheapest edges in passes, adjacency and costs are rebuilt between passes and an edge
+// is only collapsed if neither endpoint changed earlier in the same pass
+//
+size_t simplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions,
+	const float* attributes, size_t attributeCount, size_t vertexStride, size_t targetIndexCount, float* resultError) {
+	if (resultError)
+		*resultError = 0.0f;
+	size_t triangleCount = indexCount / 3;
+	size_t targetTriangleCount = targetIndexCount / 3;
+	std::memcpy(destination, indices, sizeof(uint32_t) * triangleCount * 3);
+	if (triangleCount <= targetTriangleCount || triangleCount < 2)
+		return triangleCount * 3;
+
+	//Compact the vertex ids of the list so the working arrays only cover the vertices in use
+	std::vector<uint32_t> vertexIds(indices, indices + triangleCount * 3);
+	std::sort(vertexIds.begin(), vertexIds.end());
+	vertexIds.erase(std::unique(vertexIds.begin(), vertexIds.end()), vertexIds.end());
+	size_t vertexCount = vertexIds.size();
+	std::vector<uint32_t> corners(triangleCount * 3);
+	for (size_t i = 0; i < corners.size(); i++)
+		corners[i] = static_cast<uint32_t>(std::lower_bound(vertexIds.begin(), vertexIds.end(), indices[i]) - vertexIds.begin());
+	auto vertexPosition = [&](uint32_t vertex) {
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertexStride * vertexIds[vertex]);
+	};
+	auto vertexAttributes = [&](uint32_t vertex) {
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(attributes) + vertexStride * vertexIds[vertex]);
+	};
+
+	//Weld vertices with equal positions, the wedges of a position are the vertices sharing it
+	std::vector<uint32_t> wedges(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		wedges[v] = static_cast<uint32_t>(v);
+	auto positionLess = [&](uint32_t a, uint32_t b) {
+		const float* pa = vertexPosition(a);
+		const float* pb = vertexPosition(b);
+		return std::lexicographical_compare(pa, pa + 3, pb, pb + 3);
+	};
+	std::sort(wedges.begin(), wedges.end(), positionLess);
+	std::vector<uint32_t> positionIds(vertexCount);
+	std::vector<size_t> wedgeOffsets{ 0 };
+	for (size_t i = 0; i < vertexCount; i++) {
+		if (i > 0 && positionLess(wedges[i - 1], wedges[i]))
+			wedgeOffsets.push_back(i);
+		positionIds[wedges[i]] = static_cast<uint32_t>(wedgeOffsets.size() - 1);
+	}
+	size_t positionCount = wedgeOffsets.size();
+	wedgeOffsets.push_back(vertexCount);
+	auto position = [&](uint32_t positionId) { return vertexPosition(wedges[wedgeOffsets[positionId]]); };
+	auto cornerPosition = [&](size_t corner) { return positionIds[corners[corner]]; };
+
+	//Triangles that are degenerate after welding are dropped right away
+	std::vector<bool> alive(triangleCount, true);
+	size_t aliveCount = triangleCount;
+	for (size_t t = 0; t < triangleCount; t++) {
+		uint32_t p0 = cornerPosition(t * 3), p1 = cornerPosition(t * 3 + 1), p2 = cornerPosition(t * 3 + 2);
+		if (p0 == p1 || p1 == p2 || p2 == p0) {
+			alive[t] = false;
+			aliveCount--;
+		}
+	}
+
+	//Plane quadrics of the adjacent triangles
+	std::vector<Quadric> quadrics(positionCount);
+	for (size_t t = 0; t < triangleCount; t++) {
+		if (!alive[t])
+			continue;
+		double normal[3];
+		triangleNormal(position(cornerPosition(t * 3)), position(cornerPosition(t * 3 + 1)), position(cornerPosition(t * 3 + 2)), normal);
+		double length = std::sqrt(dot(normal, normal));
+		if (length == 0.0)
+			continue;
+		double a = normal[0] / length, b = normal[1] / length, c = normal[2] / length;
+		const float* p0 = position(cornerPosition(t * 3));
+		double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+		for (int k = 0; k < 3; k++)
+			quadrics[cornerPosition(t * 3 + k)].addPlane(a, b, c, d, length * 0.5);
+	}
+
+	//Lock the endpoints of open border and non-manifold edges, they keep the outline of the mesh
+	std::vector<bool> locked(positionCount, false);
+	{
+		std::vector<uint64_t> edges;
+		edges.reserve(aliveCount * 3);
+		for (size_t t = 0; t < triangleCount; t++) {
+			if (!alive[t])
+				continue;
+			for (int k = 0; k < 3; k++)
+				edges.push_back(edgeKey(cornerPosition(t * 3 + k), cornerPosition(t * 3 + (k + 1) % 3)));
+		}
+		std::sort(edges.begin(), edges.end());
+		for (size_t begin = 0, end = 0; begin < edges.size(); begin = end) {
+			while (end < edges.size() && edges[end] == edges[begin])
+				end++;
+			if (end - begin != 2) {
+				locked[uint32_t(edges[begin] >> 32)] = true;
+				locked[uint32_t(edges[begin])] = true;
+			}
+		}
+	}
+
+	//Wedge of the position to keep whose attributes are closest to a wedge of the removed position
+	auto closestWedge = [&](uint32_t vertex, uint32_t positionId) {
+		uint32_t best = wedges[wedgeOffsets[positionId]];
+		if (wedgeOffsets[positionId + 1] - wedgeOffsets[positionId] == 1)
+			return best;
+		float bestDistance = INFINITY;
+		const float* source = vertexAttributes(vertex);
+		for (size_t w = wedgeOffsets[positionId]; w < wedgeOffsets[positionId + 1]; w++) {
+			const float* candidate = vertexAttributes(wedges[w]);
+			float distance = 0.0f;
+			for (size_t i = 0; i < attributeCount; i++)
+				distance += (candidate[i] - source[i]) * (candidate[i] - source[i]);
+			if (distance < bestDistance) {
+				bestDistance = distance;
+				best = wedges[w];
+			}
+		}
+		return best;
+	};
+
+	std::vector<size_t> adjacencyOffsets(positionCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<uint64_t> edges;
+	std::vector<Collapse> collapses;
+	std::vector<bool> touched(positionCount);
+	std::vector<uint32_t> fromNeighbors, toNeighbors;
+	float maxError = 0.0f;
+
+	//Neighbor positions of a position over its live triangles
+	auto gatherNeighbors = [&](uint32_t positionId, std::vector<uint32_t>& neighbors) {
+		neighbors.clear();
+		for (size_t a = adjacencyOffsets[positionId]; a < adjacencyOffsets[positionId + 1]; a++) {
+			size_t t = adjacency[a];
+			if (!alive[t])
+				continue;
+			for (int k = 0; k < 3; k++) {
+				if (cornerPosition(t * 3 + k) != positionId)
+					neighbors.push_back(cornerPosition(t * 3 + k));
+			}
+		}
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+	};
+
+	//A collapse has to keep the surface manifold and must not fold any remaining triangle over
+	auto canCollapse = [&](uint32_t from, uint32_t to) {
+		size_t sharedCount = 0;
+		for (size_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++) {
+			size_t t = adjacency[a];
+			if (!alive[t])
+				continue;
+			const float* p[3];
+			const float* moved[3];
+			bool shared = false;
+			for (int k = 0; k < 3; k++) {
+				uint32_t cornerId = cornerPosition(t * 3 + k);
+				shared = shared || cornerId == to;
+				p[k] = position(cornerId);
+				moved[k] = cornerId == from ? position(to) : p[k];
+			}
+			if (shared) {
+				sharedCount++;
+				continue;
+			}
+			double before[3], after[3];
+			triangleNormal(p[0], p[1], p[2], before);
+			triangleNormal(moved[0], moved[1], moved[2], after);
+			if (dot(before, after) <= maxNormalChange * std::sqrt(dot(before, before) * dot(after, after)))
+				return false;
+		}
+		if (sharedCount != 2)
+			return false;
+
+		//Link condition: the only common neighbors are the two vertices opposite the edge
+		gatherNeighbors(from, fromNeighbors);
+		gatherNeighbors(to, toNeighbors);
+		size_t commonCount = 0;
+		for (size_t i = 0, j = 0; i < fromNeighbors.size() && j < toNeighbors.size();) {
+			if (fromNeighbors[i] < toNeighbors[j])
+				i++;
+			else if (toNeighbors[j] < fromNeighbors[i])
+				j++;
+			else {
+				commonCount++;
+				i++;
+				j++;
+			}
+		}
+		return commonCount == 2;
+	};
+
+	while (aliveCount > targetTriangleCount) {
+		//Triangles adjacent to every position
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (size_t t = 0; t < triangleCount; t++) {
+			if (alive[t]) {
+				for (int k = 0; k < 3; k++)
+					adjacencyOffsets[cornerPosition(t * 3 + k) + 1]++;
+			}
+		}
+		for (size_t p = 0; p < positionCount; p++)
+			adjacencyOffsets[p + 1] += adjacencyOffsets[p];
+		adjacency.resize(adjacencyOffsets[positionCount]);
+		std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		edges.clear();
+		for (size_t t = 0; t < triangleCount; t++) {
+			if (!alive[t])
+				continue;
+			for (int k = 0; k < 3; k++) {
+				adjacency[fill[cornerPosition(t * 3 + k)]++] = static_cast<uint32_t>(t);
+				edges.push_back(edgeKey(cornerPosition(t * 3 + k), cornerPosition(t * 3 + (k + 1) % 3)));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		//Cost of every edge, collapsed in the direction with the smaller error
+		collapses.clear();
+		for (uint64_t edge : edges) {
+			uint32_t a = uint32_t(edge >> 32), b = uint32_t(edge);
+			Collapse best{ INFINITY, 0, 0 };
+			for (int direction = 0; direction < 2; direction++) {
+				uint32_t from = direction == 0 ? a : b;
+				uint32_t to = direction == 0 ? b : a;
+				if (locked[from])
+					continue;
+				Quadric quadric = quadrics[from];
+				quadric += quadrics[to];
+				float cost = quadric.weight > 0.0 ? float(std::sqrt(std::max(quadric.error(position(to)) / quadric.weight, 0.0))) : 0.0f;
+				if (cost < best.cost)
+					best = { cost, from, to };
+			}
+			if (best.cost < INFINITY)
+				collapses.push_back(best);
+		}
+		if (collapses.empty())
+			break;
+		size_t candidateCount = std::max<size_t>(collapses.size() / passCandidateDivisor, 1);
+		std::partial_sort(collapses.begin(), collapses.begin() + candidateCount, collapses.end(),
+			[](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		//Collapse the cheapest edges whose endpoints are untouched in this pass
+		std::fill(touched.begin(), touched.end(), false);
+		size_t collapseCount = 0;
+		for (size_t c = 0; c < candidateCount && aliveCount > targetTriangleCount; c++) {
+			const Collapse& collapse = collapses[c];
+			if (touched[collapse.from] || touched[collapse.to] || !canCollapse(collapse.from, collapse.to))
+				continue;
+			for (size_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++) {
+				size_t t = adjacency[a];
+				if (!alive[t])
+					continue;
+				if (cornerPosition(t * 3) == collapse.to || cornerPosition(t * 3 + 1) == collapse.to || cornerPosition(t * 3 + 2) == collapse.to) {
+					alive[t] = false;
+					aliveCount--;
+					continue;
+				}
+				for (int k = 0; k < 3; k++) {
+					if (cornerPosition(t * 3 + k) == collapse.from)
+						corners[t * 3 + k] = closestWedge(corners[t * 3 + k], collapse.to);
+				}
+			}
+			quadrics[collapse.to] += quadrics[collapse.from];
+			touched[collapse.from] = true;
+			touched[collapse.to] = true;
+			maxError = std::max(maxError, collapse.cost);
+			collapseCount++;
+		}
+		if (collapseCount == 0)
+			break;
+	}
+
+	size_t destinationCount = 0;
+	for (size_t t = 0; t < triangleCount; t++) {
+		if (!alive[t])
+			continue;
+		for (int k = 0; k < 3; k++)
+			destination[destinationCount++] = vertexIds[corners[t * 3 + k]];
+	}
+	if (resultError)
+		*resultError = maxError;
+	return destinationCount;
+}
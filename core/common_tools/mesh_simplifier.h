@@ -0,0 +1,19 @@
+#ifndef MESH_SIMPLIFIER_COMMON
+#define MESH_SIMPLIFIER_COMMON
+#include <cstddef>
+#include <cstdint>
+
+//--------------------------------------------------------------------------------------------------
+// Simplify a triangle list with quadric error metrics (Garland and Heckbert, "Surface Simplification
+// Using Quadric Error Metrics") down to about targetIndexCount indices. Edges are collapsed onto one
+// of their endpoints, so the result indexes the same vertices and no vertex is created. Vertices are
+// welded by position, and a collapse moves every attribute wedge of a position onto the wedge of the
+// kept position with the closest attributes. Open borders and non-manifold edges are kept as they
+// are. positions points at the first vertex position (three floats), attributes at attributeCount
+// floats compared between wedges, both vertexStride bytes apart. Writes the simplified list to
+// destination, which holds indexCount indices, and returns its index count. resultError receives
+// the largest collapse error as a distance in position units.
+//
+size_t simplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions,
+	const float* attributes, size_t attributeCount, size_t vertexStride, size_t targetIndexCount, float* resultError = nullptr);
+#endif // !MESH_SIMPLIFIER_COMMON
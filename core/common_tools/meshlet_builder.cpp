@@ -0,0 +1,111 @@
+#include "meshlet_builder.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+inline const float* vertexPosition(const float* positions, size_t positionStride, uint32_t index) {
+	return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + positionStride * index);
+}
+
+}
+
+//--------------------------------------------------------------------------------------------------
+// Split a triangle list into meshlets of consecutive triangles
+//
+size_t buildMeshlets(std::vector<MeshletBounds>& meshlets, const uint32_t* indices, size_t indexCount, const float* positions,
+	size_t positionStride, size_t maxVertices, size_t maxTriangles) {
+	size_t firstMeshlet = meshlets.size();
+	std::vector<uint32_t> meshletVertices;
+	meshletVertices.reserve(maxVertices);
+	size_t meshletBegin = 0;
+	for (size_t i = 0; i + 3 <= indexCount; i += 3) {
+		size_t newVertices = 0;
+		for (size_t j = 0; j < 3; j++) {
+			bool seen = std::find(meshletVertices.begin(), meshletVertices.end(), indices[i + j]) != meshletVertices.end();
+			for (size_t k = 0; k < j && !seen; k++)
+				seen = indices[i + k] == indices[i + j];
+			newVertices += seen ? 0 : 1;
+		}
+		if (meshletVertices.size() + newVertices > maxVertices || (i - meshletBegin) / 3 >= maxTriangles) {
+			meshlets.push_back(computeMeshletBounds(indices + meshletBegin, i - meshletBegin, positions, positionStride));
+			meshlets.back().indexOffset = static_cast<uint32_t>(meshletBegin);
+			meshletBegin = i;
+			meshletVertices.clear();
+		}
+		for (size_t j = 0; j < 3; j++) {
+			if (std::find(meshletVertices.begin(), meshletVertices.end(), indices[i + j]) == meshletVertices.end())
+				meshletVertices.push_back(indices[i + j]);
+		}
+	}
+	size_t triangleEnd = indexCount - indexCount % 3;
+	if (triangleEnd > meshletBegin) {
+		meshlets.push_back(computeMeshletBounds(indices + meshletBegin, triangleEnd - meshletBegin, positions, positionStride));
+		meshlets.back().indexOffset = static_cast<uint32_t>(meshletBegin);
+	}
+	return meshlets.size() - firstMeshlet;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Bounding sphere around the box center and normal cone around the average triangle normal
+//
+MeshletBounds computeMeshletBounds(const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride) {
+	MeshletBounds bounds{};
+	bounds.indexOffset = 0;
+	bounds.indexCount = static_cast<uint32_t>(indexCount);
+	bounds.coneCutoff = 1.0f;
+	if (indexCount == 0)
+		return bounds;
+
+	float lower[3] = { INFINITY, INFINITY, INFINITY };
+	float upper[3] = { -INFINITY, -INFINITY, -INFINITY };
+	for (size_t i = 0; i < indexCount; i++) {
+		const float* p = vertexPosition(positions, positionStride, indices[i]);
+		for (int k = 0; k < 3; k++) {
+			lower[k] = std::min(lower[k], p[k]);
+			upper[k] = std::max(upper[k], p[k]);
+		}
+	}
+	for (int k = 0; k < 3; k++)
+		bounds.center[k] = (lower[k] + upper[k]) * 0.5f;
+	float radiusSquared = 0.0f;
+	for (size_t i = 0; i < indexCount; i++) {
+		const float* p = vertexPosition(positions, positionStride, indices[i]);
+		float dx = p[0] - bounds.center[0], dy = p[1] - bounds.center[1], dz = p[2] - bounds.center[2];
+		radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+	}
+	bounds.radius = std::sqrt(radiusSquared);
+
+	//Unit normals of the non degenerate triangles, the cone is left open if they spread over a half space
+	std::vector<float> normals;
+	normals.reserve(indexCount);
+	float axis[3] = { 0.0f, 0.0f, 0.0f };
+	for (size_t i = 0; i + 3 <= indexCount; i += 3) {
+		const float* a = vertexPosition(positions, positionStride, indices[i]);
+		const float* b = vertexPosition(positions, positionStride, indices[i + 1]);
+		const float* c = vertexPosition(positions, positionStride, indices[i + 2]);
+		float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.0f)
+			continue;
+		for (int k = 0; k < 3; k++) {
+			normals.push_back(n[k] / length);
+			axis[k] += n[k] / length;
+		}
+	}
+	float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	if (axisLength == 0.0f)
+		return bounds;
+	for (int k = 0; k < 3; k++)
+		bounds.coneAxis[k] = axis[k] / axisLength;
+
+	float minDot = 1.0f;
+	for (size_t i = 0; i < normals.size(); i += 3)
+		minDot = std::min(minDot, normals[i] * bounds.coneAxis[0] + normals[i + 1] * bounds.coneAxis[1] + normals[i + 2] * bounds.coneAxis[2]);
+	if (minDot > 0.0f)
+		bounds.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	return bounds;
+}
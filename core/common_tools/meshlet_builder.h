@@ -0,0 +1,33 @@
+#ifndef MESHLET_BUILDER_COMMON
+#define MESHLET_BUILDER_COMMON
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+//Triangle range of an index list with the bounds used for culling it
+struct MeshletBounds {
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	float center[3];      //Bounding sphere
+	float radius;
+	float coneAxis[3];    //Average facing of the triangles
+	float coneCutoff;     //Cosine of the widest angle from the view direction at which every triangle faces away, 1 if none does
+};
+
+//--------------------------------------------------------------------------------------------------
+// Split a triangle list into meshlets of consecutive triangles, each referencing at most
+// maxVertices distinct vertices and holding at most maxTriangles triangles. The triangle order is
+// kept, so a vertex cache optimized list gives compact meshlets and the meshlets are index ranges
+// of the list. positions points at the first vertex position (three floats) and positionStride is
+// the byte distance between vertices. Meshlets are appended to meshlets with indexOffset relative
+// to indices, returns the number appended.
+//
+size_t buildMeshlets(std::vector<MeshletBounds>& meshlets, const uint32_t* indices, size_t indexCount, const float* positions,
+	size_t positionStride, size_t maxVertices = 64, size_t maxTriangles = 124);
+
+//--------------------------------------------------------------------------------------------------
+// Bounding sphere and normal cone of a triangle range. A meshlet is facing away from a viewer at
+// position p if dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius.
+//
+MeshletBounds computeMeshletBounds(const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride);
+#endif // !MESHLET_BUILDER_COMMON
@@ -0,0 +1,1162 @@
+#include "obj_parser.h"
+#include "mapped_file.h"
+#include "tools.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+namespace {
+
+/**
+* Token helpers working on [p, end) ranges of the mapped file, which is not null terminated
+*/
+
+inline bool isSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+inline const char* skipSpaces(const char* p, const char* end) {
+	while (p < end && isSpace(*p))
+		p++;
+	return p;
+}
+
+inline const char* skipToken(const char* p, const char* end) {
+	while (p < end && !isSpace(*p))
+		p++;
+	return p;
+}
+
+//Check if the line starts with the keyword followed by a space or the line end
+inline bool isKeyword(const char* p, const char* end, const char* keyword, size_t length) {
+	return size_t(end - p) >= length && std::memcmp(p, keyword, length) == 0 && (p + length == end || isSpace(p[length]));
+}
+
+//Rest of the line with surrounding spaces removed
+inline std::string restOfLine(const char* p, const char* end) {
+	p = skipSpaces(p, end);
+	while (end > p && isSpace(end[-1]))
+		end--;
+	return std::string(p, end);
+}
+
+//Tokens of the rest of the line joined by single spaces, like tinyobj names groups
+inline std::string joinedTokens(const char* p, const char* end) {
+	std::string joined;
+	while ((p = skipSpaces(p, end)) < end) {
+		const char* tokenEnd = skipToken(p, end);
+		if (!joined.empty())
+			joined += ' ';
+		joined.append(p, tokenEnd);
+		p = tokenEnd;
+	}
+	return joined;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Split a mtllib line into file names, a backslash keeps the next character so escaped spaces stay
+// in the name like tinyobj's SplitString
+//
+std::vector<std::string> splitEscapedTokens(const std::string& line) {
+	std::vector<std::string> tokens;
+	std::string token;
+	bool escaping = false;
+	for (char c : line) {
+		if (!escaping && c == '\\') {
+			escaping = true;
+			continue;
+		}
+		if (!escaping && isSpace(c)) {
+			if (!token.empty())
+				tokens.push_back(token);
+			token.clear();
+			continue;
+		}
+		escaping = false;
+		token += c;
+	}
+	if (!token.empty())
+		tokens.push_back(token);
+	return tokens;
+}
+
+const double pow10Table[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+//--------------------------------------------------------------------------------------------------
+// Parse a decimal floating point number, up to 19 significant digits are kept
+//
+bool parseFloat(const char*& p, const char* end, float& out) {
+	const char* s = skipSpaces(p, end);
+	const char* c = s;
+	bool negative = false;
+	if (c < end && (*c == '+' || *c == '-')) {
+		negative = *c == '-';
+		c++;
+	}
+
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool found = false;
+	while (c < end && isDigit(*c)) {
+		found = true;
+		if (digits < 19) {
+			mantissa = mantissa * 10 + uint64_t(*c - '0');
+			if (mantissa)
+				digits++;
+		}
+		else {
+			exponent++;
+		}
+		c++;
+	}
+	if (c < end && *c == '.') {
+		c++;
+		while (c < end && isDigit(*c)) {
+			found = true;
+			if (digits < 19) {
+				mantissa = mantissa * 10 + uint64_t(*c - '0');
+				if (mantissa)
+					digits++;
+				exponent--;
+			}
+			c++;
+		}
+	}
+	if (!found)
+		return false;
+
+	if (c < end && (*c == 'e' || *c == 'E')) {
+		const char* e = c + 1;
+		bool negativeExp = false;
+		if (e < end && (*e == '+' || *e == '-')) {
+			negativeExp = *e == '-';
+			e++;
+		}
+		if (e < end && isDigit(*e)) {
+			int value = 0;
+			while (e < end && isDigit(*e)) {
+				if (value < 10000)
+					value = value * 10 + (*e - '0');
+				e++;
+			}
+			exponent += negativeExp ? -value : value;
+			c = e;
+		}
+	}
+	if (c < end && !isSpace(*c))
+		return false;
+
+	double value = double(mantissa);
+	if (exponent > 0 && exponent <= 22)
+		value *= pow10Table[exponent];
+	else if (exponent < 0 && exponent >= -22)
+		value /= pow10Table[-exponent];
+	else if (exponent != 0)
+		value *= std::pow(10.0, exponent);
+
+	out = float(negative ? -value : value);
+	p = c;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Parse a float or skip the token and return the default value, mirroring tinyobj::parseReal
+//
+bool parseFloatOr(const char*& p, const char* end, float& out, float defaultValue) {
+	if (parseFloat(p, end, out))
+		return true;
+	p = skipToken(skipSpaces(p, end), end);
+	out = defaultValue;
+	return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Parse a signed integer face index
+//
+bool parseIndex(const char*& p, const char* end, int& out) {
+	const char* c = p;
+	bool negative = false;
+	if (c < end && (*c == '+' || *c == '-')) {
+		negative = *c == '-';
+		c++;
+	}
+	if (c >= end || !isDigit(*c))
+		return false;
+	int64_t value = 0;
+	while (c < end && isDigit(*c)) {
+		value = value * 10 + (*c - '0');
+		if (value > INT32_MAX)
+			return false;
+		c++;
+	}
+	out = int(negative ? -value : value);
+	p = c;
+	return true;
+}
+
+/**
+* Per chunk parse results
+*/
+
+//State changing statements, applied in file order during the merge
+struct ObjEvent {
+	enum Type {
+		USE_MTL,
+		MTL_LIB,
+		GROUP,
+		OBJECT,
+		SMOOTHING
+	};
+	Type type;
+	size_t faceBegin;
+	std::string name;
+	unsigned smoothingId{ 0 };
+};
+
+struct ObjChunk {
+	const char* begin;
+	const char* end;
+
+	std::vector<float> positions;
+	std::vector<float> colors;
+	std::vector<float> texcoords;
+	std::vector<float> normals;
+	std::vector<tinyobj::index_t> indices;  //Triangulated, three per face
+	std::vector<size_t> quadFaces;          //First of the two faces of every quad, split along 0-2 until positions are known
+
+	//Positions in indices holding negative (relative) indices that still miss the chunk offset
+	std::vector<size_t> relativePositions;
+	std::vector<size_t> relativeTexcoords;
+	std::vector<size_t> relativeNormals;
+
+	std::vector<ObjEvent> events;
+
+	int greatestPosition{ -1 };
+	int greatestTexcoord{ -1 };
+	int greatestNormal{ -1 };
+
+	//Attribute lines seen, also counted when the attributes are not stored
+	size_t positionCount{ 0 };
+	size_t colorCount{ 0 };       //Positions with an explicit color, only counted when attributes are stored
+	size_t texcoordCount{ 0 };
+	size_t normalCount{ 0 };
+	size_t triangleCount{ 0 };
+
+	size_t lineCount{ 0 };
+	size_t skippedLines{ 0 };
+	size_t degenerateFaces{ 0 };
+	size_t errorLine{ 0 };
+	std::string error;
+
+	size_t positionOffset{ 0 };
+	size_t texcoordOffset{ 0 };
+	size_t normalOffset{ 0 };
+
+	size_t faceCount() const { return indices.size() / 3; }
+};
+
+//What parseChunk keeps, the streaming passes only need one half of the file each
+enum ObjParseMode {
+	PARSE_ALL = 0,
+	PARSE_ATTRIBUTES = 1,   //Store v, vn and vt, only count the triangles of faces
+	PARSE_FACES = 2         //Store faces and statements, only count v, vn and vt
+};
+
+//Contiguous run of faces of a chunk sharing shape, material and smoothing group
+struct ObjSegment {
+	size_t chunk;
+	size_t faceBegin;
+	size_t faceEnd;
+	size_t shape;
+	size_t shapeFaceOffset;
+	int materialId;
+	unsigned smoothingId;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Resolve a raw 1 based or negative index against the chunk local element count
+//
+inline void resolveIndex(int raw, size_t localCount, int& out, int& greatest, bool& relative) {
+	if (raw > 0) {
+		out = raw - 1;
+		greatest = std::max(greatest, out);
+		relative = false;
+	}
+	else {
+		out = int(localCount) + raw;
+		relative = true;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Parse one face vertex "v", "v/vt", "v//vn" or "v/vt/vn"
+//
+bool parseFaceVertex(const char*& p, const char* end, ObjChunk& chunk, tinyobj::index_t& index, uint8_t& relativeMask) {
+	index = { -1, -1, -1 };
+	relativeMask = 0;
+	bool relative = false;
+	int raw = 0;
+
+	if (!parseIndex(p, end, raw) || raw == 0)
+		return false;
+	resolveIndex(raw, chunk.positionCount, index.vertex_index, chunk.greatestPosition, relative);
+	relativeMask |= relative ? 1 : 0;
+
+	if (p < end && *p == '/') {
+		p++;
+		if (p < end && *p != '/' && !isSpace(*p)) {
+			if (!parseIndex(p, end, raw) || raw == 0)
+				return false;
+			resolveIndex(raw, chunk.texcoordCount, index.texcoord_index, chunk.greatestTexcoord, relative);
+			relativeMask |= relative ? 2 : 0;
+		}
+		if (p < end && *p == '/') {
+			p++;
+			if (!parseIndex(p, end, raw) || raw == 0)
+				return false;
+			resolveIndex(raw, chunk.normalCount, index.normal_index, chunk.greatestNormal, relative);
+			relativeMask |= relative ? 4 : 0;
+		}
+	}
+	return p >= end || isSpace(*p);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Count the vertices of a face line without parsing them
+//
+size_t countFaceVertices(const char* p, const char* end) {
+	size_t count = 0;
+	while ((p = skipSpaces(p, end)) < end) {
+		p = skipToken(p, end);
+		count++;
+	}
+	return count;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Parse the lines of a chunk, mode selects which statements are stored
+//
+void parseChunk(ObjChunk& chunk, ObjParseMode mode = PARSE_ALL) {
+	std::vector<tinyobj::index_t> faceVertices;
+	std::vector<uint8_t> faceRelativeMasks;
+
+	auto emitFaceVertex = [&](size_t i) {
+		size_t position = chunk.indices.size();
+		chunk.indices.push_back(faceVertices[i]);
+		if (faceRelativeMasks[i] & 1)
+			chunk.relativePositions.push_back(position);
+		if (faceRelativeMasks[i] & 2)
+			chunk.relativeTexcoords.push_back(position);
+		if (faceRelativeMasks[i] & 4)
+			chunk.relativeNormals.push_back(position);
+	};
+
+	const char* p = chunk.begin;
+	while (p < chunk.end) {
+		const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+		if (lineEnd == nullptr)
+			lineEnd = chunk.end;
+		const char* s = skipSpaces(p, lineEnd);
+		p = lineEnd < chunk.end ? lineEnd + 1 : chunk.end;
+		chunk.lineCount++;
+
+		if (s >= lineEnd || *s == '#')
+			continue;
+
+		if (s[0] == 'v' && s + 1 < lineEnd && isSpace(s[1])) {
+			//Vertex, with optional vertex color
+			chunk.positionCount++;
+			if (mode == PARSE_FACES)
+				continue;
+			const char* c = s + 2;
+			float x, y, z, r, g, b;
+			parseFloatOr(c, lineEnd, x, 0.0f);
+			parseFloatOr(c, lineEnd, y, 0.0f);
+			parseFloatOr(c, lineEnd, z, 0.0f);
+			if (parseFloat(c, lineEnd, r) && parseFloat(c, lineEnd, g) && parseFloat(c, lineEnd, b))
+				chunk.colorCount++;
+			else
+				r = g = b = 1.0f;
+			chunk.positions.insert(chunk.positions.end(), { x, y, z });
+			chunk.colors.insert(chunk.colors.end(), { r, g, b });
+		}
+		else if (s[0] == 'v' && s + 2 < lineEnd && s[1] == 'n' && isSpace(s[2])) {
+			//Normal
+			chunk.normalCount++;
+			if (mode == PARSE_FACES)
+				continue;
+			const char* c = s + 3;
+			float x, y, z;
+			parseFloatOr(c, lineEnd, x, 0.0f);
+			parseFloatOr(c, lineEnd, y, 0.0f);
+			parseFloatOr(c, lineEnd, z, 0.0f);
+			chunk.normals.insert(chunk.normals.end(), { x, y, z });
+		}
+		else if (s[0] == 'v' && s + 2 < lineEnd && s[1] == 't' && isSpace(s[2])) {
+			//Texture coordinate, 'w' is ignored
+			chunk.texcoordCount++;
+			if (mode == PARSE_FACES)
+				continue;
+			const char* c = s + 3;
+			float u, v;
+			parseFloatOr(c, lineEnd, u, 0.0f);
+			parseFloatOr(c, lineEnd, v, 0.0f);
+			chunk.texcoords.insert(chunk.texcoords.end(), { u, v });
+		}
+		else if (s[0] == 'f' && s + 1 < lineEnd && isSpace(s[1])) {
+			//Face, fan triangulated
+			if (mode == PARSE_ATTRIBUTES) {
+				size_t vertexCount = countFaceVertices(s + 2, lineEnd);
+				chunk.triangleCount += vertexCount >= 3 ? vertexCount - 2 : 0;
+				continue;
+			}
+			faceVertices.clear();
+			faceRelativeMasks.clear();
+			const char* c = skipSpaces(s + 2, lineEnd);
+			while (c < lineEnd) {
+				tinyobj::index_t index;
+				uint8_t relativeMask;
+				if (!parseFaceVertex(c, lineEnd, chunk, index, relativeMask)) {
+					chunk.error = "Failed parse `f' line(e.g. zero value for face index.";
+					chunk.errorLine = chunk.lineCount;
+					return;
+				}
+				faceVertices.push_back(index);
+				faceRelativeMasks.push_back(relativeMask);
+				c = skipSpaces(c, lineEnd);
+			}
+			if (faceVertices.size() < 3) {
+				chunk.degenerateFaces++;
+				continue;
+			}
+			if (faceVertices.size() == 4)
+				chunk.quadFaces.push_back(chunk.faceCount());
+			for (size_t i = 1; i + 1 < faceVertices.size(); i++) {
+				emitFaceVertex(0);
+				emitFaceVertex(i);
+				emitFaceVertex(i + 1);
+			}
+			chunk.triangleCount += faceVertices.size() - 2;
+		}
+		else if (mode == PARSE_ATTRIBUTES) {
+			continue;
+		}
+		else if (isKeyword(s, lineEnd, "usemtl", 6)) {
+			const char* c = skipSpaces(s + 6, lineEnd);
+			chunk.events.push_back({ ObjEvent::USE_MTL, chunk.faceCount(), std::string(c, skipToken(c, lineEnd)) });
+		}
+		else if (isKeyword(s, lineEnd, "mtllib", 6)) {
+			chunk.events.push_back({ ObjEvent::MTL_LIB, chunk.faceCount(), restOfLine(s + 6, lineEnd) });
+		}
+		else if (isKeyword(s, lineEnd, "g", 1)) {
+			chunk.events.push_back({ ObjEvent::GROUP, chunk.faceCount(), joinedTokens(s + 1, lineEnd) });
+		}
+		else if (isKeyword(s, lineEnd, "o", 1)) {
+			chunk.events.push_back({ ObjEvent::OBJECT, chunk.faceCount(), restOfLine(s + 1, lineEnd) });
+		}
+		else if (isKeyword(s, lineEnd, "s", 1)) {
+			std::string value = restOfLine(s + 1, lineEnd);
+			ObjEvent event{ ObjEvent::SMOOTHING, chunk.faceCount(), "" };
+			if (!value.empty() && value != "off") {
+				const char* c = value.c_str();
+				int id = 0;
+				if (parseIndex(c, c + value.size(), id) && id > 0)
+					event.smoothingId = unsigned(id);
+			}
+			chunk.events.push_back(event);
+		}
+		else {
+			//Lines, points and tinyobj extensions are not consumed by the viewer
+			chunk.skippedLines++;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Split the mapped file in chunkCount pieces ending at line boundaries
+//
+std::vector<ObjChunk> splitChunks(const char* data, size_t size, size_t chunkCount) {
+	std::vector<ObjChunk> chunks;
+	chunks.reserve(chunkCount);
+	const char* end = data + size;
+	const char* begin = data;
+	for (size_t i = 1; i <= chunkCount && begin < end; i++) {
+		const char* split = i == chunkCount ? end : data + size / chunkCount * i;
+		if (split < begin)
+			split = begin;
+		if (split < end) {
+			const char* newline = static_cast<const char*>(std::memchr(split, '\n', end - split));
+			split = newline ? newline + 1 : end;
+		}
+		ObjChunk chunk{};
+		chunk.begin = begin;
+		chunk.end = split;
+		chunks.push_back(std::move(chunk));
+		begin = split;
+	}
+	return chunks;
+}
+
+using Clock = std::chrono::high_resolution_clock;
+
+double millisecondsSince(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+//Running totals over the chunks of a file
+struct ObjTotals {
+	size_t lineCount{ 0 };
+	size_t positionCount{ 0 };
+	size_t colorCount{ 0 };
+	size_t texcoordCount{ 0 };
+	size_t normalCount{ 0 };
+	size_t triangleCount{ 0 };
+	size_t skippedLines{ 0 };
+	size_t degenerateFaces{ 0 };
+	int greatestPosition{ -1 };
+	int greatestTexcoord{ -1 };
+	int greatestNormal{ -1 };
+};
+
+//--------------------------------------------------------------------------------------------------
+// Report the first chunk error with its global line number and assign the attribute offsets of the
+// chunks, the totals carry over between calls so a file can be accumulated window by window
+//
+bool accumulateChunks(std::vector<ObjChunk>& chunks, ObjTotals& totals, std::string* err) {
+	for (ObjChunk& chunk : chunks) {
+		if (!chunk.error.empty()) {
+			if (err)
+				(*err) += chunk.error + " line " + std::to_string(totals.lineCount + chunk.errorLine) + ".)\n";
+			return false;
+		}
+		totals.lineCount += chunk.lineCount;
+		chunk.positionOffset = totals.positionCount;
+		chunk.texcoordOffset = totals.texcoordCount;
+		chunk.normalOffset = totals.normalCount;
+		totals.positionCount += chunk.positionCount;
+		totals.colorCount += chunk.colorCount;
+		totals.texcoordCount += chunk.texcoordCount;
+		totals.normalCount += chunk.normalCount;
+		totals.triangleCount += chunk.triangleCount;
+		totals.skippedLines += chunk.skippedLines;
+		totals.degenerateFaces += chunk.degenerateFaces;
+		totals.greatestPosition = std::max(totals.greatestPosition, chunk.greatestPosition);
+		totals.greatestTexcoord = std::max(totals.greatestTexcoord, chunk.greatestTexcoord);
+		totals.greatestNormal = std::max(totals.greatestNormal, chunk.greatestNormal);
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Check the absolute position indices seen so far against the position count of the whole file,
+// texcoord and normal indices out of range are dropped by dropOutOfRangeIndices instead
+//
+bool checkIndexRange(const ObjTotals& totals, size_t positionCount, std::string* err) {
+	if (totals.greatestPosition >= int64_t(positionCount)) {
+		if (err)
+			(*err) += "Face index out of range of the vertex positions.\n";
+		return false;
+	}
+	return true;
+}
+
+//Texcoord and normal indices reset to -1 because they were out of range
+struct ObjDroppedIndices {
+	size_t texcoords{ 0 };
+	size_t normals{ 0 };
+};
+
+//--------------------------------------------------------------------------------------------------
+// Reset the texcoord and normal indices of a chunk past the attribute counts to -1, so the faces
+// load without them. tinyobj only warns about these files, which it loads.
+//
+ObjDroppedIndices dropOutOfRangeIndices(ObjChunk& chunk, size_t texcoordCount, size_t normalCount) {
+	ObjDroppedIndices dropped{};
+	for (tinyobj::index_t& index : chunk.indices) {
+		if (index.texcoord_index >= int64_t(texcoordCount)) {
+			index.texcoord_index = -1;
+			dropped.texcoords++;
+		}
+		if (index.normal_index >= int64_t(normalCount)) {
+			index.normal_index = -1;
+			dropped.normals++;
+		}
+	}
+	return dropped;
+}
+
+void warnDroppedIndices(const ObjDroppedIndices& dropped, std::string* warn) {
+	if (warn && dropped.texcoords > 0)
+		(*warn) += "Dropped " + std::to_string(dropped.texcoords) + " out of range texcoord face index(es).\n";
+	if (warn && dropped.normals > 0)
+		(*warn) += "Dropped " + std::to_string(dropped.normals) + " out of range normal face index(es).\n";
+}
+
+void warnSkippedLines(const ObjTotals& totals, std::string* warn) {
+	if (warn && totals.skippedLines > 0)
+		(*warn) += "Skipped " + std::to_string(totals.skippedLines) + " unsupported line(s) (l, p, vw, t, ...).\n";
+	if (warn && totals.degenerateFaces > 0)
+		(*warn) += "Skipped " + std::to_string(totals.degenerateFaces) + " face(s) with less than 3 vertices.\n";
+}
+
+//--------------------------------------------------------------------------------------------------
+// Add the chunk offsets to the relative indices, returns false if one points before the file start
+//
+bool resolveRelativeIndices(ObjChunk& chunk) {
+	bool valid = true;
+	for (size_t position : chunk.relativePositions) {
+		int& index = chunk.indices[position].vertex_index;
+		index += int(chunk.positionOffset);
+		valid &= index >= 0;
+	}
+	for (size_t position : chunk.relativeTexcoords) {
+		int& index = chunk.indices[position].texcoord_index;
+		index += int(chunk.texcoordOffset);
+		valid &= index >= 0;
+	}
+	for (size_t position : chunk.relativeNormals) {
+		int& index = chunk.indices[position].normal_index;
+		index += int(chunk.normalOffset);
+		valid &= index >= 0;
+	}
+	return valid;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Split the quads of a chunk along their shorter diagonal like tinyobj does, indices must be global
+//
+void splitQuads(ObjChunk& chunk, const float* positions) {
+	auto squaredDistance = [&](int a, int b) {
+		float dx = positions[3 * b + 0] - positions[3 * a + 0];
+		float dy = positions[3 * b + 1] - positions[3 * a + 1];
+		float dz = positions[3 * b + 2] - positions[3 * a + 2];
+		return dx * dx + dy * dy + dz * dz;
+	};
+	for (size_t face : chunk.quadFaces) {
+		tinyobj::index_t* quad = &chunk.indices[face * 3];
+		tinyobj::index_t i0 = quad[0], i1 = quad[1], i2 = quad[2], i3 = quad[5];
+		if (!(squaredDistance(i0.vertex_index, i2.vertex_index) < squaredDistance(i1.vertex_index, i3.vertex_index))) {
+			quad[0] = i0; quad[1] = i1; quad[2] = i3;
+			quad[3] = i1; quad[4] = i2; quad[5] = i3;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Applies the state changing statements of the chunks in file order and splits their faces into
+// segments of one shape, material and smoothing group. Material libraries are read on mtllib.
+//
+class ObjEventWalker {
+public:
+	ObjEventWalker(const std::string& mtlBaseDir, std::vector<tinyobj::material_t>* materials, std::vector<std::string>& materialFilenames,
+		std::string* warn, std::string* err);
+
+	void walk(const ObjChunk& chunk, size_t chunkIndex, std::vector<ObjSegment>& segments);
+
+	std::vector<std::string> m_shapeNames;
+	std::vector<size_t> m_shapeFaceCounts;
+
+private:
+	void addSegment(size_t chunkIndex, size_t faceBegin, size_t faceEnd, std::vector<ObjSegment>& segments);
+	void loadMaterialLibrary(const std::string& filenames);
+
+	std::string m_baseDir;
+	tinyobj::MaterialFileReader m_materialReader;
+	std::vector<tinyobj::material_t>* m_materials;
+	std::vector<std::string>& m_materialFilenames;
+	std::string* m_warn;
+	std::string* m_err;
+
+	std::map<std::string, int> m_materialMap;
+	std::set<std::string> m_loadedLibraries;
+	std::string m_name;
+	int m_materialId{ -1 };
+	unsigned m_smoothingId{ 0 };
+	bool m_shapeOpen{ false };
+};
+
+//Base directory with the trailing separator tinyobj::MaterialFileReader expects
+std::string materialBaseDir(const std::string& mtlBaseDir) {
+	std::string baseDir = mtlBaseDir;
+	if (!baseDir.empty()) {
+#ifndef _WIN32
+		const char dirsep = '/';
+#else
+		const char dirsep = '\\';
+#endif
+		if (baseDir.back() != dirsep)
+			baseDir += dirsep;
+	}
+	return baseDir;
+}
+
+ObjEventWalker::ObjEventWalker(const std::string& mtlBaseDir, std::vector<tinyobj::material_t>* materials, std::vector<std::string>& materialFilenames,
+	std::string* warn, std::string* err)
+	: m_baseDir(materialBaseDir(mtlBaseDir)), m_materialReader(m_baseDir), m_materials(materials), m_materialFilenames(materialFilenames),
+	m_warn(warn), m_err(err) {
+}
+
+//--------------------------------------------------------------------------------------------------
+// Append the segments of a chunk, the walker state carries over to the next chunk
+//
+void ObjEventWalker::walk(const ObjChunk& chunk, size_t chunkIndex, std::vector<ObjSegment>& segments) {
+	size_t faceBegin = 0;
+	for (const ObjEvent& event : chunk.events) {
+		addSegment(chunkIndex, faceBegin, event.faceBegin, segments);
+		faceBegin = event.faceBegin;
+		switch (event.type) {
+		case ObjEvent::USE_MTL: {
+			auto it = m_materialMap.find(event.name);
+			if (it != m_materialMap.end()) {
+				m_materialId = it->second;
+			}
+			else {
+				m_materialId = -1;
+				if (m_warn)
+					(*m_warn) += "material [ '" + event.name + "' ] not found in .mtl\n";
+			}
+			break;
+		}
+		case ObjEvent::MTL_LIB:
+			loadMaterialLibrary(event.name);
+			break;
+		case ObjEvent::GROUP:
+		case ObjEvent::OBJECT:
+			m_name = event.name;
+			m_shapeOpen = false;
+			break;
+		case ObjEvent::SMOOTHING:
+			m_smoothingId = event.smoothingId;
+			break;
+		}
+	}
+	addSegment(chunkIndex, faceBegin, chunk.faceCount(), segments);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Add the faces [faceBegin, faceEnd) of a chunk to the current shape
+//
+void ObjEventWalker::addSegment(size_t chunkIndex, size_t faceBegin, size_t faceEnd, std::vector<ObjSegment>& segments) {
+	if (faceEnd <= faceBegin)
+		return;
+	if (!m_shapeOpen) {
+		m_shapeNames.push_back(m_name);
+		m_shapeFaceCounts.push_back(0);
+		m_shapeOpen = true;
+	}
+	size_t shape = m_shapeFaceCounts.size() - 1;
+	segments.push_back({ chunkIndex, faceBegin, faceEnd, shape, m_shapeFaceCounts[shape], m_materialId, m_smoothingId });
+	m_shapeFaceCounts[shape] += faceEnd - faceBegin;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Read the first loadable .mtl file of a mtllib statement, like tinyobj
+//
+void ObjEventWalker::loadMaterialLibrary(const std::string& filenames) {
+	bool found = false;
+	for (const std::string& mtlFilename : splitEscapedTokens(filenames)) {
+		if (m_loadedLibraries.count(mtlFilename) > 0) {
+			found = true;
+			continue;
+		}
+		std::string warnMtl, errMtl;
+		if (m_materialReader(mtlFilename, m_materials, &m_materialMap, &warnMtl, &errMtl)) {
+			m_loadedLibraries.insert(mtlFilename);
+			m_materialFilenames.push_back(m_baseDir + mtlFilename);
+			found = true;
+		}
+		if (m_warn)
+			(*m_warn) += warnMtl;
+		if (m_err)
+			(*m_err) += errMtl;
+		if (found)
+			break;
+	}
+	if (!found && m_warn)
+		(*m_warn) += "Failed to load material file(s). Use default material.\n";
+}
+
+//--------------------------------------------------------------------------------------------------
+// Temporary files holding the vertex attributes of a streamed .obj file. They are written during
+// the first pass and mapped read-only for the second one, so the attributes live in the page cache
+// instead of the heap. The files are removed on destruction.
+//
+class ObjSpillFiles {
+public:
+	enum Stream {
+		POSITIONS = 0,
+		COLORS = 1,
+		TEXCOORDS = 2,
+		NORMALS = 3,
+		STREAM_COUNT = 4
+	};
+
+	~ObjSpillFiles();
+
+	bool create(const std::string& directory, const std::string& filename);
+	bool append(const ObjChunk& chunk);
+	bool map();
+	const float* data(Stream stream) const { return reinterpret_cast<const float*>(m_mappings[stream].data()); }
+	size_t size() const;
+
+private:
+	std::string m_paths[STREAM_COUNT];
+	std::ofstream m_files[STREAM_COUNT];
+	MappedFile m_mappings[STREAM_COUNT];
+};
+
+ObjSpillFiles::~ObjSpillFiles() {
+	std::error_code errorCode;
+	for (int i = 0; i < STREAM_COUNT; i++) {
+		m_files[i].close();
+		m_mappings[i].close();
+		if (!m_paths[i].empty())
+			std::filesystem::remove(m_paths[i], errorCode);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Create the files in directory, or in the temp directory if it is empty
+//
+bool ObjSpillFiles::create(const std::string& directory, const std::string& filename) {
+	std::error_code errorCode;
+	std::filesystem::path spillDirectory = directory.empty() ? std::filesystem::temp_directory_path(errorCode) / "VulkanModelViewer" : std::filesystem::path(directory);
+	if (errorCode || (std::filesystem::create_directories(spillDirectory, errorCode), errorCode))
+		return false;
+
+	const char* streamNames[STREAM_COUNT] = { "positions", "colors", "texcoords", "normals" };
+	std::string prefix = std::filesystem::path(filename).stem().string() + "_" + std::to_string(Clock::now().time_since_epoch().count());
+	for (int i = 0; i < STREAM_COUNT; i++) {
+		m_paths[i] = (spillDirectory / (prefix + "_" + streamNames[i] + ".spill")).string();
+		m_files[i].open(m_paths[i], std::ios::binary | std::ios::trunc);
+		if (!m_files[i].is_open())
+			return false;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Append the attributes of a chunk parsed with PARSE_ATTRIBUTES
+//
+bool ObjSpillFiles::append(const ObjChunk& chunk) {
+	const std::vector<float>* streams[STREAM_COUNT] = { &chunk.positions, &chunk.colors, &chunk.texcoords, &chunk.normals };
+	for (int i = 0; i < STREAM_COUNT; i++)
+		m_files[i].write(reinterpret_cast<const char*>(streams[i]->data()), std::streamsize(streams[i]->size() * sizeof(float)));
+	return std::all_of(std::begin(m_files), std::end(m_files), [](const std::ofstream& file) { return file.good(); });
+}
+
+//--------------------------------------------------------------------------------------------------
+// Finish writing and map the files for reading
+//
+bool ObjSpillFiles::map() {
+	try {
+		for (int i = 0; i < STREAM_COUNT; i++) {
+			m_files[i].close();
+			if (m_files[i].fail())
+				return false;
+			m_mappings[i].open(m_paths[i]);
+		}
+	}
+	catch (const std::runtime_error&) {
+		return false;
+	}
+	return true;
+}
+
+size_t ObjSpillFiles::size() const {
+	size_t size = 0;
+	for (const MappedFile& mapping : m_mappings)
+		size += mapping.size();
+	return size;
+}
+
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Load a .obj file and its .mtl libraries.
+// The output matches tinyobj::LoadObj with triangulation and default vertex colors enabled.
+//
+bool ObjParser::load(tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes, std::vector<tinyobj::material_t>* materials,
+	std::string* warn, std::string* err, const std::string& filename, const std::string& mtlBaseDir) {
+	Clock::time_point startTime = Clock::now();
+	m_stats = {};
+	m_materialFilenames.clear();
+
+	attrib->vertices.clear();
+	attrib->normals.clear();
+	attrib->texcoords.clear();
+	attrib->colors.clear();
+	shapes->clear();
+
+	//Map the file
+	MappedFile file;
+	try {
+		file.open(filename);
+	}
+	catch (const std::runtime_error&) {
+		if (err)
+			(*err) += "Cannot open file [" + filename + "]\n";
+		return false;
+	}
+	m_stats.fileSize = file.size();
+	m_stats.mapMilliseconds = millisecondsSince(startTime);
+
+	//Parse chunks in parallel
+	Clock::time_point parseTime = Clock::now();
+	unsigned threadCount = m_threadCount > 0 ? m_threadCount : default_thread_count();
+	size_t chunkCount = std::max<size_t>(1, std::min<size_t>(size_t(threadCount) * 4, file.size() / std::max<size_t>(m_minChunkSize, 1)));
+	std::vector<ObjChunk> chunks = splitChunks(file.data(), file.size(), chunkCount);
+	parallel_for(chunks.size(), [&](size_t i) { parseChunk(chunks[i]); }, threadCount);
+	m_stats.threadCount = threadCount;
+	m_stats.chunkCount = chunks.size();
+	m_stats.windowCount = 1;
+	m_stats.parseMilliseconds = millisecondsSince(parseTime);
+
+	//Report the first error with its global line number, and compute attribute offsets
+	Clock::time_point mergeTime = Clock::now();
+	ObjTotals totals{};
+	if (!accumulateChunks(chunks, totals, err))
+		return false;
+	if (!checkIndexRange(totals, totals.positionCount, err))
+		return false;
+	bool dropIndices = totals.greatestTexcoord >= int64_t(totals.texcoordCount) || totals.greatestNormal >= int64_t(totals.normalCount);
+	warnSkippedLines(totals, warn);
+
+	//Walk the state changing statements in file order to split faces into shapes
+	ObjEventWalker walker(mtlBaseDir, materials, m_materialFilenames, warn, err);
+	std::vector<ObjSegment> segments;
+	std::vector<size_t> chunkSegmentBegin(chunks.size() + 1, 0);
+	for (size_t c = 0; c < chunks.size(); c++) {
+		chunkSegmentBegin[c] = segments.size();
+		walker.walk(chunks[c], c, segments);
+	}
+	chunkSegmentBegin[chunks.size()] = segments.size();
+
+	//Allocate the outputs
+	attrib->vertices.resize(totals.positionCount * 3);
+	attrib->colors.resize(totals.positionCount * 3);
+	attrib->texcoords.resize(totals.texcoordCount * 2);
+	attrib->normals.resize(totals.normalCount * 3);
+	shapes->resize(walker.m_shapeNames.size());
+	for (size_t s = 0; s < shapes->size(); s++) {
+		tinyobj::shape_t& shape = (*shapes)[s];
+		size_t shapeFaceCount = walker.m_shapeFaceCounts[s];
+		shape.name = walker.m_shapeNames[s];
+		shape.mesh.indices.resize(shapeFaceCount * 3);
+		shape.mesh.num_face_vertices.assign(shapeFaceCount, 3);
+		shape.mesh.material_ids.resize(shapeFaceCount);
+		shape.mesh.smoothing_group_ids.resize(shapeFaceCount);
+	}
+
+	//Resolve relative indices and copy the vertex attributes in parallel
+	std::vector<char> relativeIndexErrors(chunks.size(), 0);
+	std::vector<ObjDroppedIndices> droppedIndices(chunks.size());
+	parallel_for(chunks.size(), [&](size_t c) {
+		ObjChunk& chunk = chunks[c];
+		relativeIndexErrors[c] = !resolveRelativeIndices(chunk);
+		if (dropIndices)
+			droppedIndices[c] = dropOutOfRangeIndices(chunk, totals.texcoordCount, totals.normalCount);
+		std::copy(chunk.positions.begin(), chunk.positions.end(), attrib->vertices.begin() + chunk.positionOffset * 3);
+		std::copy(chunk.colors.begin(), chunk.colors.end(), attrib->colors.begin() + chunk.positionOffset * 3);
+		std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), attrib->texcoords.begin() + chunk.texcoordOffset * 2);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), attrib->normals.begin() + chunk.normalOffset * 3);
+	}, threadCount);
+
+	for (char relativeIndexError : relativeIndexErrors) {
+		if (relativeIndexError) {
+			if (err)
+				(*err) += "Relative face index points before the first vertex attribute.\n";
+			shapes->clear();
+			return false;
+		}
+	}
+	ObjDroppedIndices dropped{};
+	for (const ObjDroppedIndices& chunkDropped : droppedIndices) {
+		dropped.texcoords += chunkDropped.texcoords;
+		dropped.normals += chunkDropped.normals;
+	}
+	warnDroppedIndices(dropped, warn);
+
+	//Split quads, then scatter faces into the shapes
+	parallel_for(chunks.size(), [&](size_t c) {
+		ObjChunk& chunk = chunks[c];
+		splitQuads(chunk, attrib->vertices.data());
+
+		for (size_t i = chunkSegmentBegin[c]; i < chunkSegmentBegin[c + 1]; i++) {
+			const ObjSegment& segment = segments[i];
+			tinyobj::mesh_t& mesh = (*shapes)[segment.shape].mesh;
+			std::copy(chunk.indices.begin() + segment.faceBegin * 3, chunk.indices.begin() + segment.faceEnd * 3,
+				mesh.indices.begin() + segment.shapeFaceOffset * 3);
+			size_t faceCount = segment.faceEnd - segment.faceBegin;
+			std::fill_n(mesh.material_ids.begin() + segment.shapeFaceOffset, faceCount, segment.materialId);
+			std::fill_n(mesh.smoothing_group_ids.begin() + segment.shapeFaceOffset, faceCount, segment.smoothingId);
+		}
+
+		//Release the chunk memory early, large files would otherwise be held twice
+		chunk = ObjChunk{};
+	}, threadCount);
+
+	m_stats.mergeMilliseconds = millisecondsSince(mergeTime);
+	m_stats.totalMilliseconds = millisecondsSince(startTime);
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Stream a .obj file in windows of m_windowSize bytes without building the whole mesh in memory.
+// The first pass spills the vertex attributes to temporary files, which are mapped and handed to
+// beginFaces. The second pass hands the triangulated faces to processWindow piece by piece, in file
+// order, with indices into those attributes. Pages of the .obj file are dropped after each window.
+// The time spent in the callbacks is not part of m_stats.
+//
+bool ObjParser::stream(const std::string& filename, const std::string& mtlBaseDir, std::vector<tinyobj::material_t>* materials,
+	std::string* warn, std::string* err, const std::function<void(const ObjStreamAttributes&)>& beginFaces,
+	const std::function<void(const ObjStreamWindow&)>& processWindow) {
+	Clock::time_point startTime = Clock::now();
+	m_stats = {};
+	m_materialFilenames.clear();
+
+	//Map the file
+	MappedFile file;
+	try {
+		file.open(filename);
+	}
+	catch (const std::runtime_error&) {
+		if (err)
+			(*err) += "Cannot open file [" + filename + "]\n";
+		return false;
+	}
+	m_stats.fileSize = file.size();
+	m_stats.mapMilliseconds = millisecondsSince(startTime);
+
+	unsigned threadCount = m_threadCount > 0 ? m_threadCount : default_thread_count();
+	size_t windowSize = std::max<size_t>(m_windowSize, 1);
+	std::vector<ObjChunk> windows = splitChunks(file.data(), file.size(), std::max<size_t>(1, (file.size() + windowSize - 1) / windowSize));
+	m_stats.threadCount = threadCount;
+	m_stats.windowCount = windows.size();
+
+	//Each window is split again into chunks parsed in parallel
+	auto parseWindow = [&](const ObjChunk& window, ObjParseMode mode) {
+		size_t windowBytes = size_t(window.end - window.begin);
+		size_t chunkCount = std::max<size_t>(1, std::min<size_t>(size_t(threadCount) * 4, windowBytes / std::max<size_t>(m_minChunkSize, 1)));
+		std::vector<ObjChunk> chunks = splitChunks(window.begin, windowBytes, chunkCount);
+		parallel_for(chunks.size(), [&](size_t i) { parseChunk(chunks[i], mode); }, threadCount);
+		m_stats.chunkCount += chunks.size();
+		return chunks;
+	};
+	auto evictWindow = [&](const ObjChunk& window) {
+		file.evict(size_t(window.begin - file.data()), size_t(window.end - window.begin));
+	};
+
+	//First pass, spill the vertex attributes
+	Clock::time_point parseTime = Clock::now();
+	ObjSpillFiles spillFiles;
+	if (!spillFiles.create(m_spillDirectory, filename)) {
+		if (err)
+			(*err) += "Cannot create the attribute spill files.\n";
+		return false;
+	}
+	ObjTotals attributeTotals{};
+	for (const ObjChunk& window : windows) {
+		std::vector<ObjChunk> chunks = parseWindow(window, PARSE_ATTRIBUTES);
+		if (!accumulateChunks(chunks, attributeTotals, err))
+			return false;
+		for (const ObjChunk& chunk : chunks) {
+			if (!spillFiles.append(chunk)) {
+				if (err)
+					(*err) += "Cannot write the attribute spill files.\n";
+				return false;
+			}
+		}
+		evictWindow(window);
+	}
+	if (!spillFiles.map()) {
+		if (err)
+			(*err) += "Cannot map the attribute spill files.\n";
+		return false;
+	}
+	m_stats.spillBytes = spillFiles.size();
+
+	ObjStreamAttributes attributes{};
+	attributes.positions = spillFiles.data(ObjSpillFiles::POSITIONS);
+	attributes.colors = spillFiles.data(ObjSpillFiles::COLORS);
+	attributes.texcoords = spillFiles.data(ObjSpillFiles::TEXCOORDS);
+	attributes.normals = spillFiles.data(ObjSpillFiles::NORMALS);
+	attributes.positionCount = attributeTotals.positionCount;
+	attributes.colorCount = attributeTotals.colorCount;
+	attributes.texcoordCount = attributeTotals.texcoordCount;
+	attributes.normalCount = attributeTotals.normalCount;
+	attributes.triangleCount = attributeTotals.triangleCount;
+	m_stats.parseMilliseconds = millisecondsSince(parseTime);
+
+	Clock::time_point callbackTime = Clock::now();
+	beginFaces(attributes);
+	double beginFacesMilliseconds = millisecondsSince(callbackTime);
+
+	//Second pass, faces window by window
+	parseTime = Clock::now();
+	ObjEventWalker walker(mtlBaseDir, materials, m_materialFilenames, warn, err);
+	ObjTotals faceTotals{};
+	ObjDroppedIndices dropped{};
+	double processWindowMilliseconds = 0.0;
+	std::vector<ObjSegment> segments;
+	std::vector<ObjStreamRun> runs;
+	for (const ObjChunk& window : windows) {
+		std::vector<ObjChunk> chunks = parseWindow(window, PARSE_FACES);
+		if (!accumulateChunks(chunks, faceTotals, err))
+			return false;
+		if (!checkIndexRange(faceTotals, attributes.positionCount, err))
+			return false;
+
+		std::vector<char> relativeIndexErrors(chunks.size(), 0);
+		parallel_for(chunks.size(), [&](size_t c) { relativeIndexErrors[c] = !resolveRelativeIndices(chunks[c]); }, threadCount);
+		if (std::find(relativeIndexErrors.begin(), relativeIndexErrors.end(), 1) != relativeIndexErrors.end()) {
+			if (err)
+				(*err) += "Relative face index points before the first vertex attribute.\n";
+			return false;
+		}
+		if (faceTotals.greatestTexcoord >= int64_t(attributes.texcoordCount) || faceTotals.greatestNormal >= int64_t(attributes.normalCount)) {
+			for (ObjChunk& chunk : chunks) {
+				ObjDroppedIndices chunkDropped = dropOutOfRangeIndices(chunk, attributes.texcoordCount, attributes.normalCount);
+				dropped.texcoords += chunkDropped.texcoords;
+				dropped.normals += chunkDropped.normals;
+			}
+		}
+		parallel_for(chunks.size(), [&](size_t c) { splitQuads(chunks[c], attributes.positions); }, threadCount);
+
+		for (size_t c = 0; c < chunks.size(); c++) {
+			segments.clear();
+			walker.walk(chunks[c], c, segments);
+			runs.clear();
+			for (const ObjSegment& segment : segments)
+				runs.push_back({ segment.faceBegin, segment.faceEnd, segment.shape, segment.materialId });
+			if (runs.empty())
+				continue;
+
+			callbackTime = Clock::now();
+			processWindow({ chunks[c].indices.data(), chunks[c].faceCount(), runs.data(), runs.size() });
+			processWindowMilliseconds += millisecondsSince(callbackTime);
+		}
+		evictWindow(window);
+	}
+	warnSkippedLines(faceTotals, warn);
+	warnDroppedIndices(dropped, warn);
+
+	m_stats.parseMilliseconds += millisecondsSince(parseTime) - processWindowMilliseconds;
+	m_stats.totalMilliseconds = millisecondsSince(startTime) - beginFacesMilliseconds - processWindowMilliseconds;
+	return true;
+}
@@ -0,0 +1,81 @@
+#ifndef OBJ_PARSER_COMMON
+#define OBJ_PARSER_COMMON
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <tiny_obj_loader.h>
+
+//Timing of the last ObjParser::load or ObjParser::stream call
+struct ObjParseStats {
+	size_t fileSize{ 0 };
+	unsigned threadCount{ 0 };
+	size_t chunkCount{ 0 };
+	size_t windowCount{ 0 };
+	size_t spillBytes{ 0 };
+	double mapMilliseconds{ 0.0 };
+	double parseMilliseconds{ 0.0 };
+	double mergeMilliseconds{ 0.0 };
+	double totalMilliseconds{ 0.0 };
+
+	double throughputMBs() const {
+		return totalMilliseconds > 0.0 ? fileSize / (1024.0 * 1024.0) / (totalMilliseconds / 1000.0) : 0.0;
+	}
+};
+
+//Vertex attributes of a streamed file, mapped read-only from the spill files
+struct ObjStreamAttributes {
+	const float* positions;   //xyz
+	const float* colors;      //rgb, white where the file has none
+	const float* texcoords;   //uv
+	const float* normals;     //xyz
+	size_t positionCount;
+	size_t colorCount;        //Positions with a color in the file
+	size_t texcoordCount;
+	size_t normalCount;
+	size_t triangleCount;     //Triangles of the whole file after triangulation
+};
+
+//Faces of a streamed piece sharing shape and material, shapes are numbered in file order
+struct ObjStreamRun {
+	size_t faceBegin;
+	size_t faceEnd;
+	size_t shape;
+	int materialId;
+};
+
+//Triangulated faces of one piece of a streamed file
+struct ObjStreamWindow {
+	const tinyobj::index_t* indices;   //Three per face, indexing ObjStreamAttributes
+	size_t faceCount;
+	const ObjStreamRun* runs;
+	size_t runCount;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Multi-threaded .obj parser producing the same attrib/shape/material layout as tinyobj::LoadObj.
+// The file is memory mapped and split at line boundaries, chunks are parsed in parallel and then
+// merged. Quads are split along the shorter diagonal and larger polygons are fan triangulated,
+// vertex colors fall back to white like tinyobj does, and lines, points and tinyobj extensions
+// (vw, t) are skipped. Texcoord and normal indices out of range are set to -1 with a warning, where
+// tinyobj only warns. .mtl files are read with tinyobj.
+// stream() is the out-of-core variant: memory stays bounded by m_windowSize instead of the file size.
+//
+class ObjParser {
+public:
+	ObjParser(unsigned threadCount = 0) : m_threadCount(threadCount) {};
+
+	bool load(tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes, std::vector<tinyobj::material_t>* materials,
+		std::string* warn, std::string* err, const std::string& filename, const std::string& mtlBaseDir = "");
+	bool stream(const std::string& filename, const std::string& mtlBaseDir, std::vector<tinyobj::material_t>* materials,
+		std::string* warn, std::string* err, const std::function<void(const ObjStreamAttributes&)>& beginFaces,
+		const std::function<void(const ObjStreamWindow&)>& processWindow);
+
+	unsigned m_threadCount;   //0 uses every hardware thread
+	size_t m_minChunkSize{ 1 << 20 };
+	size_t m_windowSize{ 64 << 20 };   //Bytes of the file parsed at once by stream()
+	std::string m_spillDirectory;      //Where stream() spills the attributes, the temp directory if empty
+	ObjParseStats m_stats{};
+	std::vector<std::string> m_materialFilenames;  //.mtl files read by the last load or stream
+};
+#endif // !OBJ_PARSER_COMMON
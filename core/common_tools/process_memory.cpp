@@ -0,0 +1,57 @@
+#include "process_memory.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <cstdio>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Current working set on Windows, resident set size from /proc elsewhere
+//
+size_t getResidentMemory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.WorkingSetSize;
+#else
+	FILE* statm = std::fopen("/proc/self/statm", "r");
+	if (statm == nullptr)
+		return 0;
+	unsigned long totalPages = 0, residentPages = 0;
+	int fields = std::fscanf(statm, "%lu %lu", &totalPages, &residentPages);
+	std::fclose(statm);
+	return fields == 2 ? size_t(residentPages) * size_t(sysconf(_SC_PAGESIZE)) : 0;
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+// Peak working set on Windows, maximum resident set size elsewhere
+//
+size_t getPeakResidentMemory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage {};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return size_t(usage.ru_maxrss);
+#else
+	return size_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
@@ -0,0 +1,29 @@
+#ifndef PROCESS_MEMORY_COMMON
+#define PROCESS_MEMORY_COMMON
+#include <cstddef>
+
+//Resident memory (working set) of the process in bytes, 0 if it can't be queried
+size_t getResidentMemory();
+
+//Highest resident memory of the process since it started in bytes, 0 if it can't be queried
+size_t getPeakResidentMemory();
+
+//--------------------------------------------------------------------------------------------------
+// Tracks the peak resident memory over a phase of the program, e.g. a model load.
+// The process wide peak can't be reset, so the resident memory is sampled at every sample() call.
+//
+class ResidentMemoryTracker {
+public:
+	ResidentMemoryTracker() { reset(); }
+
+	void reset() { m_startBytes = m_peakBytes = getResidentMemory(); }
+	void sample() {
+		size_t residentBytes = getResidentMemory();
+		if (residentBytes > m_peakBytes)
+			m_peakBytes = residentBytes;
+	}
+
+	size_t m_startBytes{ 0 };
+	size_t m_peakBytes{ 0 };
+};
+#endif // !PROCESS_MEMORY_COMMON
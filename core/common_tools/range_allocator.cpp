@@ -0,0 +1,304 @@
+#include "range_allocator.h"
+
+#include "tools.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//Index of the highest set bit, value must not be 0
+static uint32_t highestBit(uint64_t value) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+//Index of the lowest set bit, value must not be 0
+static uint32_t lowestBit(uint64_t value) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return index;
+#else
+	return __builtin_ctzll(value);
+#endif
+}
+
+/**
+* The implementation of class TlsfAllocator
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Reset the allocator to a single free range covering [0, size)
+//
+void TlsfAllocator::init(uint64_t size) {
+	m_size = size;
+	m_usedBytes = 0;
+	m_allocationCount = 0;
+	m_ranges.clear();
+	m_unusedRanges.clear();
+	m_flBitmap = 0;
+	for (uint32_t fl = 0; fl < TLSF_FL_COUNT; fl++) {
+		m_slBitmaps[fl] = 0;
+		for (uint32_t sl = 0; sl < TLSF_SL_COUNT; sl++)
+			m_freeHeads[fl][sl] = invalidHandle;
+	}
+	if (size > 0)
+		insertFree(newRange(0, size));
+}
+
+//--------------------------------------------------------------------------------------------------
+// Size class of a range: sizes below TLSF_SL_COUNT map one to one into the first level 0 classes,
+// larger sizes map to their power of two and the next TLSF_SL_BITS bits below it
+//
+void TlsfAllocator::mapping(uint64_t size, uint32_t& fl, uint32_t& sl) const {
+	if (size < TLSF_SL_COUNT) {
+		fl = 0;
+		sl = static_cast<uint32_t>(size);
+		return;
+	}
+	uint32_t log = highestBit(size);
+	sl = static_cast<uint32_t>(size >> (log - TLSF_SL_BITS)) ^ TLSF_SL_COUNT;
+	fl = log - TLSF_SL_BITS + 1;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Take a range record from the unused records or append a new one
+//
+uint32_t TlsfAllocator::newRange(uint64_t offset, uint64_t size) {
+	uint32_t index;
+	if (!m_unusedRanges.empty()) {
+		index = m_unusedRanges.back();
+		m_unusedRanges.pop_back();
+	}
+	else {
+		index = static_cast<uint32_t>(m_ranges.size());
+		m_ranges.emplace_back();
+	}
+	m_ranges[index] = { offset, size, invalidHandle, invalidHandle, invalidHandle, invalidHandle, true };
+	return index;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Push a range to the front of the free list of its size class
+//
+void TlsfAllocator::insertFree(uint32_t index) {
+	uint32_t fl, sl;
+	mapping(m_ranges[index].size, fl, sl);
+	uint32_t head = m_freeHeads[fl][sl];
+	m_ranges[index].free = true;
+	m_ranges[index].prevFree = invalidHandle;
+	m_ranges[index].nextFree = head;
+	if (head != invalidHandle)
+		m_ranges[head].prevFree = index;
+	m_freeHeads[fl][sl] = index;
+	m_slBitmaps[fl] |= 1u << sl;
+	m_flBitmap |= 1ull << fl;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Unlink a range from the free list of its size class
+//
+void TlsfAllocator::removeFree(uint32_t index) {
+	Range& range = m_ranges[index];
+	if (range.prevFree != invalidHandle)
+		m_ranges[range.prevFree].nextFree = range.nextFree;
+	if (range.nextFree != invalidHandle)
+		m_ranges[range.nextFree].prevFree = range.prevFree;
+
+	uint32_t fl, sl;
+	mapping(range.size, fl, sl);
+	if (m_freeHeads[fl][sl] == index) {
+		m_freeHeads[fl][sl] = range.nextFree;
+		if (range.nextFree == invalidHandle) {
+			m_slBitmaps[fl] &= ~(1u << sl);
+			if (m_slBitmaps[fl] == 0)
+				m_flBitmap &= ~(1ull << fl);
+		}
+	}
+	range.free = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Find a free range that holds size bytes at the given alignment.
+// The search starts at the class above size so the first range of a class fits unless alignment
+// padding is needed, then walks up the classes.
+//
+uint32_t TlsfAllocator::findFree(uint64_t size, uint64_t alignment) {
+	uint64_t searchSize = size;
+	if (size >= TLSF_SL_COUNT)
+		searchSize += (1ull << (highestBit(size) - TLSF_SL_BITS)) - 1;
+	uint32_t fl, sl;
+	mapping(searchSize, fl, sl);
+
+	while (fl < TLSF_FL_COUNT) {
+		uint32_t slMap = sl < TLSF_SL_COUNT ? m_slBitmaps[fl] & (~0u << sl) : 0;
+		if (slMap == 0) {
+			uint64_t flMap = fl + 1 < TLSF_FL_COUNT ? m_flBitmap & (~0ull << (fl + 1)) : 0;
+			if (flMap == 0)
+				return invalidHandle;
+			fl = lowestBit(flMap);
+			slMap = m_slBitmaps[fl];
+		}
+		sl = lowestBit(slMap);
+
+		for (uint32_t index = m_freeHeads[fl][sl]; index != invalidHandle; index = m_ranges[index].nextFree) {
+			const Range& range = m_ranges[index];
+			if (align_up(range.offset, alignment) + size <= range.offset + range.size)
+				return index;
+		}
+		sl++;
+	}
+	return invalidHandle;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Allocate size bytes at the given alignment, the alignment padding and the rest of the free range
+// are split off as free ranges
+//
+uint32_t TlsfAllocator::allocate(uint64_t size, uint64_t alignment, uint64_t& offset) {
+	if (size == 0)
+		size = 1;
+	uint32_t index = findFree(size, alignment);
+	if (index == invalidHandle)
+		return invalidHandle;
+	removeFree(index);
+
+	uint64_t rangeOffset = m_ranges[index].offset;
+	uint64_t alignedOffset = align_up(rangeOffset, alignment);
+	if (alignedOffset > rangeOffset) {
+		uint32_t front = newRange(rangeOffset, alignedOffset - rangeOffset);
+		m_ranges[front].prevPhysical = m_ranges[index].prevPhysical;
+		m_ranges[front].nextPhysical = index;
+		if (m_ranges[index].prevPhysical != invalidHandle)
+			m_ranges[m_ranges[index].prevPhysical].nextPhysical = front;
+		m_ranges[index].prevPhysical = front;
+		m_ranges[index].offset = alignedOffset;
+		m_ranges[index].size -= alignedOffset - rangeOffset;
+		insertFree(front);
+	}
+	if (m_ranges[index].size > size) {
+		uint32_t back = newRange(alignedOffset + size, m_ranges[index].size - size);
+		m_ranges[back].prevPhysical = index;
+		m_ranges[back].nextPhysical = m_ranges[index].nextPhysical;
+		if (m_ranges[index].nextPhysical != invalidHandle)
+			m_ranges[m_ranges[index].nextPhysical].prevPhysical = back;
+		m_ranges[index].nextPhysical = back;
+		m_ranges[index].size = size;
+		insertFree(back);
+	}
+	m_ranges[index].free = false;
+
+	m_usedBytes += size;
+	m_allocationCount++;
+	offset = alignedOffset;
+	return index;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Free an allocation and merge it with its free neighbours
+//
+void TlsfAllocator::free(uint32_t handle) {
+	m_usedBytes -= m_ranges[handle].size;
+	m_allocationCount--;
+
+	uint32_t next = m_ranges[handle].nextPhysical;
+	if (next != invalidHandle && m_ranges[next].free) {
+		removeFree(next);
+		m_ranges[handle].size += m_ranges[next].size;
+		m_ranges[handle].nextPhysical = m_ranges[next].nextPhysical;
+		if (m_ranges[next].nextPhysical != invalidHandle)
+			m_ranges[m_ranges[next].nextPhysical].prevPhysical = handle;
+		m_unusedRanges.push_back(next);
+	}
+	uint32_t prev = m_ranges[handle].prevPhysical;
+	if (prev != invalidHandle && m_ranges[prev].free) {
+		removeFree(prev);
+		m_ranges[prev].size += m_ranges[handle].size;
+		m_ranges[prev].nextPhysical = m_ranges[handle].nextPhysical;
+		if (m_ranges[handle].nextPhysical != invalidHandle)
+			m_ranges[m_ranges[handle].nextPhysical].prevPhysical = prev;
+		m_unusedRanges.push_back(handle);
+		handle = prev;
+	}
+	insertFree(handle);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Size of the largest free range, found in the highest non-empty size class
+//
+uint64_t TlsfAllocator::largestFreeRange() const {
+	if (m_flBitmap == 0)
+		return 0;
+	uint32_t fl = highestBit(m_flBitmap);
+	uint32_t sl = highestBit(m_slBitmaps[fl]);
+	uint64_t largest = 0;
+	for (uint32_t index = m_freeHeads[fl][sl]; index != invalidHandle; index = m_ranges[index].nextFree)
+		largest = std::max(largest, m_ranges[index].size);
+	return largest;
+}
+
+/**
+* The implementation of class LinearAllocator
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Bump the head past size bytes at the given alignment
+//
+bool LinearAllocator::allocate(uint64_t size, uint64_t alignment, uint64_t& offset) {
+	uint64_t alignedOffset = align_up(m_head, alignment);
+	if (alignedOffset + size > m_size)
+		return false;
+	offset = alignedOffset;
+	m_head = alignedOffset + size;
+	m_usedBytes += size;
+	m_allocationCount++;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Count a freed allocation of size bytes, rewind the head once all of them are freed
+//
+void LinearAllocator::free(uint64_t size) {
+	m_usedBytes -= size;
+	if (--m_allocationCount == 0)
+		m_head = 0;
+}
+
+/**
+* The implementation of class SlotAllocator
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Reset the allocator to slotCount free slots of slotSize bytes
+//
+void SlotAllocator::init(uint64_t slotSize, uint32_t slotCount) {
+	m_slotSize = slotSize;
+	m_slotCount = slotCount;
+	m_freeSlots.resize(slotCount);
+	//Hand out the low slots first
+	for (uint32_t i = 0; i < slotCount; i++)
+		m_freeSlots[i] = slotCount - 1 - i;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Take a free slot
+//
+bool SlotAllocator::allocate(uint64_t& offset) {
+	if (m_freeSlots.empty())
+		return false;
+	offset = m_freeSlots.back() * m_slotSize;
+	m_freeSlots.pop_back();
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Return the slot at offset
+//
+void SlotAllocator::free(uint64_t offset) {
+	m_freeSlots.push_back(static_cast<uint32_t>(offset / m_slotSize));
+}
@@ -0,0 +1,97 @@
+#ifndef RANGE_ALLOCATOR_COMMON
+#define RANGE_ALLOCATOR_COMMON
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//--------------------------------------------------------------------------------------------------
+// Two level segregated fit allocator of offset ranges inside [0, size).
+// Free ranges are kept in lists by size class, the first level is the power of two and the second
+// level splits it into TLSF_SL_COUNT classes, so allocation and free run in constant time.
+// Neighbouring free ranges are merged on free. Alignments must be powers of two.
+//
+class TlsfAllocator {
+public:
+	static constexpr uint32_t invalidHandle = UINT32_MAX;
+
+	void init(uint64_t size);
+
+	//Returns a handle to pass to free(), or invalidHandle if no free range fits
+	uint32_t allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+	void free(uint32_t handle);
+
+	uint64_t largestFreeRange() const;
+	bool empty() const { return m_allocationCount == 0; }
+
+	uint64_t m_size{ 0 };
+	uint64_t m_usedBytes{ 0 };
+	size_t m_allocationCount{ 0 };
+
+private:
+	static constexpr uint32_t TLSF_SL_BITS = 4;
+	static constexpr uint32_t TLSF_SL_COUNT = 1 << TLSF_SL_BITS;
+	static constexpr uint32_t TLSF_FL_COUNT = 64 - TLSF_SL_BITS + 1;
+
+	struct Range {
+		uint64_t offset;
+		uint64_t size;
+		uint32_t prevPhysical;
+		uint32_t nextPhysical;
+		uint32_t prevFree;
+		uint32_t nextFree;
+		bool free;
+	};
+
+	void mapping(uint64_t size, uint32_t& fl, uint32_t& sl) const;
+	uint32_t newRange(uint64_t offset, uint64_t size);
+	void insertFree(uint32_t index);
+	void removeFree(uint32_t index);
+	uint32_t findFree(uint64_t size, uint64_t alignment);
+
+	std::vector<Range> m_ranges;
+	std::vector<uint32_t> m_unusedRanges;
+	uint64_t m_flBitmap{ 0 };
+	uint32_t m_slBitmaps[TLSF_FL_COUNT];
+	uint32_t m_freeHeads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+};
+
+//--------------------------------------------------------------------------------------------------
+// Bump allocator of offset ranges inside [0, size) for short lived allocations.
+// Freed ranges are only counted, the whole range is reused once every allocation is freed.
+//
+class LinearAllocator {
+public:
+	void init(uint64_t size) { m_size = size; m_head = 0; m_usedBytes = 0; m_allocationCount = 0; }
+
+	bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+	void free(uint64_t size);
+
+	bool empty() const { return m_allocationCount == 0; }
+
+	uint64_t m_size{ 0 };
+	uint64_t m_head{ 0 };
+	uint64_t m_usedBytes{ 0 };
+	size_t m_allocationCount{ 0 };
+};
+
+//--------------------------------------------------------------------------------------------------
+// Allocator of equally sized slots, the size class buckets for small allocations.
+// Offsets are relative to the first slot.
+//
+class SlotAllocator {
+public:
+	void init(uint64_t slotSize, uint32_t slotCount);
+
+	bool allocate(uint64_t& offset);
+	void free(uint64_t offset);
+
+	bool full() const { return m_freeSlots.empty(); }
+	bool empty() const { return m_freeSlots.size() == m_slotCount; }
+
+	uint64_t m_slotSize{ 0 };
+	uint32_t m_slotCount{ 0 };
+
+private:
+	std::vector<uint32_t> m_freeSlots;
+};
+#endif // !RANGE_ALLOCATOR_COMMON
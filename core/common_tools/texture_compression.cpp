@@ -0,0 +1,543 @@
+#include "texture_compression.h"
+#include "tools.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+//VkFormat values of the cooked formats
+const uint32_t vkFormatBC1RgbUnorm = 131;
+const uint32_t vkFormatBC1RgbSrgb = 132;
+const uint32_t vkFormatBC3Unorm = 137;
+const uint32_t vkFormatBC3Srgb = 138;
+const uint32_t vkFormatBC5Unorm = 141;
+const uint32_t vkFormatBC7Unorm = 145;
+const uint32_t vkFormatBC7Srgb = 146;
+
+//Palette weights of the BC1 color and BC7 mode 6 indices, of the first endpoint
+const float bc1Weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+//Texels of a block by channel
+struct BlockTexels {
+	float channels[4][16];
+};
+
+BlockTexels loadBlockTexels(const uint8_t* rgba) {
+	BlockTexels texels;
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 4; c++)
+			texels.channels[c][i] = rgba[i * 4 + c];
+	}
+	return texels;
+}
+
+//Endpoints of the first N channels at the ends of their principal axis, found by power iteration
+template <int N>
+void fitPrincipalEndpoints(const BlockTexels& texels, float endpoint0[N], float endpoint1[N]) {
+	float mean[N];
+	for (int c = 0; c < N; c++) {
+		float sum = 0.0f;
+		for (int i = 0; i < 16; i++)
+			sum += texels.channels[c][i];
+		mean[c] = sum / 16.0f;
+	}
+	float covariance[N][N];
+	for (int a = 0; a < N; a++) {
+		for (int b = 0; b < N; b++) {
+			float sum = 0.0f;
+			for (int i = 0; i < 16; i++)
+				sum += (texels.channels[a][i] - mean[a]) * (texels.channels[b][i] - mean[b]);
+			covariance[a][b] = sum;
+		}
+	}
+
+	//Start from the covariance column of the channel varying the most. Unlike the box diagonal it
+	//carries the signs of the correlations, so it is not orthogonal to the principal axis when
+	//channels move in opposite directions.
+	int largest = 0;
+	for (int c = 1; c < N; c++) {
+		if (covariance[c][c] > covariance[largest][largest])
+			largest = c;
+	}
+	float axis[N];
+	float startLength = 0.0f;
+	for (int c = 0; c < N; c++) {
+		axis[c] = covariance[c][largest];
+		startLength += axis[c] * axis[c];
+	}
+	if (startLength == 0.0f) {
+		//Flat block
+		for (int c = 0; c < N; c++)
+			endpoint0[c] = endpoint1[c] = mean[c];
+		return;
+	}
+	startLength = std::sqrt(startLength);
+	for (int c = 0; c < N; c++)
+		axis[c] /= startLength;
+
+	//The axis stays normalized, an iteration reaching zero keeps the last one
+	for (int iteration = 0; iteration < 8; iteration++) {
+		float next[N];
+		float length = 0.0f;
+		for (int a = 0; a < N; a++) {
+			next[a] = 0.0f;
+			for (int b = 0; b < N; b++)
+				next[a] += covariance[a][b] * axis[b];
+			length += next[a] * next[a];
+		}
+		if (length == 0.0f)
+			break;
+		length = std::sqrt(length);
+		for (int c = 0; c < N; c++)
+			axis[c] = next[c] / length;
+	}
+
+	float minProjection = 0.0f, maxProjection = 0.0f;
+	for (int i = 0; i < 16; i++) {
+		float projection = 0.0f;
+		for (int c = 0; c < N; c++)
+			projection += (texels.channels[c][i] - mean[c]) * axis[c];
+		minProjection = std::min(minProjection, projection);
+		maxProjection = std::max(maxProjection, projection);
+	}
+	for (int c = 0; c < N; c++) {
+		endpoint0[c] = std::clamp(mean[c] + axis[c] * maxProjection, 0.0f, 255.0f);
+		endpoint1[c] = std::clamp(mean[c] + axis[c] * minProjection, 0.0f, 255.0f);
+	}
+}
+
+//Map every texel to its nearest palette entry, returns the squared error
+template <int N, int P>
+float fitIndices(const BlockTexels& texels, const float palette[P][N], uint8_t indices[16]) {
+	float bestDistances[16];
+	for (int i = 0; i < 16; i++)
+		bestDistances[i] = INFINITY;
+	for (int p = 0; p < P; p++) {
+		float distances[16] = {};
+		for (int c = 0; c < N; c++) {
+			for (int i = 0; i < 16; i++) {
+				float d = texels.channels[c][i] - palette[p][c];
+				distances[i] += d * d;
+			}
+		}
+		for (int i = 0; i < 16; i++) {
+			indices[i] = distances[i] < bestDistances[i] ? uint8_t(p) : indices[i];
+			bestDistances[i] = std::min(distances[i], bestDistances[i]);
+		}
+	}
+	float error = 0.0f;
+	for (int i = 0; i < 16; i++)
+		error += bestDistances[i];
+	return error;
+}
+
+//Least squares endpoints for fixed indices, weights[index] is the weight of the first endpoint.
+//Returns false if the indices do not determine both endpoints.
+template <int N>
+bool refineEndpoints(const BlockTexels& texels, const uint8_t indices[16], const float* weights, float endpoint0[N], float endpoint1[N]) {
+	float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+	float ax[N] = {}, bx[N] = {};
+	for (int i = 0; i < 16; i++) {
+		float a = weights[indices[i]];
+		float b = 1.0f - a;
+		aa += a * a;
+		bb += b * b;
+		ab += a * b;
+		for (int c = 0; c < N; c++) {
+			ax[c] += a * texels.channels[c][i];
+			bx[c] += b * texels.channels[c][i];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (std::abs(determinant) < 1e-6f)
+		return false;
+	for (int c = 0; c < N; c++) {
+		endpoint0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+		endpoint1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+	}
+	return true;
+}
+
+uint16_t packRGB565(const float color[3]) {
+	uint16_t r = static_cast<uint16_t>(std::lround(color[0] * 31.0f / 255.0f));
+	uint16_t g = static_cast<uint16_t>(std::lround(color[1] * 63.0f / 255.0f));
+	uint16_t b = static_cast<uint16_t>(std::lround(color[2] * 31.0f / 255.0f));
+	return static_cast<uint16_t>(r << 11 | g << 5 | b);
+}
+
+void unpackRGB565(uint16_t packed, float color[3]) {
+	uint32_t r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = float(r << 3 | r >> 2);
+	color[1] = float(g << 2 | g >> 4);
+	color[2] = float(b << 3 | b >> 2);
+}
+
+float fitBC1Indices(const BlockTexels& texels, uint16_t color0, uint16_t color1, uint8_t indices[16]) {
+	float palette[4][3];
+	unpackRGB565(color0, palette[0]);
+	unpackRGB565(color1, palette[1]);
+	for (int c = 0; c < 3; c++) {
+		palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+		palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+	}
+	return fitIndices<3, 4>(texels, palette, indices);
+}
+
+//BC1 color block in four color mode, also the color half of BC3
+void encodeColorBlock(const BlockTexels& texels, uint8_t* block) {
+	float endpoint0[3], endpoint1[3];
+	fitPrincipalEndpoints<3>(texels, endpoint0, endpoint1);
+
+	//Inset the endpoints, the extremes are better covered by the interpolated entries
+	for (int c = 0; c < 3; c++) {
+		float inset = (endpoint0[c] - endpoint1[c]) / 16.0f;
+		endpoint0[c] -= inset;
+		endpoint1[c] += inset;
+	}
+	uint16_t color0 = packRGB565(endpoint0), color1 = packRGB565(endpoint1);
+	uint8_t indices[16];
+	float error = fitBC1Indices(texels, color0, color1, indices);
+
+	if (refineEndpoints<3>(texels, indices, bc1Weights, endpoint0, endpoint1)) {
+		uint16_t refinedColor0 = packRGB565(endpoint0), refinedColor1 = packRGB565(endpoint1);
+		uint8_t refinedIndices[16];
+		float refinedError = fitBC1Indices(texels, refinedColor0, refinedColor1, refinedIndices);
+		if (refinedError < error) {
+			color0 = refinedColor0;
+			color1 = refinedColor1;
+			std::memcpy(indices, refinedIndices, sizeof(indices));
+		}
+	}
+
+	//Four color mode needs color0 > color1, equal colors only use the first entry
+	if (color0 < color1) {
+		std::swap(color0, color1);
+		for (int i = 0; i < 16; i++)
+			indices[i] ^= 1;
+	}
+	else if (color0 == color1) {
+		std::memset(indices, 0, sizeof(indices));
+	}
+	uint32_t indexBits = 0;
+	for (int i = 0; i < 16; i++)
+		indexBits |= uint32_t(indices[i]) << (2 * i);
+	block[0] = uint8_t(color0);
+	block[1] = uint8_t(color0 >> 8);
+	block[2] = uint8_t(color1);
+	block[3] = uint8_t(color1 >> 8);
+	std::memcpy(block + 4, &indexBits, sizeof(indexBits));
+}
+
+//BC4 block of one channel in eight value mode, also the alpha half of BC3 and the halves of BC5
+void encodeBC4Block(const BlockTexels& texels, int channel, uint8_t* block) {
+	const float* values = texels.channels[channel];
+	float lower = *std::min_element(values, values + 16), upper = *std::max_element(values, values + 16);
+	uint8_t value0 = static_cast<uint8_t>(std::lround(upper)), value1 = static_cast<uint8_t>(std::lround(lower));
+	std::memset(block, 0, 8);
+	block[0] = value0;
+	block[1] = value1;
+	if (value0 == value1)
+		return;
+
+	BlockTexels channelTexels;
+	std::memcpy(channelTexels.channels[0], values, sizeof(channelTexels.channels[0]));
+	float palette[8][1];
+	palette[0][0] = value0;
+	palette[1][0] = value1;
+	for (int i = 2; i < 8; i++)
+		palette[i][0] = ((8 - i) * float(value0) + (i - 1) * float(value1)) / 7.0f;
+	uint8_t indices[16];
+	fitIndices<1, 8>(channelTexels, palette, indices);
+	uint64_t indexBits = 0;
+	for (int i = 0; i < 16; i++)
+		indexBits |= uint64_t(indices[i]) << (3 * i);
+	for (int i = 0; i < 6; i++)
+		block[2 + i] = uint8_t(indexBits >> (8 * i));
+}
+
+//BC7 mode 6 palette of quantized 7 bit endpoints and their parity bits
+void bc7Palette(const int quantized0[4], const int quantized1[4], int parity0, int parity1, float palette[16][4]) {
+	for (int c = 0; c < 4; c++) {
+		int value0 = quantized0[c] << 1 | parity0, value1 = quantized1[c] << 1 | parity1;
+		for (int i = 0; i < 16; i++)
+			palette[i][c] = float(((64 - bc7Weights[i]) * value0 + bc7Weights[i] * value1 + 32) >> 6);
+	}
+}
+
+//Quantize the endpoints for every combination of parity bits and keep the one with the least error
+float fitBC7Endpoints(const BlockTexels& texels, const float endpoint0[4], const float endpoint1[4], int quantized0[4], int quantized1[4],
+	int& parity0, int& parity1, uint8_t indices[16]) {
+	float bestError = INFINITY;
+	for (int p0 = 0; p0 < 2; p0++) {
+		for (int p1 = 0; p1 < 2; p1++) {
+			int q0[4], q1[4];
+			for (int c = 0; c < 4; c++) {
+				q0[c] = std::clamp(int(std::lround((endpoint0[c] - p0) / 2.0f)), 0, 127);
+				q1[c] = std::clamp(int(std::lround((endpoint1[c] - p1) / 2.0f)), 0, 127);
+			}
+			float palette[16][4];
+			bc7Palette(q0, q1, p0, p1, palette);
+			uint8_t candidateIndices[16];
+			float error = fitIndices<4, 16>(texels, palette, candidateIndices);
+			if (error < bestError) {
+				bestError = error;
+				std::memcpy(quantized0, q0, sizeof(q0));
+				std::memcpy(quantized1, q1, sizeof(q1));
+				parity0 = p0;
+				parity1 = p1;
+				std::memcpy(indices, candidateIndices, sizeof(candidateIndices));
+			}
+		}
+	}
+	return bestError;
+}
+
+//Little endian bit writer of a 128 bit block
+struct BlockBitWriter {
+	uint8_t* block;
+	int position{ 0 };
+
+	void write(uint32_t value, int bitCount) {
+		for (int i = 0; i < bitCount; i++, position++)
+			block[position >> 3] |= uint8_t(((value >> i) & 1) << (position & 7));
+	}
+};
+
+//Linear value of every sRGB encoded byte
+const float* srgbToLinearTable() {
+	static const std::vector<float> table = []() {
+		std::vector<float> values(256);
+		for (int i = 0; i < 256; i++) {
+			float v = i / 255.0f;
+			values[i] = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+		}
+		return values;
+	}();
+	return table.data();
+}
+
+uint8_t linearToSrgb(float v) {
+	v = std::clamp(v, 0.0f, 1.0f);
+	float encoded = v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+	return static_cast<uint8_t>(std::lround(encoded * 255.0f));
+}
+
+}
+
+//--------------------------------------------------------------------------------------------------
+// Size of a 4x4 block
+//
+size_t textureBlockBytes(TextureBlockFormat format) {
+	return format == TextureBlockFormat::BC1 ? 8 : 16;
+}
+
+//--------------------------------------------------------------------------------------------------
+// VkFormat value of a block format
+//
+uint32_t textureBlockVkFormat(TextureBlockFormat format, bool srgb) {
+	switch (format) {
+	case TextureBlockFormat::BC1:
+		return srgb ? vkFormatBC1RgbSrgb : vkFormatBC1RgbUnorm;
+	case TextureBlockFormat::BC3:
+		return srgb ? vkFormatBC3Srgb : vkFormatBC3Unorm;
+	case TextureBlockFormat::BC5:
+		return vkFormatBC5Unorm;
+	default:
+		return srgb ? vkFormatBC7Srgb : vkFormatBC7Unorm;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Block format of a VkFormat value
+//
+bool findTextureBlockFormat(uint32_t vkFormat, TextureBlockFormat& format, bool& srgb) {
+	const TextureBlockFormat formats[] = { TextureBlockFormat::BC1, TextureBlockFormat::BC3, TextureBlockFormat::BC5, TextureBlockFormat::BC7 };
+	for (TextureBlockFormat candidate : formats) {
+		for (bool candidateSrgb : { false, true }) {
+			if (textureBlockVkFormat(candidate, candidateSrgb) == vkFormat) {
+				format = candidate;
+				srgb = candidateSrgb && candidate != TextureBlockFormat::BC5;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Encode a BC1 block, opaque texels only
+//
+void encodeBC1Block(const uint8_t* rgba, uint8_t* block) {
+	encodeColorBlock(loadBlockTexels(rgba), block);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Encode a BC3 block, BC4 alpha followed by the color
+//
+void encodeBC3Block(const uint8_t* rgba, uint8_t* block) {
+	BlockTexels texels = loadBlockTexels(rgba);
+	encodeBC4Block(texels, 3, block);
+	encodeColorBlock(texels, block + 8);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Encode a BC5 block from the red and green channels
+//
+void encodeBC5Block(const uint8_t* rgba, uint8_t* block) {
+	BlockTexels texels = loadBlockTexels(rgba);
+	encodeBC4Block(texels, 0, block);
+	encodeBC4Block(texels, 1, block + 8);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Encode a BC7 mode 6 block: one subset, 7 bit RGBA endpoints with a parity bit each and 4 bit
+// indices
+//
+void encodeBC7Block(const uint8_t* rgba, uint8_t* block) {
+	BlockTexels texels = loadBlockTexels(rgba);
+	float endpoint0[4], endpoint1[4];
+	fitPrincipalEndpoints<4>(texels, endpoint0, endpoint1);
+	int quantized0[4], quantized1[4], parity0 = 0, parity1 = 0;
+	uint8_t indices[16];
+	float error = fitBC7Endpoints(texels, endpoint0, endpoint1, quantized0, quantized1, parity0, parity1, indices);
+
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = (64 - bc7Weights[i]) / 64.0f;
+	if (refineEndpoints<4>(texels, indices, weights, endpoint0, endpoint1)) {
+		int refined0[4], refined1[4], refinedParity0 = 0, refinedParity1 = 0;
+		uint8_t refinedIndices[16];
+		float refinedError = fitBC7Endpoints(texels, endpoint0, endpoint1, refined0, refined1, refinedParity0, refinedParity1, refinedIndices);
+		if (refinedError < error) {
+			std::memcpy(quantized0, refined0, sizeof(refined0));
+			std::memcpy(quantized1, refined1, sizeof(refined1));
+			parity0 = refinedParity0;
+			parity1 = refinedParity1;
+			std::memcpy(indices, refinedIndices, sizeof(indices));
+		}
+	}
+
+	//The most significant bit of the first index is implied zero
+	if (indices[0] & 8) {
+		std::swap(quantized0, quantized1);
+		std::swap(parity0, parity1);
+		for (int i = 0; i < 16; i++)
+			indices[i] = uint8_t(15 - indices[i]);
+	}
+
+	std::memset(block, 0, 16);
+	BlockBitWriter writer{ block };
+	writer.write(1u << 6, 7);
+	for (int c = 0; c < 4; c++) {
+		writer.write(quantized0[c], 7);
+		writer.write(quantized1[c], 7);
+	}
+	writer.write(parity0, 1);
+	writer.write(parity1, 1);
+	writer.write(indices[0], 3);
+	for (int i = 1; i < 16; i++)
+		writer.write(indices[i], 4);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Halve an RGBA8 image with a box filter
+//
+void downsampleRGBA8(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, std::vector<uint8_t>& halved) {
+	uint32_t halvedWidth = std::max(width / 2, 1u), halvedHeight = std::max(height / 2, 1u);
+	halved.resize(size_t(halvedWidth) * halvedHeight * 4);
+	const float* toLinear = srgbToLinearTable();
+	for (uint32_t y = 0; y < halvedHeight; y++) {
+		uint32_t rows[2] = { std::min(2 * y, height - 1), std::min(2 * y + 1, height - 1) };
+		for (uint32_t x = 0; x < halvedWidth; x++) {
+			uint32_t columns[2] = { std::min(2 * x, width - 1), std::min(2 * x + 1, width - 1) };
+			uint8_t* texel = &halved[(size_t(y) * halvedWidth + x) * 4];
+			for (int c = 0; c < 4; c++) {
+				bool linearize = srgb && c < 3;
+				float sum = 0.0f;
+				for (uint32_t row : rows) {
+					for (uint32_t column : columns) {
+						uint8_t value = rgba[(size_t(row) * width + column) * 4 + c];
+						sum += linearize ? toLinear[value] : float(value);
+					}
+				}
+				texel[c] = linearize ? linearToSrgb(sum / 4.0f) : static_cast<uint8_t>(std::lround(sum / 4.0f));
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Encode an RGBA8 image into blocks
+//
+void compressImage(const uint8_t* rgba, uint32_t width, uint32_t height, TextureBlockFormat format, std::vector<uint8_t>& blocks) {
+	uint32_t blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+	size_t blockBytes = textureBlockBytes(format);
+	blocks.resize(size_t(blocksWide) * blocksHigh * blockBytes);
+	parallel_for(blocksHigh, [&](size_t blockY) {
+		uint8_t texels[64];
+		for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+			for (uint32_t y = 0; y < 4; y++) {
+				uint32_t row = std::min(uint32_t(blockY) * 4 + y, height - 1);
+				for (uint32_t x = 0; x < 4; x++) {
+					uint32_t column = std::min(blockX * 4 + x, width - 1);
+					std::memcpy(texels + (y * 4 + x) * 4, rgba + (size_t(row) * width + column) * 4, 4);
+				}
+			}
+			uint8_t* block = &blocks[(blockY * blocksWide + blockX) * blockBytes];
+			switch (format) {
+			case TextureBlockFormat::BC1:
+				encodeBC1Block(texels, block);
+				break;
+			case TextureBlockFormat::BC3:
+				encodeBC3Block(texels, block);
+				break;
+			case TextureBlockFormat::BC5:
+				encodeBC5Block(texels, block);
+				break;
+			case TextureBlockFormat::BC7:
+				encodeBC7Block(texels, block);
+				break;
+			}
+		}
+	});
+}
+
+//--------------------------------------------------------------------------------------------------
+// Encode an RGBA8 image and its mip chain
+//
+CompressedTexture compressTexture(const uint8_t* rgba, uint32_t width, uint32_t height, TextureBlockFormat format, bool srgb, bool generateMips) {
+	CompressedTexture texture;
+	texture.format = format;
+	texture.srgb = srgb && format != TextureBlockFormat::BC5;
+	texture.width = width;
+	texture.height = height;
+	texture.levels.emplace_back();
+	compressImage(rgba, width, height, format, texture.levels.back());
+
+	std::vector<uint8_t> level, halved;
+	const uint8_t* levelTexels = rgba;
+	while (generateMips && (width > 1 || height > 1)) {
+		downsampleRGBA8(levelTexels, width, height, texture.srgb, halved);
+		level.swap(halved);
+		levelTexels = level.data();
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+		texture.levels.emplace_back();
+		compressImage(levelTexels, width, height, format, texture.levels.back());
+	}
+	return texture;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Check for texels that are not opaque
+//
+bool hasAlpha(const uint8_t* rgba, size_t texelCount) {
+	for (size_t i = 0; i < texelCount; i++) {
+		if (rgba[i * 4 + 3] != 255)
+			return true;
+	}
+	return false;
+}
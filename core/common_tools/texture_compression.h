@@ -0,0 +1,63 @@
+#ifndef TEXTURE_COMPRESSION_COMMON
+#define TEXTURE_COMPRESSION_COMMON
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+//Block compressed formats written by the texture cooker, all use blocks of 4x4 texels
+enum class TextureBlockFormat {
+	BC1,   //RGB, 8 bytes per block
+	BC3,   //RGBA, BC1 color and BC4 alpha, 16 bytes per block
+	BC5,   //RG, two BC4 channels, 16 bytes per block, for normal maps
+	BC7    //RGBA, mode 6 blocks, 16 bytes per block
+};
+
+size_t textureBlockBytes(TextureBlockFormat format);
+
+//VkFormat value of a block format, common_tools does not include the Vulkan headers. BC5 has no
+//sRGB variant and is always UNORM.
+uint32_t textureBlockVkFormat(TextureBlockFormat format, bool srgb);
+
+//Block format of a VkFormat value, returns false if it is none of the cooked formats
+bool findTextureBlockFormat(uint32_t vkFormat, TextureBlockFormat& format, bool& srgb);
+
+//--------------------------------------------------------------------------------------------------
+// Encode one block from 16 RGBA8 texels given row by row. BC1 and BC3 fit the colors along their
+// principal axis and refine the endpoints by least squares, BC7 does the same in RGBA and picks the
+// best parity bits of mode 6. The palette searches run over structure of arrays texels so the
+// compiler vectorizes them.
+//
+void encodeBC1Block(const uint8_t* rgba, uint8_t* block);
+void encodeBC3Block(const uint8_t* rgba, uint8_t* block);
+void encodeBC5Block(const uint8_t* rgba, uint8_t* block);
+void encodeBC7Block(const uint8_t* rgba, uint8_t* block);
+
+//Mip chain of block compressed texels
+struct CompressedTexture {
+	TextureBlockFormat format{ TextureBlockFormat::BC1 };
+	bool srgb{ false };
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	std::vector<std::vector<uint8_t>> levels;   //Level 0 is the full size
+};
+
+//--------------------------------------------------------------------------------------------------
+// Halve an RGBA8 image with a box filter, odd sizes drop their last row or column. With srgb the
+// color channels are averaged in linear space, alpha always is.
+//
+void downsampleRGBA8(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, std::vector<uint8_t>& halved);
+
+//--------------------------------------------------------------------------------------------------
+// Encode an RGBA8 image into blocks row by row, rows of blocks are encoded in parallel. Blocks
+// over the image border repeat the last row or column.
+//
+void compressImage(const uint8_t* rgba, uint32_t width, uint32_t height, TextureBlockFormat format, std::vector<uint8_t>& blocks);
+
+//--------------------------------------------------------------------------------------------------
+// Encode an RGBA8 image and, with generateMips, every level of its mip chain down to 1x1
+//
+CompressedTexture compressTexture(const uint8_t* rgba, uint32_t width, uint32_t height, TextureBlockFormat format, bool srgb, bool generateMips = true);
+
+//True if any texel of an RGBA8 image is not opaque
+bool hasAlpha(const uint8_t* rgba, size_t texelCount);
+#endif // !TEXTURE_COMPRESSION_COMMON
@@ -0,0 +1,62 @@
+#include "texture_residency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <tuple>
+
+namespace {
+
+//Texels of a level per needed texel, unseen textures come first
+inline float levelOversampling(const TextureResidencyInput& texture, uint32_t level) {
+	if (texture.neededTexels <= 0.0f)
+		return std::numeric_limits<float>::infinity();
+	return static_cast<float>(std::max(texture.extent >> level, 1u)) / texture.neededTexels;
+}
+
+}
+
+//--------------------------------------------------------------------------------------------------
+// Finest level a texture needs on screen
+//
+uint32_t getNeededTextureLevel(const TextureResidencyInput& texture) {
+	if (texture.neededTexels <= 0.0f)
+		return texture.coarsestLevel;
+	float level = std::floor(std::log2(static_cast<float>(texture.extent) / texture.neededTexels));
+	return level <= 0.0f ? 0 : std::min(static_cast<uint32_t>(level), texture.coarsestLevel);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Select the finest resident level of every texture under budget bytes
+//
+uint64_t selectTextureLevels(const std::vector<TextureResidencyInput>& textures, uint64_t budget, std::vector<uint32_t>& levels) {
+	levels.resize(textures.size());
+	uint64_t totalBytes = 0;
+	for (size_t i = 0; i < textures.size(); i++) {
+		levels[i] = std::min(textures[i].currentLevel, getNeededTextureLevel(textures[i]));
+		totalBytes += textures[i].chainBytes[levels[i]];
+	}
+	if (totalBytes <= budget)
+		return totalBytes;
+
+	//Oversampling, bytes of the finest level and texture, the largest first
+	std::priority_queue<std::tuple<float, uint64_t, size_t>> candidates;
+	auto pushCandidate = [&](size_t i) {
+		const TextureResidencyInput& texture = textures[i];
+		if (levels[i] >= texture.coarsestLevel)
+			return;
+		uint64_t levelBytes = texture.chainBytes[levels[i]] - texture.chainBytes[levels[i] + 1];
+		candidates.push({ levelOversampling(texture, levels[i]), levelBytes, i });
+	};
+	for (size_t i = 0; i < textures.size(); i++)
+		pushCandidate(i);
+	while (totalBytes > budget && !candidates.empty()) {
+		size_t i = std::get<2>(candidates.top());
+		totalBytes -= std::get<1>(candidates.top());
+		candidates.pop();
+		levels[i]++;
+		pushCandidate(i);
+	}
+	return totalBytes;
+}
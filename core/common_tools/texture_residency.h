@@ -0,0 +1,30 @@
+#ifndef TEXTURE_RESIDENCY_COMMON
+#define TEXTURE_RESIDENCY_COMMON
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+//Mip chain of a texture sharing the texture memory budget. Levels are numbered from the finest one.
+struct TextureResidencyInput {
+	uint32_t extent{ 0 };           //Largest side of level 0 in texels
+	uint32_t coarsestLevel{ 0 };    //Finest level of the mip tail, always resident
+	uint32_t currentLevel{ 0 };     //Finest level held now, coarsestLevel if none
+	float neededTexels{ 0.0f };     //Texels across the largest side needed on screen, 0 if the texture is not seen
+	std::vector<uint64_t> chainBytes;   //Bytes of the levels from each level on, one entry per level
+};
+
+//--------------------------------------------------------------------------------------------------
+// Finest level a texture needs on screen: the first level with no more texels than neededTexels,
+// the mip tail if the texture is not seen.
+//
+uint32_t getNeededTextureLevel(const TextureResidencyInput& texture);
+
+//--------------------------------------------------------------------------------------------------
+// Select the finest resident level of every texture under budget bytes. A texture keeps the levels
+// it holds and gains those it needs. While the selection exceeds the budget, the texture showing the
+// most texels per needed texel drops its finest level, unseen textures first, down to their mip
+// tails. levels receives the selected level of every texture, returns the bytes of the selection,
+// above the budget only if the mip tails alone exceed it.
+//
+uint64_t selectTextureLevels(const std::vector<TextureResidencyInput>& textures, uint64_t budget, std::vector<uint32_t>& levels);
+#endif // !TEXTURE_RESIDENCY_COMMON
@@ -2,6 +2,10 @@
 #define TOOLS_COMMON
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cstdint>
 
 void add_unique_c_str(std::vector<const char*>& v, const char* c_str);
 
@@ -20,4 +24,43 @@ void add_unique(std::vector<T>& v, T element) {
 		}
 	}
 }
+
+// Round value up to a multiple of alignment
+inline uint64_t align_up(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// Number of worker threads to use when the caller passes 0
+inline unsigned default_thread_count() {
+	unsigned count = std::thread::hardware_concurrency();
+	return count > 0 ? count : 1;
+}
+
+// Run func(i) for every i in [0, count) on up to threadCount threads.
+// Work items are handed out through an atomic counter so uneven items balance themselves.
+// func must not throw, record failures and report them after the call instead.
+template <typename Func>
+void parallel_for(size_t count, Func&& func, unsigned threadCount = 0) {
+	if (threadCount == 0)
+		threadCount = default_thread_count();
+	threadCount = static_cast<unsigned>(std::min<size_t>(threadCount, count));
+	if (threadCount <= 1) {
+		for (size_t i = 0; i < count; i++)
+			func(i);
+		return;
+	}
+
+	std::atomic<size_t> next{ 0 };
+	auto worker = [&]() {
+		for (size_t i = next++; i < count; i = next++)
+			func(i);
+	};
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (unsigned t = 1; t < threadCount; t++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto& thread : threads)
+		thread.join();
+}
 #endif // !TOOLS_COMMON
@@ -0,0 +1,76 @@
+#include "worker_pool.h"
+
+#include <stdexcept>
+
+//--------------------------------------------------------------------------------------------------
+// Start the threads, they wait for the next batch
+//
+void WorkerPool::init(size_t threadCount) {
+	destroy();
+	m_threads.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; i++)
+		m_threads.emplace_back(&WorkerPool::workerLoop, this, i, m_batch);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Stop and join the threads, a batch in flight is finished first since run() waits for it
+//
+void WorkerPool::destroy() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_batchStarted.notify_all();
+	for (auto& thread : m_threads)
+		thread.join();
+	m_threads.clear();
+	m_stopping = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Hand a batch to the threads and wait until each of its tasks returned
+//
+void WorkerPool::run(size_t count, const std::function<void(size_t)>& task) {
+	if (count == 0)
+		return;
+	if (count > m_threads.size())
+		throw std::runtime_error("failed to run tasks, more tasks than worker threads!");
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+		m_taskCount = count;
+		m_pendingCount = count;
+		m_batch++;
+	}
+	m_batchStarted.notify_all();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_batchFinished.wait(lock, [this]() { return m_pendingCount == 0; });
+	m_task = nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Wait for a batch and run its task of the thread, threads past the task count of a batch skip it
+//
+void WorkerPool::workerLoop(size_t worker, uint64_t lastBatch) {
+	while (true) {
+		const std::function<void(size_t)>* task = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_batchStarted.wait(lock, [this, lastBatch]() { return m_stopping || m_batch != lastBatch; });
+			if (m_stopping)
+				return;
+			lastBatch = m_batch;
+			if (worker >= m_taskCount)
+				continue;
+			task = m_task;
+		}
+
+		(*task)(worker);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_pendingCount == 0)
+			m_batchFinished.notify_one();
+	}
+}
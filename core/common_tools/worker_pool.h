@@ -0,0 +1,46 @@
+#ifndef WORKER_POOL_COMMON
+#define WORKER_POOL_COMMON
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Threads started once and woken for each batch of tasks, for work repeated every frame where
+// parallel_for would start its threads every call. Task i of a batch always runs on thread i, so a
+// worker can keep per thread state like a command pool indexed by its task index.
+// run() is called by one thread at a time and blocks until the batch is done.
+//
+class WorkerPool {
+public:
+	WorkerPool() = default;
+	~WorkerPool() { destroy(); }
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	void init(size_t threadCount);
+	void destroy();
+
+	//Run task(i) for every i in [0, count) on the first count threads, task must not throw
+	void run(size_t count, const std::function<void(size_t)>& task);
+
+	size_t size() const { return m_threads.size(); }
+
+private:
+	void workerLoop(size_t worker, uint64_t lastBatch);
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_batchStarted;
+	std::condition_variable m_batchFinished;
+	const std::function<void(size_t)>* m_task{ nullptr };
+	size_t m_taskCount{ 0 };
+	size_t m_pendingCount{ 0 };
+	uint64_t m_batch{ 0 };
+	bool m_stopping{ false };
+};
+#endif // !WORKER_POOL_COMMON
@@ -2,6 +2,7 @@
 
 #include "vulkan_commands.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 namespace vkimpl {
@@ -13,28 +14,37 @@ namespace vkimpl {
 //--------------------------------------------------------------------------------------------------
 // Copy data of certain size into the buffer
 //
-void VulkanBuffers::fillBufferData(VkBuffer &buffer, void* bufferData, VkDeviceSize bufferSize) {
+void VulkanBuffers::fillBufferData(VkBuffer &buffer, const void* bufferData, VkDeviceSize bufferSize) {
 	//Create the staging buffer
 	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
+	MemoryAllocation stagingBufferMemory;
 	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-	//Copy data to staging buffer
-	void* data;
-	vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, bufferData, (size_t)bufferSize);
-	vkUnmapMemory(m_device, stagingBufferMemory);
+	//Copy data to staging buffer, which is mapped by the allocator
+	memcpy(stagingBufferMemory.mapped, bufferData, (size_t)bufferSize);
 	
 	copyBuffer(stagingBuffer, buffer, bufferSize);//Copy staging buffer to destination buffer
 
 	//Destroy the staging buffer
-	vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-	vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+	destroyBuffer(stagingBuffer, stagingBufferMemory);
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create a buffer of specified size
+// Copy data of certain size into the buffer at dstOffset through a persistently mapped, host coherent
+// staging buffer owned by the caller. Data larger than the staging buffer is copied in several rounds.
 //
-void VulkanBuffers::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+void VulkanBuffers::fillBufferData(VkBuffer& buffer, const void* bufferData, VkDeviceSize bufferSize, VkDeviceSize dstOffset, VkBuffer stagingBuffer, void* stagingData, VkDeviceSize stagingSize) {
+	const char* data = static_cast<const char*>(bufferData);
+	for (VkDeviceSize offset = 0; offset < bufferSize; offset += stagingSize) {
+		VkDeviceSize copySize = std::min(stagingSize, bufferSize - offset);
+		memcpy(stagingData, data + offset, (size_t)copySize);
+		copyBuffer(stagingBuffer, buffer, copySize, 0, dstOffset + offset);//Waits for the copy, so the staging buffer can be reused
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Create a buffer of specified size and bind it to memory suballocated by the memory allocator
+//
+void VulkanBuffers::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory) {
 	VkBufferCreateInfo bufferInfo{};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = size;
@@ -45,29 +55,28 @@ void VulkanBuffers::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, Vk
 		throw std::runtime_error("failed to create buffer!");
 	}
 
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
-
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(m_physicalDevice, memRequirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(m_device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate buffer memory!");
-	}
+	bufferMemory = m_allocator->allocateBufferMemory(buffer, usage, properties);
+	vkBindBufferMemory(m_device, buffer, bufferMemory.memory, bufferMemory.offset);
+}
 
-	vkBindBufferMemory(m_device, buffer, bufferMemory, 0);
+//--------------------------------------------------------------------------------------------------
+// Destroy a buffer and return its memory to the memory allocator
+//
+void VulkanBuffers::destroyBuffer(VkBuffer buffer, MemoryAllocation& bufferMemory) {
+	vkDestroyBuffer(m_device, buffer, nullptr);
+	m_allocator->free(bufferMemory);
 }
 
 //--------------------------------------------------------------------------------------------------
-// Copy the source buffer to the destination buffer
+// Copy size bytes of the source buffer to the destination buffer
 //
-void VulkanBuffers::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+void VulkanBuffers::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset) {
 	VulkanCommands commandHelper(m_device, m_commandPool);
 	VkCommandBuffer commandBuffer = commandHelper.beginSingleTimeCommands();
 
 	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = srcOffset;
+	copyRegion.dstOffset = dstOffset;
 	copyRegion.size = size;
 	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
@@ -4,6 +4,7 @@
 #include <vulkan/vulkan_core.h>
 
 #include "vulkan_common.h"
+#include "vulkan_memory.h"
 
 #include <vector>
 
@@ -19,19 +20,22 @@ vkimpl::VulkanBuffers handles the creation of Vulkan buffers and data tranfer in
 */
 class VulkanBuffers {
 public:
-	VulkanBuffers(VkPhysicalDevice physicalDevice = VK_NULL_HANDLE, VkDevice device = VK_NULL_HANDLE, VkCommandPool commandPool = VK_NULL_HANDLE, VkQueue queue = VK_NULL_HANDLE)
-		: m_physicalDevice(physicalDevice), m_device(device), m_commandPool(commandPool), m_queue(queue) { };	
+	VulkanBuffers(VkPhysicalDevice physicalDevice = VK_NULL_HANDLE, VkDevice device = VK_NULL_HANDLE, VkCommandPool commandPool = VK_NULL_HANDLE, VkQueue queue = VK_NULL_HANDLE, VulkanMemoryAllocator* allocator = nullptr)
+		: m_physicalDevice(physicalDevice), m_device(device), m_commandPool(commandPool), m_queue(queue), m_allocator(allocator) { };	
 
-	void fillBufferData(VkBuffer& buffer, void* bufferData, VkDeviceSize bufferSize);
+	void fillBufferData(VkBuffer& buffer, const void* bufferData, VkDeviceSize bufferSize);
+	void fillBufferData(VkBuffer& buffer, const void* bufferData, VkDeviceSize bufferSize, VkDeviceSize dstOffset, VkBuffer stagingBuffer, void* stagingData, VkDeviceSize stagingSize);
 
-	void VulkanBuffers::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+	void VulkanBuffers::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory);
+	void VulkanBuffers::destroyBuffer(VkBuffer buffer, MemoryAllocation& bufferMemory);
 	void VulkanBuffers::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkImageAspectFlags aspectMask);
-	void VulkanBuffers::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+	void VulkanBuffers::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
 
 	VkPhysicalDevice m_physicalDevice;
 	VkDevice m_device;
 	VkCommandPool m_commandPool;
 	VkQueue m_queue;
+	VulkanMemoryAllocator* m_allocator;
 
 private:
 	
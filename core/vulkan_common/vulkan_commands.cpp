@@ -42,15 +42,15 @@ VkCommandPool VulkanCommands::createCommandPool(uint32_t queueFamilyIndex, VkCom
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create the comman buffers for each swapchain image
+// Create the comman buffers for each swapchain image, secondary ones are executed by a primary
 //
-std::vector<VkCommandBuffer> VulkanCommands::createCommandBuffers(VkCommandPool commandPool, int size) {
+std::vector<VkCommandBuffer> VulkanCommands::createCommandBuffers(VkCommandPool commandPool, int size, VkCommandBufferLevel level) {
 	m_commandBuffers.resize(size);
 
 	VkCommandBufferAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	allocInfo.commandPool = commandPool;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.level = level;
 	allocInfo.commandBufferCount = (uint32_t)m_commandBuffers.size();
 
 	if (vkAllocateCommandBuffers(m_device, &allocInfo, m_commandBuffers.data()) != VK_SUCCESS) {
@@ -34,7 +34,7 @@ public:
 	void init(uint32_t queueFamilyIndex, int commandBufferSize, VkCommandPoolCreateFlags flags = 0);
 	void setPoolInfo(VkCommandPool commandPool, uint32_t queueFamilyIndex = 0);
 	VkCommandPool createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags flags = 0);
-	std::vector<VkCommandBuffer> createCommandBuffers(VkCommandPool commandPool, int size);
+	std::vector<VkCommandBuffer> createCommandBuffers(VkCommandPool commandPool, int size, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
 	VkCommandBuffer beginSingleTimeCommands();
 	void VulkanCommands::endSingleTimeCommands(VkCommandBuffer commandBuffer, VkQueue queue);
@@ -350,6 +350,16 @@ QueueFamilyIndices  VulkanContext::findQueueFamilies(VkPhysicalDevice device, Vk
 		i++;
 	}
 
+	//Prefer a family made for transfers only, its copies run beside the graphics work. Devices without
+	//one keep the family found above.
+	for (uint32_t family = 0; family < queueFamilyCount; family++) {
+		VkQueueFlags flags = queueFamilies[family].queueFlags;
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+			m_queueFamilyIndices.transferFamily = family;
+			break;
+		}
+	}
+
 	return m_queueFamilyIndices;
 }
 
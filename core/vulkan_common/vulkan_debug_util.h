@@ -4,6 +4,7 @@
 
 #include "tools.h" 
 #include "vulkan_common_utils.h"
+#include "vulkan_memory.h"
 
 #include <stdexcept>
 #include <vector>
@@ -20,17 +21,19 @@ namespace vkimpl
 
 /**
 * \class vkimpl::VulkanDebugUtil
-* vkimpl::VulkanDebugUtil contains the debug helpers that enriches the functions of validation layers
+* vkimpl::VulkanDebugUtil contains the debug helpers that enriches the functions of validation layers.
+* Names of buffers, images and their memory are also given to the memory tracker for its reports.
 */
 class VulkanDebugUtil 
 {
 public:
 	VulkanDebugUtil() = default;
-	VulkanDebugUtil(VkInstance instance, VkDevice device)
-		: m_instance(instance), m_device(device) { }
+	VulkanDebugUtil(VkInstance instance, VkDevice device, VulkanMemoryTracker* memoryTracker = nullptr)
+		: m_instance(instance), m_device(device), m_memoryTracker(memoryTracker) { }
 
 	VkInstance m_instance;
 	VkDevice m_device;
+	VulkanMemoryTracker* m_memoryTracker{ nullptr };
 	VulkanCommonUtils m_utils;
 
 	static const VkDebugUtilsMessageSeverityFlagsEXT severity = 
@@ -50,7 +53,7 @@ public:
 
 	//Set debug object name
 	void setObjectName(const uint64_t object, const std::string& name, VkObjectType t);
-	void setObjectName(VkBuffer object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_BUFFER); }
+	void setObjectName(VkBuffer object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_BUFFER); setTrackedName((uint64_t)object, name, true); }
 	void setObjectName(VkBufferView object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_BUFFER_VIEW); }
 	void setObjectName(VkCommandBuffer object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_COMMAND_BUFFER); }
 	void setObjectName(VkCommandPool object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_COMMAND_POOL); }
@@ -59,8 +62,10 @@ public:
 	void setObjectName(VkDescriptorSetLayout object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT); }
 	void setObjectName(VkDevice object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_DEVICE); }
 	void setObjectName(VkDeviceMemory object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_DEVICE_MEMORY); }
+	//Suballocations share their VkDeviceMemory, only dedicated ones are named after their resource
+	void setObjectName(const MemoryAllocation& object, const std::string& name) { if (object.strategy == MemoryStrategy::Dedicated) setObjectName(object.memory, name); setTrackedName(object.resource, name, false); }
 	void setObjectName(VkFramebuffer object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_FRAMEBUFFER); }
-	void setObjectName(VkImage object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_IMAGE); }
+	void setObjectName(VkImage object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_IMAGE); setTrackedName((uint64_t)object, name, true); }
 	void setObjectName(VkImageView object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_IMAGE_VIEW); }
 	void setObjectName(VkPipeline object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_PIPELINE); }
 	void setObjectName(VkPipelineLayout object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_PIPELINE_LAYOUT); }
@@ -71,6 +76,7 @@ public:
 	void setObjectName(VkSemaphore object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_SEMAPHORE); }
 	void setObjectName(VkShaderModule object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_SHADER_MODULE); }
 	void setObjectName(VkSwapchainKHR object, const std::string& name) { setObjectName((uint64_t)object, name, VK_OBJECT_TYPE_SWAPCHAIN_KHR); }
+	void setTrackedName(uint64_t resource, const std::string& name, bool resourceName) { if (m_memoryTracker != nullptr) m_memoryTracker->setName(resource, name, resourceName); }
 	
 	//Implementations
 	VKAPI_ATTR VkResult VKAPI_CALL vkSetDebugUtilsObjectNameEXT(VkDevice device, const VkDebugUtilsObjectNameInfoEXT* pNameInfo);
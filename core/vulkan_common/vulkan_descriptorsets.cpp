@@ -42,17 +42,35 @@ void VulkanDescriptorSets::createDescriptorSetLayout(std::vector<DescriptorSetLa
 	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());;
 	layoutInfo.pBindings = bindings.data();
 
+	//Descriptor indexing flags are chained only if a binding has some
+	std::vector<VkDescriptorBindingFlags> bindingFlags(numBindings);
+	bool hasBindingFlags = false;
+	for (int bindingIx = 0; bindingIx < numBindings; bindingIx++) {
+		bindingFlags[bindingIx] = bindingInfos[bindingIx].bindingFlags;
+		hasBindingFlags = hasBindingFlags || bindingFlags[bindingIx] != 0;
+		if (bindingFlags[bindingIx] & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT)
+			layoutInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	}
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.bindingCount = numBindings;
+	bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+	if (hasBindingFlags)
+		layoutInfo.pNext = &bindingFlagsInfo;
+
 	if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create descriptor set layout!");
 	}
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create the descriptor pool given pool sizes and max sets
+// Create the descriptor pool given pool sizes and max sets, sets of update after bind layouts need
+// VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT in flags
 //
-void VulkanDescriptorSets::createDescriptorPool(int maxSets, std::vector<VkDescriptorPoolSize> poolSizes, VkDescriptorPool& descriptorPool) {
+void VulkanDescriptorSets::createDescriptorPool(int maxSets, std::vector<VkDescriptorPoolSize> poolSizes, VkDescriptorPool& descriptorPool, VkDescriptorPoolCreateFlags flags) {
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = flags;
 	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	poolInfo.pPoolSizes = poolSizes.data();
 	poolInfo.maxSets = static_cast<uint32_t>(maxSets);
@@ -63,9 +81,10 @@ void VulkanDescriptorSets::createDescriptorPool(int maxSets, std::vector<VkDescr
 }
 
 //--------------------------------------------------------------------------------------------------
-// Allocate the a single descriptor set from descriptor pool given its layout and resources
+// Allocate a single descriptor set from descriptor pool given its layout, its descriptors are written
+// later
 //
-void VulkanDescriptorSets::createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, DescriptorSetInfo descriptorSetInfo, VkDescriptorSet& descriptorSet) {
+void VulkanDescriptorSets::allocateDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptorSet) {
 	VkDescriptorSetAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocInfo.descriptorPool = descriptorPool;
@@ -76,7 +95,22 @@ void VulkanDescriptorSets::createDescriptorSet(VkDescriptorPool descriptorPool,
 		throw std::runtime_error("failed to allocate descriptor sets!");
 		std::cout << vkAllocateDescriptorSets(m_device, &allocInfo, &descriptorSet) << std::endl;
 	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Allocate the a single descriptor set from descriptor pool given its layout and resources
+//
+void VulkanDescriptorSets::createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, DescriptorSetInfo descriptorSetInfo, VkDescriptorSet& descriptorSet) {
+	allocateDescriptorSet(descriptorPool, descriptorSetLayout, descriptorSet);
+	updateDescriptorSet(descriptorSetInfo, descriptorSet);
+}
 
+//--------------------------------------------------------------------------------------------------
+// Write the resources of a descriptor set again, e.g. after an image view changed. The set must
+// not be in use by pending command buffers, and the command buffers that bound it must be recorded
+// again.
+//
+void VulkanDescriptorSets::updateDescriptorSet(const DescriptorSetInfo& descriptorSetInfo, VkDescriptorSet descriptorSet) {
 	std::vector<VkWriteDescriptorSet> descriptorWrites{};
 	uint32_t currentBinding = 0;
 	uint32_t currentBuffer = 0;
@@ -92,7 +126,8 @@ void VulkanDescriptorSets::createDescriptorSet(VkDescriptorPool descriptorPool,
 		descriptorWrite.descriptorType = descriptorType;
 		descriptorWrite.descriptorCount = descriptorCount;
 		currentBinding += descriptorCount;
-		if (descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+		if (descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+			|| descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) {
 			descriptorWrite.pBufferInfo = &descriptorSetInfo.bufferInfos[currentBuffer];
 			currentBuffer += descriptorCount;
 		}
@@ -106,6 +141,39 @@ void VulkanDescriptorSets::createDescriptorSet(VkDescriptorPool descriptorPool,
 	vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
+//--------------------------------------------------------------------------------------------------
+// Write the buffer descriptor of a single binding, the other bindings keep their descriptors
+//
+void VulkanDescriptorSets::updateBufferDescriptor(VkDescriptorSet descriptorSet, uint32_t binding, VkDescriptorType descriptorType, const VkDescriptorBufferInfo& bufferInfo) {
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = descriptorSet;
+	descriptorWrite.dstBinding = binding;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = descriptorType;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pBufferInfo = &bufferInfo;
+	vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Write consecutive elements of an array binding from firstElement on, e.g. the entries of newly
+// loaded textures in a descriptor indexed texture array
+//
+void VulkanDescriptorSets::updateImageDescriptors(VkDescriptorSet descriptorSet, uint32_t binding, uint32_t firstElement, VkDescriptorType descriptorType, const std::vector<VkDescriptorImageInfo>& imageInfos) {
+	if (imageInfos.empty())
+		return;
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = descriptorSet;
+	descriptorWrite.dstBinding = binding;
+	descriptorWrite.dstArrayElement = firstElement;
+	descriptorWrite.descriptorType = descriptorType;
+	descriptorWrite.descriptorCount = static_cast<uint32_t>(imageInfos.size());
+	descriptorWrite.pImageInfo = imageInfos.data();
+	vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+}
+
 //--------------------------------------------------------------------------------------------------
 // Allocate the descriptor sets from descriptor pool given layouts and resources
 //
@@ -140,7 +208,8 @@ void VulkanDescriptorSets::createDescriptorSets(VkDescriptorPool descriptorPool,
 			descriptorWrite.descriptorType = descriptorType;
 			descriptorWrite.descriptorCount = descriptorCount;
 			currentBinding += descriptorCount;
-			if (descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+			if (descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+				|| descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) {
 				descriptorWrite.pBufferInfo = &descriptorSetInfos[setIx].bufferInfos[currentBuffer];
 				currentBuffer += descriptorCount;
 			}
@@ -15,12 +15,15 @@ namespace vkimpl
 
 /**
 \struct vkimpl::DescriptorSetLayoutBindingInfo
-vkimpl::DescriptorSetLayoutBindingInfo contains the binding information for descriptor set layout
+vkimpl::DescriptorSetLayoutBindingInfo contains the binding information for descriptor set layout.
+bindingFlags are the descriptor indexing flags of the binding, a layout with an update after bind
+binding is created for update after bind pools.
 */
 struct DescriptorSetLayoutBindingInfo {
 	VkDescriptorType descriptorType;
 	uint32_t descriptorCount;
 	VkShaderStageFlags stageFlags;
+	VkDescriptorBindingFlags bindingFlags{ 0 };
 };
 
 /**
@@ -42,8 +45,12 @@ public:
 	VulkanDescriptorSets(VkDevice device = VK_NULL_HANDLE)
 		:m_device(device) { };
 	void createDescriptorSetLayout(std::vector<DescriptorSetLayoutBindingInfo> bindingInfos, VkDescriptorSetLayout& descriptorSetLayout);
-	void createDescriptorPool(int maxSets, std::vector<VkDescriptorPoolSize> poolSizes, VkDescriptorPool& descriptorPool);
+	void createDescriptorPool(int maxSets, std::vector<VkDescriptorPoolSize> poolSizes, VkDescriptorPool& descriptorPool, VkDescriptorPoolCreateFlags flags = 0);
+	void allocateDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptorSet);
 	void createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, DescriptorSetInfo descriptorSetInfo, VkDescriptorSet& descriptorSet);
+	void updateDescriptorSet(const DescriptorSetInfo& descriptorSetInfo, VkDescriptorSet descriptorSet);
+	void updateBufferDescriptor(VkDescriptorSet descriptorSet, uint32_t binding, VkDescriptorType descriptorType, const VkDescriptorBufferInfo& bufferInfo);
+	void updateImageDescriptors(VkDescriptorSet descriptorSet, uint32_t binding, uint32_t firstElement, VkDescriptorType descriptorType, const std::vector<VkDescriptorImageInfo>& imageInfos);
 	void createDescriptorSets(VkDescriptorPool descriptorPool, std::vector<VkDescriptorSetLayout> descriptorSetLayouts, std::vector<DescriptorSetInfo> descriptorSetInfos, std::vector<VkDescriptorSet>& descriptorSets);
 
 	VkDevice m_device;
@@ -4,6 +4,7 @@
 
 #include "vulkan_buffers.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 namespace vkimpl {
@@ -29,9 +30,18 @@ void VulkanImages::setImageInfo(VulkanImageInfo imageInfo) {
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create an image,then allocate and bind to its memory
+// Create an image, then suballocate its memory from the memory allocator and bind to it
 //
-void VulkanImages::createImage(VkImage& image, VkDeviceMemory& imageMemory) {	
+void VulkanImages::createImage(VkImage& image, MemoryAllocation& imageMemory) {
+	createUnboundImage(image);
+	imageMemory = m_allocator->allocateImageMemory(image, m_currentImageInfo.tiling, m_currentImageInfo.usage, m_currentImageInfo.properties);
+	vkBindImageMemory(m_device, image, imageMemory.memory, imageMemory.offset);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Create an image without memory, for the caller to query its requirements or bind it itself
+//
+void VulkanImages::createUnboundImage(VkImage& image) {
 	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -48,34 +58,20 @@ void VulkanImages::createImage(VkImage& image, VkDeviceMemory& imageMemory) {
 	if (vkCreateImage(m_device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create image!");
 	}
-
-	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(m_device, image, &memRequirements);
-
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(m_physicalDevice, memRequirements.memoryTypeBits, m_currentImageInfo.properties);
-
-	if (vkAllocateMemory(m_device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory!");
-	}
-
-	vkBindImageMemory(m_device, image, imageMemory, 0);
 }
 
 //--------------------------------------------------------------------------------------------------
 // Create the image view for given image
 //
-VkImageView VulkanImages::createImageView(VkImage image) {
+VkImageView VulkanImages::createImageView(VkImage image, uint32_t baseMipLevel) {
 	VkImageViewCreateInfo viewInfo{};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewInfo.image = image;
 	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 	viewInfo.format = m_currentImageInfo.format;
 	viewInfo.subresourceRange.aspectMask = m_currentImageInfo.aspectFlags;
-	viewInfo.subresourceRange.baseMipLevel = 0;
-	viewInfo.subresourceRange.levelCount = m_currentImageInfo.mipLevels;
+	viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
+	viewInfo.subresourceRange.levelCount = m_currentImageInfo.mipLevels - baseMipLevel;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
 	viewInfo.subresourceRange.layerCount = 1;
 
@@ -94,21 +90,66 @@ VkImageView VulkanImages::createImageView(VkImage image) {
 //
 void VulkanImages::fillImagePixels(VkImage& image, void* pixels, VkDeviceSize imageSize, VkImageLayout originalLayout, VkImageAspectFlags aspectMask) {
 	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
+	MemoryAllocation stagingBufferMemory;
 
-	vkimpl::VulkanBuffers bufferHelper(m_physicalDevice, m_device, m_commandPool, m_queue);
+	vkimpl::VulkanBuffers bufferHelper(m_physicalDevice, m_device, m_commandPool, m_queue, m_allocator);
 	bufferHelper.createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
 
-	void* data;
-	vkMapMemory(m_device, stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(m_device, stagingBufferMemory);
+	memcpy(stagingBufferMemory.mapped, pixels, static_cast<size_t>(imageSize));
 
 	transitionImageLayout(image, originalLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 	bufferHelper.copyBufferToImage(stagingBuffer, image, static_cast<uint32_t>(m_currentImageInfo.extent.width), static_cast<uint32_t>(m_currentImageInfo.extent.height), aspectMask);
 
-	vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-	vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+	bufferHelper.destroyBuffer(stagingBuffer, stagingBufferMemory);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Record the transition of an image to the transfer layout and the copy of its pixels from the
+// staging buffer at stagingOffset
+//
+void VulkanImages::recordFillImagePixels(VkCommandBuffer commandBuffer, VkImage image, VkBuffer stagingBuffer, VkDeviceSize stagingOffset, VkImageAspectFlags aspectMask) {
+	recordTransitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = stagingOffset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = aspectMask;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = m_currentImageInfo.extent;
+
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Record the copy of mip levels from a staging buffer, e.g. block compressed levels baked offline.
+// levelOffsets holds the levels from baseLevel on, only those are transitioned so the other levels
+// can be filled by later submissions. The levels end in the shader read layout, no blits are needed.
+//
+void VulkanImages::recordFillImageLevels(VkCommandBuffer commandBuffer, VkImage image, VkBuffer stagingBuffer, const std::vector<VkDeviceSize>& levelOffsets, VkImageAspectFlags aspectMask, uint32_t baseLevel) {
+	uint32_t levelCount = static_cast<uint32_t>(levelOffsets.size());
+	recordTransitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, baseLevel, levelCount);
+
+	std::vector<VkBufferImageCopy> regions(levelCount);
+	for (uint32_t i = 0; i < levelCount; i++) {
+		uint32_t level = baseLevel + i;
+		VkBufferImageCopy& region = regions[i];
+		region.bufferOffset = levelOffsets[i];
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = aspectMask;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { std::max(m_currentImageInfo.extent.width >> level, 1u), std::max(m_currentImageInfo.extent.height >> level, 1u), 1 };
+	}
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, regions.data());
+
+	recordTransitionImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, baseLevel, levelCount);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -117,7 +158,15 @@ void VulkanImages::fillImagePixels(VkImage& image, void* pixels, VkDeviceSize im
 void VulkanImages::transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout) {
 	VulkanCommands commandHelper{ m_device, m_commandPool };
 	VkCommandBuffer commandBuffer = commandHelper.beginSingleTimeCommands();
+	recordTransitionImageLayout(commandBuffer, image, oldLayout, newLayout);
+	commandHelper.endSingleTimeCommands(commandBuffer, m_queue);
+}
 
+//--------------------------------------------------------------------------------------------------
+// Record the layout transition of an image, or of levelCount of its levels from baseLevel on. A
+// levelCount of 0 transitions every level from baseLevel on.
+//
+void VulkanImages::recordTransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseLevel, uint32_t levelCount) {
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	barrier.oldLayout = oldLayout;
@@ -126,8 +175,8 @@ void VulkanImages::transitionImageLayout(VkImage image, VkImageLayout oldLayout,
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.image = image;
 	barrier.subresourceRange.aspectMask = m_currentImageInfo.aspectFlags;
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = m_currentImageInfo.mipLevels;
+	barrier.subresourceRange.baseMipLevel = baseLevel;
+	barrier.subresourceRange.levelCount = levelCount > 0 ? levelCount : m_currentImageInfo.mipLevels - baseLevel;
 	barrier.subresourceRange.baseArrayLayer = 0;
 	barrier.subresourceRange.layerCount = 1;
 
@@ -155,6 +204,20 @@ void VulkanImages::transitionImageLayout(VkImage image, VkImageLayout oldLayout,
 		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
 		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	}
+	else if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+		barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		sourceStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
+	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	}
 	else {
 		throw std::invalid_argument("unsupported layout transition!");
 	}
@@ -167,14 +230,23 @@ void VulkanImages::transitionImageLayout(VkImage image, VkImageLayout oldLayout,
 		0, nullptr,
 		1, &barrier
 	);
-
-	commandHelper.endSingleTimeCommands(commandBuffer, m_queue);
 }
 
 //--------------------------------------------------------------------------------------------------
 // Generate the mipmaps of given VkImage in place
 //
 void VulkanImages::generateMipmaps(VkImage image) {
+	VulkanCommands commandHelper{m_device, m_commandPool};
+	VkCommandBuffer commandBuffer = commandHelper.beginSingleTimeCommands();
+	recordGenerateMipmaps(commandBuffer, image);
+	commandHelper.endSingleTimeCommands(commandBuffer, m_queue);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Record the mip chain generation of an image whose first level is in the transfer layout, every
+// level ends in the shader read layout
+//
+void VulkanImages::recordGenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image) {
 	VkFormatProperties formatProperties;
 	vkGetPhysicalDeviceFormatProperties(m_physicalDevice, m_currentImageInfo.format, &formatProperties);
 
@@ -182,9 +254,6 @@ void VulkanImages::generateMipmaps(VkImage image) {
 		throw std::runtime_error("texture image format does not support linear blitting!");
 	}
 
-	VulkanCommands commandHelper{m_device, m_commandPool};
-	VkCommandBuffer commandBuffer = commandHelper.beginSingleTimeCommands();
-
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	barrier.image = image;
@@ -257,8 +326,31 @@ void VulkanImages::generateMipmaps(VkImage image) {
 		0, nullptr,
 		0, nullptr,
 		1, &barrier);
+}
 
-	commandHelper.endSingleTimeCommands(commandBuffer, m_queue);
+//--------------------------------------------------------------------------------------------------
+// Record the copy of levelCount levels of an image in the shader read layout into the levels of
+// another image of the same format, from dstBaseLevel on. The current image info describes the
+// destination, the source levels have the size of the destination levels. Both images end in the
+// shader read layout, so the source can be sampled while the copy is recorded.
+//
+void VulkanImages::recordCopyImageLevels(VkCommandBuffer commandBuffer, VkImage srcImage, uint32_t srcBaseLevel, VkImage dstImage, uint32_t dstBaseLevel, uint32_t levelCount) {
+	recordTransitionImageLayout(commandBuffer, srcImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, srcBaseLevel, levelCount);
+	recordTransitionImageLayout(commandBuffer, dstImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, dstBaseLevel, levelCount);
+
+	std::vector<VkImageCopy> regions(levelCount);
+	for (uint32_t i = 0; i < levelCount; i++) {
+		VkImageCopy& region = regions[i];
+		region.srcSubresource = { m_currentImageInfo.aspectFlags, srcBaseLevel + i, 0, 1 };
+		region.srcOffset = { 0, 0, 0 };
+		region.dstSubresource = { m_currentImageInfo.aspectFlags, dstBaseLevel + i, 0, 1 };
+		region.dstOffset = { 0, 0, 0 };
+		region.extent = { std::max(m_currentImageInfo.extent.width >> (dstBaseLevel + i), 1u), std::max(m_currentImageInfo.extent.height >> (dstBaseLevel + i), 1u), 1 };
+	}
+	vkCmdCopyImage(commandBuffer, srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, regions.data());
+
+	recordTransitionImageLayout(commandBuffer, srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, srcBaseLevel, levelCount);
+	recordTransitionImageLayout(commandBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, dstBaseLevel, levelCount);
 }
 
-}
\ No newline at end of file
+}
@@ -4,6 +4,7 @@
 #include <vulkan/vulkan_core.h>
 
 #include "vulkan_common.h"
+#include "vulkan_memory.h"
 
 #include <vector>
 
@@ -41,25 +42,34 @@ vkimpl::VulkanImages handles the creation Vulkan images and imageviews, and the
 */
 class VulkanImages {
 public:
-	VulkanImages(VkPhysicalDevice physicalDevice = VK_NULL_HANDLE, VkDevice device = VK_NULL_HANDLE, VkCommandPool commandPool = VK_NULL_HANDLE, VkQueue queue = VK_NULL_HANDLE, VulkanImageInfo info = {})
-		: m_physicalDevice(physicalDevice), m_device(device), m_commandPool(commandPool), m_queue(queue), m_currentImageInfo(info) { };
+	VulkanImages(VkPhysicalDevice physicalDevice = VK_NULL_HANDLE, VkDevice device = VK_NULL_HANDLE, VkCommandPool commandPool = VK_NULL_HANDLE, VkQueue queue = VK_NULL_HANDLE, VulkanImageInfo info = {}, VulkanMemoryAllocator* allocator = nullptr)
+		: m_physicalDevice(physicalDevice), m_device(device), m_commandPool(commandPool), m_queue(queue), m_currentImageInfo(info), m_allocator(allocator) { };
 	
 	void setOperationInfo(VkCommandPool commandPool = VK_NULL_HANDLE, VkQueue queue = VK_NULL_HANDLE, VulkanImageInfo info = {});
 
 	void setImageInfo(VulkanImageInfo imageInfo);
 
-	void createImage(VkImage& image, VkDeviceMemory& imageMemory);
+	void createImage(VkImage& image, MemoryAllocation& imageMemory);
+	void createUnboundImage(VkImage& image);
 	void fillImagePixels(VkImage& image, void* pixels, VkDeviceSize imageSize, VkImageLayout originalLayout, VkImageAspectFlags aspectMask);
-	VkImageView createImageView(VkImage image);
+	VkImageView createImageView(VkImage image, uint32_t baseMipLevel = 0);
 	
 	void transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout);
 	void generateMipmaps(VkImage image);
 
+	//Record the operations into a command buffer instead of submitting and waiting for each one
+	void recordFillImagePixels(VkCommandBuffer commandBuffer, VkImage image, VkBuffer stagingBuffer, VkDeviceSize stagingOffset, VkImageAspectFlags aspectMask);
+	void recordFillImageLevels(VkCommandBuffer commandBuffer, VkImage image, VkBuffer stagingBuffer, const std::vector<VkDeviceSize>& levelOffsets, VkImageAspectFlags aspectMask, uint32_t baseLevel = 0);
+	void recordTransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseLevel = 0, uint32_t levelCount = 0);
+	void recordGenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image);
+	void recordCopyImageLevels(VkCommandBuffer commandBuffer, VkImage srcImage, uint32_t srcBaseLevel, VkImage dstImage, uint32_t dstBaseLevel, uint32_t levelCount);
+
 	VkPhysicalDevice m_physicalDevice;
 	VkDevice m_device;
 	VkCommandPool m_commandPool;
 	VkQueue m_queue;
 	VulkanImageInfo m_currentImageInfo;
+	VulkanMemoryAllocator* m_allocator;
 
 private:
 	
@@ -0,0 +1,426 @@
+#include "vulkan_memory.h"
+
+#include "tools.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace vkimpl {
+
+/**
+* The implementation of class VulkanMemoryAllocator
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Query the memory types and limits of the device and create an empty pool per memory type.
+// Blocks are at most blockSize and at most an eighth of their heap.
+//
+void VulkanMemoryAllocator::init(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize) {
+	m_physicalDevice = physicalDevice;
+	m_device = device;
+	m_blockSize = blockSize;
+	m_stats = {};
+
+	vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_memoryProperties);
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+	m_bufferImageGranularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+	m_stats.maxDeviceMemoryCount = properties.limits.maxMemoryAllocationCount;
+	m_tracker.init(m_physicalDevice);
+
+	//Two pools per memory type, the second one for optimal tiling images
+	m_pools.clear();
+	m_pools.resize(m_memoryProperties.memoryTypeCount * 2);
+	for (uint32_t i = 0; i < m_pools.size(); i++) {
+		uint32_t memoryTypeIndex = i / 2;
+		VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+		m_pools[i].memoryTypeIndex = memoryTypeIndex;
+		m_pools[i].blockSize = std::max(std::min(m_blockSize, align_up(heapSize / 8, slabSize)), slabSize);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Free all blocks, the dedicated allocations are freed by their owners
+//
+void VulkanMemoryAllocator::destroy() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& pool : m_pools) {
+		pool.slabBuckets.clear();
+		for (auto& block : pool.blocks)
+			freeDeviceMemory(block->memory, block->size, pool.memoryTypeIndex);
+		for (auto& block : pool.linearBlocks)
+			freeDeviceMemory(block->memory, block->size, pool.memoryTypeIndex);
+		pool.blocks.clear();
+		pool.linearBlocks.clear();
+	}
+	m_pools.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Allocate the memory of a buffer, buffers only used as a copy source are taken as short lived
+// staging buffers
+//
+MemoryAllocation VulkanMemoryAllocator::allocateBufferMemory(VkBuffer buffer, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+	VkBufferMemoryRequirementsInfo2 requirementsInfo{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2 };
+	requirementsInfo.buffer = buffer;
+	VkMemoryDedicatedRequirements dedicatedRequirements{ VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS };
+	VkMemoryRequirements2 requirements{ VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2 };
+	requirements.pNext = &dedicatedRequirements;
+	vkGetBufferMemoryRequirements2(m_device, &requirementsInfo, &requirements);
+
+	bool dedicated = dedicatedRequirements.requiresDedicatedAllocation || dedicatedRequirements.prefersDedicatedAllocation;
+	bool transient = usage == VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	return allocate(requirements.memoryRequirements, dedicated, buffer, VK_NULL_HANDLE, properties, false, transient, VulkanMemoryTracker::bufferCategory(usage));
+}
+
+//--------------------------------------------------------------------------------------------------
+// Allocate the memory of an image
+//
+MemoryAllocation VulkanMemoryAllocator::allocateImageMemory(VkImage image, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties) {
+	VkImageMemoryRequirementsInfo2 requirementsInfo{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2 };
+	requirementsInfo.image = image;
+	VkMemoryDedicatedRequirements dedicatedRequirements{ VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS };
+	VkMemoryRequirements2 requirements{ VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2 };
+	requirements.pNext = &dedicatedRequirements;
+	vkGetImageMemoryRequirements2(m_device, &requirementsInfo, &requirements);
+
+	bool dedicated = dedicatedRequirements.requiresDedicatedAllocation || dedicatedRequirements.prefersDedicatedAllocation;
+	return allocate(requirements.memoryRequirements, dedicated, VK_NULL_HANDLE, image, properties, tiling == VK_IMAGE_TILING_OPTIMAL, false, VulkanMemoryTracker::imageCategory(usage));
+}
+
+//--------------------------------------------------------------------------------------------------
+// Allocate a VkDeviceMemory for resources aliasing each other, like render targets never in use at
+// the same time. The memory is not dedicated to a resource.
+//
+MemoryAllocation VulkanMemoryAllocator::allocateSharedMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryCategory category, uint64_t resource) {
+	uint32_t memoryTypeIndex = findMemoryTypeIndex(requirements.memoryTypeBits, properties);
+	MemoryAllocation allocation{};
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		allocation = allocateDedicated(memoryTypeIndex, requirements.size, VK_NULL_HANDLE, VK_NULL_HANDLE);
+	}
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	allocation.resource = resource;
+	m_tracker.track(allocation.resource, category, m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex, allocation.size);
+	return allocation;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Pick the pool and the strategy of an allocation: dedicated memory for resources the driver wants
+// alone or that take more than half a block, slots for small resources, a linear range for
+// staging buffers and a TLSF range for the rest. The allocation is tracked under its resource.
+//
+MemoryAllocation VulkanMemoryAllocator::allocate(const VkMemoryRequirements& requirements, bool dedicated, VkBuffer buffer, VkImage image, VkMemoryPropertyFlags properties, bool optimalImage, bool transient, MemoryCategory category) {
+	uint32_t memoryTypeIndex = findMemoryTypeIndex(requirements.memoryTypeBits, properties);
+	MemoryPool& pool = m_pools[memoryTypeIndex * 2 + (optimalImage && m_bufferImageGranularity > 1 ? 1 : 0)];
+
+	MemoryAllocation allocation{};
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (dedicated || requirements.size > pool.blockSize / 2)
+			allocation = allocateDedicated(memoryTypeIndex, requirements.size, buffer, image);
+		else if (transient)
+			allocation = allocateLinear(pool, requirements.size, requirements.alignment);
+		else if (requirements.size <= maxSlotSize && requirements.alignment <= maxSlotSize)
+			allocation = allocateSlab(pool, requirements.size, requirements.alignment);
+		else
+			allocation = allocateTlsf(pool, requirements.size, requirements.alignment);
+	}
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	allocation.resource = buffer != VK_NULL_HANDLE ? (uint64_t)buffer : (uint64_t)image;
+	m_tracker.track(allocation.resource, category, m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex, allocation.size);
+	return allocation;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Allocate a VkDeviceMemory for a single resource, or for several ones without buffer and image
+//
+MemoryAllocation VulkanMemoryAllocator::allocateDedicated(uint32_t memoryTypeIndex, VkDeviceSize size, VkBuffer buffer, VkImage image) {
+	VkMemoryDedicatedAllocateInfo dedicatedInfo{ VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO };
+	dedicatedInfo.buffer = buffer;
+	dedicatedInfo.image = image;
+	bool shared = buffer == VK_NULL_HANDLE && image == VK_NULL_HANDLE;
+
+	MemoryAllocation allocation{};
+	char* mapped = nullptr;
+	allocation.memory = allocateDeviceMemory(memoryTypeIndex, size, shared ? nullptr : &dedicatedInfo, &mapped);
+	allocation.size = size;
+	allocation.mapped = mapped;
+	allocation.strategy = MemoryStrategy::Dedicated;
+
+	m_stats.dedicatedCount++;
+	m_stats.usedBytes += size;
+	return allocation;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Allocate a range of the first block with a fitting free range, adding a block if none has one
+//
+MemoryAllocation VulkanMemoryAllocator::allocateTlsf(MemoryPool& pool, VkDeviceSize size, VkDeviceSize alignment) {
+	MemoryAllocation allocation{};
+	allocation.strategy = MemoryStrategy::Tlsf;
+	allocation.size = size;
+
+	uint32_t handle = TlsfAllocator::invalidHandle;
+	MemoryBlock* block = nullptr;
+	for (auto& candidate : pool.blocks) {
+		handle = candidate->tlsf.allocate(size, alignment, allocation.offset);
+		if (handle != TlsfAllocator::invalidHandle) {
+			block = candidate.get();
+			break;
+		}
+	}
+	if (block == nullptr) {
+		block = createBlock(pool, pool.blocks);
+		block->tlsf.init(block->size);
+		handle = block->tlsf.allocate(size, alignment, allocation.offset);
+	}
+
+	allocation.memory = block->memory;
+	allocation.mapped = block->mapped != nullptr ? block->mapped + allocation.offset : nullptr;
+	allocation.owner = block;
+	allocation.handle = handle;
+
+	m_stats.tlsfAllocationCount++;
+	m_stats.usedBytes += size;
+	return allocation;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Allocate a slot of the size class bucket of size. Slots are powers of two aligned to their size,
+// a new slab is carved out of the TLSF blocks when every slab of the bucket is full.
+//
+MemoryAllocation VulkanMemoryAllocator::allocateSlab(MemoryPool& pool, VkDeviceSize size, VkDeviceSize alignment) {
+	VkDeviceSize slotSize = minSlotSize;
+	while (slotSize < size || slotSize < alignment)
+		slotSize *= 2;
+	size_t bucketIndex = 0;
+	for (VkDeviceSize s = minSlotSize; s < slotSize; s *= 2)
+		bucketIndex++;
+	if (pool.slabBuckets.size() <= bucketIndex)
+		pool.slabBuckets.resize(bucketIndex + 1);
+	auto& bucket = pool.slabBuckets[bucketIndex];
+
+	MemorySlab* slab = nullptr;
+	for (auto& candidate : bucket) {
+		if (!candidate->slots.full()) {
+			slab = candidate.get();
+			break;
+		}
+	}
+	if (slab == nullptr) {
+		MemoryAllocation range = allocateTlsf(pool, slabSize, slotSize);
+		m_stats.tlsfAllocationCount--;
+		m_stats.usedBytes -= slabSize;
+
+		bucket.push_back(std::make_unique<MemorySlab>());
+		slab = bucket.back().get();
+		slab->bucketIndex = bucketIndex;
+		slab->block = static_cast<MemoryBlock*>(range.owner);
+		slab->blockHandle = range.handle;
+		slab->offset = range.offset;
+		slab->slots.init(slotSize, static_cast<uint32_t>(slabSize / slotSize));
+	}
+
+	MemoryAllocation allocation{};
+	slab->slots.allocate(allocation.offset);
+	allocation.offset += slab->offset;
+	allocation.size = slotSize;
+	allocation.memory = slab->block->memory;
+	allocation.mapped = slab->block->mapped != nullptr ? slab->block->mapped + allocation.offset : nullptr;
+	allocation.strategy = MemoryStrategy::Slab;
+	allocation.owner = slab;
+
+	m_stats.slabAllocationCount++;
+	m_stats.usedBytes += slotSize;
+	return allocation;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Allocate a bump allocated range, blocks are rewound once all of their ranges are freed
+//
+MemoryAllocation VulkanMemoryAllocator::allocateLinear(MemoryPool& pool, VkDeviceSize size, VkDeviceSize alignment) {
+	MemoryAllocation allocation{};
+	allocation.strategy = MemoryStrategy::Linear;
+	allocation.size = size;
+
+	MemoryBlock* block = nullptr;
+	for (auto& candidate : pool.linearBlocks) {
+		if (candidate->linear.allocate(size, alignment, allocation.offset)) {
+			block = candidate.get();
+			break;
+		}
+	}
+	if (block == nullptr) {
+		block = createBlock(pool, pool.linearBlocks);
+		block->linear.init(block->size);
+		block->linear.allocate(size, alignment, allocation.offset);
+	}
+
+	allocation.memory = block->memory;
+	allocation.mapped = block->mapped != nullptr ? block->mapped + allocation.offset : nullptr;
+	allocation.owner = block;
+
+	m_stats.linearAllocationCount++;
+	m_stats.usedBytes += size;
+	return allocation;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Return an allocation to where it came from. Blocks and slabs that become empty are released
+// unless they are the last one of their kind, which is kept to avoid allocating it again.
+//
+void VulkanMemoryAllocator::free(MemoryAllocation& allocation) {
+	if (allocation.memory == VK_NULL_HANDLE)
+		return;
+	m_tracker.untrack(allocation.resource);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.usedBytes -= allocation.size;
+	switch (allocation.strategy) {
+	case MemoryStrategy::Dedicated:
+		freeDeviceMemory(allocation.memory, allocation.size, allocation.memoryTypeIndex);
+		m_stats.dedicatedCount--;
+		break;
+	case MemoryStrategy::Tlsf: {
+		MemoryBlock* block = static_cast<MemoryBlock*>(allocation.owner);
+		MemoryPool& pool = m_pools[block->poolIndex];
+		block->tlsf.free(allocation.handle);
+		m_stats.tlsfAllocationCount--;
+		if (block->tlsf.empty() && pool.blocks.size() > 1)
+			destroyBlock(pool.blocks, block);
+		break;
+	}
+	case MemoryStrategy::Slab: {
+		MemorySlab* slab = static_cast<MemorySlab*>(allocation.owner);
+		MemoryBlock* block = slab->block;
+		MemoryPool& pool = m_pools[block->poolIndex];
+		auto& bucket = pool.slabBuckets[slab->bucketIndex];
+		slab->slots.free(allocation.offset - slab->offset);
+		m_stats.slabAllocationCount--;
+		if (slab->slots.empty() && bucket.size() > 1) {
+			block->tlsf.free(slab->blockHandle);
+			bucket.erase(std::find_if(bucket.begin(), bucket.end(), [slab](const std::unique_ptr<MemorySlab>& s) { return s.get() == slab; }));
+			if (block->tlsf.empty() && pool.blocks.size() > 1)
+				destroyBlock(pool.blocks, block);
+		}
+		break;
+	}
+	case MemoryStrategy::Linear: {
+		MemoryBlock* block = static_cast<MemoryBlock*>(allocation.owner);
+		MemoryPool& pool = m_pools[block->poolIndex];
+		block->linear.free(allocation.size);
+		m_stats.linearAllocationCount--;
+		if (block->linear.empty() && pool.linearBlocks.size() > 1)
+			destroyBlock(pool.linearBlocks, block);
+		break;
+	}
+	}
+	allocation = {};
+}
+
+//--------------------------------------------------------------------------------------------------
+// Copy of the counters
+//
+MemoryAllocatorStats VulkanMemoryAllocator::getStats() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Allocate device memory and map it if it is host visible
+//
+VkDeviceMemory VulkanMemoryAllocator::allocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, const void* pNext, char** mapped) {
+	if (m_stats.maxDeviceMemoryCount > 0 && m_stats.deviceMemoryCount >= m_stats.maxDeviceMemoryCount) {
+		throw std::runtime_error("failed to allocate device memory, maxMemoryAllocationCount reached!");
+	}
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = pNext;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate device memory!");
+	}
+	m_stats.deviceAllocateMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+	*mapped = nullptr;
+	if (m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(mapped)) != VK_SUCCESS) {
+			vkFreeMemory(m_device, memory, nullptr);
+			throw std::runtime_error("failed to map device memory!");
+		}
+	}
+
+	m_stats.deviceMemoryCount++;
+	m_stats.deviceAllocateCount++;
+	m_stats.reservedBytes += size;
+	m_tracker.addReservedBytes(m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex, size);
+	return memory;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Free device memory, mapped memory is implicitly unmapped
+//
+void VulkanMemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex) {
+	vkFreeMemory(m_device, memory, nullptr);
+	m_stats.deviceMemoryCount--;
+	m_stats.reservedBytes -= size;
+	m_tracker.removeReservedBytes(m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex, size);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Allocate a block of the pool and append it to blocks
+//
+VulkanMemoryAllocator::MemoryBlock* VulkanMemoryAllocator::createBlock(MemoryPool& pool, std::vector<std::unique_ptr<MemoryBlock>>& blocks) {
+	auto block = std::make_unique<MemoryBlock>();
+	block->poolIndex = static_cast<uint32_t>(&pool - m_pools.data());
+	block->size = pool.blockSize;
+	block->memory = allocateDeviceMemory(pool.memoryTypeIndex, block->size, nullptr, &block->mapped);
+	m_stats.blockCount++;
+	blocks.push_back(std::move(block));
+	return blocks.back().get();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Free a block and remove it from blocks
+//
+void VulkanMemoryAllocator::destroyBlock(std::vector<std::unique_ptr<MemoryBlock>>& blocks, MemoryBlock* block) {
+	auto it = std::find_if(blocks.begin(), blocks.end(), [block](const std::unique_ptr<MemoryBlock>& b) { return b.get() == block; });
+	if (it == blocks.end())
+		return;
+	freeDeviceMemory(block->memory, block->size, m_pools[block->poolIndex].memoryTypeIndex);
+	m_stats.blockCount--;
+	blocks.erase(it);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Whether a memory type allowed by typeFilter has all the properties
+//
+bool VulkanMemoryAllocator::hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return true;
+	}
+	return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Index of the first memory type allowed by typeFilter that has all the properties
+//
+uint32_t VulkanMemoryAllocator::findMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+}
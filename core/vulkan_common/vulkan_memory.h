@@ -0,0 +1,149 @@
+#ifndef VULKAN_MEMORY
+#define VULKAN_MEMORY
+
+#include <vulkan/vulkan_core.h>
+
+#include "vulkan_common.h"
+#include "vulkan_memory_tracker.h"
+#include "range_allocator.h"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+namespace vkimpl
+{
+/**
+* Containers and helpers of vulkan API
+*/
+
+/**
+\enum vkimpl::MemoryStrategy
+vkimpl::MemoryStrategy tells how a vkimpl::MemoryAllocation was carved out of device memory
+*/
+enum class MemoryStrategy : uint32_t {
+	Dedicated,	//Its own VkDeviceMemory, for large resources or when the driver asks for it
+	Tlsf,		//A range of a shared block
+	Slab,		//A slot of a size class bucket, for small resources like uniform buffers
+	Linear,		//A bump allocated range of a shared block, for short lived staging buffers
+};
+
+/**
+\struct vkimpl::MemoryAllocation
+vkimpl::MemoryAllocation is a range of device memory handed out by vkimpl::VulkanMemoryAllocator.
+Resources are bound at offset of memory, mapped points at offset for host visible memory.
+*/
+struct MemoryAllocation {
+	VkDeviceMemory memory{ VK_NULL_HANDLE };
+	VkDeviceSize offset{ 0 };
+	VkDeviceSize size{ 0 };
+	void* mapped{ nullptr };
+
+	//Where the range came from, used by the allocator to free it
+	MemoryStrategy strategy{ MemoryStrategy::Dedicated };
+	void* owner{ nullptr };
+	uint32_t handle{ 0 };
+	uint32_t memoryTypeIndex{ 0 };
+	uint64_t resource{ 0 };		//The buffer or image, its key in the memory tracker
+};
+
+/**
+\struct vkimpl::MemoryAllocatorStats
+vkimpl::MemoryAllocatorStats contains the counters of a vkimpl::VulkanMemoryAllocator
+*/
+struct MemoryAllocatorStats {
+	uint32_t deviceMemoryCount{ 0 };	//Live VkDeviceMemory objects
+	uint32_t maxDeviceMemoryCount{ 0 };	//maxMemoryAllocationCount of the device
+	uint32_t blockCount{ 0 };
+	uint32_t dedicatedCount{ 0 };
+	size_t tlsfAllocationCount{ 0 };
+	size_t slabAllocationCount{ 0 };
+	size_t linearAllocationCount{ 0 };
+	VkDeviceSize reservedBytes{ 0 };	//Blocks and dedicated allocations
+	VkDeviceSize usedBytes{ 0 };
+	uint64_t deviceAllocateCount{ 0 };	//vkAllocateMemory calls since init
+	double deviceAllocateMilliseconds{ 0.0 };
+
+	size_t allocationCount() const { return dedicatedCount + tlsfAllocationCount + slabAllocationCount + linearAllocationCount; }
+};
+
+/**
+\class vkimpl::VulkanMemoryAllocator
+vkimpl::VulkanMemoryAllocator suballocates buffers and images from large blocks of device memory.
+Every memory type has a pool of blocks for buffers and linear images, and when bufferImageGranularity
+is above 1 a separate pool for optimal tiling images so the two never share a granularity page.
+Host visible blocks are mapped once for their lifetime. Every allocation is accounted by m_tracker.
+The allocator is thread safe.
+*/
+class VulkanMemoryAllocator {
+public:
+	static constexpr VkDeviceSize defaultBlockSize = 64 * 1024 * 1024;
+	static constexpr VkDeviceSize slabSize = 256 * 1024;
+	static constexpr VkDeviceSize minSlotSize = 256;
+	static constexpr VkDeviceSize maxSlotSize = 16 * 1024;
+
+	VulkanMemoryAllocator() = default;
+	VulkanMemoryAllocator(const VulkanMemoryAllocator&) = delete;
+	VulkanMemoryAllocator& operator=(const VulkanMemoryAllocator&) = delete;
+
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize = defaultBlockSize);
+	void destroy();
+
+	MemoryAllocation allocateBufferMemory(VkBuffer buffer, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+	MemoryAllocation allocateImageMemory(VkImage image, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties);
+	//Memory of its own for resources bound at offsets of it, tracked under resource
+	MemoryAllocation allocateSharedMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryCategory category, uint64_t resource);
+	void free(MemoryAllocation& allocation);
+	bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	MemoryAllocatorStats getStats();
+
+	VkPhysicalDevice m_physicalDevice{ VK_NULL_HANDLE };
+	VkDevice m_device{ VK_NULL_HANDLE };
+	VkDeviceSize m_blockSize{ defaultBlockSize };
+	VulkanMemoryTracker m_tracker;
+
+private:
+	struct MemoryBlock {
+		uint32_t poolIndex;
+		VkDeviceMemory memory;
+		VkDeviceSize size;
+		char* mapped;
+		TlsfAllocator tlsf;
+		LinearAllocator linear;
+	};
+	struct MemorySlab {
+		size_t bucketIndex;
+		MemoryBlock* block;
+		uint32_t blockHandle;
+		VkDeviceSize offset;
+		SlotAllocator slots;
+	};
+	struct MemoryPool {
+		uint32_t memoryTypeIndex;
+		VkDeviceSize blockSize;
+		std::vector<std::unique_ptr<MemoryBlock>> blocks;
+		std::vector<std::unique_ptr<MemoryBlock>> linearBlocks;
+		std::vector<std::vector<std::unique_ptr<MemorySlab>>> slabBuckets;
+	};
+
+	MemoryAllocation allocate(const VkMemoryRequirements& requirements, bool dedicated, VkBuffer buffer, VkImage image, VkMemoryPropertyFlags properties, bool optimalImage, bool transient, MemoryCategory category);
+	MemoryAllocation allocateDedicated(uint32_t memoryTypeIndex, VkDeviceSize size, VkBuffer buffer, VkImage image);
+	MemoryAllocation allocateTlsf(MemoryPool& pool, VkDeviceSize size, VkDeviceSize alignment);
+	MemoryAllocation allocateSlab(MemoryPool& pool, VkDeviceSize size, VkDeviceSize alignment);
+	MemoryAllocation allocateLinear(MemoryPool& pool, VkDeviceSize size, VkDeviceSize alignment);
+
+	VkDeviceMemory allocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, const void* pNext, char** mapped);
+	void freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex);
+	MemoryBlock* createBlock(MemoryPool& pool, std::vector<std::unique_ptr<MemoryBlock>>& blocks);
+	void destroyBlock(std::vector<std::unique_ptr<MemoryBlock>>& blocks, MemoryBlock* block);
+	uint32_t findMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+	VkDeviceSize m_bufferImageGranularity{ 1 };
+	std::vector<MemoryPool> m_pools;
+	MemoryAllocatorStats m_stats;
+	std::mutex m_mutex;
+};
+}
+#endif // !VULKAN_MEMORY
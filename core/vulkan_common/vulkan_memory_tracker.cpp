@@ -0,0 +1,210 @@
+#include "vulkan_memory_tracker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace vkimpl {
+
+/**
+* The implementation of class VulkanMemoryTracker
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Query the heaps of the device and whether it reports their budget
+//
+void VulkanMemoryTracker::init(VkPhysicalDevice physicalDevice) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_physicalDevice = physicalDevice;
+	vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_memoryProperties);
+	m_resources.clear();
+	m_reservedBytes = {};
+
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, extensions.data());
+	m_budgetSupported = std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties& extension) {
+		return std::strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+	});
+}
+
+//--------------------------------------------------------------------------------------------------
+// Start accounting the memory of a buffer or an image
+//
+void VulkanMemoryTracker::track(uint64_t resource, MemoryCategory category, uint32_t heapIndex, VkDeviceSize size) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	TrackedResource& tracked = m_resources[resource];
+	tracked.allocation = { std::string(), category, heapIndex, size };
+	tracked.resourceNamed = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Stop accounting the memory of a resource, its memory is freed
+//
+void VulkanMemoryTracker::untrack(uint64_t resource) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_resources.erase(resource);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Account a VkDeviceMemory object of the allocator in its heap
+//
+void VulkanMemoryTracker::addReservedBytes(uint32_t heapIndex, VkDeviceSize size) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_reservedBytes[heapIndex] += size;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Remove a freed VkDeviceMemory object from its heap
+//
+void VulkanMemoryTracker::removeReservedBytes(uint32_t heapIndex, VkDeviceSize size) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_reservedBytes[heapIndex] -= size;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Name the allocation of a tracked resource, resources that are not tracked are ignored
+//
+void VulkanMemoryTracker::setName(uint64_t resource, const std::string& name, bool resourceName) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto tracked = m_resources.find(resource);
+	if (tracked == m_resources.end() || (tracked->second.resourceNamed && !resourceName))
+		return;
+	tracked->second.allocation.name = name;
+	tracked->second.resourceNamed = resourceName;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Snapshot of the heaps, the categories and the allocations. The budget is queried every call, it
+// changes with the other processes of the device.
+//
+MemoryReport VulkanMemoryTracker::getReport() {
+	MemoryReport report{};
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
+	VkPhysicalDeviceMemoryProperties2 memoryProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2 };
+	if (m_budgetSupported) {
+		memoryProperties.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &memoryProperties);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	report.budgetSupported = m_budgetSupported;
+	report.heaps.resize(m_memoryProperties.memoryHeapCount);
+	for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++) {
+		report.heaps[i].flags = m_memoryProperties.memoryHeaps[i].flags;
+		report.heaps[i].size = m_memoryProperties.memoryHeaps[i].size;
+		report.heaps[i].reservedBytes = m_reservedBytes[i];
+		if (m_budgetSupported) {
+			report.heaps[i].budget = budgetProperties.heapBudget[i];
+			report.heaps[i].usage = budgetProperties.heapUsage[i];
+		}
+	}
+	report.allocations.reserve(m_resources.size());
+	for (const auto& resource : m_resources) {
+		const TrackedAllocation& allocation = resource.second.allocation;
+		report.heaps[allocation.heapIndex].trackedBytes += allocation.size;
+		report.categoryBytes[static_cast<size_t>(allocation.category)] += allocation.size;
+		report.categoryCounts[static_cast<size_t>(allocation.category)]++;
+		report.allocations.push_back(allocation);
+	}
+	std::sort(report.allocations.begin(), report.allocations.end(), [](const TrackedAllocation& a, const TrackedAllocation& b) {
+		return a.size != b.size ? a.size > b.size : a.name < b.name;
+	});
+	return report;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Name of a category in reports
+//
+const char* VulkanMemoryTracker::categoryName(MemoryCategory category) {
+	switch (category) {
+	case MemoryCategory::Textures: return "textures";
+	case MemoryCategory::Geometry: return "geometry";
+	case MemoryCategory::Attachments: return "attachments";
+	case MemoryCategory::ShadowMaps: return "shadow maps";
+	case MemoryCategory::Staging: return "staging";
+	case MemoryCategory::Uniforms: return "uniforms";
+	default: return "other";
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Category of a buffer by its usage, buffers read by draws count as geometry before anything else
+//
+MemoryCategory VulkanMemoryTracker::bufferCategory(VkBufferUsageFlags usage) {
+	if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
+		return MemoryCategory::Geometry;
+	if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+		return MemoryCategory::Uniforms;
+	if (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
+		return MemoryCategory::Staging;
+	return MemoryCategory::Other;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Category of an image by its usage, depth attachments that are sampled are shadow maps
+//
+MemoryCategory VulkanMemoryTracker::imageCategory(VkImageUsageFlags usage) {
+	if ((usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) && (usage & VK_IMAGE_USAGE_SAMPLED_BIT))
+		return MemoryCategory::ShadowMaps;
+	if (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT))
+		return MemoryCategory::Attachments;
+	if (usage & VK_IMAGE_USAGE_SAMPLED_BIT)
+		return MemoryCategory::Textures;
+	return MemoryCategory::Other;
+}
+
+/**
+* The implementation of struct MemoryReport
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Write a string as a JSON string literal
+//
+static void writeJsonString(std::ostringstream& out, const std::string& value) {
+	out << '"';
+	for (char c : value) {
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (static_cast<unsigned char>(c) < 0x20)
+			out << ' ';
+		else
+			out << c;
+	}
+	out << '"';
+}
+
+//--------------------------------------------------------------------------------------------------
+// The report as a JSON object of heaps, categories and allocations, sizes in bytes
+//
+std::string MemoryReport::toJson() const {
+	std::ostringstream out;
+	out << "{\n  \"budgetSupported\": " << (budgetSupported ? "true" : "false") << ",\n  \"heaps\": [";
+	for (size_t i = 0; i < heaps.size(); i++) {
+		const MemoryHeapReport& heap = heaps[i];
+		out << (i > 0 ? "," : "") << "\n    { \"index\": " << i
+			<< ", \"deviceLocal\": " << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "true" : "false")
+			<< ", \"size\": " << heap.size << ", \"reserved\": " << heap.reservedBytes << ", \"tracked\": " << heap.trackedBytes
+			<< ", \"budget\": " << heap.budget << ", \"usage\": " << heap.usage << " }";
+	}
+	out << "\n  ],\n  \"categories\": {";
+	for (size_t i = 0; i < categoryBytes.size(); i++) {
+		out << (i > 0 ? "," : "") << "\n    ";
+		writeJsonString(out, VulkanMemoryTracker::categoryName(static_cast<MemoryCategory>(i)));
+		out << ": { \"bytes\": " << categoryBytes[i] << ", \"count\": " << categoryCounts[i] << " }";
+	}
+	out << "\n  },\n  \"allocations\": [";
+	for (size_t i = 0; i < allocations.size(); i++) {
+		const TrackedAllocation& allocation = allocations[i];
+		out << (i > 0 ? "," : "") << "\n    { \"name\": ";
+		writeJsonString(out, allocation.name);
+		out << ", \"category\": ";
+		writeJsonString(out, VulkanMemoryTracker::categoryName(allocation.category));
+		out << ", \"heap\": " << allocation.heapIndex << ", \"size\": " << allocation.size << " }";
+	}
+	out << "\n  ]\n}\n";
+	return out.str();
+}
+
+}
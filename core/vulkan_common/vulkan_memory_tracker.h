@@ -0,0 +1,115 @@
+#ifndef VULKAN_MEMORY_TRACKER
+#define VULKAN_MEMORY_TRACKER
+
+#include <vulkan/vulkan_core.h>
+
+#include "vulkan_common.h"
+
+#include <array>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+namespace vkimpl
+{
+/**
+* Containers and helpers of vulkan API
+*/
+
+/**
+\enum vkimpl::MemoryCategory
+vkimpl::MemoryCategory is what a tracked allocation holds, derived from the usage of its resource
+*/
+enum class MemoryCategory : uint32_t {
+	Textures,		//Sampled images
+	Geometry,		//Vertex, index, indirect and storage buffers
+	Attachments,	//Render targets
+	ShadowMaps,		//Sampled depth attachments
+	Staging,		//Copy sources
+	Uniforms,		//Uniform buffers
+	Other,
+	Count
+};
+
+/**
+\struct vkimpl::TrackedAllocation
+vkimpl::TrackedAllocation is the memory of a buffer or an image, named after the resource or its memory
+*/
+struct TrackedAllocation {
+	std::string name;
+	MemoryCategory category{ MemoryCategory::Other };
+	uint32_t heapIndex{ 0 };
+	VkDeviceSize size{ 0 };
+};
+
+/**
+\struct vkimpl::MemoryHeapReport
+vkimpl::MemoryHeapReport contains the usage of a memory heap. budget and usage come from
+VK_EXT_memory_budget and count every process, they are 0 without it.
+*/
+struct MemoryHeapReport {
+	VkMemoryHeapFlags flags{ 0 };
+	VkDeviceSize size{ 0 };
+	VkDeviceSize reservedBytes{ 0 };	//VkDeviceMemory objects of the allocator
+	VkDeviceSize trackedBytes{ 0 };		//Allocations of the resources
+	VkDeviceSize budget{ 0 };
+	VkDeviceSize usage{ 0 };
+};
+
+/**
+\struct vkimpl::MemoryReport
+vkimpl::MemoryReport is a snapshot of a vkimpl::VulkanMemoryTracker, allocations are sorted by size
+*/
+struct MemoryReport {
+	bool budgetSupported{ false };
+	std::vector<MemoryHeapReport> heaps;
+	std::array<VkDeviceSize, static_cast<size_t>(MemoryCategory::Count)> categoryBytes{};
+	std::array<size_t, static_cast<size_t>(MemoryCategory::Count)> categoryCounts{};
+	std::vector<TrackedAllocation> allocations;
+
+	std::string toJson() const;
+};
+
+/**
+\class vkimpl::VulkanMemoryTracker
+vkimpl::VulkanMemoryTracker accounts the allocations of vkimpl::VulkanMemoryAllocator by resource,
+heap and category. Resources are named by vkimpl::VulkanDebugUtil::setObjectName. The budget of the
+heaps is queried with VK_EXT_memory_budget if the device supports it. The tracker is thread safe.
+*/
+class VulkanMemoryTracker {
+public:
+	VulkanMemoryTracker() = default;
+	VulkanMemoryTracker(const VulkanMemoryTracker&) = delete;
+	VulkanMemoryTracker& operator=(const VulkanMemoryTracker&) = delete;
+
+	void init(VkPhysicalDevice physicalDevice);
+
+	void track(uint64_t resource, MemoryCategory category, uint32_t heapIndex, VkDeviceSize size);
+	void untrack(uint64_t resource);
+	void addReservedBytes(uint32_t heapIndex, VkDeviceSize size);
+	void removeReservedBytes(uint32_t heapIndex, VkDeviceSize size);
+	//Resource names replace memory names, which are kept only for resources without a name
+	void setName(uint64_t resource, const std::string& name, bool resourceName);
+
+	MemoryReport getReport();
+	static const char* categoryName(MemoryCategory category);
+	static MemoryCategory bufferCategory(VkBufferUsageFlags usage);
+	static MemoryCategory imageCategory(VkImageUsageFlags usage);
+
+	VkPhysicalDevice m_physicalDevice{ VK_NULL_HANDLE };
+	bool m_budgetSupported{ false };
+
+private:
+	struct TrackedResource {
+		TrackedAllocation allocation;
+		bool resourceNamed;
+	};
+
+	VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+	std::unordered_map<uint64_t, TrackedResource> m_resources;
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> m_reservedBytes{};
+	std::mutex m_mutex;
+};
+}
+#endif // !VULKAN_MEMORY_TRACKER
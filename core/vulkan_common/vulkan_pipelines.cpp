@@ -43,8 +43,8 @@ void VulkanPipeline::createGraphicsPipelineLayout(VkPipelineLayout& graphicsPipe
 	m_graphicsPipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	m_graphicsPipelineLayoutInfo.setLayoutCount = m_vulkanPipelineCreateInfo.descriptorSetLayouts.size();
 	m_graphicsPipelineLayoutInfo.pSetLayouts = m_vulkanPipelineCreateInfo.descriptorSetLayouts.data();
-	m_graphicsPipelineLayoutInfo.pushConstantRangeCount = 0;
-	m_graphicsPipelineLayoutInfo.pPushConstantRanges = nullptr; 
+	m_graphicsPipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(m_vulkanPipelineCreateInfo.pushConstantRanges.size());
+	m_graphicsPipelineLayoutInfo.pPushConstantRanges = m_vulkanPipelineCreateInfo.pushConstantRanges.data();
 
 	if (vkCreatePipelineLayout(m_device, &m_graphicsPipelineLayoutInfo, nullptr, &m_graphicsPipelineLayout) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create pipeline layout!");
@@ -84,6 +84,35 @@ void VulkanPipeline::createGraphicsPipeline(VkPipeline& graphicsPipeline) {
 		vkDestroyShaderModule(m_device, m_vertShaderModule, nullptr);
 }
 
+//--------------------------------------------------------------------------------------------------
+// Create a compute pipeline and its layout from the compute shader code
+//
+void VulkanPipeline::createComputePipeline(const std::vector<char>& compShaderCode, std::vector<VkDescriptorSetLayout> descriptorSetLayouts, VkPipelineLayout& computePipelineLayout, VkPipeline& computePipeline) {
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+
+	if (vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &computePipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+
+	VkShaderModule compShaderModule = createShaderModule(compShaderCode);
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = compShaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = computePipelineLayout;
+
+	VkResult result = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline);
+	vkDestroyShaderModule(m_device, compShaderModule, nullptr);
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("failed to create compute pipeline!");
+	}
+}
+
 //--------------------------------------------------------------------------------------------------
 // Create the shader module from SpirV code
 //
@@ -141,9 +170,9 @@ void VulkanPipeline::populateShaderStages() {
 void VulkanPipeline::populateVertexInput() {
 	m_vertexInputInfo = {};
 	m_vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	m_vertexInputInfo.vertexBindingDescriptionCount = 1;
+	m_vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(m_vulkanPipelineCreateInfo.bindingDescriptions.size());
 	m_vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(m_vulkanPipelineCreateInfo.attributeDescriptions.size());
-	m_vertexInputInfo.pVertexBindingDescriptions = &m_vulkanPipelineCreateInfo.bindingDescription;
+	m_vertexInputInfo.pVertexBindingDescriptions = m_vulkanPipelineCreateInfo.bindingDescriptions.data();
 	m_vertexInputInfo.pVertexAttributeDescriptions = m_vulkanPipelineCreateInfo.attributeDescriptions.data();
 
 	m_inputAssemblyInfo = {};
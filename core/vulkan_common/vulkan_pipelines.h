@@ -21,12 +21,13 @@ struct VulkanPipelineCreateInfo {
 	std::vector<char> vertShaderCode;
 	std::vector<char> fragShaderCode;
 
-	VkVertexInputBindingDescription bindingDescription;
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions;
 	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 
 	VkExtent2D extent;
 	VkSampleCountFlagBits msaaSamples;
 	std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
+	std::vector<VkPushConstantRange> pushConstantRanges;
 	VkRenderPass renderPass;
 };
 
@@ -43,6 +44,7 @@ public:
 	void initGraphicsPipelineCreateInfo(VulkanPipelineCreateInfo info);
 	void createGraphicsPipelineLayout(VkPipelineLayout& graphicsPipelineLayout);
 	void createGraphicsPipeline(VkPipeline& pipeline);
+	void createComputePipeline(const std::vector<char>& compShaderCode, std::vector<VkDescriptorSetLayout> descriptorSetLayouts, VkPipelineLayout& computePipelineLayout, VkPipeline& computePipeline);
 
 	VkShaderModule VulkanPipeline::createShaderModule(const std::vector<char>& code);
 
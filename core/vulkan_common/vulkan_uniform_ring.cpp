@@ -0,0 +1,109 @@
+#include "vulkan_uniform_ring.h"
+
+#include "vulkan_buffers.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vkimpl {
+
+/**
+* The implementation of class VulkanUniformRing
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Create the buffer of regionCount regions of at least regionSize bytes. Regions start at multiples
+// of minUniformBufferOffsetAlignment, so every offset handed out can be a dynamic offset.
+//
+void VulkanUniformRing::init(VkPhysicalDevice physicalDevice, VkDevice device, VulkanMemoryAllocator* allocator, uint32_t regionCount, VkDeviceSize regionSize) {
+	m_device = device;
+	m_allocator = allocator;
+	m_regionCount = regionCount;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	//16 bytes keep the mat4 and vec4 members of the blocks aligned for the host stores
+	m_alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 16);
+	m_regionSize = alignUp(regionSize);
+	m_reservedSize = 0;
+	m_region = 0;
+	m_head = 0;
+	m_peakBytes = 0;
+	m_frameCount = 0;
+	m_allocationCount = 0;
+
+	VulkanBuffers bufferHelper(physicalDevice, m_device, VK_NULL_HANDLE, VK_NULL_HANDLE, m_allocator);
+	bufferHelper.createBuffer(m_regionSize * m_regionCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_buffer, m_memory);
+	m_mapped = static_cast<char*>(m_memory.mapped);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Destroy the buffer, no submitted frame may read it anymore
+//
+void VulkanUniformRing::destroy() {
+	if (m_device == VK_NULL_HANDLE)
+		return;
+	VulkanBuffers bufferHelper(VK_NULL_HANDLE, m_device, VK_NULL_HANDLE, VK_NULL_HANDLE, m_allocator);
+	bufferHelper.destroyBuffer(m_buffer, m_memory);
+	m_buffer = VK_NULL_HANDLE;
+	m_mapped = nullptr;
+	m_device = VK_NULL_HANDLE;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reserve a slot of size bytes at the same offset of every region, for data bound by command buffers
+// recorded once. Returns the offset of the slot in a region.
+//
+VkDeviceSize VulkanUniformRing::reserve(VkDeviceSize size) {
+	if (m_frameCount > 0 || m_allocationCount > 0) {
+		throw std::runtime_error("failed to reserve uniform slot, the ring is in use!");
+	}
+	if (m_reservedSize + alignUp(size) > m_regionSize) {
+		throw std::runtime_error("failed to reserve uniform slot, the region is full!");
+	}
+	VkDeviceSize slot = m_reservedSize;
+	m_reservedSize += alignUp(size);
+	return slot;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Start writing the region of a frame. The caller waited for the frame that used it before, so the
+// allocations of that frame are dropped.
+//
+void VulkanUniformRing::beginRegion(uint32_t region) {
+	m_region = region;
+	m_head = m_reservedSize;
+	m_frameCount++;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Allocate size bytes of the current region, valid until the region begins again
+//
+UniformAllocation VulkanUniformRing::allocate(VkDeviceSize size) {
+	if (m_head + size > m_regionSize) {
+		throw std::runtime_error("failed to allocate uniform data, the frame region is full!");
+	}
+	UniformAllocation allocation{ dynamicOffset(m_region, m_head), data(m_region, m_head) };
+	m_head = alignUp(m_head + size);
+	m_peakBytes = std::max(m_peakBytes, m_head);
+	m_allocationCount++;
+	return allocation;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Get the sizes and counters of the ring
+//
+UniformRingStats VulkanUniformRing::getStats() const {
+	UniformRingStats stats{};
+	stats.regionCount = m_regionCount;
+	stats.regionSize = m_regionSize;
+	stats.alignment = m_alignment;
+	stats.reservedBytes = m_reservedSize;
+	stats.usedBytes = std::max(m_head, m_reservedSize);
+	stats.peakBytes = std::max(m_peakBytes, m_reservedSize);
+	stats.frameCount = m_frameCount;
+	stats.allocationCount = m_allocationCount;
+	return stats;
+}
+
+}
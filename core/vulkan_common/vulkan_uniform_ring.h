@@ -0,0 +1,93 @@
+#ifndef VULKAN_UNIFORM_RING
+#define VULKAN_UNIFORM_RING
+
+#include <vulkan/vulkan_core.h>
+
+#include "vulkan_common.h"
+#include "vulkan_memory.h"
+
+namespace vkimpl
+{
+/**
+* Containers and helpers of vulkan API
+*/
+
+/**
+\struct vkimpl::UniformAllocation
+vkimpl::UniformAllocation is a range of a region of a vkimpl::VulkanUniformRing. dynamicOffset is
+passed to vkCmdBindDescriptorSets for the dynamic uniform buffer binding, data points at its mapped bytes.
+*/
+struct UniformAllocation {
+	uint32_t dynamicOffset{ 0 };
+	char* data{ nullptr };
+};
+
+/**
+\struct vkimpl::UniformRingStats
+vkimpl::UniformRingStats contains the sizes and counters of a vkimpl::VulkanUniformRing
+*/
+struct UniformRingStats {
+	uint32_t regionCount{ 0 };
+	VkDeviceSize regionSize{ 0 };
+	VkDeviceSize alignment{ 0 };
+	VkDeviceSize reservedBytes{ 0 };	//Slots of every region
+	VkDeviceSize usedBytes{ 0 };		//Slots and allocations of the current region
+	VkDeviceSize peakBytes{ 0 };		//Largest usedBytes of a region since init
+	uint64_t frameCount{ 0 };			//beginRegion() calls
+	uint64_t allocationCount{ 0 };		//allocate() calls
+};
+
+/**
+\class vkimpl::VulkanUniformRing
+vkimpl::VulkanUniformRing holds the uniform data written by the host every frame in one persistently
+mapped, host coherent buffer bound as a dynamic uniform buffer. The buffer is split into regions, one
+per frame that may be in flight, and a region is written only after the frame that last read it
+finished. Slots reserved with reserve() sit at the same place in every region, so command buffers
+recorded once bind them with dynamicOffset(region, slot). Data that changes per draw is allocated
+linearly from the rest of the region with allocate() after beginRegion(). Writes are plain stores,
+nothing is mapped, flushed or written to descriptor sets per frame.
+*/
+class VulkanUniformRing {
+public:
+	static constexpr VkDeviceSize defaultRegionSize = 64 * 1024;
+
+	VulkanUniformRing() = default;
+	VulkanUniformRing(const VulkanUniformRing&) = delete;
+	VulkanUniformRing& operator=(const VulkanUniformRing&) = delete;
+
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, VulkanMemoryAllocator* allocator, uint32_t regionCount, VkDeviceSize regionSize = defaultRegionSize);
+	void destroy();
+
+	//Slots are reserved before the first region begins, the returned offset is passed to data() and dynamicOffset()
+	VkDeviceSize reserve(VkDeviceSize size);
+	char* data(uint32_t region, VkDeviceSize slot) const { return m_mapped + region * m_regionSize + slot; }
+	uint32_t dynamicOffset(uint32_t region, VkDeviceSize slot) const { return static_cast<uint32_t>(region * m_regionSize + slot); }
+
+	void beginRegion(uint32_t region);
+	UniformAllocation allocate(VkDeviceSize size);
+
+	//Buffer info of the dynamic uniform buffer binding, range is the size of the bound data
+	VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) const { return { m_buffer, 0, range }; }
+	VkDeviceSize alignUp(VkDeviceSize size) const { return (size + m_alignment - 1) & ~(m_alignment - 1); }
+	UniformRingStats getStats() const;
+
+	VkDevice m_device{ VK_NULL_HANDLE };
+	uint32_t m_regionCount{ 0 };
+	VkDeviceSize m_regionSize{ 0 };
+
+private:
+	VulkanMemoryAllocator* m_allocator{ nullptr };
+	VkDeviceSize m_alignment{ 256 };
+	VkBuffer m_buffer{ VK_NULL_HANDLE };
+	MemoryAllocation m_memory;
+	char* m_mapped{ nullptr };
+
+	VkDeviceSize m_reservedSize{ 0 };
+	uint32_t m_region{ 0 };
+	VkDeviceSize m_head{ 0 };		//Offset in the current region of the next allocation
+	VkDeviceSize m_peakBytes{ 0 };
+	uint64_t m_frameCount{ 0 };
+	uint64_t m_allocationCount{ 0 };
+};
+}
+#endif // !VULKAN_UNIFORM_RING
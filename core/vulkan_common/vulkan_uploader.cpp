@@ -0,0 +1,530 @@
+#include "vulkan_uploader.h"
+
+#include "vulkan_buffers.h"
+#include "vulkan_commands.h"
+#include "tools.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace vkimpl {
+
+/**
+* The implementation of class VulkanUploader
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Create the staging ring and the command pools of the batches. Copies are submitted to queue, work
+// that needs a graphics queue to graphicsQueue. Both can be the same queue.
+//
+void VulkanUploader::init(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, uint32_t queueFamilyIndex, VkQueue graphicsQueue, uint32_t graphicsQueueFamilyIndex,
+	VulkanMemoryAllocator* allocator, VkDeviceSize ringSize) {
+	m_device = device;
+	m_queue = queue;
+	m_queueFamilyIndex = queueFamilyIndex;
+	m_graphicsQueue = graphicsQueue;
+	m_graphicsQueueFamilyIndex = graphicsQueueFamilyIndex;
+	m_allocator = allocator;
+	m_ringSize = ringSize;
+	m_writePos = 0;
+	m_releasePos = 0;
+	m_stats = {};
+
+	//Image copies start at the alignment the device prefers, a multiple of every texel block size
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	m_imageCopyAlignment = std::max<VkDeviceSize>(properties.limits.optimalBufferCopyOffsetAlignment, 16);
+	//Transfer only families may copy images in units larger than a texel
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+	m_imageTransferGranularity = queueFamilies[m_queueFamilyIndex].minImageTransferGranularity;
+
+	VulkanBuffers bufferHelper(physicalDevice, m_device, VK_NULL_HANDLE, m_queue, m_allocator);
+	bufferHelper.createBuffer(m_ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_ringBuffer, m_ringMemory);
+
+	VulkanCommands commandHelper(m_device);
+	m_commandPool = commandHelper.createCommandPool(m_queueFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	m_graphicsCommandPool = dedicatedTransfer() ? commandHelper.createCommandPool(m_graphicsQueueFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT) : m_commandPool;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Wait for the submitted batches and destroy the staging ring and the command pools
+//
+void VulkanUploader::destroy() {
+	if (m_device == VK_NULL_HANDLE)
+		return;
+	waitIdle();
+	for (const UploadBatch& batch : m_freeBatches) {
+		vkDestroyFence(m_device, batch.fence, nullptr);
+		if (batch.graphicsCommandBuffer != VK_NULL_HANDLE) {
+			vkDestroyFence(m_device, batch.graphicsFence, nullptr);
+			vkDestroySemaphore(m_device, batch.transferSemaphore, nullptr);
+		}
+	}
+	m_freeBatches.clear();
+	if (m_graphicsCommandPool != m_commandPool)
+		vkDestroyCommandPool(m_device, m_graphicsCommandPool, nullptr);
+	vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+
+	VulkanBuffers bufferHelper(VK_NULL_HANDLE, m_device, VK_NULL_HANDLE, m_queue, m_allocator);
+	bufferHelper.destroyBuffer(m_ringBuffer, m_ringMemory);
+	m_device = VK_NULL_HANDLE;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Begin a batch if none is open, its command buffer and fence are reused from a finished batch
+// when there is one
+//
+VulkanUploader::UploadBatch& VulkanUploader::openBatch() {
+	if (m_batchOpen)
+		return m_openBatch;
+
+	if (!m_freeBatches.empty()) {
+		m_openBatch = std::move(m_freeBatches.back());
+		m_freeBatches.pop_back();
+		vkResetFences(m_device, 1, &m_openBatch.fence);
+	}
+	else {
+		m_openBatch = {};
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = m_commandPool;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(m_device, &allocInfo, &m_openBatch.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate upload command buffer!");
+		}
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(m_device, &fenceInfo, nullptr, &m_openBatch.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload fence!");
+		}
+	}
+	m_openBatch.callbacks.clear();
+	m_openBatch.graphicsRecorded = false;
+	m_openBatch.transferDone = false;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(m_openBatch.commandBuffer, &beginInfo);
+	m_batchOpen = true;
+	return m_openBatch;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Get the transfer command buffer of the open batch, to record more copies
+//
+VkCommandBuffer VulkanUploader::getCommandBuffer() {
+	return openBatch().commandBuffer;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Get the graphics command buffer of the open batch, to record blits and copies that read what the
+// graphics queue owns. The buffer ranges and images released so far are acquired first. Without a
+// dedicated transfer family it is the transfer command buffer.
+//
+VkCommandBuffer VulkanUploader::getGraphicsCommandBuffer() {
+	UploadBatch& batch = openBatch();
+	if (!dedicatedTransfer()) {
+		recordReleases();
+		return batch.commandBuffer;
+	}
+
+	if (!batch.graphicsRecorded) {
+		if (batch.graphicsCommandBuffer == VK_NULL_HANDLE) {
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = m_graphicsCommandPool;
+			allocInfo.commandBufferCount = 1;
+			if (vkAllocateCommandBuffers(m_device, &allocInfo, &batch.graphicsCommandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate upload command buffer!");
+			}
+			VkFenceCreateInfo fenceInfo{};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			VkSemaphoreCreateInfo semaphoreInfo{};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			if (vkCreateFence(m_device, &fenceInfo, nullptr, &batch.graphicsFence) != VK_SUCCESS ||
+				vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &batch.transferSemaphore) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create upload synchronization objects!");
+			}
+		}
+		else {
+			vkResetFences(m_device, 1, &batch.graphicsFence);
+		}
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(batch.graphicsCommandBuffer, &beginInfo);
+		batch.graphicsRecorded = true;
+	}
+	recordReleases();
+	return batch.graphicsCommandBuffer;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Allocate size bytes of the staging ring for the open batch. A range never wraps around the end
+// of the ring. An open batch holding half the ring is submitted first, so the device copies it while
+// the other half is filled. When the ring is full the oldest batch is waited for.
+//
+StagingRange VulkanUploader::allocateStaging(VkDeviceSize size, VkDeviceSize alignment) {
+	if (size > m_ringSize) {
+		throw std::runtime_error("failed to allocate staging memory, the range is larger than the staging ring!");
+	}
+	if (m_batchOpen && m_openBatchBytes >= m_ringSize / 2)
+		submit();
+	for (;;) {
+		if (m_writePos == m_releasePos && m_pendingTransferCount == 0) {
+			m_writePos = 0;
+			m_releasePos = 0;
+		}
+		uint64_t pos = align_up(m_writePos, alignment);
+		VkDeviceSize ringOffset = pos % m_ringSize;
+		if (ringOffset + size > m_ringSize) {
+			pos += m_ringSize - ringOffset;
+			ringOffset = 0;
+		}
+		if (pos + size - m_releasePos <= m_ringSize) {
+			openBatch();
+			m_writePos = pos + size;
+			m_openBatchBytes += size;
+			m_stats.uploadedBytes += size;
+			return { m_ringBuffer, ringOffset, size, static_cast<char*>(m_ringMemory.mapped) + ringOffset };
+		}
+
+		if (m_pendingTransferCount == 0)
+			submit();
+		auto waitStartTime = std::chrono::high_resolution_clock::now();
+		completeTransfer(true);
+		auto waitEndTime = std::chrono::high_resolution_clock::now();
+		m_stats.ringWaitCount++;
+		m_stats.ringWaitMilliseconds += std::chrono::duration<double, std::chrono::milliseconds::period>(waitEndTime - waitStartTime).count();
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Record the copy of a staging range to a buffer at dstOffset. The written range is released to the
+// graphics queue, merged with the range written before it when they touch.
+//
+void VulkanUploader::copyBuffer(const StagingRange& staging, VkBuffer dstBuffer, VkDeviceSize dstOffset) {
+	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = staging.offset;
+	copyRegion.dstOffset = dstOffset;
+	copyRegion.size = staging.size;
+	vkCmdCopyBuffer(getCommandBuffer(), staging.buffer, dstBuffer, 1, &copyRegion);
+	m_stats.copyCount++;
+
+	if (!m_bufferReleases.empty() && m_bufferReleases.back().buffer == dstBuffer && m_bufferReleases.back().offset + m_bufferReleases.back().size == dstOffset) {
+		m_bufferReleases.back().size += staging.size;
+		return;
+	}
+	VkBufferMemoryBarrier release{};
+	release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	release.buffer = dstBuffer;
+	release.offset = dstOffset;
+	release.size = staging.size;
+	m_bufferReleases.push_back(release);
+	m_stats.releaseCount++;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Stage size bytes of data and record their copy to a buffer at dstOffset. Data larger than a
+// chunk of the ring is split into chunks, so a batch can be submitted while the next one is staged.
+// The data can be released once the call returns.
+//
+void VulkanUploader::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+	const char* bytes = static_cast<const char*>(data);
+	if (size > chunkSize())
+		m_stats.splitCount++;
+	for (VkDeviceSize offset = 0; offset < size; offset += chunkSize()) {
+		StagingRange staging = allocateStaging(std::min(chunkSize(), size - offset));
+		memcpy(staging.data, bytes + offset, static_cast<size_t>(staging.size));
+		copyBuffer(staging, dstBuffer, dstOffset + offset);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Record the transition of image subresources from the undefined to the transfer layout, before
+// their levels are uploaded
+//
+void VulkanUploader::prepareImage(VkImage image, const VkImageSubresourceRange& range) {
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = range;
+	vkCmdPipelineBarrier(getCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Stage a tightly packed image level and record its copy to an image in the transfer layout.
+// Levels larger than a chunk of the ring are split into bands of rows, rows of blockExtent texels
+// for block compressed formats, in multiples of the image transfer granularity of the queue. The
+// data can be released once the call returns.
+//
+void VulkanUploader::uploadImageLevel(VkImage image, VkImageAspectFlags aspectMask, uint32_t level, VkExtent3D extent, const void* data, VkDeviceSize size, uint32_t blockExtent) {
+	if (dedicatedTransfer() && (aspectMask & (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT))) {
+		throw std::runtime_error("failed to upload image level, depth and stencil can only be copied on a graphics queue!");
+	}
+	const char* bytes = static_cast<const char*>(data);
+	uint32_t blockRows = (extent.height + blockExtent - 1) / blockExtent;
+	VkDeviceSize rowPitch = size / blockRows;
+	if (rowPitch > m_ringSize) {
+		throw std::runtime_error("failed to upload image level, a row is larger than the staging ring!");
+	}
+	uint32_t bandRows = static_cast<uint32_t>(std::min<VkDeviceSize>(std::max<VkDeviceSize>(chunkSize() / rowPitch, 1), blockRows));
+	//A granularity of 0 only allows whole levels, bands otherwise start at multiples of it
+	uint32_t granularity = m_imageTransferGranularity.height;
+	if (granularity == 0)
+		bandRows = blockRows;
+	else if (bandRows < blockRows && granularity > 1)
+		bandRows = std::max(bandRows / granularity, 1u) * granularity;
+	if (rowPitch * std::min(bandRows, blockRows) > m_ringSize) {
+		throw std::runtime_error("failed to upload image level, the level is larger than the staging ring!");
+	}
+	if (bandRows < blockRows)
+		m_stats.splitCount++;
+
+	for (uint32_t row = 0; row < blockRows; row += bandRows) {
+		uint32_t rowCount = std::min(bandRows, blockRows - row);
+		StagingRange staging = allocateStaging(rowPitch * rowCount, m_imageCopyAlignment);
+		memcpy(staging.data, bytes + rowPitch * row, static_cast<size_t>(staging.size));
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = staging.offset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = aspectMask;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, static_cast<int32_t>(row * blockExtent), 0 };
+		region.imageExtent = { extent.width, std::min(rowCount * blockExtent, extent.height - row * blockExtent), 1 };
+		vkCmdCopyBufferToImage(getCommandBuffer(), staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		m_stats.copyCount++;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Release uploaded image subresources to the graphics queue, moving them from the transfer layout
+// to newLayout
+//
+void VulkanUploader::releaseImage(VkImage image, const VkImageSubresourceRange& range, VkImageLayout newLayout) {
+	openBatch();
+	VkImageMemoryBarrier release{};
+	release.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	release.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	release.newLayout = newLayout;
+	release.image = image;
+	release.subresourceRange = range;
+	m_imageReleases.push_back(release);
+	m_stats.releaseCount++;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Record the ownership transfers of the open batch: the transfer command buffer releases the
+// written buffer ranges and images, and the graphics command buffer acquires them. Without a
+// dedicated transfer family one barrier makes them visible to the commands that follow.
+//
+void VulkanUploader::recordReleases() {
+	if (m_bufferReleases.empty() && m_imageReleases.empty())
+		return;
+
+	uint32_t srcFamily = dedicatedTransfer() ? m_queueFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+	uint32_t dstFamily = dedicatedTransfer() ? m_graphicsQueueFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+	VkAccessFlags dstAccess = dedicatedTransfer() ? 0 : VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	for (VkBufferMemoryBarrier& release : m_bufferReleases) {
+		release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		release.dstAccessMask = dstAccess;
+		release.srcQueueFamilyIndex = srcFamily;
+		release.dstQueueFamilyIndex = dstFamily;
+	}
+	for (VkImageMemoryBarrier& release : m_imageReleases) {
+		release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		release.dstAccessMask = dstAccess;
+		release.srcQueueFamilyIndex = srcFamily;
+		release.dstQueueFamilyIndex = dstFamily;
+	}
+	vkCmdPipelineBarrier(m_openBatch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		dedicatedTransfer() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+		0, nullptr, static_cast<uint32_t>(m_bufferReleases.size()), m_bufferReleases.data(),
+		static_cast<uint32_t>(m_imageReleases.size()), m_imageReleases.data());
+
+	if (dedicatedTransfer()) {
+		//The acquire repeats the release, with the access of the graphics queue. The graphics part
+		//waits for the transfer part with a semaphore on every stage.
+		for (VkBufferMemoryBarrier& acquire : m_bufferReleases) {
+			acquire.srcAccessMask = 0;
+			acquire.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		}
+		for (VkImageMemoryBarrier& acquire : m_imageReleases) {
+			acquire.srcAccessMask = 0;
+			acquire.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		}
+		vkCmdPipelineBarrier(m_openBatch.graphicsCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+			0, nullptr, static_cast<uint32_t>(m_bufferReleases.size()), m_bufferReleases.data(),
+			static_cast<uint32_t>(m_imageReleases.size()), m_imageReleases.data());
+	}
+	m_bufferReleases.clear();
+	m_imageReleases.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Submit the transfer part of the open batch and return its ticket, the graphics part follows once
+// the copies finished. onComplete runs from poll() or wait() once both parts finished. Without an
+// open batch the callback waits for the last submitted batch instead, or runs right away if every
+// batch finished.
+//
+uint64_t VulkanUploader::submit(std::function<void()> onComplete) {
+	if (!m_batchOpen) {
+		if (onComplete && m_submittedBatches.empty())
+			onComplete();
+		else if (onComplete)
+			m_submittedBatches.back().callbacks.push_back(std::move(onComplete));
+		return m_submittedTicket;
+	}
+
+	//A graphics part is needed to acquire what the batch released
+	if (dedicatedTransfer() && !(m_bufferReleases.empty() && m_imageReleases.empty()))
+		getGraphicsCommandBuffer();
+	recordReleases();
+	if (!dedicatedTransfer()) {
+		//Make the uploads visible to every later command on the queue, so they need no wait on the host
+		VkMemoryBarrier memoryBarrier{};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(m_openBatch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+			1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+	vkEndCommandBuffer(m_openBatch.commandBuffer);
+	if (m_openBatch.graphicsRecorded)
+		vkEndCommandBuffer(m_openBatch.graphicsCommandBuffer);
+
+	UploadBatch batch = std::move(m_openBatch);
+	m_batchOpen = false;
+	m_openBatchBytes = 0;
+	batch.ticket = ++m_submittedTicket;
+	batch.ringEnd = m_writePos;
+	if (onComplete)
+		batch.callbacks.push_back(std::move(onComplete));
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.commandBuffer;
+	submitInfo.signalSemaphoreCount = batch.graphicsRecorded ? 1 : 0;
+	submitInfo.pSignalSemaphores = &batch.transferSemaphore;
+	if (vkQueueSubmit(m_queue, 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit upload batch!");
+	}
+	m_submittedBatches.push_back(std::move(batch));
+	m_pendingTransferCount++;
+	m_stats.submitCount++;
+	return m_submittedTicket;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Submit the open batch and wait for the copies of every batch, so the graphics parts are submitted
+// before the graphics work that reads the uploads
+//
+void VulkanUploader::finishTransfers() {
+	submit();
+	while (m_pendingTransferCount > 0)
+		completeTransfer(true);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Check, or wait for, the transfer part of the oldest batch still copying. Once it finished its ring
+// range is released and its graphics part is submitted, the semaphore it waits for is already
+// signaled so the graphics queue does not stall. Returns whether the transfer part finished.
+//
+bool VulkanUploader::completeTransfer(bool waitForFence) {
+	if (m_pendingTransferCount == 0)
+		return false;
+	UploadBatch& batch = m_submittedBatches[m_submittedBatches.size() - m_pendingTransferCount];
+	if (waitForFence)
+		vkWaitForFences(m_device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+	else if (vkGetFenceStatus(m_device, batch.fence) != VK_SUCCESS)
+		return false;
+
+	m_releasePos = batch.ringEnd;
+	if (batch.graphicsRecorded) {
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &batch.transferSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.graphicsCommandBuffer;
+		if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, batch.graphicsFence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload batch!");
+		}
+		m_stats.graphicsSubmitCount++;
+	}
+	batch.transferDone = true;
+	m_pendingTransferCount--;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Retire the oldest submitted batch, whose transfer and graphics parts finished: its callbacks run
+//
+void VulkanUploader::retireBatch() {
+	UploadBatch batch = std::move(m_submittedBatches.front());
+	m_submittedBatches.pop_front();
+	m_completedTicket = batch.ticket;
+
+	//Callbacks may upload again, so the batch is back in the free list before they run
+	std::vector<std::function<void()>> callbacks;
+	callbacks.swap(batch.callbacks);
+	m_freeBatches.push_back(std::move(batch));
+	for (auto& callback : callbacks)
+		callback();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Submit the graphics parts of the batches whose copies finished and retire the batches that
+// finished, without waiting. Both parts finish in submission order.
+//
+void VulkanUploader::poll() {
+	while (completeTransfer(false));
+	while (!m_submittedBatches.empty() && m_submittedBatches.front().transferDone && (!m_submittedBatches.front().graphicsRecorded ||
+		vkGetFenceStatus(m_device, m_submittedBatches.front().graphicsFence) == VK_SUCCESS))
+		retireBatch();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Wait until the batch of a ticket and every batch before it finished
+//
+void VulkanUploader::wait(uint64_t ticket) {
+	while (m_completedTicket < ticket && !m_submittedBatches.empty()) {
+		UploadBatch& batch = m_submittedBatches.front();
+		if (!batch.transferDone)
+			completeTransfer(true);
+		if (batch.graphicsRecorded)
+			vkWaitForFences(m_device, 1, &batch.graphicsFence, VK_TRUE, UINT64_MAX);
+		retireBatch();
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Submit the open batch and wait for every batch
+//
+void VulkanUploader::waitIdle() {
+	wait(submit());
+}
+
+}
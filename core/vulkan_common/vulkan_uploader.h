@@ -0,0 +1,149 @@
+#ifndef VULKAN_UPLOADER
+#define VULKAN_UPLOADER
+
+#include <vulkan/vulkan_core.h>
+
+#include "vulkan_common.h"
+#include "vulkan_memory.h"
+
+#include <vector>
+#include <deque>
+#include <functional>
+
+namespace vkimpl
+{
+/**
+* Containers and helpers of vulkan API
+*/
+
+/**
+\struct vkimpl::StagingRange
+vkimpl::StagingRange is a range of the staging ring of a vkimpl::VulkanUploader, data points at its
+mapped bytes. It can be written until the batch it was allocated for is submitted.
+*/
+struct StagingRange {
+	VkBuffer buffer{ VK_NULL_HANDLE };
+	VkDeviceSize offset{ 0 };
+	VkDeviceSize size{ 0 };
+	char* data{ nullptr };
+};
+
+/**
+\struct vkimpl::UploadStats
+vkimpl::UploadStats contains the counters of a vkimpl::VulkanUploader
+*/
+struct UploadStats {
+	uint64_t uploadedBytes{ 0 };	//Bytes staged through the ring
+	uint64_t copyCount{ 0 };		//Recorded copy commands
+	uint64_t submitCount{ 0 };
+	uint64_t splitCount{ 0 };		//Uploads split because they are larger than a ring chunk
+	uint64_t ringWaitCount{ 0 };	//Waits for a batch to free ring space
+	double ringWaitMilliseconds{ 0.0 };
+	uint64_t releaseCount{ 0 };		//Buffer ranges and image subresources handed to the graphics queue family
+	uint64_t graphicsSubmitCount{ 0 };	//Submissions of the graphics part of batches
+};
+
+/**
+\class vkimpl::VulkanUploader
+vkimpl::VulkanUploader uploads buffer and image data through a persistently mapped staging ring.
+Copies recorded through it are batched into one command buffer for the transfer queue, submitted on
+submit(). Work that needs the graphics queue, like mip blits, goes into a second command buffer of
+the batch. When the transfer queue is of another family, written buffer ranges and released image
+subresources change owner: the transfer part releases them and the graphics part acquires them.
+The graphics part is submitted from poll() once the transfer part finished, so the graphics queue
+never waits for copies. Each batch is identified by a ticket, and callbacks passed to submit() run
+once both parts finished. Uploads larger than a quarter of the ring are split, a batch holding half
+the ring is submitted on its own and when the ring is full the oldest copies are waited for.
+The uploader is used from one thread.
+*/
+class VulkanUploader {
+public:
+	static constexpr VkDeviceSize defaultRingSize = 64 * 1024 * 1024;
+
+	VulkanUploader() = default;
+	VulkanUploader(const VulkanUploader&) = delete;
+	VulkanUploader& operator=(const VulkanUploader&) = delete;
+
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, uint32_t queueFamilyIndex, VkQueue graphicsQueue, uint32_t graphicsQueueFamilyIndex,
+		VulkanMemoryAllocator* allocator, VkDeviceSize ringSize = defaultRingSize);
+	void destroy();
+
+	//The command buffers of the open batch, for the transfer and the graphics queue. A staging
+	//allocation may submit the open batch to free ring space, so they are fetched again after each one.
+	//Fetching the graphics command buffer acquires what the batch released so far.
+	VkCommandBuffer getCommandBuffer();
+	VkCommandBuffer getGraphicsCommandBuffer();
+	StagingRange allocateStaging(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+	void copyBuffer(const StagingRange& staging, VkBuffer dstBuffer, VkDeviceSize dstOffset);
+	void uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+	void prepareImage(VkImage image, const VkImageSubresourceRange& range);
+	void uploadImageLevel(VkImage image, VkImageAspectFlags aspectMask, uint32_t level, VkExtent3D extent, const void* data, VkDeviceSize size, uint32_t blockExtent = 1);
+	void releaseImage(VkImage image, const VkImageSubresourceRange& range, VkImageLayout newLayout);
+
+	uint64_t submit(std::function<void()> onComplete = nullptr);
+	void finishTransfers();
+	void poll();
+	void wait(uint64_t ticket);
+	void waitIdle();
+	bool isComplete(uint64_t ticket) const { return ticket <= m_completedTicket; }
+
+	bool dedicatedTransfer() const { return m_queueFamilyIndex != m_graphicsQueueFamilyIndex; }
+	VkDeviceSize chunkSize() const { return m_ringSize / 4; }
+	UploadStats getStats() const { return m_stats; }
+
+	VkDevice m_device{ VK_NULL_HANDLE };
+	VkQueue m_queue{ VK_NULL_HANDLE };
+	uint32_t m_queueFamilyIndex{ 0 };
+	VkQueue m_graphicsQueue{ VK_NULL_HANDLE };
+	uint32_t m_graphicsQueueFamilyIndex{ 0 };
+	VkDeviceSize m_ringSize{ 0 };
+
+private:
+	struct UploadBatch {
+		VkCommandBuffer commandBuffer;
+		VkFence fence;
+		VkCommandBuffer graphicsCommandBuffer;	//Created for the first batch with graphics work
+		VkFence graphicsFence;
+		VkSemaphore transferSemaphore;			//Signaled by the transfer part for the graphics part
+		bool graphicsRecorded;
+		bool transferDone;
+		uint64_t ticket;
+		uint64_t ringEnd;   //Ring position after the last staging range of the batch
+		std::vector<std::function<void()>> callbacks;
+	};
+
+	UploadBatch& openBatch();
+	void recordReleases();
+	bool completeTransfer(bool waitForFence);
+	void retireBatch();
+
+	VulkanMemoryAllocator* m_allocator{ nullptr };
+	VkDeviceSize m_imageCopyAlignment{ 16 };
+	VkExtent3D m_imageTransferGranularity{ 1, 1, 1 };
+	VkCommandPool m_commandPool{ VK_NULL_HANDLE };
+	VkCommandPool m_graphicsCommandPool{ VK_NULL_HANDLE };
+	VkBuffer m_ringBuffer{ VK_NULL_HANDLE };
+	MemoryAllocation m_ringMemory;
+
+	//Ring positions grow until the ring is empty again, offsets in the ring are the positions modulo m_ringSize
+	uint64_t m_writePos{ 0 };
+	uint64_t m_releasePos{ 0 };
+
+	bool m_batchOpen{ false };
+	UploadBatch m_openBatch{};
+	VkDeviceSize m_openBatchBytes{ 0 };   //Staging bytes of the open batch
+	std::deque<UploadBatch> m_submittedBatches;   //In submission order
+	size_t m_pendingTransferCount{ 0 };   //Submitted batches whose transfer part did not finish, the last ones
+	std::vector<UploadBatch> m_freeBatches;
+
+	//Ownership transfers of the open batch not recorded yet
+	std::vector<VkBufferMemoryBarrier> m_bufferReleases;
+	std::vector<VkImageMemoryBarrier> m_imageReleases;
+	uint64_t m_submittedTicket{ 0 };
+	uint64_t m_completedTicket{ 0 };
+
+	UploadStats m_stats;
+};
+}
+#endif // !VULKAN_UPLOADER
@@ -0,0 +1,234 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "obj_parser.h"
+
+namespace {
+
+void check(bool condition, const std::string& message) {
+	if (!condition)
+		throw std::runtime_error(message);
+}
+
+bool sameIndex(const tinyobj::index_t& a, const tinyobj::index_t& b) {
+	return a.vertex_index == b.vertex_index && a.texcoord_index == b.texcoord_index && a.normal_index == b.normal_index;
+}
+
+//Small chunks and windows so even the sample models are split across chunks and threads
+ObjParser smallChunkParser() {
+	ObjParser parser(4);
+	parser.m_minChunkSize = 64;
+	parser.m_windowSize = 256;
+	return parser;
+}
+
+struct LoadedObj {
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn;
+	std::string err;
+};
+
+LoadedObj loadWithTinyobj(const std::string& directory, const std::string& name) {
+	LoadedObj obj;
+	bool loaded = tinyobj::LoadObj(&obj.attrib, &obj.shapes, &obj.materials, &obj.warn, &obj.err, (directory + "/" + name).c_str(), directory.c_str());
+	check(loaded, name + ": tinyobj failed to load it: " + obj.err);
+	return obj;
+}
+
+LoadedObj loadWithParser(const std::string& directory, const std::string& name) {
+	LoadedObj obj;
+	ObjParser parser = smallChunkParser();
+	bool loaded = parser.load(&obj.attrib, &obj.shapes, &obj.materials, &obj.warn, &obj.err, directory + "/" + name, directory);
+	check(loaded, name + ": ObjParser failed to load it: " + obj.err);
+	return obj;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Compare the parser output with tinyobj. Texcoord and normal indices tinyobj keeps out of range
+// are expected to be -1.
+//
+void compareWithTinyobj(const std::string& name, const LoadedObj& expected, const LoadedObj& actual) {
+	check(expected.attrib.vertices == actual.attrib.vertices, name + ": positions differ");
+	check(expected.attrib.colors == actual.attrib.colors, name + ": colors differ");
+	check(expected.attrib.texcoords == actual.attrib.texcoords, name + ": texcoords differ");
+	check(expected.attrib.normals == actual.attrib.normals, name + ": normals differ");
+	check(expected.materials.size() == actual.materials.size(), name + ": material count differs");
+	for (size_t i = 0; i < expected.materials.size(); i++)
+		check(expected.materials[i].name == actual.materials[i].name, name + ": material names differ");
+
+	int texcoordCount = int(expected.attrib.texcoords.size() / 2);
+	int normalCount = int(expected.attrib.normals.size() / 3);
+	check(expected.shapes.size() == actual.shapes.size(), name + ": shape count differs");
+	for (size_t s = 0; s < expected.shapes.size(); s++) {
+		const tinyobj::mesh_t& expectedMesh = expected.shapes[s].mesh;
+		const tinyobj::mesh_t& actualMesh = actual.shapes[s].mesh;
+		check(expected.shapes[s].name == actual.shapes[s].name, name + ": shape name '" + actual.shapes[s].name + "' should be '" + expected.shapes[s].name + "'");
+		check(expectedMesh.indices.size() == actualMesh.indices.size(), name + ": index count of shape " + expected.shapes[s].name + " differs");
+		for (size_t i = 0; i < expectedMesh.indices.size(); i++) {
+			tinyobj::index_t index = expectedMesh.indices[i];
+			if (index.texcoord_index >= texcoordCount)
+				index.texcoord_index = -1;
+			if (index.normal_index >= normalCount)
+				index.normal_index = -1;
+			check(sameIndex(index, actualMesh.indices[i]), name + ": face indices of shape " + expected.shapes[s].name + " differ");
+		}
+		check(expectedMesh.material_ids == actualMesh.material_ids, name + ": material ids of shape " + expected.shapes[s].name + " differ");
+		check(expectedMesh.smoothing_group_ids == actualMesh.smoothing_group_ids, name + ": smoothing groups of shape " + expected.shapes[s].name + " differ");
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Streamed faces must be the faces load() puts in the shapes, in the same order
+//
+void compareStreamWithLoad(const std::string& directory, const std::string& name, const LoadedObj& loaded) {
+	ObjParser parser = smallChunkParser();
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+	std::vector<std::vector<tinyobj::index_t>> shapeIndices;
+	std::vector<std::vector<int>> shapeMaterialIds;
+	size_t texcoordCount = 0;
+	size_t normalCount = 0;
+	bool streamed = parser.stream(directory + "/" + name, directory, &materials, &warn, &err,
+		[&](const ObjStreamAttributes& attributes) {
+			texcoordCount = attributes.texcoordCount;
+			normalCount = attributes.normalCount;
+		},
+		[&](const ObjStreamWindow& window) {
+			for (size_t r = 0; r < window.runCount; r++) {
+				const ObjStreamRun& run = window.runs[r];
+				if (shapeIndices.size() <= run.shape) {
+					shapeIndices.resize(run.shape + 1);
+					shapeMaterialIds.resize(run.shape + 1);
+				}
+				shapeIndices[run.shape].insert(shapeIndices[run.shape].end(), window.indices + run.faceBegin * 3, window.indices + run.faceEnd * 3);
+				shapeMaterialIds[run.shape].insert(shapeMaterialIds[run.shape].end(), run.faceEnd - run.faceBegin, run.materialId);
+			}
+		});
+	check(streamed, name + ": ObjParser failed to stream it: " + err);
+	check(texcoordCount == loaded.attrib.texcoords.size() / 2 && normalCount == loaded.attrib.normals.size() / 3, name + ": streamed attribute counts differ");
+	check(warn == loaded.warn, name + ": streamed warnings differ");
+	check(shapeIndices.size() == loaded.shapes.size(), name + ": streamed shape count differs");
+	for (size_t s = 0; s < loaded.shapes.size(); s++) {
+		const tinyobj::mesh_t& mesh = loaded.shapes[s].mesh;
+		check(shapeIndices[s].size() == mesh.indices.size(), name + ": streamed index count differs");
+		for (size_t i = 0; i < mesh.indices.size(); i++)
+			check(sameIndex(shapeIndices[s][i], mesh.indices[i]), name + ": streamed face indices differ");
+		check(shapeMaterialIds[s] == mesh.material_ids, name + ": streamed material ids differ");
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Sample models of tinyobj, loaded and streamed like tinyobj loads them. Models with lines, points
+// or NaN coordinates are left out, the parser skips the first two on purpose.
+//
+void testSampleModels(const std::string& directory) {
+	const char* names[] = {
+		"cornell_box.obj",
+		"cornell_box_multimaterial.obj",
+		"cube.obj",
+		"cube-vertexcol.obj",
+		"issue-92.obj",
+		"issue-95.obj",
+		"issue-138.obj",
+		"issue-161-inconsistent-f.obj",
+		"issue-162-smoothing-group.obj",
+		"issue-235-usemtl-then-o.obj",
+		"issue-246-usemtl-whitespace.obj",
+		"issue-295-trianguation-failure.obj",
+		"leading-decimal-dot-issue-201.obj",
+		"mtllib-multiple-files-issue-112.obj",
+		"no_material.obj",
+		"smoothing-normal.obj",
+		"texture-filename-with-whitespace.obj",
+		"usemtl-issue-68.obj",
+		"usemtl-issue-104.obj",
+		//Texcoord or normal indices out of range
+		"catmark_torus_creases0.obj",
+		"smoothing-group-two-squares.obj",
+		//Escaped spaces in mtllib
+		"mtl filename with whitespace issue46.obj",
+	};
+	for (const char* name : names) {
+		LoadedObj loaded = loadWithParser(directory, name);
+		compareWithTinyobj(name, loadWithTinyobj(directory, name), loaded);
+		compareStreamWithLoad(directory, name, loaded);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Out of range texcoord and normal indices are dropped with a warning instead of failing the file
+//
+void testOutOfRangeIndices(const std::string& directory) {
+	LoadedObj torus = loadWithParser(directory, "catmark_torus_creases0.obj");
+	check(torus.warn.find("out of range normal") != std::string::npos, "catmark_torus_creases0.obj: no warning about the dropped normals");
+	check(torus.shapes.size() == 1 && torus.shapes[0].mesh.indices.size() == 32 * 6, "catmark_torus_creases0.obj: faces missing");
+	for (const tinyobj::index_t& index : torus.shapes[0].mesh.indices)
+		check(index.texcoord_index >= 0 && index.normal_index == -1, "catmark_torus_creases0.obj: only the normal indices should be dropped");
+
+	LoadedObj squares = loadWithParser(directory, "smoothing-group-two-squares.obj");
+	check(squares.warn.find("out of range normal") != std::string::npos, "smoothing-group-two-squares.obj: no warning about the dropped normals");
+	check(squares.shapes.size() == 1 && squares.shapes[0].mesh.indices.size() == 9, "smoothing-group-two-squares.obj: faces missing");
+	for (const tinyobj::index_t& index : squares.shapes[0].mesh.indices)
+		check(index.normal_index == -1, "smoothing-group-two-squares.obj: normal index should be dropped");
+}
+
+//--------------------------------------------------------------------------------------------------
+// The material library name has escaped spaces, and follows names that do not load
+//
+void testEscapedMaterialLibrary(const std::string& directory) {
+	LoadedObj obj = loadWithParser(directory, "mtl filename with whitespace issue46.obj");
+	check(obj.materials.size() == 1 && obj.materials[0].name == "green", "mtl filename with whitespace issue46.obj: material library not loaded");
+	check(obj.shapes.size() == 6 && obj.shapes[1].name == "back cube", "mtl filename with whitespace issue46.obj: shapes differ");
+	for (const tinyobj::shape_t& shape : obj.shapes)
+		for (int materialId : shape.mesh.material_ids)
+			check(materialId == 0, "mtl filename with whitespace issue46.obj: faces lost their material");
+}
+
+//--------------------------------------------------------------------------------------------------
+// Group names are their tokens joined by single spaces, object names are kept as written
+//
+void testGroupNames() {
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "obj_parser_test_group_names.obj";
+	{
+		std::ofstream file(path);
+		file << "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+			<< "g back  cube\t side \r\nf 1 2 3\n"
+			<< "g front\nf 1 2 3\n"
+			<< "o named  object\nf 1 2 3\n";
+	}
+	LoadedObj expected = loadWithTinyobj(path.parent_path().string(), path.filename().string());
+	LoadedObj actual = loadWithParser(path.parent_path().string(), path.filename().string());
+	std::filesystem::remove(path);
+
+	compareWithTinyobj("group names", expected, actual);
+	check(actual.shapes.size() == 3 && actual.shapes[0].name == "back cube side", "group names: tokens are not joined by single spaces");
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cerr << "usage: obj_parser_test <tinyobjloader models directory>" << std::endl;
+		return 1;
+	}
+	std::string directory = argv[1];
+	try {
+		testSampleModels(directory);
+		testOutOfRangeIndices(directory);
+		testEscapedMaterialLibrary(directory);
+		testGroupNames();
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	std::cout << "ObjParser matches tinyobj on the sample models" << std::endl;
+	return 0;
+}
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "texture_compression.h"
+
+namespace {
+
+void check(bool condition, const std::string& message) {
+	if (!condition)
+		throw std::runtime_error(message);
+}
+
+/**
+* Reference decoders of the cooked formats, written from the BC specification and independent of
+* the encoders. Blocks hold 16 RGBA8 texels row by row.
+*/
+
+void decodeRGB565(uint16_t packed, int color[3]) {
+	int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+//Color half of BC1 and BC3, alpha is left untouched except for the transparent entry of BC1
+void decodeColorBlock(const uint8_t* block, uint8_t* rgba, bool bc1) {
+	uint16_t color0 = uint16_t(block[0] | block[1] << 8), color1 = uint16_t(block[2] | block[3] << 8);
+	int palette[4][4];
+	decodeRGB565(color0, palette[0]);
+	decodeRGB565(color1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+	for (int c = 0; c < 3; c++) {
+		if (color0 > color1 || !bc1) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+		}
+		else {
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	if (color0 <= color1 && bc1)
+		palette[3][3] = 0;
+	uint32_t indexBits = uint32_t(block[4]) | uint32_t(block[5]) << 8 | uint32_t(block[6]) << 16 | uint32_t(block[7]) << 24;
+	for (int i = 0; i < 16; i++) {
+		int index = (indexBits >> (2 * i)) & 3;
+		for (int c = 0; c < 3; c++)
+			rgba[i * 4 + c] = uint8_t(palette[index][c]);
+		if (bc1)
+			rgba[i * 4 + 3] = uint8_t(palette[index][3]);
+	}
+}
+
+void decodeBC4Block(const uint8_t* block, uint8_t* rgba, int channel) {
+	int value0 = block[0], value1 = block[1];
+	int palette[8] = { value0, value1 };
+	for (int i = 2; i < 8; i++) {
+		if (value0 > value1)
+			palette[i] = ((8 - i) * value0 + (i - 1) * value1 + 3) / 7;
+		else
+			palette[i] = i < 6 ? ((6 - i) * value0 + (i - 1) * value1 + 2) / 5 : (i == 6 ? 0 : 255);
+	}
+	uint64_t indexBits = 0;
+	for (int i = 0; i < 6; i++)
+		indexBits |= uint64_t(block[2 + i]) << (8 * i);
+	for (int i = 0; i < 16; i++)
+		rgba[i * 4 + channel] = uint8_t(palette[(indexBits >> (3 * i)) & 7]);
+}
+
+//BC7 blocks of mode 6, the only mode the cooker writes
+void decodeBC7Block(const uint8_t* block, uint8_t* rgba) {
+	int position = 0;
+	auto read = [&](int bitCount) {
+		int value = 0;
+		for (int i = 0; i < bitCount; i++, position++)
+			value |= ((block[position >> 3] >> (position & 7)) & 1) << i;
+		return value;
+	};
+	check(read(7) == 1 << 6, "BC7 block is not mode 6");
+	int endpoints[2][4];
+	for (int c = 0; c < 4; c++) {
+		endpoints[0][c] = read(7);
+		endpoints[1][c] = read(7);
+	}
+	int parity0 = read(1), parity1 = read(1);
+	const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	for (int i = 0; i < 16; i++) {
+		int index = read(i == 0 ? 3 : 4);
+		for (int c = 0; c < 4; c++) {
+			int value0 = endpoints[0][c] << 1 | parity0, value1 = endpoints[1][c] << 1 | parity1;
+			rgba[i * 4 + c] = uint8_t(((64 - weights[index]) * value0 + weights[index] * value1 + 32) >> 6);
+		}
+	}
+}
+
+//Encode and decode a block, returns the root mean square error over the channels of the format
+float roundTripError(TextureBlockFormat format, const uint8_t* rgba) {
+	uint8_t block[16] = {};
+	uint8_t decoded[64] = {};
+	int channelCount = 4;
+	switch (format) {
+	case TextureBlockFormat::BC1:
+		encodeBC1Block(rgba, block);
+		decodeColorBlock(block, decoded, true);
+		channelCount = 3;
+		break;
+	case TextureBlockFormat::BC3:
+		encodeBC3Block(rgba, block);
+		decodeBC4Block(block, decoded, 3);
+		decodeColorBlock(block + 8, decoded, false);
+		break;
+	case TextureBlockFormat::BC5:
+		encodeBC5Block(rgba, block);
+		decodeBC4Block(block, decoded, 0);
+		decodeBC4Block(block + 8, decoded, 1);
+		channelCount = 2;
+		break;
+	case TextureBlockFormat::BC7:
+		encodeBC7Block(rgba, block);
+		decodeBC7Block(block, decoded);
+		break;
+	}
+	float error = 0.0f;
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < channelCount; c++) {
+			float d = float(decoded[i * 4 + c]) - float(rgba[i * 4 + c]);
+			error += d * d;
+		}
+	}
+	return std::sqrt(error / (16.0f * channelCount));
+}
+
+const char* formatName(TextureBlockFormat format) {
+	const char* names[] = { "BC1", "BC3", "BC5", "BC7" };
+	return names[int(format)];
+}
+
+//Block of texels interpolated from one color to another along t(i)
+std::vector<uint8_t> gradientBlock(const int from[4], const int to[4], const std::function<float(int)>& t) {
+	std::vector<uint8_t> rgba(64);
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 4; c++)
+			rgba[i * 4 + c] = uint8_t(std::lround(from[c] + (to[c] - from[c]) * t(i)));
+	}
+	return rgba;
+}
+
+void checkRoundTrip(TextureBlockFormat format, const std::vector<uint8_t>& rgba, float maxError, const std::string& name) {
+	float error = roundTripError(format, rgba.data());
+	check(error <= maxError, std::string(formatName(format)) + " " + name + ": RMSE " + std::to_string(error) + " over " + std::to_string(maxError));
+}
+
+//--------------------------------------------------------------------------------------------------
+// Two color gradients, also with channels moving in opposite directions, two color blocks and flat
+// blocks. The limits of the ramps are the error of quantizing 16 steps to the 4 entries of a BC1
+// palette, the two color blocks fit the palette exactly.
+//
+void testGradients() {
+	const int red[4] = { 255, 0, 0, 255 }, green[4] = { 0, 255, 0, 255 }, blue[4] = { 0, 0, 255, 255 };
+	const int cyan[4] = { 0, 255, 255, 255 }, black[4] = { 0, 0, 0, 255 }, white[4] = { 255, 255, 255, 255 };
+	const int redOpaque[4] = { 255, 32, 0, 255 }, grayClear[4] = { 96, 96, 96, 0 };
+	auto ramp = [](int i) { return i / 15.0f; };
+	auto rows = [](int i) { return (i / 4) / 3.0f; };
+	auto checker = [](int i) { return float((i + i / 4) % 2); };
+
+	struct Case {
+		const char* name;
+		const int* from;
+		const int* to;
+		std::function<float(int)> t;
+		float maxBC1Error;   //Also the limit of the BC3 color
+		float maxBC7Error;
+	};
+	const Case cases[] = {
+		{ "red to green ramp", red, green, ramp, 20.0f, 2.0f },
+		{ "red to green rows", red, green, rows, 2.0f, 2.0f },
+		{ "red and green checker", red, green, checker, 2.0f, 2.0f },
+		{ "green to blue ramp", green, blue, ramp, 20.0f, 2.0f },
+		{ "red to cyan ramp", red, cyan, ramp, 20.0f, 2.0f },
+		{ "black to white ramp", black, white, ramp, 20.0f, 2.0f },
+		{ "red", red, red, ramp, 1.0f, 1.0f },
+		{ "cyan", cyan, cyan, ramp, 1.0f, 1.0f },
+	};
+	for (const Case& c : cases) {
+		std::vector<uint8_t> rgba = gradientBlock(c.from, c.to, c.t);
+		checkRoundTrip(TextureBlockFormat::BC1, rgba, c.maxBC1Error, c.name);
+		checkRoundTrip(TextureBlockFormat::BC3, rgba, c.maxBC1Error, c.name);
+		checkRoundTrip(TextureBlockFormat::BC7, rgba, c.maxBC7Error, c.name);
+	}
+
+	//Alpha moving against the color channels, BC7 fits alpha along the same axis as the color
+	std::vector<uint8_t> fading = gradientBlock(redOpaque, grayClear, ramp);
+	checkRoundTrip(TextureBlockFormat::BC3, fading, 12.0f, "color against alpha ramp");
+	checkRoundTrip(TextureBlockFormat::BC7, fading, 2.0f, "color against alpha ramp");
+
+	//BC5 fits its channels one by one, the limit is the error of 16 steps in 8 values
+	checkRoundTrip(TextureBlockFormat::BC5, gradientBlock(red, green, ramp), 12.0f, "red to green ramp");
+}
+
+//--------------------------------------------------------------------------------------------------
+// Random two color gradients in every direction, with a little noise
+//
+void testRandomGradients(std::mt19937& rng) {
+	std::uniform_int_distribution<int> channel(0, 255);
+	std::uniform_int_distribution<int> noise(-3, 3);
+	for (int round = 0; round < 2000; round++) {
+		int from[4], to[4];
+		for (int c = 0; c < 4; c++) {
+			from[c] = channel(rng);
+			to[c] = channel(rng);
+		}
+		std::vector<uint8_t> rgba = gradientBlock(from, to, [](int i) { return i / 15.0f; });
+		for (uint8_t& value : rgba)
+			value = uint8_t(std::clamp(int(value) + noise(rng), 0, 255));
+		std::string name = "random gradient " + std::to_string(round);
+		checkRoundTrip(TextureBlockFormat::BC1, rgba, 20.0f, name);
+		checkRoundTrip(TextureBlockFormat::BC3, rgba, 20.0f, name);
+		checkRoundTrip(TextureBlockFormat::BC7, rgba, 4.0f, name);
+	}
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	uint32_t seed = argc > 1 ? uint32_t(std::stoul(argv[1])) : 7;
+	std::mt19937 rng(seed);
+	try {
+		testGradients();
+		testRandomGradients(rng);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "seed " << seed << ": " << e.what() << std::endl;
+		return 1;
+	}
+	std::cout << "encoded blocks decode within their error bounds" << std::endl;
+	return 0;
+}
@@ -0,0 +1,137 @@
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stb_image.h>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ktx2_file.h"
+#include "texture_compression.h"
+
+namespace {
+
+//Format choice of the command line, auto picks BC1 for opaque images and BC7 otherwise
+enum class FormatOption { AUTO, BC1, BC3, BC5, BC7 };
+
+struct CookOptions {
+	FormatOption format{ FormatOption::AUTO };
+	bool srgb{ true };
+	bool generateMips{ true };
+	std::string output;
+	std::vector<std::string> inputs;
+};
+
+void printUsage() {
+	std::cout << "usage: texture_cooker [--format auto|bc1|bc3|bc5|bc7] [--linear] [--no-mips] [-o output.ktx2] input...\n"
+		<< "  Cooks images into block compressed KTX2 files with their mip chain, written next to each input\n"
+		<< "  with the extension replaced by .ktx2. The model viewer loads them instead of the source image.\n"
+		<< "  --linear stores UNORM data for non color maps, BC5 is always linear.\n";
+}
+
+bool parseOptions(int argc, char* argv[], CookOptions& options) {
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+		if (argument == "--format" && i + 1 < argc) {
+			std::string format = argv[++i];
+			if (format == "auto")
+				options.format = FormatOption::AUTO;
+			else if (format == "bc1")
+				options.format = FormatOption::BC1;
+			else if (format == "bc3")
+				options.format = FormatOption::BC3;
+			else if (format == "bc5")
+				options.format = FormatOption::BC5;
+			else if (format == "bc7")
+				options.format = FormatOption::BC7;
+			else
+				return false;
+		}
+		else if (argument == "--linear") {
+			options.srgb = false;
+		}
+		else if (argument == "--no-mips") {
+			options.generateMips = false;
+		}
+		else if (argument == "-o" && i + 1 < argc) {
+			options.output = argv[++i];
+		}
+		else if (!argument.empty() && argument[0] != '-') {
+			options.inputs.push_back(argument);
+		}
+		else {
+			return false;
+		}
+	}
+	return !options.inputs.empty() && (options.output.empty() || options.inputs.size() == 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Cook one image, prints the chosen format and the size against uncompressed RGBA8 with mips
+//
+void cookTexture(const std::string& input, const std::string& output, const CookOptions& options) {
+	auto startTime = std::chrono::high_resolution_clock::now();
+	int width, height, channels;
+	stbi_uc* pixels = stbi_load(input.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (!pixels) {
+		throw std::runtime_error("failed to load texture image " + input + "!");
+	}
+
+	TextureBlockFormat format = TextureBlockFormat::BC7;
+	switch (options.format) {
+	case FormatOption::AUTO:
+		format = hasAlpha(pixels, size_t(width) * height) ? TextureBlockFormat::BC7 : TextureBlockFormat::BC1;
+		break;
+	case FormatOption::BC1:
+		format = TextureBlockFormat::BC1;
+		break;
+	case FormatOption::BC3:
+		format = TextureBlockFormat::BC3;
+		break;
+	case FormatOption::BC5:
+		format = TextureBlockFormat::BC5;
+		break;
+	case FormatOption::BC7:
+		format = TextureBlockFormat::BC7;
+		break;
+	}
+	CompressedTexture texture = compressTexture(pixels, uint32_t(width), uint32_t(height), format, options.srgb, options.generateMips);
+	stbi_image_free(pixels);
+	writeKtx2File(output, texture);
+
+	size_t compressedBytes = 0, uncompressedBytes = 0;
+	for (size_t level = 0; level < texture.levels.size(); level++) {
+		compressedBytes += texture.levels[level].size();
+		uncompressedBytes += size_t(std::max(width >> level, 1)) * std::max(height >> level, 1) * 4;
+	}
+	const char* formatNames[] = { "BC1", "BC3", "BC5", "BC7" };
+	float milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << input << " -> " << output << ": " << width << "x" << height << " " << formatNames[static_cast<int>(format)]
+		<< (texture.srgb ? " sRGB" : " UNORM") << ", " << texture.levels.size() << " levels, " << compressedBytes / 1024 << " KB of "
+		<< uncompressedBytes / 1024 << " KB RGBA8, " << milliseconds << " ms" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+	CookOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage();
+		return 1;
+	}
+	try {
+		for (const std::string& input : options.inputs) {
+			std::string output = options.output.empty() ? std::filesystem::path(input).replace_extension(".ktx2").string() : options.output;
+			cookTexture(input, output, options);
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
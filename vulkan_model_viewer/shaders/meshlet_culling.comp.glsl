@@ -0,0 +1,101 @@
+#version 450
+
+//Culls the meshlets of the drawn material groups against the view frustum and their normal cone, and
+//writes one indexed indirect draw per meshlet. Compacted draws are appended behind the first draw of
+//their group and counted in drawCounts, otherwise every meshlet keeps its slot and culled ones are
+//drawn with no instance.
+
+layout(local_size_x = 64) in;
+
+layout(set = 0, binding = 0) uniform CameraUniformObject {
+    mat4 model;
+	mat4 view;
+	mat4 proj;
+	vec3 pos;
+	mat4 dequantize;
+} camera;
+
+struct Meshlet {
+	vec4 sphere;      //xyz center, w radius
+	vec4 cone;        //xyz axis, w cutoff, 1 if the meshlet can not face away
+	uint indexBase;
+	uint indexCount;
+	uint padding0;
+	uint padding1;
+};
+
+struct DrawCommand {
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Meshlets {
+	Meshlet meshlets[];
+};
+
+//Meshlet and draw group of every meshlet to cull
+layout(std430, set = 0, binding = 2) readonly buffer CullItems {
+	uint itemCount;
+	uint compactDraws;
+	uvec2 items[];
+};
+
+//First draw of every draw group
+layout(std430, set = 0, binding = 3) readonly buffer DrawGroups {
+	uint drawGroupBases[];
+};
+
+layout(std430, set = 0, binding = 4) writeonly buffer DrawCommands {
+	DrawCommand drawCommands[];
+};
+
+layout(std430, set = 0, binding = 5) buffer DrawCounts {
+	uint visibleTriangles;
+	uint drawCounts[];
+};
+
+bool isVisible(Meshlet meshlet) {
+	//Bounds in world space, the model matrix only translates and scales uniformly
+	vec3 center = (camera.model * vec4(meshlet.sphere.xyz, 1.0)).xyz;
+	float radius = meshlet.sphere.w * length(camera.model[0].xyz);
+
+	//Frustum planes from the rows of the view projection (Gribb and Hartmann), the near plane w + z
+	//holds for both depth ranges
+	mat4 viewProj = transpose(camera.proj * camera.view);
+	vec4 planes[6] = vec4[6](viewProj[3] + viewProj[0], viewProj[3] - viewProj[0], viewProj[3] + viewProj[1],
+		viewProj[3] - viewProj[1], viewProj[3] + viewProj[2], viewProj[3] - viewProj[2]);
+	for (int i = 0; i < 6; i++) {
+		if (dot(planes[i].xyz, center) + planes[i].w < -radius * length(planes[i].xyz))
+			return false;
+	}
+
+	//Every triangle faces away if the view direction is inside the cone around the axis
+	if (meshlet.cone.w < 1.0) {
+		vec3 axis = normalize(mat3(camera.model) * meshlet.cone.xyz);
+		vec3 toCenter = center - camera.pos;
+		if (dot(toCenter, axis) >= meshlet.cone.w * length(toCenter) + radius)
+			return false;
+	}
+	return true;
+}
+
+void main() {
+	uint item = gl_GlobalInvocationID.x;
+	if (item >= itemCount)
+		return;
+
+	Meshlet meshlet = meshlets[items[item].x];
+	uint drawGroup = items[item].y;
+	bool visible = isVisible(meshlet);
+	if (visible) {
+		atomicAdd(visibleTriangles, meshlet.indexCount / 3);
+		uint drawIndex = atomicAdd(drawCounts[drawGroup], 1);
+		if (compactDraws != 0)
+			drawCommands[drawGroupBases[drawGroup] + drawIndex] = DrawCommand(meshlet.indexCount, 1, meshlet.indexBase, 0, 0);
+	}
+	if (compactDraws == 0)
+		drawCommands[item] = DrawCommand(meshlet.indexCount, visible ? 1 : 0, meshlet.indexBase, 0, 0);
+}
@@ -1,5 +1,6 @@
 #version 450
 #extension GL_KHR_vulkan_glsl: enable
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(set = 0, binding = 0) uniform CameraUniformObject {
     mat4 model;
@@ -17,7 +18,7 @@ layout(set = 0, binding = 1) uniform LightUniformObject {
 
 layout(set = 0, binding = 2) uniform sampler2D shadow_texture;
 
-layout(set = 1, binding = 0) uniform MaterialUniformObject {
+struct MaterialData {
      vec3 ambient;
 	 vec3 diffuse;
 	 vec3 specular;
@@ -51,16 +52,24 @@ layout(set = 1, binding = 0) uniform MaterialUniformObject {
 	 int sheen_texture_ind;
 	 int emissive_texture_ind;
 	 int normal_texture_ind;
-} material;
+	 int texture_channels;     //Channel of every scalar map, two bits per texture slot
+};
 
-layout(set = 1, binding = 1) uniform sampler2D ambient_texture;
-layout(set = 1, binding = 2) uniform sampler2D diffuse_texture;
-layout(set = 1, binding = 3) uniform sampler2D specular_texture;
-layout(set = 1, binding = 4) uniform sampler2D specular_highlight_texture;
-layout(set = 1, binding = 5) uniform sampler2D bump_texture;
-layout(set = 1, binding = 6) uniform sampler2D displacement_texture;
-layout(set = 1, binding = 7) uniform sampler2D alpha_texture;
-layout(set = 1, binding = 8) uniform sampler2D reflection_texture;
+//Parameters of every material of the model, indexed by the material id of the vertices
+layout(std430, set = 1, binding = 0) readonly buffer MaterialBuffer {
+	MaterialData materials[];
+};
+
+//A material shown instead of the one of the vertices if not negative, blank models use the default one
+layout(push_constant) uniform MaterialPushConstants {
+	int materialOverride;
+} materialPush;
+
+MaterialData material;
+
+//Every loaded texture, indexed by the texture indices of the materials. Index 0 is the empty texture
+//of materials without the map.
+layout(set = 1, binding = 1) uniform sampler2D textures[];
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
@@ -71,6 +80,41 @@ layout(location = 5) in vec4 inShadowCoord;
 
 layout(location = 0) out vec4 outColor;
 
+//Texture slots of the scalar maps in texture_channels
+const int ALPHA_TEXTURE_SLOT = 6;
+const int ROUGHNESS_TEXTURE_SLOT = 8;
+const int METALLIC_TEXTURE_SLOT = 9;
+
+//Textures differ between the fragments of a draw, the index has to be marked as non uniform
+vec4 sampleTexture(int textureIndex) {
+	return texture(textures[nonuniformEXT(textureIndex)], fragTexCoord);
+}
+
+//Scalar maps are single channel textures or one channel of a packed texture
+float sampleScalarTexture(int textureIndex, int slot) {
+	return sampleTexture(textureIndex)[(material.texture_channels >> (2 * slot)) & 3];
+}
+
+//Normal maps are two channel textures of the tangent space x and y, the tangent frame is built from
+//the derivatives of the position and the texture coordinates since the vertices have no tangents
+vec3 perturbNormal(vec3 normal) {
+	vec2 xy = sampleTexture(material.normal_texture_ind).rg * 2.0 - 1.0;
+	vec3 tangentNormal = vec3(xy, sqrt(max(0.0, 1.0 - dot(xy, xy))));
+
+	vec3 dp1 = dFdx(inPosition);
+	vec3 dp2 = dFdy(inPosition);
+	vec2 duv1 = dFdx(fragTexCoord);
+	vec2 duv2 = dFdy(fragTexCoord);
+	vec3 dp2perp = cross(dp2, normal);
+	vec3 dp1perp = cross(normal, dp1);
+	vec3 t = dp2perp * duv1.x + dp1perp * duv2.x;
+	vec3 b = dp2perp * duv1.y + dp1perp * duv2.y;
+	float invmax = inversesqrt(max(dot(t, t), dot(b, b)));
+	if (isinf(invmax))
+		return normal;
+	return normalize(mat3(t * invmax, b * invmax, normal) * tangentNormal);
+}
+
 float shadowMap(vec4 shadowCoord, vec2 off)
 {   
 	float shadow = 1.0;
@@ -110,26 +154,52 @@ float filterPCF(vec4 sc)
 
 
 void main() {
+	material = materials[materialPush.materialOverride < 0 ? inMaterialId : materialPush.materialOverride];
+
+	if (material.alpha_texture_ind != 0 && sampleScalarTexture(material.alpha_texture_ind, ALPHA_TEXTURE_SLOT) < 0.5)
+		discard;
+
 	vec3 normal = normalize(inNormal);
+	if (material.normal_texture_ind != 0)
+		normal = perturbNormal(normal);
 
 	vec4 kd = {0.0f, 0.0f, 0.0f, 0.0f};
 	if (material.diffuse_texture_ind != 0)
-		kd = texture(diffuse_texture, fragTexCoord);
+		kd = sampleTexture(material.diffuse_texture_ind);
 	else
 		kd = vec4(material.diffuse, 1.0f);
 
 	vec4 ks = {0.0f, 0.0f, 0.0f, 0.0f};
 	if (material.specular_texture_ind != 0)
-		ks = texture(specular_texture, fragTexCoord);
+		ks = sampleTexture(material.specular_texture_ind);
 	else
 		ks = vec4(material.specular, 1.0f);
 
 	vec4 ka = {0.0f, 0.0f, 0.0f, 0.0f};
 	if (material.ambient_texture_ind != 0)
-		ka = texture(ambient_texture, fragTexCoord);
+		ka = sampleTexture(material.ambient_texture_ind);
 	else
 		ka = vec4(material.ambient, 1.0f);
 
+	//Metals reflect with their base color and have no diffuse term
+	if (material.metallic_texture_ind != 0) {
+		float metallic = sampleScalarTexture(material.metallic_texture_ind, METALLIC_TEXTURE_SLOT);
+		ks = mix(ks, kd, metallic);
+		kd *= 1.0 - metallic;
+	}
+
+	//Roughness maps give the Blinn-Phong exponent matching their GGX roughness
+	float specularExponent = 150;
+	if (material.roughness_texture_ind != 0) {
+		float roughness = sampleScalarTexture(material.roughness_texture_ind, ROUGHNESS_TEXTURE_SLOT);
+		float alpha = max(roughness * roughness, 0.01);
+		specularExponent = 2.0 / (alpha * alpha) - 2.0;
+	}
+
+	vec4 ke = {0.0f, 0.0f, 0.0f, 0.0f};
+	if (material.emissive_texture_ind != 0)
+		ke = sampleTexture(material.emissive_texture_ind);
+
 	float shadow = filterPCF(inShadowCoord / inShadowCoord.w);
 
 	vec3 vL = normalize(light.pos - inPosition);
@@ -137,8 +207,8 @@ void main() {
     vec3 h = normalize((vC + vL) / 2);
     float d_light = length(vL);
     vec4 L_d = vec4(light.color, 1.0f) / (d_light * d_light) * kd * max(0, dot(vL, normal));
-    vec4 L_s = vec4(light.color, 1.0f) / (d_light * d_light) * ks * pow(max(0, dot(h, normal)), 150);
+    vec4 L_s = vec4(light.color, 1.0f) / (d_light * d_light) * ks * pow(max(0, dot(h, normal)), specularExponent);
     vec4 L_a = vec4(light.color, 1.0f) * ka * kd;
 	//outColor = vec3(kd.x, kd.y, kd.z);
-	outColor = (L_d + L_s) * shadow + L_a;
+	outColor = (L_d + L_s) * shadow + L_a + ke;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #version 450
 #extension GL_KHR_vulkan_glsl: enable
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(set = 0, binding = 0) uniform CameraUniformObject {
     mat4 model;
@@ -17,7 +18,7 @@ layout(set = 0, binding = 1) uniform LightUniformObject {
 
 layout(set = 0, binding = 2) uniform sampler2D shadow_texture;
 
-layout(set = 1, binding = 0) uniform MaterialUniformObject {
+struct MaterialData {
      vec3 ambient;
 	 vec3 diffuse;
 	 vec3 specular;
@@ -51,16 +52,24 @@ layout(set = 1, binding = 0) uniform MaterialUniformObject {
 	 int sheen_texture_ind;
 	 int emissive_texture_ind;
 	 int normal_texture_ind;
-} material;
+	 int texture_channels;     //Channel of every scalar map, two bits per texture slot
+};
 
-layout(set = 1, binding = 1) uniform sampler2D ambient_texture;
-layout(set = 1, binding = 2) uniform sampler2D diffuse_texture;
-layout(set = 1, binding = 3) uniform sampler2D specular_texture;
-layout(set = 1, binding = 4) uniform sampler2D specular_highlight_texture;
-layout(set = 1, binding = 5) uniform sampler2D bump_texture;
-layout(set = 1, binding = 6) uniform sampler2D displacement_texture;
-layout(set = 1, binding = 7) uniform sampler2D alpha_texture;
-layout(set = 1, binding = 8) uniform sampler2D reflection_texture;
+//Parameters of every material of the model, indexed by the material id of the vertices
+layout(std430, set = 1, binding = 0) readonly buffer MaterialBuffer {
+	MaterialData materials[];
+};
+
+//A material shown instead of the one of the vertices if not negative, blank models use the default one
+layout(push_constant) uniform MaterialPushConstants {
+	int materialOverride;
+} materialPush;
+
+MaterialData material;
+
+//Every loaded texture, indexed by the texture indices of the materials. Index 0 is the empty texture
+//of materials without the map.
+layout(set = 1, binding = 1) uniform sampler2D textures[];
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
@@ -71,6 +80,19 @@ layout(location = 5) in vec4 inShadowCoord;
 
 layout(location = 0) out vec4 outColor;
 
+//Texture slot of the alpha map (map_d) in texture_channels
+const int ALPHA_TEXTURE_SLOT = 6;
+
+//Textures differ between the fragments of a draw, the index has to be marked as non uniform
+vec4 sampleTexture(int textureIndex) {
+	return texture(textures[nonuniformEXT(textureIndex)], fragTexCoord);
+}
+
+//Scalar maps are single channel textures or one channel of a packed texture
+float sampleScalarTexture(int textureIndex, int slot) {
+	return sampleTexture(textureIndex)[(material.texture_channels >> (2 * slot)) & 3];
+}
+
 float shadowMap(vec4 shadowCoord, vec2 off)
 {   
 	float shadow = 1.0;
@@ -110,29 +132,38 @@ float filterPCF(vec4 sc)
 
 
 void main() {
+	material = materials[materialPush.materialOverride < 0 ? inMaterialId : materialPush.materialOverride];
+
+	if (material.alpha_texture_ind != 0 && sampleScalarTexture(material.alpha_texture_ind, ALPHA_TEXTURE_SLOT) < 0.5)
+		discard;
+
 	vec3 normal = normalize(inNormal);
 
 	vec4 kd = {0.0f, 0.0f, 0.0f, 0.0f};
 	if (material.diffuse_texture_ind != 0)
-		kd = texture(diffuse_texture, fragTexCoord);
+		kd = sampleTexture(material.diffuse_texture_ind);
 	else
 		kd = vec4(material.diffuse, 1.0f);
 
 	vec4 ks = {0.0f, 0.0f, 0.0f, 0.0f};
 	if (material.specular_texture_ind != 0)
-		ks = texture(specular_texture, fragTexCoord);
+		ks = sampleTexture(material.specular_texture_ind);
 	else
 		ks = vec4(material.specular, 1.0f);
 
 	vec4 ka = {0.0f, 0.0f, 0.0f, 0.0f};
 	if (material.ambient_texture_ind != 0)
-		ka = texture(ambient_texture, fragTexCoord);
+		ka = sampleTexture(material.ambient_texture_ind);
 	else
 		ka = vec4(material.ambient, 1.0f);
 
+	vec4 ke = {0.0f, 0.0f, 0.0f, 0.0f};
+	if (material.emissive_texture_ind != 0)
+		ke = sampleTexture(material.emissive_texture_ind);
+
 	float shadow = filterPCF(inShadowCoord / inShadowCoord.w);
 
     vec4 L_d = kd;
     vec4 L_a = ka * kd;
-	outColor = L_d * shadow + L_a;
+	outColor = L_d * shadow + L_a + ke;
 }
\ No newline at end of file
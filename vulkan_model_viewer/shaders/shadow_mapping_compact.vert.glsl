@@ -0,0 +1,14 @@
+#version 450
+
+layout(binding = 0) uniform LightUniformObject {
+    vec3 pos;
+	vec3 color;
+	mat4 mvp;
+} light;
+
+layout(location = 0) in vec3 inPosition;      //Quantized in the model bounds
+
+//The model matrix in light.mvp dequantizes the position
+void main (){
+    gl_Position = light.mvp * vec4(inPosition, 1.0f);
+}
\ No newline at end of file
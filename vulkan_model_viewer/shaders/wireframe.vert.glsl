@@ -8,10 +8,7 @@ layout(set = 0, binding = 0) uniform CameraUniformObject {
 } camera;
 
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
-layout(location = 2) in vec2 inTexCoord;
 layout(location = 3) in vec3 inNormal;
-layout(location = 4) in int inMaterialId;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
@@ -22,9 +19,9 @@ layout(location = 5) out vec4 shadowTexCoord;
 
 void main() {
 	gl_Position = camera.proj * camera.view * camera.model * vec4(inPosition + inNormal * 0.001, 1.0);
-	fragColor = inColor;
-    fragTexCoord = inTexCoord;
+	fragColor = vec3(0.0);
+    fragTexCoord = vec2(0.0);
     outPosition = inPosition;
     outNormal = inNormal;
-	outMaterialId = inMaterialId;
+	outMaterialId = 0;
 }
\ No newline at end of file
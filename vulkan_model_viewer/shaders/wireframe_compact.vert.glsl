@@ -0,0 +1,37 @@
+#version 450
+
+layout(set = 0, binding = 0) uniform CameraUniformObject {
+    mat4 model;
+	mat4 view;
+	mat4 proj;
+	vec3 pos;
+	mat4 dequantize;
+} camera;
+
+layout(location = 0) in vec3 inPosition;      //Quantized in the model bounds
+layout(location = 3) in vec2 inNormal;        //Octahedral encoded
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 outPosition;
+layout(location = 3) out vec3 outNormal;
+layout(location = 4) out int outMaterialId;
+layout(location = 5) out vec4 shadowTexCoord;
+
+vec3 octahedralDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+void main() {
+	vec3 position = (camera.dequantize * vec4(inPosition, 1.0)).xyz;
+	vec3 normal = octahedralDecode(inNormal);
+	gl_Position = camera.proj * camera.view * camera.model * vec4(position + normal * 0.001, 1.0);
+	fragColor = vec3(0.0);
+    fragTexCoord = vec2(0.0);
+    outPosition = position;
+    outNormal = normal;
+	outMaterialId = 0;
+}
\ No newline at end of file
@@ -51,6 +51,10 @@ void VulkanAppBase::createVulkanContext() {
 	contextCreateInfo.addPhysicalDeviceFeatureRequirement(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, "samplerAnisotropy");
 	contextCreateInfo.addPhysicalDeviceFeatureRequirement(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES, "multiviewGeometryShader");
 	contextCreateInfo.addPhysicalDeviceFeatureRequirement(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES, "imagelessFramebuffer");
+	//Materials sample a descriptor indexed array of every texture
+	contextCreateInfo.addPhysicalDeviceFeatureRequirement(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES, "shaderSampledImageArrayNonUniformIndexing");
+	contextCreateInfo.addPhysicalDeviceFeatureRequirement(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES, "runtimeDescriptorArray");
+	contextCreateInfo.addPhysicalDeviceFeatureRequirement(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES, "descriptorBindingPartiallyBound");
 
 	// Init Vulkan instance
 	vkimpl::VulkanContext context;
@@ -70,15 +74,21 @@ void VulkanAppBase::createVulkanContext() {
 	m_computeQueue = context.m_computeQueue;
 	m_transferQueue = context.m_transferQueue;
 	m_debugMessenger = context.m_debugMessenger;
+	m_deviceFeatures = context.m_physicalFeaturesStructChain.features;
+	m_deviceFeatures12 = context.m_features12;
+	m_deviceFeatures12.pNext = nullptr;
 
 	//Vulkan helper
-	m_debugUtil = vkimpl::VulkanDebugUtil(m_instance, m_device);
+	m_memoryAllocator.init(m_physicalDevice, m_device);
+	m_debugUtil = vkimpl::VulkanDebugUtil(m_instance, m_device, &m_memoryAllocator.m_tracker);
 	m_commandUtil = vkimpl::VulkanCommands(m_device);
-	m_imageUtil = vkimpl::VulkanImages(m_physicalDevice, m_device);
-	m_bufferUtil = vkimpl::VulkanBuffers(m_physicalDevice, m_device);
+	m_imageUtil = vkimpl::VulkanImages(m_physicalDevice, m_device, VK_NULL_HANDLE, VK_NULL_HANDLE, {}, &m_memoryAllocator);
+	m_bufferUtil = vkimpl::VulkanBuffers(m_physicalDevice, m_device, VK_NULL_HANDLE, VK_NULL_HANDLE, &m_memoryAllocator);
 	m_renderPassUtil = vkimpl::VulkanRenderPass(m_device);
 	m_descriptorUtil = vkimpl::VulkanDescriptorSets(m_device);
 	m_pipelineUtil = vkimpl::VulkanPipeline(m_device);
+	m_uploader.init(m_physicalDevice, m_device, m_transferQueue, m_queueFamilyIndices.transferFamily.value(), m_graphicsQueue, m_queueFamilyIndices.graphicsFamily.value(),
+		&m_memoryAllocator);
 }
 
 //--------------------------------------------
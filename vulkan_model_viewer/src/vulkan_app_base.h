@@ -8,6 +8,9 @@
 #include "vulkan_commands.h"
 #include "vulkan_images.h"
 #include "vulkan_buffers.h"
+#include "vulkan_memory.h"
+#include "vulkan_uploader.h"
+#include "vulkan_uniform_ring.h"
 #include "vulkan_renderpass.h"
 #include "vulkan_descriptorsets.h"
 #include "vulkan_pipelines.h"
@@ -35,6 +38,10 @@ public:
 	VkPhysicalDevice m_physicalDevice;
 	VkDevice m_device;
 
+	//Features enabled on the device
+	VkPhysicalDeviceFeatures m_deviceFeatures{};
+	VkPhysicalDeviceVulkan12Features m_deviceFeatures12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+
 	//Vulkan queues and queue family index
 	vkimpl::QueueFamilyIndices m_queueFamilyIndices;
 	VkQueue m_graphicsQueue;
@@ -50,6 +57,12 @@ public:
 	std::vector<VkImage> m_swapchainImages;
 	std::vector<VkImageView> m_swapchainImageViews;
 
+	//Device memory allocator the image and buffer helpers suballocate from
+	vkimpl::VulkanMemoryAllocator m_memoryAllocator;
+
+	//Uploads buffer and image data through a staging ring, copies on the transfer queue and blits on the graphics queue
+	vkimpl::VulkanUploader m_uploader;
+
 	//Helpers
 	vkimpl::VulkanDebugUtil m_debugUtil;
 	vkimpl::VulkanCommands m_commandUtil;
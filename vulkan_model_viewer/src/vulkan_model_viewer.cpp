@@ -10,6 +10,71 @@ const std::string SOURCE_PATH = std::string(SOURCE_DIR);
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+//Version of the model cache content, bump when a cached record layout changes.
+//Load options that change the cached data are added by getModelCacheVersion.
+const uint32_t MODEL_CACHE_VERSION = 5;
+
+//Levels of detail: each level aims at half the triangles of the one before and is dropped if it
+//keeps more than LOD_MIN_REDUCTION of them. Groups smaller than LOD_MIN_GROUP_TRIANGLES stay as they are.
+const size_t MAX_SHAPE_LOD_LEVELS = 8;
+const float LOD_MIN_REDUCTION = 0.85f;
+const size_t LOD_MIN_GROUP_TRIANGLES = 64;
+const int LOD_MAX_BUDGET_STEPS = 16;
+const float CAMERA_FOV_DEGREES = 60.0f;
+
+//Texture streaming: a frame submits up to TEXTURE_STREAM_FRAME_BYTES of mip levels in one upload, with
+//at most TEXTURE_STREAM_MAX_BATCHES uploads in flight. Cooked levels up to TEXTURE_STREAM_TAIL_SIZE
+//texels go in the first step of a texture. New levels are shown at most every TEXTURE_VIEW_UPDATE_INTERVAL_MS.
+const VkDeviceSize TEXTURE_STREAM_FRAME_BYTES = 32ull << 20;
+const size_t TEXTURE_STREAM_MAX_BATCHES = 2;
+const uint32_t TEXTURE_STREAM_TAIL_SIZE = 64;
+const double TEXTURE_VIEW_UPDATE_INTERVAL_MS = 100.0;
+//Texture residency: the levels of cooked textures are selected from their size on screen under the texture
+//budget at most every TEXTURE_RESIDENCY_INTERVAL_MS. The automatic budget is TEXTURE_BUDGET_HEAP_SHARE of
+//the budget of the device local heap, less the memory it holds outside textures.
+const double TEXTURE_RESIDENCY_INTERVAL_MS = 250.0;
+const double TEXTURE_BUDGET_HEAP_SHARE = 0.75;
+//Textures and cooked mip levels are counted at this alignment in the staging ring, a multiple of every
+//texel block size. Cooked levels are copied in rows of TEXTURE_BLOCK_EXTENT texels.
+const VkDeviceSize TEXTURE_STAGING_ALIGNMENT = 16;
+const uint32_t TEXTURE_BLOCK_EXTENT = 4;
+
+//Upload benchmark: bytes uploaded to a device local buffer in chunks of UPLOAD_BENCHMARK_CHUNK_SIZE
+const VkDeviceSize UPLOAD_BENCHMARK_BYTES = 256ull << 20;
+const VkDeviceSize UPLOAD_BENCHMARK_CHUNK_SIZE = 1ull << 20;
+
+//Frame attachments: passes of a frame in their order, for the lifetimes of the render targets, and the
+//resolutions their memory is reported at
+const uint32_t SHADOW_PASS = 0;
+const uint32_t SCENE_PASS = 1;
+const uint32_t WIREFRAME_PASS = 2;
+const VkExtent2D ATTACHMENT_REPORT_RESOLUTIONS[] = { { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+
+//Memory report: JSON file written by the Tools window, allocations listed in the Information window
+const std::string MEMORY_REPORT_PATH = "memory_report.json";
+const size_t MEMORY_REPORT_GUI_ALLOCATIONS = 32;
+
+//Meshlets: vertex and triangle limits of a meshlet and the workgroup size of the culling pass
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+const uint32_t MESHLET_CULLING_WORKGROUP_SIZE = 64;
+
+//Draw recording: the draws of an object pass are split into secondary command buffers across up to
+//MAX_DRAW_RECORD_WORKERS workers, each recording at least DRAW_RECORD_MIN_WORKER_DRAWS draws. Smaller
+//passes are recorded inline in their primary command buffer.
+const size_t MAX_DRAW_RECORD_WORKERS = 16;
+const size_t DRAW_RECORD_MIN_WORKER_DRAWS = 1024;
+//The draw recording benchmark records every object pass DRAW_RECORD_BENCHMARK_ROUNDS times per thread count
+const int DRAW_RECORD_BENCHMARK_ROUNDS = 5;
+
+//Materials: the material buffer holds at least MIN_MATERIAL_BUFFER_CAPACITY MaterialUBOs. The scene
+//pipelines get the material to show as a push constant, NO_MATERIAL_OVERRIDE reads it from the vertices.
+const size_t MIN_MATERIAL_BUFFER_CAPACITY = 256;
+const int NO_MATERIAL_OVERRIDE = -1;
+//The texture array of the material set holds at most MAX_BINDLESS_TEXTURES textures, less if the
+//device limits are lower
+const uint32_t MAX_BINDLESS_TEXTURES = 16384;
+
 const std::string SCENE_VERT_SHADER_PATH = SOURCE_PATH + "shaders/scene.vert.glsl.spv";
 const std::string SCENE_FRAG_SHADER_PATH = SOURCE_PATH + "shaders/scene.frag.glsl.spv";
 
@@ -22,6 +87,19 @@ const std::string SCENE_WIREFRAME_FRAG_SHADER_PATH = SOURCE_PATH + "shaders/wire
 const std::string SHADOW_MAPPING_VERT_SHADER_PATH = SOURCE_PATH + "shaders/shadow_mapping.vert.glsl.spv";
 const std::string SHADOW_MAPPING_FRAG_SHADER_PATH = SOURCE_PATH + "shaders/shadow_mapping.frag.glsl.spv";
 
+const std::string MESHLET_CULLING_COMP_SHADER_PATH = SOURCE_PATH + "shaders/meshlet_culling.comp.glsl.spv";
+
+//Vertex streams read by the pipelines
+const uint32_t SCENE_VERTEX_STREAMS = (1u << VulkanModelViewer::VERTEX_STREAM_COUNT) - 1;
+const uint32_t WIREFRAME_VERTEX_STREAMS = 1u << VulkanModelViewer::POSITION_STREAM | 1u << VulkanModelViewer::NORMAL_STREAM;
+const uint32_t SHADOW_VERTEX_STREAMS = 1u << VulkanModelViewer::POSITION_STREAM;
+
+//Vertex shaders reading CompactVertex, the fragment shaders are shared
+const std::string SCENE_COMPACT_VERT_SHADER_PATH = SOURCE_PATH + "shaders/scene_compact.vert.glsl.spv";
+const std::string SCENE_NO_LIHGTING_COMPACT_VERT_SHADER_PATH = SOURCE_PATH + "shaders/scene_no_lighting_compact.vert.glsl.spv";
+const std::string SCENE_WIREFRAME_COMPACT_VERT_SHADER_PATH = SOURCE_PATH + "shaders/wireframe_compact.vert.glsl.spv";
+const std::string SHADOW_MAPPING_COMPACT_VERT_SHADER_PATH = SOURCE_PATH + "shaders/shadow_mapping_compact.vert.glsl.spv";
+
 /**
 * run
 */
@@ -102,10 +180,10 @@ void VulkanModelViewer::initDefaultMaterial() {
 	Material defaultMat = {};
 	defaultMat.diffuse = { 0.5f, 0.5f, 0.5f };
 	updateMaterialUbo(defaultMat);
-
-	_materialCache.push_back(defaultMat);
-	_uniformBuffers.materialUniformBuffers.push_back(getMaterialUniformBuffer(defaultMat));
-	_descriptorSets.materialDescriptorSets.push_back(getMaterialDescriptorSet(defaultMat, _uniformBuffers.materialUniformBuffers.back().buffer));
+	addMaterial(defaultMat);
+	updateMaterialDescriptors();
+	//The graphics queue acquires the material buffer before the first frame reads it
+	m_uploader.finishTransfers();
 }
 
 
@@ -178,6 +256,12 @@ void VulkanModelViewer::createSceneRenderPass() {
 	renderPassCreateInfo.colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 	_renderPasses.sceneRenderPass = m_renderPassUtil.createRenderPass(renderPassCreateInfo);
 	m_debugUtil.setObjectName(_renderPasses.sceneRenderPass, "SceneRenderPass");
+
+	//Compatible with the scene pass, its framebuffers and pipelines are shared
+	renderPassCreateInfo.colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	renderPassCreateInfo.depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	_renderPasses.sceneLastRenderPass = m_renderPassUtil.createRenderPass(renderPassCreateInfo);
+	m_debugUtil.setObjectName(_renderPasses.sceneLastRenderPass, "SceneLastRenderPass");
 }
 
 //--------------------------------------------
@@ -191,6 +275,8 @@ void VulkanModelViewer::createWireframeRenderPass() {
 	renderPassCreateInfo.colorAttachment.samples = m_msaaSamples;
 	renderPassCreateInfo.depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
 	renderPassCreateInfo.depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	renderPassCreateInfo.colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	renderPassCreateInfo.depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	renderPassCreateInfo.depthAttachment.format = _defaultDepthFormat;
 	renderPassCreateInfo.depthAttachment.samples = m_msaaSamples;
 	renderPassCreateInfo.colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -235,35 +321,32 @@ void VulkanModelViewer::createGuiRenderPass() {
 void VulkanModelViewer::initImageResources() {
 	createPresentImageResources();
 
-	//Shadow image
-	vkimpl::VulkanImageInfo shadowDepthInfo = getImageInfo(DEPTH_IMAGE);
-	shadowDepthInfo.extent.width = m_shadowMapExtent.width;
-	shadowDepthInfo.extent.height = m_shadowMapExtent.height;
-	shadowDepthInfo.numSamples = VK_SAMPLE_COUNT_1_BIT;
-	shadowDepthInfo.usage = shadowDepthInfo.usage | VK_IMAGE_USAGE_SAMPLED_BIT;
-	_imageResources.shadowDepth = getImageResource(shadowDepthInfo);
+	//Shadow image, the scene pass samples it so it overlaps the scene targets and is never aliased
+	_imageResources.shadowDepth = getImageResource(getShadowDepthInfo());
 	m_debugUtil.setObjectName(_imageResources.shadowDepth.image, "shadowDepthImage");
 	m_debugUtil.setObjectName(_imageResources.shadowDepth.imageMemory, "shadowDepthImageMemory");
 	m_debugUtil.setObjectName(_imageResources.shadowDepth.imageView, "shadowDepthImageView");
 
-	//Default shadow image
-	vkimpl::VulkanImageInfo defaultShadowDepthInfo = getImageInfo(DEPTH_IMAGE);
-	defaultShadowDepthInfo.extent.width = m_shadowMapExtent.width;
-	defaultShadowDepthInfo.extent.height = m_shadowMapExtent.height;
-	defaultShadowDepthInfo.numSamples = VK_SAMPLE_COUNT_1_BIT;
-	defaultShadowDepthInfo.usage = defaultShadowDepthInfo.usage | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	//Default shadow image, a single far depth texel reads the same as a cleared shadow map
+	vkimpl::VulkanImageInfo defaultShadowDepthInfo = getShadowDepthInfo();
+	defaultShadowDepthInfo.extent.width = 1;
+	defaultShadowDepthInfo.extent.height = 1;
+	defaultShadowDepthInfo.usage = defaultShadowDepthInfo.usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
-	std::vector<float> pixels(m_shadowMapExtent.width * m_shadowMapExtent.height * 4, 1.0f);
-	VkDeviceSize imageSize = pixels.size();
+	//Depth is cleared to the far plane on the graphics queue, transfer queues cannot write depth
 	m_imageUtil.setOperationInfo(_commandPool, m_graphicsQueue, defaultShadowDepthInfo);
 	m_imageUtil.createImage(_imageResources.defaultShadowDepth.image, _imageResources.defaultShadowDepth.imageMemory);
-	m_imageUtil.fillImagePixels(_imageResources.defaultShadowDepth.image, pixels.data(), imageSize, VK_IMAGE_LAYOUT_UNDEFINED, defaultShadowDepthInfo.aspectFlags);
-	m_imageUtil.transitionImageLayout(_imageResources.defaultShadowDepth.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	VkCommandBuffer graphicsCommandBuffer = m_uploader.getGraphicsCommandBuffer();
+	m_imageUtil.recordTransitionImageLayout(graphicsCommandBuffer, _imageResources.defaultShadowDepth.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	VkClearDepthStencilValue farDepth = { 1.0f, 0 };
+	VkImageSubresourceRange depthRange = { defaultShadowDepthInfo.aspectFlags, 0, 1, 0, 1 };
+	vkCmdClearDepthStencilImage(graphicsCommandBuffer, _imageResources.defaultShadowDepth.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &farDepth, 1, &depthRange);
+	m_imageUtil.recordTransitionImageLayout(graphicsCommandBuffer, _imageResources.defaultShadowDepth.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	_imageResources.defaultShadowDepth.imageView = m_imageUtil.createImageView(_imageResources.defaultShadowDepth.image);//Create the texture image view
 
-	m_debugUtil.setObjectName(_imageResources.defaultShadowDepth.image, "shadowDepthImage");
-	m_debugUtil.setObjectName(_imageResources.defaultShadowDepth.imageMemory, "shadowDepthImageMemory");
-	m_debugUtil.setObjectName(_imageResources.defaultShadowDepth.imageView, "shadowDepthImageView");
+	m_debugUtil.setObjectName(_imageResources.defaultShadowDepth.image, "defaultShadowDepthImage");
+	m_debugUtil.setObjectName(_imageResources.defaultShadowDepth.imageMemory, "defaultShadowDepthImageMemory");
+	m_debugUtil.setObjectName(_imageResources.defaultShadowDepth.imageView, "defaultShadowDepthImageView");
 
 	//Create the empty texture and change its layout to shader optimal
 	vkimpl::VulkanImageInfo emptyTextureInfo = getImageInfo(TEXTURE_IMAGE);
@@ -274,63 +357,1110 @@ void VulkanModelViewer::initImageResources() {
 	ImageResource emptyTexture{};
 	m_imageUtil.setOperationInfo(_commandPool, m_graphicsQueue, emptyTextureInfo);
 	m_imageUtil.createImage(emptyTexture.image, emptyTexture.imageMemory);
-	m_imageUtil.transitionImageLayout(emptyTexture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	m_imageUtil.recordTransitionImageLayout(m_uploader.getGraphicsCommandBuffer(), emptyTexture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	emptyTexture.imageView = m_imageUtil.createImageView(emptyTexture.image);
 	_textureResources.push_back(emptyTexture);
+	_textureImageOwners.push_back(0);
 	_texturePaths.push_back("empty_texture");
 	m_debugUtil.setObjectName(_textureResources[0].image, "emptyTextureImage");
 	m_debugUtil.setObjectName(_textureResources[0].imageMemory, "emptyTextureImageMemory");
 	m_debugUtil.setObjectName(_textureResources[0].imageView, "emptyTextureImageView");
+
+	//Create the placeholder of streamed textures, a mid grey texel also reads as a flat normal and
+	//an opaque alpha
+	vkimpl::VulkanImageInfo placeholderTextureInfo = emptyTextureInfo;
+	placeholderTextureInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+	placeholderTextureInfo.mipLevels = 1;
+	uint8_t placeholderTexel[4] = { 128, 128, 128, 255 };
+	ImageResource& placeholderTexture = _imageResources.placeholderTexture;
+	m_imageUtil.setOperationInfo(_commandPool, m_graphicsQueue, placeholderTextureInfo);
+	m_imageUtil.createImage(placeholderTexture.image, placeholderTexture.imageMemory);
+	VkImageSubresourceRange placeholderRange = { placeholderTextureInfo.aspectFlags, 0, 1, 0, 1 };
+	m_uploader.prepareImage(placeholderTexture.image, placeholderRange);
+	m_uploader.uploadImageLevel(placeholderTexture.image, placeholderTextureInfo.aspectFlags, 0, placeholderTextureInfo.extent, placeholderTexel, sizeof(placeholderTexel));
+	m_uploader.releaseImage(placeholderTexture.image, placeholderRange, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	placeholderTexture.imageView = m_imageUtil.createImageView(placeholderTexture.image);
+	m_debugUtil.setObjectName(placeholderTexture.image, "placeholderTextureImage");
+	m_debugUtil.setObjectName(placeholderTexture.imageMemory, "placeholderTextureImageMemory");
+	m_debugUtil.setObjectName(placeholderTexture.imageView, "placeholderTextureImageView");
+
+	//The first frame samples these images, the graphics queue acquires them before it
+	m_uploader.finishTransfers();
+
+	reportAttachmentMemory();
 }
 
 //--------------------------------------------
-// Create the color and depth images and image views for present
+// Create the color and depth images and image views for present, in the memory planned for them
 //
 void VulkanModelViewer::createPresentImageResources() {
-	vkimpl::VulkanImageInfo sceneColorInfo = getImageInfo(COLOR_IMAGE);
-	_imageResources.sceneColor = getImageResource(sceneColorInfo);
-	m_debugUtil.setObjectName(_imageResources.sceneColor.image, "sceneColorImage");
-	m_debugUtil.setObjectName(_imageResources.sceneColor.imageMemory, "sceneColorImageMemory");
-	m_debugUtil.setObjectName(_imageResources.sceneColor.imageView, "sceneColorImageView");
+	AttachmentPlan plan = createFrameAttachments(getPresentAttachments(m_swapchainExtent), _presentAttachmentMemory);
+	_presentAttachmentReport = { m_swapchainExtent, plan.requestedBytes, plan.plannedBytes - plan.lazyBytes, plan.lazyBytes, plan.groups.size() };
+}
+
+//--------------------------------------------------------------------------------------------------
+// Image info of the shadow map
+//
+vkimpl::VulkanImageInfo VulkanModelViewer::getShadowDepthInfo() {
+	vkimpl::VulkanImageInfo shadowDepthInfo = getImageInfo(DEPTH_IMAGE);
+	shadowDepthInfo.extent.width = m_shadowMapExtent.width;
+	shadowDepthInfo.extent.height = m_shadowMapExtent.height;
+	shadowDepthInfo.numSamples = VK_SAMPLE_COUNT_1_BIT;
+	shadowDepthInfo.usage = shadowDepthInfo.usage | VK_IMAGE_USAGE_SAMPLED_BIT;
+	return shadowDepthInfo;
+}
 
+//--------------------------------------------------------------------------------------------------
+// Multisampled scene targets at a resolution. They are written by the scene pass and loaded by the
+// wireframe pass at most, their contents never leave the render passes.
+//
+std::vector<VulkanModelViewer::FrameAttachment> VulkanModelViewer::getPresentAttachments(VkExtent2D extent) {
+	vkimpl::VulkanImageInfo sceneColorInfo = getImageInfo(COLOR_IMAGE);
+	sceneColorInfo.extent.width = extent.width;
+	sceneColorInfo.extent.height = extent.height;
 	vkimpl::VulkanImageInfo sceneDepthInfo = getImageInfo(DEPTH_IMAGE);
-	_imageResources.sceneDepth = getImageResource(sceneDepthInfo);
-	m_debugUtil.setObjectName(_imageResources.sceneDepth.image, "sceneDepthImage");
-	m_debugUtil.setObjectName(_imageResources.sceneDepth.imageMemory, "sceneDepthImageMemory");
-	m_debugUtil.setObjectName(_imageResources.sceneDepth.imageView, "sceneDepthImageView");
+	sceneDepthInfo.extent.width = extent.width;
+	sceneDepthInfo.extent.height = extent.height;
+	sceneDepthInfo.usage = sceneDepthInfo.usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+	return {
+		{ &_imageResources.sceneColor, sceneColorInfo, SCENE_PASS, WIREFRAME_PASS, "sceneColor" },
+		{ &_imageResources.sceneDepth, sceneDepthInfo, SCENE_PASS, WIREFRAME_PASS, "sceneDepth" }
+	};
+}
+
+//--------------------------------------------------------------------------------------------------
+// Create the images of the attachments without memory and plan their memory. Transient attachments
+// are lazy where the device has lazily allocated memory for them.
+//
+AttachmentPlan VulkanModelViewer::planFrameAttachments(const std::vector<FrameAttachment>& attachments, std::vector<VkImage>& images) {
+	images.resize(attachments.size());
+	std::vector<AttachmentRequest> requests(attachments.size());
+	for (size_t i = 0; i < attachments.size(); i++) {
+		m_imageUtil.setImageInfo(attachments[i].imageInfo);
+		m_imageUtil.createUnboundImage(images[i]);
+		VkMemoryRequirements memoryRequirements;
+		vkGetImageMemoryRequirements(m_device, images[i], &memoryRequirements);
+		requests[i].size = memoryRequirements.size;
+		requests[i].alignment = memoryRequirements.alignment;
+		requests[i].memoryTypeBits = memoryRequirements.memoryTypeBits;
+		requests[i].firstPass = attachments[i].firstPass;
+		requests[i].lastPass = attachments[i].lastPass;
+		requests[i].lazy = (attachments[i].imageInfo.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+			&& m_memoryAllocator.hasMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+	}
+	return planAttachmentMemory(requests);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Create the attachments in the memory planned for them, one allocation per group of the plan
+//
+AttachmentPlan VulkanModelViewer::createFrameAttachments(const std::vector<FrameAttachment>& attachments, std::vector<vkimpl::MemoryAllocation>& memory) {
+	std::vector<VkImage> images;
+	AttachmentPlan plan = planFrameAttachments(attachments, images);
+	memory.resize(plan.groups.size());
+	for (size_t g = 0; g < plan.groups.size(); g++) {
+		const AttachmentPlan::Group& group = plan.groups[g];
+		size_t first = std::find(plan.attachmentGroups.begin(), plan.attachmentGroups.end(), static_cast<uint32_t>(g)) - plan.attachmentGroups.begin();
+		VkMemoryRequirements memoryRequirements{ group.size, group.alignment, group.memoryTypeBits };
+		VkMemoryPropertyFlags properties = attachments[first].imageInfo.properties;
+		if (group.lazy && m_memoryAllocator.hasMemoryType(group.memoryTypeBits, properties | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+			properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+		memory[g] = m_memoryAllocator.allocateSharedMemory(memoryRequirements, properties,
+			vkimpl::VulkanMemoryTracker::imageCategory(attachments[first].imageInfo.usage), (uint64_t)images[first]);
+		m_debugUtil.setObjectName(memory[g], "FrameAttachmentMemory[" + std::to_string(g) + "]");
+	}
+	for (size_t i = 0; i < attachments.size(); i++) {
+		const vkimpl::MemoryAllocation& groupMemory = memory[plan.attachmentGroups[i]];
+		vkBindImageMemory(m_device, images[i], groupMemory.memory, groupMemory.offset + plan.attachmentOffsets[i]);
+		ImageResource& resource = *attachments[i].resource;
+		resource = ImageResource{ images[i], {}, VK_NULL_HANDLE };
+		m_imageUtil.setImageInfo(attachments[i].imageInfo);
+		resource.imageView = m_imageUtil.createImageView(resource.image);
+		m_debugUtil.setObjectName(resource.image, attachments[i].name + "Image");
+		m_debugUtil.setObjectName(resource.imageView, attachments[i].name + "ImageView");
+	}
+	return plan;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Plan the render targets of a frame, the shadow map included, at common resolutions and print the
+// memory saved against separate allocations and the full size default shadow map
+//
+void VulkanModelViewer::reportAttachmentMemory() {
+	vkimpl::VulkanImageInfo fullDefaultShadowInfo = getShadowDepthInfo();
+	fullDefaultShadowInfo.usage = fullDefaultShadowInfo.usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	VkImage fullDefaultShadow;
+	m_imageUtil.setImageInfo(fullDefaultShadowInfo);
+	m_imageUtil.createUnboundImage(fullDefaultShadow);
+	VkMemoryRequirements fullDefaultShadowRequirements;
+	vkGetImageMemoryRequirements(m_device, fullDefaultShadow, &fullDefaultShadowRequirements);
+	vkDestroyImage(m_device, fullDefaultShadow, nullptr);
+
+	_attachmentMemoryReports.clear();
+	for (const VkExtent2D& extent : ATTACHMENT_REPORT_RESOLUTIONS) {
+		std::vector<FrameAttachment> attachments = getPresentAttachments(extent);
+		attachments.push_back({ nullptr, getShadowDepthInfo(), SHADOW_PASS, SCENE_PASS, "shadowDepth" });
+		std::vector<VkImage> images;
+		AttachmentPlan plan = planFrameAttachments(attachments, images);
+		for (VkImage image : images)
+			vkDestroyImage(m_device, image, nullptr);
+
+		AttachmentMemoryReport report{ extent, plan.requestedBytes + fullDefaultShadowRequirements.size,
+			plan.plannedBytes - plan.lazyBytes + _imageResources.defaultShadowDepth.imageMemory.size, plan.lazyBytes, plan.groups.size() };
+		_attachmentMemoryReports.push_back(report);
+		std::cout << "Frame attachments at " << extent.width << "x" << extent.height << ": " << report.separateBytes / (1024.0 * 1024.0)
+			<< " MB in separate allocations, " << report.committedBytes / (1024.0 * 1024.0) << " MB committed in " << report.groupCount
+			<< " planned allocation(s) (" << report.lazyBytes / (1024.0 * 1024.0) << " MB lazily allocated), "
+			<< (report.separateBytes - report.committedBytes) / (1024.0 * 1024.0) << " MB saved" << std::endl;
+	}
 }
 
 //--------------------------------------------
-// Create texture images
+// Start loading the textures queued by loadTexture. Textures whose files have the same contents as
+// an earlier texture of the model share its image, the files are compared when their hashes match. The others show the placeholder texture and are
+// decoded on a worker thread, streamTextures uploads their mip levels over the following frames.
+//
+void VulkanModelViewer::loadPendingTextures() {
+	if (_pendingTextures.empty())
+		return;
+	auto loadStartTime = std::chrono::high_resolution_clock::now();
+
+	//Hash the files of every texture, a texture whose files can't be read is never shared and fails
+	//to decode below
+	std::vector<uint64_t> contentHashes(_pendingTextures.size(), 0);
+	std::vector<char> contentHashed(_pendingTextures.size(), 0);
+	parallel_for(_pendingTextures.size(), [&](size_t i) {
+		try {
+			contentHashes[i] = hashTextureContents(_pendingTextures[i]);
+			contentHashed[i] = 1;
+		}
+		catch (const std::exception&) {
+		}
+	});
+	std::vector<size_t> decodeIndices;
+	for (size_t i = 0; i < _pendingTextures.size(); i++) {
+		int textureIndex = _pendingTextures[i].textureIndex;
+		int owner = textureIndex;
+		if (contentHashed[i]) {
+			auto candidates = _textureContents.equal_range(contentHashes[i]);
+			for (auto candidate = candidates.first; candidate != candidates.second; ++candidate) {
+				if (sameTextureContents(candidate->second, _pendingTextures[i])) {
+					owner = candidate->second.textureIndex;
+					break;
+				}
+			}
+			if (owner == textureIndex)
+				_textureContents.emplace(contentHashes[i], _pendingTextures[i]);
+		}
+		if (owner == textureIndex) {
+			_textureResources[textureIndex] = _imageResources.placeholderTexture;
+			_textureImageOwners[textureIndex] = 0;
+			decodeIndices.push_back(i);
+			continue;
+		}
+
+		//Duplicates use the image of their owner, updateStreamedTextureViews keeps them in step with it
+		_textureResources[textureIndex] = _textureResources[owner];
+		_textureImageOwners[textureIndex] = owner;
+		_modelLoadStats.duplicateTextureCount++;
+	}
+	auto hashEndTime = std::chrono::high_resolution_clock::now();
+	_modelLoadStats.textureHashMilliseconds += std::chrono::duration<double, std::chrono::milliseconds::period>(hashEndTime - loadStartTime).count();
+
+	//Decode on a worker thread, the textures of an earlier call keep their index in _decodingTextures
+	if (_textureDecodeThread.joinable())
+		_textureDecodeThread.join();
+	size_t firstIndex = _decodingTextures.size();
+	for (size_t i : decodeIndices)
+		_decodingTextures.push_back(_pendingTextures[i]);
+	_pendingTextures.clear();
+	if (decodeIndices.empty())
+		return;
+	if (!_texturesStreaming) {
+		_texturesStreaming = true;
+		_textureStreamStartTime = hashEndTime;
+		_textureViewUpdateTime = hashEndTime;
+	}
+	_texturesDecoding += decodeIndices.size();
+	size_t decodeCount = decodeIndices.size();
+	_textureDecodeThread = std::thread([this, firstIndex, decodeCount]() {
+		parallel_for(decodeCount, [&](size_t i) {
+			if (_cancelTextureDecode)
+				return;
+			DecodedTexture texture = decodeTexture(firstIndex + i);
+			std::lock_guard<std::mutex> lock(_decodedTextureMutex);
+			_decodedTextures.push_back(texture);
+			_textureDecodeEndTime = std::chrono::high_resolution_clock::now();
+		});
+	});
+}
+
+//--------------------------------------------------------------------------------------------------
+// Decode a texture of _decodingTextures, runs on the decode workers. Cooked textures are mapped
+// instead of decoded and come with their mip chains, a cooked file next to an image falls back to
+// the image if it can't be read.
+//
+VulkanModelViewer::DecodedTexture VulkanModelViewer::decodeTexture(size_t decodingIndex) {
+	DecodedTexture texture{ decodingIndex, nullptr, 0, nullptr, 0, 0, VK_FORMAT_UNDEFINED, 0 };
+	const PendingTexture& pending = _decodingTextures[decodingIndex];
+	if (!pending.cookedPath.empty()) {
+		auto cooked = std::make_shared<Ktx2Reader>();
+		if (m_deviceFeatures.textureCompressionBC && cooked->open(pending.cookedPath)) {
+			texture.cooked = cooked;
+			texture.width = static_cast<int>(cooked->width());
+			texture.height = static_cast<int>(cooked->height());
+			for (uint32_t level = 0; level < cooked->levelCount(); level++) {
+				size_t levelSize;
+				cooked->levelData(level, levelSize);
+				texture.stagingSize += align_up(levelSize, TEXTURE_STAGING_ALIGNMENT);
+			}
+		}
+	}
+	const std::string& imagePath = pending.channelSources.empty() ? pending.path : pending.channelSources[0].path;
+	if (!texture.cooked && pending.cookedPath != imagePath) {
+		if (pending.channelSources.empty()) {
+			int texChannels;
+			texture.pixels.reset(stbi_load(pending.path.c_str(), &texture.width, &texture.height, &texChannels, STBI_rgb_alpha), stbi_image_free);
+			texture.pixelBytes = texture.pixels ? size_t(texture.width) * texture.height * 4 : 0;
+			texture.format = VK_FORMAT_R8G8B8A8_SRGB;
+		}
+		else
+			decodeChannelTexture(pending.channelSources, texture);
+		texture.stagingSize = align_up(texture.pixelBytes, TEXTURE_STAGING_ALIGNMENT);
+	}
+	return texture;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Hash the files a texture is made of together with how they are loaded, so that copies of an image
+// under other names get the same hash. Throws if a file can't be read, runs on worker threads.
+//
+uint64_t VulkanModelViewer::hashTextureContents(const PendingTexture& pending) {
+	auto combine = [](uint64_t hash, uint64_t value) {
+		hash = (hash ^ value) * 0x9E3779B97F4A7C15ull;
+		return hash ^ (hash >> 29);
+	};
+	uint64_t hash = pending.cookedPath.empty() ? 0 : hashFileStream(pending.cookedPath);
+	if (pending.channelSources.empty()) {
+		hash = combine(hash, pending.cookedPath == pending.path ? 0 : hashFileStream(pending.path));
+	}
+	for (const TextureChannelSource& source : pending.channelSources) {
+		hash = combine(hash, hashFileStream(source.path));
+		hash = combine(hash, std::hash<std::string>()(source.channels));
+	}
+	return combine(hash, pending.channelSources.size());
+}
+
+//--------------------------------------------------------------------------------------------------
+// Compare the files of two textures with the same content hash byte by byte, and how they are
+// loaded, so a hash collision never shares an image between different textures. Files that can't
+// be read anymore are not the same.
+//
+bool VulkanModelViewer::sameTextureContents(const PendingTexture& pending0, const PendingTexture& pending1) {
+	if (pending0.cookedPath.empty() != pending1.cookedPath.empty() || pending0.channelSources.size() != pending1.channelSources.size())
+		return false;
+	try {
+		if (!pending0.cookedPath.empty() && !sameFileContents(pending0.cookedPath, pending1.cookedPath))
+			return false;
+		if (pending0.channelSources.empty()) {
+			bool imageHashed0 = pending0.cookedPath != pending0.path, imageHashed1 = pending1.cookedPath != pending1.path;
+			if (imageHashed0 != imageHashed1 || (imageHashed0 && !sameFileContents(pending0.path, pending1.path)))
+				return false;
+		}
+		for (size_t i = 0; i < pending0.channelSources.size(); i++) {
+			const TextureChannelSource& source0 = pending0.channelSources[i];
+			const TextureChannelSource& source1 = pending1.channelSources[i];
+			if (source0.channels != source1.channels || !sameFileContents(source0.path, source1.path))
+				return false;
+		}
+	}
+	catch (const std::exception&) {
+		return false;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Decode the images of a channel texture and gather their channels, three channels are padded with
+// an opaque alpha. Images of another size than the first one are sampled at the nearest texel.
+// Leaves the texels empty if an image can't be decoded, runs on the decode workers.
+//
+void VulkanModelViewer::decodeChannelTexture(const std::vector<TextureChannelSource>& sources, DecodedTexture& texture) {
+	size_t channelCount = 0;
+	for (const TextureChannelSource& source : sources)
+		channelCount += source.channels.size();
+	if (channelCount == 0 || channelCount > 4)
+		return;
+	size_t texelBytes = channelCount == 3 ? 4 : channelCount;
+
+	size_t outputChannel = 0;
+	for (const TextureChannelSource& source : sources) {
+		int width, height, fileChannels;
+		stbi_uc* image = stbi_load(source.path.c_str(), &width, &height, &fileChannels, STBI_rgb_alpha);
+		if (!image) {
+			texture.pixels.reset();
+			texture.pixelBytes = 0;
+			return;
+		}
+		if (!texture.pixels) {
+			texture.width = width;
+			texture.height = height;
+			texture.pixelBytes = size_t(width) * height * texelBytes;
+			texture.pixels.reset(new uint8_t[texture.pixelBytes], std::default_delete<uint8_t[]>());
+			memset(texture.pixels.get(), 255, texture.pixelBytes);
+		}
+
+		//'m' is the alpha of images with a translucent texel, luminance is weighted like stb does
+		bool matteIsAlpha = (fileChannels == 2 || fileChannels == 4) && source.channels.find('m') != std::string::npos
+			&& hasAlpha(image, size_t(width) * height);
+		for (char channel : source.channels) {
+			int sourceChannel = channel == 'r' ? 0 : channel == 'g' ? 1 : channel == 'b' ? 2 : channel == 'a' || (channel == 'm' && matteIsAlpha) ? 3 : -1;
+			uint8_t* output = texture.pixels.get() + outputChannel++;
+			for (int y = 0; y < texture.height; y++) {
+				const stbi_uc* row = image + size_t(int64_t(y) * height / texture.height) * width * 4;
+				for (int x = 0; x < texture.width; x++) {
+					const stbi_uc* texel = row + size_t(int64_t(x) * width / texture.width) * 4;
+					output[(size_t(y) * texture.width + x) * texelBytes] = sourceChannel >= 0 ? texel[sourceChannel]
+						: static_cast<uint8_t>((texel[0] * 77 + texel[1] * 150 + texel[2] * 29) >> 8);
+				}
+			}
+		}
+		stbi_image_free(image);
+	}
+	texture.format = channelCount == 1 ? VK_FORMAT_R8_UNORM : channelCount == 2 ? VK_FORMAT_R8G8_UNORM : VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Advance the texture streaming, called once per frame after the uploader ran the callbacks of the
+// finished uploads, which make their levels resident. Decoded textures get their images, the levels
+// of cooked textures are selected under the texture budget and the next levels are submitted, the
+// coarse levels of every texture before the finer ones. Resident levels are shown at most every
+// TEXTURE_VIEW_UPDATE_INTERVAL_MS since each update records the object passes again. The residency
+// keeps running once every texture is loaded.
+//
+void VulkanModelViewer::streamTextures() {
+	if (!_texturesStreaming && _streamingTextures.empty())
+		return;
+	auto streamStartTime = std::chrono::high_resolution_clock::now();
+
+	//Create the images of the textures decoded since the last frame
+	std::vector<DecodedTexture> decoded;
+	{
+		std::lock_guard<std::mutex> lock(_decodedTextureMutex);
+		decoded.swap(_decodedTextures);
+		if (!decoded.empty())
+			_modelLoadStats.textureDecodeMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(_textureDecodeEndTime - _textureStreamStartTime).count();
+	}
+	_texturesDecoding -= decoded.size();
+	std::string failedPath;
+	for (DecodedTexture& texture : decoded) {
+		if (!texture.pixels && !texture.cooked) {
+			failedPath = failedPath.empty() ? _decodingTextures[texture.pendingIndex].path : failedPath;
+			continue;
+		}
+		createStreamingTexture(texture);
+	}
+
+	//Select the levels of the cooked textures, new ones get their images right away
+	if (_textureResidencyPending
+		|| std::chrono::duration<double, std::chrono::milliseconds::period>(streamStartTime - _textureResidencyTime).count() >= TEXTURE_RESIDENCY_INTERVAL_MS) {
+		updateTextureResidency();
+		_textureResidencyTime = streamStartTime;
+	}
+
+	//Submit the next step of the textures with the coarsest levels left
+	if (_textureUploadsInFlight < TEXTURE_STREAM_MAX_BATCHES) {
+		std::vector<std::pair<uint32_t, size_t>> steps;   //Size of the finest level of the step and streaming texture
+		for (size_t i = 0; i < _streamingTextures.size(); i++) {
+			const StreamingTexture& streaming = _streamingTextures[i];
+			if (streaming.image.image == VK_NULL_HANDLE || streaming.submittedLevel == streaming.image.baseLevel)
+				continue;
+			VkDeviceSize stepBytes;
+			uint32_t level = getTextureStreamLevel(streaming, stepBytes);
+			steps.push_back({ std::max(streaming.imageInfo.extent.width, streaming.imageInfo.extent.height) >> level, i });
+		}
+		std::sort(steps.begin(), steps.end());
+		std::vector<size_t> batchTextures;
+		VkDeviceSize batchBytes = 0;
+		for (const auto& step : steps) {
+			VkDeviceSize stepBytes;
+			getTextureStreamLevel(_streamingTextures[step.second], stepBytes);
+			if (!batchTextures.empty() && batchBytes + stepBytes > TEXTURE_STREAM_FRAME_BYTES)
+				break;
+			batchTextures.push_back(step.second);
+			batchBytes += stepBytes;
+		}
+		if (!batchTextures.empty())
+			submitTextureUploads(batchTextures);
+	}
+
+	//Show the resident levels, and the images replacing others once their levels are copied
+	bool viewsChanged = false;
+	bool allSubmitted = _texturesDecoding == 0;
+	for (const StreamingTexture& streaming : _streamingTextures) {
+		if (streaming.retiredImage.image != VK_NULL_HANDLE)
+			viewsChanged = viewsChanged || streaming.residentLevel < streaming.imageInfo.mipLevels;
+		else
+			viewsChanged = viewsChanged || streaming.residentLevel < streaming.viewLevel;
+		allSubmitted = allSubmitted && streaming.image.image != VK_NULL_HANDLE && streaming.submittedLevel == streaming.image.baseLevel;
+	}
+	bool streamingDone = allSubmitted && _textureUploadsInFlight == 0;
+	auto viewUpdateTime = std::chrono::high_resolution_clock::now();
+	if (viewsChanged && (streamingDone
+		|| std::chrono::duration<double, std::chrono::milliseconds::period>(viewUpdateTime - _textureViewUpdateTime).count() >= TEXTURE_VIEW_UPDATE_INTERVAL_MS)) {
+		updateStreamedTextureViews();
+		_textureViewUpdateTime = viewUpdateTime;
+	}
+
+	if (!_texturesStreaming)
+		return;
+	auto streamEndTime = std::chrono::high_resolution_clock::now();
+	_modelLoadStats.textureUploadMilliseconds += std::chrono::duration<double, std::chrono::milliseconds::period>(streamEndTime - streamStartTime).count();
+	if (streamingDone) {
+		_texturesStreaming = false;
+		_modelLoadStats.textureStreamMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(streamEndTime - _textureStreamStartTime).count();
+		printTextureStats();
+		printMemoryStats();
+		printUploadStats();
+	}
+	if (!failedPath.empty()) {
+		throw std::runtime_error("failed to load texture image " + failedPath + "!");
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Start streaming a decoded texture. Decoded textures get an image with their whole mip chain, the
+// image of a cooked texture is created by the next residency update. No level is filled yet.
+//
+void VulkanModelViewer::createStreamingTexture(DecodedTexture& texture) {
+	StreamingTexture streaming{};
+	streaming.textureIndex = _decodingTextures[texture.pendingIndex].textureIndex;
+	vkimpl::VulkanImageInfo& imageInfo = streaming.imageInfo;
+	imageInfo = getImageInfo(TEXTURE_IMAGE);
+	imageInfo.extent.width = texture.width;
+	imageInfo.extent.height = texture.height;
+	imageInfo.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texture.width, texture.height)))) + 1;
+	imageInfo.format = texture.format;
+	if (texture.cooked) {
+		imageInfo.format = static_cast<VkFormat>(texture.cooked->vkFormat());
+		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.mipLevels = texture.cooked->levelCount();
+	}
+	streaming.image = ImageResource{ VK_NULL_HANDLE, {}, VK_NULL_HANDLE };
+	streaming.retiredImage = ImageResource{ VK_NULL_HANDLE, {}, VK_NULL_HANDLE };
+	streaming.memorySize = 0;
+	streaming.submittedLevel = imageInfo.mipLevels;
+	streaming.residentLevel = imageInfo.mipLevels;
+	streaming.viewLevel = imageInfo.mipLevels;
+
+	//Bytes of the levels from each level on, the first upload step of a cooked texture is its mip tail
+	streaming.chainBytes.assign(imageInfo.mipLevels, 0);
+	VkDeviceSize texelBytes = texture.pixelBytes / (VkDeviceSize(texture.width) * texture.height);
+	for (uint32_t level = imageInfo.mipLevels; level-- > 0;) {
+		size_t levelSize = VkDeviceSize(std::max(texture.width >> level, 1)) * std::max(texture.height >> level, 1) * texelBytes;
+		if (texture.cooked)
+			texture.cooked->levelData(level, levelSize);
+		streaming.chainBytes[level] = levelSize + (level + 1 < imageInfo.mipLevels ? streaming.chainBytes[level + 1] : 0);
+	}
+	streaming.tailLevel = 0;
+	if (texture.cooked) {
+		streaming.tailLevel = imageInfo.mipLevels - 1;
+		while (streaming.tailLevel > 0 && std::max(texture.width >> (streaming.tailLevel - 1), texture.height >> (streaming.tailLevel - 1)) <= static_cast<int>(TEXTURE_STREAM_TAIL_SIZE))
+			streaming.tailLevel--;
+	}
+	streaming.targetLevel = streaming.tailLevel;
+
+	VkDeviceSize mipTexels = 0;
+	for (uint32_t level = 0; level < imageInfo.mipLevels; level++)
+		mipTexels += VkDeviceSize(std::max(texture.width >> level, 1)) * std::max(texture.height >> level, 1);
+	if (texture.cooked) {
+		_modelLoadStats.textureImageBytes += streaming.chainBytes[0];
+		_modelLoadStats.cookedTextureCount++;
+	}
+	else
+		_modelLoadStats.textureImageBytes += mipTexels * texelBytes;
+	_modelLoadStats.textureRGBA8Bytes += mipTexels * 4;
+	_modelLoadStats.textureBytes += texture.stagingSize;
+	_modelLoadStats.textureCount++;
+
+	bool cooked = texture.cooked != nullptr;
+	streaming.texture = std::move(texture);
+	_streamingTextures.push_back(std::move(streaming));
+	if (cooked)
+		_textureResidencyPending = true;
+	else
+		resizeStreamingTexture(_streamingTextures.size() - 1, 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Get the first level of the next upload step of a streaming texture and its staging size. Cooked
+// textures upload their levels up to TEXTURE_STREAM_TAIL_SIZE texels in one step and every finer
+// level in a step of its own, down to the first level of their image. Decoded textures upload their
+// first level in one step, the GPU builds the rest of the chain from it.
+//
+uint32_t VulkanModelViewer::getTextureStreamLevel(const StreamingTexture& streaming, VkDeviceSize& stagingSize) {
+	const DecodedTexture& texture = streaming.texture;
+	if (!texture.cooked) {
+		stagingSize = texture.stagingSize;
+		return 0;
+	}
+	uint32_t firstLevel = streaming.submittedLevel - 1;
+	if (streaming.submittedLevel == streaming.imageInfo.mipLevels)
+		firstLevel = std::max(streaming.tailLevel, streaming.image.baseLevel);
+	stagingSize = 0;
+	for (uint32_t level = firstLevel; level < streaming.submittedLevel; level++) {
+		size_t levelSize;
+		texture.cooked->levelData(level, levelSize);
+		stagingSize += align_up(levelSize, TEXTURE_STAGING_ALIGNMENT);
+	}
+	return firstLevel;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Submit the next upload step of streaming textures through the uploader, in one submission unless
+// the levels fill the staging ring. The levels become resident when the upload finished. The texels
+// of a decoded texture are released once its last step is staged, cooked levels stay mapped for the
+// residency to stream them in again.
+//
+void VulkanModelViewer::submitTextureUploads(const std::vector<size_t>& streamingIndices) {
+	std::vector<std::pair<size_t, uint32_t>> levels;   //Streaming textures and the finest level filled for them
+	for (size_t streamingIndex : streamingIndices) {
+		StreamingTexture& streaming = _streamingTextures[streamingIndex];
+		const DecodedTexture& texture = streaming.texture;
+		VkImage image = streaming.image.image;
+		uint32_t baseLevel = streaming.image.baseLevel;
+		VkDeviceSize stepBytes;
+		uint32_t firstLevel = getTextureStreamLevel(streaming, stepBytes);
+		m_imageUtil.setOperationInfo(_commandPool, m_graphicsQueue, getStreamingImageInfo(streaming, baseLevel));
+		if (texture.cooked) {
+			VkImageSubresourceRange levelRange = { streaming.imageInfo.aspectFlags, firstLevel - baseLevel, streaming.submittedLevel - firstLevel, 0, 1 };
+			m_uploader.prepareImage(image, levelRange);
+			for (uint32_t level = firstLevel; level < streaming.submittedLevel; level++) {
+				size_t levelSize;
+				const uint8_t* levelData = texture.cooked->levelData(level, levelSize);
+				VkExtent3D levelExtent = { std::max(streaming.imageInfo.extent.width >> level, 1u), std::max(streaming.imageInfo.extent.height >> level, 1u), 1 };
+				m_uploader.uploadImageLevel(image, streaming.imageInfo.aspectFlags, level - baseLevel, levelExtent, levelData, levelSize, TEXTURE_BLOCK_EXTENT);
+			}
+			m_uploader.releaseImage(image, levelRange, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		}
+		else {
+			//The first level is copied on the transfer queue, the blits of the others need the graphics queue
+			VkImageSubresourceRange firstLevelRange = { streaming.imageInfo.aspectFlags, 0, 1, 0, 1 };
+			m_uploader.prepareImage(image, firstLevelRange);
+			m_uploader.uploadImageLevel(image, streaming.imageInfo.aspectFlags, 0, streaming.imageInfo.extent, texture.pixels.get(), texture.pixelBytes);
+			m_uploader.releaseImage(image, firstLevelRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+			VkCommandBuffer graphicsCommandBuffer = m_uploader.getGraphicsCommandBuffer();
+			if (streaming.imageInfo.mipLevels > 1)
+				m_imageUtil.recordTransitionImageLayout(graphicsCommandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1);
+			m_imageUtil.recordGenerateMipmaps(graphicsCommandBuffer, image);
+		}
+		streaming.submittedLevel = firstLevel;
+		levels.push_back({ streamingIndex, firstLevel });
+		if (streaming.submittedLevel == 0)
+			streaming.texture.pixels.reset();
+	}
+
+	_textureUploadsInFlight++;
+	m_uploader.submit([this, levels]() {
+		for (const auto& level : levels) {
+			StreamingTexture& streaming = _streamingTextures[level.first];
+			streaming.residentLevel = std::min(streaming.residentLevel, level.second);
+		}
+		_textureUploadsInFlight--;
+	});
+	_modelLoadStats.textureUploadBatches++;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Replace the image views of streaming textures by views of their resident levels and update the
+// descriptor sets of the materials using them. The old views and the images replaced by others are
+// retired until the frames in flight finished. Without update after bind the object passes are
+// recorded again, and the device is waited for since the descriptor sets are bound in them.
+//
+void VulkanModelViewer::updateStreamedTextureViews() {
+	if (!_bindlessTextures.updateAfterBind)
+		vkDeviceWaitIdle(m_device);
+	std::unordered_set<int> changedTextures;   //Texture indices of the changed streaming textures
+	for (size_t i = 0; i < _streamingTextures.size(); i++) {
+		StreamingTexture& streaming = _streamingTextures[i];
+		bool replaced = streaming.retiredImage.image != VK_NULL_HANDLE;
+		if (replaced ? streaming.residentLevel == streaming.imageInfo.mipLevels : streaming.residentLevel >= streaming.viewLevel)
+			continue;
+		m_imageUtil.setOperationInfo(_commandPool, m_graphicsQueue, getStreamingImageInfo(streaming, streaming.image.baseLevel));
+		VkImageView imageView = m_imageUtil.createImageView(streaming.image.image, streaming.residentLevel - streaming.image.baseLevel);
+		if (streaming.image.imageView != VK_NULL_HANDLE)
+			_retiredTextureResources.push_back({ _submittedFrameCount, ImageResource{ VK_NULL_HANDLE, {}, streaming.image.imageView } });
+		if (replaced) {
+			_retiredTextureResources.push_back({ _submittedFrameCount, streaming.retiredImage });
+			streaming.retiredImage = ImageResource{ VK_NULL_HANDLE, {}, VK_NULL_HANDLE };
+		}
+		streaming.image.imageView = imageView;
+		streaming.viewLevel = streaming.residentLevel;
+		_textureResources[streaming.textureIndex] = streaming.image;
+		_textureImageOwners[streaming.textureIndex] = streaming.textureIndex;
+		changedTextures.insert(streaming.textureIndex);
+	}
+
+	//Duplicates follow the texture owning their image
+	std::vector<char> textureChanged(_textureResources.size(), 0);
+	for (size_t i = 1; i < _textureResources.size(); i++) {
+		if (changedTextures.count(_textureImageOwners[i]) == 0)
+			continue;
+		_textureResources[i] = _textureResources[_textureImageOwners[i]];
+		textureChanged[i] = 1;
+	}
+
+	for (size_t i = 1; i < _bindlessTextures.writtenCount; i++) {
+		if (textureChanged[i])
+			updateTextureDescriptors(i, 1);
+	}
+	//Update after bind entries change under the recorded passes, the device is idle otherwise
+	if (!_bindlessTextures.updateAfterBind)
+		beginObjectRenderPasses();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Destroy the texture views and images retired by updateStreamedTextureViews whose frames finished
+//
+void VulkanModelViewer::destroyRetiredTextureResources() {
+	size_t keptCount = 0;
+	for (const auto& retired : _retiredTextureResources) {
+		if (retired.first > _finishedFrameCount)
+			_retiredTextureResources[keptCount++] = retired;
+		else if (retired.second.image == VK_NULL_HANDLE)
+			vkDestroyImageView(m_device, retired.second.imageView, nullptr);
+		else
+			destroyImageResource(retired.second);
+	}
+	_retiredTextureResources.resize(keptCount);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Image info of the image of a streaming texture holding the levels from baseLevel on
+//
+vkimpl::VulkanImageInfo VulkanModelViewer::getStreamingImageInfo(const StreamingTexture& streaming, uint32_t baseLevel) {
+	vkimpl::VulkanImageInfo imageInfo = streaming.imageInfo;
+	imageInfo.extent.width = std::max(imageInfo.extent.width >> baseLevel, 1u);
+	imageInfo.extent.height = std::max(imageInfo.extent.height >> baseLevel, 1u);
+	imageInfo.mipLevels -= baseLevel;
+	return imageInfo;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Texels every streaming texture needs across its largest side: the largest projected diameter in
+// pixels of the shapes drawn with it, as if the texture covered each shape once. Textures of models
+// without shapes need their full size.
+//
+std::vector<float> VulkanModelViewer::getTextureScreenTexels() {
+	std::vector<float> screenTexels(_streamingTextures.size(), 0.0f);
+	if (_shapes.empty()) {
+		for (size_t i = 0; i < _streamingTextures.size(); i++)
+			screenTexels[i] = static_cast<float>(std::max(_streamingTextures[i].imageInfo.extent.width, _streamingTextures[i].imageInfo.extent.height));
+		return screenTexels;
+	}
+
+	//Duplicates are drawn with the image of the texture owning it
+	std::vector<int> streamingIndices(_textureResources.size(), -1);
+	for (size_t i = 0; i < _streamingTextures.size(); i++)
+		streamingIndices[_streamingTextures[i].textureIndex] = static_cast<int>(i);
+	auto getStreamingIndex = [&](int textureIndex) {
+		if (textureIndex <= 0 || textureIndex >= static_cast<int>(_textureResources.size()))
+			return -1;
+		int owner = _textureImageOwners[textureIndex] > 0 ? _textureImageOwners[textureIndex] : textureIndex;
+		return streamingIndices[owner];
+	};
+
+	//Pixels covered by one model unit at distance one, as in selectShapeLods
+	float pixelsPerUnit = m_swapchainExtent.height / (2.0f * std::tan(glm::radians(CAMERA_FOV_DEGREES) / 2.0f));
+	float screenPixels = static_cast<float>(std::max(m_swapchainExtent.width, m_swapchainExtent.height));
+	for (const Shape& shape : _shapes) {
+		float distance = std::max(glm::length(_camera.pos - (shape.center - _modelCenter)) - shape.radius, 0.1f);
+		float pixels = std::min(2.0f * shape.radius * pixelsPerUnit / distance, screenPixels);
+		for (const MaterialGroup& group : shape.materialGroups) {
+			if (group.materialId < 0 || group.materialId >= static_cast<int>(_materialCache.size()))
+				continue;
+			const Material& material = _materialCache[group.materialId];
+			for (int textureIndex : { material.ambient_texture_ind, material.diffuse_texture_ind, material.specular_texture_ind,
+				material.specular_highlight_texture_ind, material.bump_texture_ind, material.displacement_texture_ind, material.alpha_texture_ind,
+				material.reflection_texture_ind, material.roughness_texture_ind, material.metallic_texture_ind, material.sheen_texture_ind,
+				material.emissive_texture_ind, material.normal_texture_ind }) {
+				int streamingIndex = getStreamingIndex(textureIndex);
+				if (streamingIndex >= 0)
+					screenTexels[streamingIndex] = std::max(screenTexels[streamingIndex], pixels);
+			}
+		}
+	}
+	return screenTexels;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Image memory of the textures: _textureBudgetMB, or TEXTURE_BUDGET_HEAP_SHARE of the budget of the
+// largest device local heap less what it holds outside textures. The heap size stands in for the
+// budget without VK_EXT_memory_budget.
+//
+VkDeviceSize VulkanModelViewer::getTextureBudget() {
+	if (_textureBudgetMB > 0)
+		return VkDeviceSize(_textureBudgetMB) << 20;
+	vkimpl::MemoryReport report = m_memoryAllocator.m_tracker.getReport();
+	const vkimpl::MemoryHeapReport* deviceHeap = nullptr;
+	for (const vkimpl::MemoryHeapReport& heap : report.heaps) {
+		if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && (deviceHeap == nullptr || heap.size > deviceHeap->size))
+			deviceHeap = &heap;
+	}
+	if (deviceHeap == nullptr)
+		return 0;
+	VkDeviceSize textureBytes = report.categoryBytes[static_cast<size_t>(vkimpl::MemoryCategory::Textures)];
+	VkDeviceSize otherBytes = deviceHeap->trackedBytes - std::min(deviceHeap->trackedBytes, textureBytes);
+	VkDeviceSize heapShare = static_cast<VkDeviceSize>((report.budgetSupported ? deviceHeap->budget : deviceHeap->size) * TEXTURE_BUDGET_HEAP_SHARE);
+	return heapShare > otherBytes ? heapShare - otherBytes : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Select the levels of the cooked textures under the texture budget from their size on screen, and
+// replace the images whose levels changed. Textures being filled or replaced keep their image until
+// a later update. Decoded textures keep every level, their images are taken from the budget first.
+//
+void VulkanModelViewer::updateTextureResidency() {
+	auto selectStartTime = std::chrono::high_resolution_clock::now();
+	_textureResidencyPending = false;
+	std::vector<float> screenTexels = getTextureScreenTexels();
+	std::vector<TextureResidencyInput> inputs;
+	std::vector<size_t> managedIndices;
+	VkDeviceSize pinnedBytes = 0, neededBytes = 0, residentBytes = 0;
+	for (size_t i = 0; i < _streamingTextures.size(); i++) {
+		const StreamingTexture& streaming = _streamingTextures[i];
+		if (!streaming.texture.cooked) {
+			pinnedBytes += streaming.memorySize;
+			continue;
+		}
+		TextureResidencyInput input;
+		input.extent = std::max(streaming.imageInfo.extent.width, streaming.imageInfo.extent.height);
+		input.coarsestLevel = streaming.tailLevel;
+		input.currentLevel = streaming.image.image != VK_NULL_HANDLE ? streaming.image.baseLevel : streaming.tailLevel;
+		input.neededTexels = screenTexels[i];
+		input.chainBytes.assign(streaming.chainBytes.begin(), streaming.chainBytes.end());
+		neededBytes += streaming.chainBytes[getNeededTextureLevel(input)];
+		residentBytes += streaming.image.imageMemory.size + streaming.retiredImage.imageMemory.size;
+		inputs.push_back(std::move(input));
+		managedIndices.push_back(i);
+	}
+	VkDeviceSize budget = getTextureBudget();
+	std::vector<uint32_t> levels;
+	VkDeviceSize selectedBytes = selectTextureLevels(inputs, budget > pinnedBytes ? budget - pinnedBytes : 0, levels);
+
+	std::vector<std::pair<size_t, uint32_t>> copies;   //Streaming textures and the finest level copied into their new image
+	size_t reducedCount = 0;
+	for (size_t i = 0; i < managedIndices.size(); i++) {
+		StreamingTexture& streaming = _streamingTextures[managedIndices[i]];
+		streaming.targetLevel = levels[i];
+		reducedCount += levels[i] > getNeededTextureLevel(inputs[i]) ? 1 : 0;
+		bool idle = streaming.submittedLevel == streaming.residentLevel && streaming.retiredImage.image == VK_NULL_HANDLE;
+		if (!idle || (streaming.image.image != VK_NULL_HANDLE && streaming.image.baseLevel == levels[i]))
+			continue;
+		uint32_t copiedLevel = resizeStreamingTexture(managedIndices[i], levels[i]);
+		if (copiedLevel < streaming.imageInfo.mipLevels)
+			copies.push_back({ managedIndices[i], copiedLevel });
+	}
+	if (!copies.empty()) {
+		_textureUploadsInFlight++;
+		m_uploader.submit([this, copies]() {
+			for (const auto& copy : copies) {
+				StreamingTexture& streaming = _streamingTextures[copy.first];
+				streaming.residentLevel = std::min(streaming.residentLevel, copy.second);
+			}
+			_textureUploadsInFlight--;
+		});
+	}
+
+	_textureResidencyStats.budget = budget;
+	_textureResidencyStats.pinnedBytes = pinnedBytes;
+	_textureResidencyStats.selectedBytes = selectedBytes;
+	_textureResidencyStats.neededBytes = neededBytes;
+	_textureResidencyStats.residentBytes = residentBytes;
+	_textureResidencyStats.managedCount = managedIndices.size();
+	_textureResidencyStats.reducedCount = reducedCount;
+	_textureResidencyStats.selectMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - selectStartTime).count();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Replace the image of a streaming texture by one holding the levels from baseLevel on. The resident
+// levels both images hold are copied on the graphics queue in the open upload batch, the caller
+// submits it. The old image is shown until updateStreamedTextureViews shows the new one, and the
+// finer levels are streamed in by streamTextures. Returns the finest copied level, mipLevels if none.
+//
+uint32_t VulkanModelViewer::resizeStreamingTexture(size_t streamingIndex, uint32_t baseLevel) {
+	StreamingTexture& streaming = _streamingTextures[streamingIndex];
+	uint32_t mipLevels = streaming.imageInfo.mipLevels;
+	ImageResource oldImage = streaming.image;
+	ImageResource& image = streaming.image;
+	image = ImageResource{ VK_NULL_HANDLE, {}, VK_NULL_HANDLE, baseLevel };
+	m_imageUtil.setOperationInfo(_commandPool, m_graphicsQueue, getStreamingImageInfo(streaming, baseLevel));
+	m_imageUtil.createImage(image.image, image.imageMemory);
+	m_debugUtil.setObjectName(image.image, _texturePaths[streaming.textureIndex]);
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(m_device, image.image, &memoryRequirements);
+	streaming.memorySize = memoryRequirements.size;
+
+	//The duplicates of the texture were all registered by loadPendingTextures before it was decoded,
+	//each of them saves the size of its first image
+	if (oldImage.image == VK_NULL_HANDLE) {
+		for (size_t i = 1; i < _textureImageOwners.size(); i++) {
+			if (_textureImageOwners[i] == streaming.textureIndex && static_cast<int>(i) != streaming.textureIndex)
+				_modelLoadStats.duplicateTextureBytes += streaming.memorySize;
+		}
+	}
+
+	uint32_t copiedLevel = mipLevels;
+	if (oldImage.image != VK_NULL_HANDLE) {
+		if (streaming.residentLevel < mipLevels) {
+			copiedLevel = std::max(baseLevel, streaming.residentLevel);
+			m_imageUtil.recordCopyImageLevels(m_uploader.getGraphicsCommandBuffer(), oldImage.image, copiedLevel - oldImage.baseLevel,
+				image.image, copiedLevel - baseLevel, mipLevels - copiedLevel);
+			streaming.retiredImage = oldImage;
+		}
+		else
+			destroyImageResource(oldImage);
+		if (baseLevel > oldImage.baseLevel)
+			_textureResidencyStats.evictions++;
+		else
+			_textureResidencyStats.restreams++;
+	}
+	streaming.submittedLevel = copiedLevel;
+	streaming.residentLevel = mipLevels;
+	return copiedLevel;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Stop the texture streaming, waits for the decode thread and the submitted uploads. Images no
+// texture shows are destroyed, the others belong to _textureResources.
+//
+void VulkanModelViewer::stopTextureStreaming() {
+	_cancelTextureDecode = true;
+	if (_textureDecodeThread.joinable())
+		_textureDecodeThread.join();
+	_cancelTextureDecode = false;
+
+	//The upload callbacks refer to the streaming textures, the device is idle
+	m_uploader.waitIdle();
+	_finishedFrameCount = _submittedFrameCount;
+	destroyRetiredTextureResources();
+	for (const StreamingTexture& streaming : _streamingTextures) {
+		VkImage shownImage = _textureResources[streaming.textureIndex].image;
+		for (const ImageResource& image : { streaming.image, streaming.retiredImage }) {
+			if (image.image != VK_NULL_HANDLE && image.image != shownImage)
+				destroyImageResource(image);
+		}
+	}
+	_textureUploadsInFlight = 0;
+	_streamingTextures.clear();
+	_decodedTextures.clear();
+	_decodingTextures.clear();
+	_texturesDecoding = 0;
+	_texturesStreaming = false;
+	_textureResidencyPending = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Print the texture statistics of the model once its textures are streamed in
+//
+void VulkanModelViewer::printTextureStats() {
+	if (_modelLoadStats.textureCount == 0)
+		return;
+	std::cout << "Textures: " << _modelLoadStats.textureCount << " (" << _modelLoadStats.textureBytes / (1024.0 * 1024.0) << " MB) decoded in "
+		<< _modelLoadStats.textureDecodeMilliseconds << " ms, full resolution after " << _modelLoadStats.textureStreamMilliseconds << " ms in "
+		<< _modelLoadStats.textureUploadBatches << " batch(es), " << _modelLoadStats.textureUploadMilliseconds << " ms upload time" << std::endl;
+	std::cout << "Texture memory: " << _modelLoadStats.textureImageBytes / (1024.0 * 1024.0) << " MB instead of "
+		<< _modelLoadStats.textureRGBA8Bytes / (1024.0 * 1024.0) << " MB as RGBA8 (" << _modelLoadStats.cookedTextureCount << " cooked, "
+		<< _modelLoadStats.channelTextureCount << " channel, " << _modelLoadStats.packedTextureCount << " packed texture(s))" << std::endl;
+	if (_modelLoadStats.duplicateTextureCount > 0)
+		std::cout << "Texture dedup: " << _modelLoadStats.duplicateTextureCount << " duplicate(s) share an image, "
+			<< _modelLoadStats.duplicateTextureBytes / (1024.0 * 1024.0) << " MB saved, hashed in "
+			<< _modelLoadStats.textureHashMilliseconds << " ms" << std::endl;
+	if (_textureResidencyStats.managedCount > 0)
+		std::cout << "Texture residency: " << (_textureResidencyStats.selectedBytes + _textureResidencyStats.pinnedBytes) / (1024.0 * 1024.0) << " MB selected of "
+			<< _textureResidencyStats.budget / (1024.0 * 1024.0) << " MB budget (" << _textureResidencyStats.pinnedBytes / (1024.0 * 1024.0) << " MB pinned), "
+			<< _textureResidencyStats.neededBytes / (1024.0 * 1024.0) << " MB needed on screen, " << _textureResidencyStats.reducedCount << " of "
+			<< _textureResidencyStats.managedCount << " cooked texture(s) below the needed level, " << _textureResidencyStats.evictions << " eviction(s), "
+			<< _textureResidencyStats.restreams << " restream(s)" << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Print the counters of the device memory allocator
+//
+void VulkanModelViewer::printMemoryStats() {
+	vkimpl::MemoryAllocatorStats stats = m_memoryAllocator.getStats();
+	std::cout << "GPU memory: " << stats.allocationCount() << " allocation(s) in " << stats.deviceMemoryCount << " of "
+		<< stats.maxDeviceMemoryCount << " VkDeviceMemory object(s) (" << stats.blockCount << " block(s), " << stats.dedicatedCount
+		<< " dedicated), " << stats.usedBytes / (1024.0 * 1024.0) << " MB used of " << stats.reservedBytes / (1024.0 * 1024.0)
+		<< " MB reserved" << std::endl;
+
+	vkimpl::MemoryReport report = m_memoryAllocator.m_tracker.getReport();
+	for (size_t i = 0; i < report.heaps.size(); i++) {
+		const vkimpl::MemoryHeapReport& heap = report.heaps[i];
+		std::cout << "GPU heap " << i << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local): " : ": ") << heap.trackedBytes / (1024.0 * 1024.0)
+			<< " MB tracked, " << heap.reservedBytes / (1024.0 * 1024.0) << " MB reserved of " << heap.size / (1024.0 * 1024.0) << " MB";
+		if (report.budgetSupported)
+			std::cout << ", process usage " << heap.usage / (1024.0 * 1024.0) << " MB of " << heap.budget / (1024.0 * 1024.0) << " MB budget";
+		std::cout << std::endl;
+	}
+	std::cout << "GPU memory by category:";
+	for (size_t i = 0; i < report.categoryBytes.size(); i++) {
+		std::cout << (i > 0 ? ", " : " ") << vkimpl::VulkanMemoryTracker::categoryName(static_cast<vkimpl::MemoryCategory>(i)) << " "
+			<< report.categoryBytes[i] / (1024.0 * 1024.0) << " MB (" << report.categoryCounts[i] << ")";
+	}
+	std::cout << std::endl;
+	std::cout << "Scene targets: " << _presentAttachmentReport.committedBytes / (1024.0 * 1024.0) << " MB committed in " << _presentAttachmentReport.groupCount
+		<< " allocation(s), " << _presentAttachmentReport.lazyBytes / (1024.0 * 1024.0) << " MB lazily allocated, "
+		<< _presentAttachmentReport.separateBytes / (1024.0 * 1024.0) << " MB in separate allocations" << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Write the memory report of the tracker as JSON to MEMORY_REPORT_PATH
 //
-VulkanModelViewer::ImageResource VulkanModelViewer::createTextureImageResource(std::string texPath) {
-	//Load texture image data
-	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(texPath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
-	uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-	if (!pixels) {
-		throw std::runtime_error("failed to load texture image!");
+void VulkanModelViewer::exportMemoryReport() {
+	std::ofstream file(MEMORY_REPORT_PATH, std::ios::trunc);
+	file << m_memoryAllocator.m_tracker.getReport().toJson();
+	if (!file.good()) {
+		throw std::runtime_error("failed to write memory report " + MEMORY_REPORT_PATH + "!");
 	}
+	std::cout << "Memory report written to " << std::filesystem::absolute(MEMORY_REPORT_PATH).string() << std::endl;
+	printMemoryStats();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Print the counters of the uploader
+//
+void VulkanModelViewer::printUploadStats() {
+	vkimpl::UploadStats stats = m_uploader.getStats();
+	std::cout << "Uploads: " << stats.uploadedBytes / (1024.0 * 1024.0) << " MB staged in " << stats.copyCount << " copies, "
+		<< stats.submitCount << " submission(s), " << stats.splitCount << " split upload(s), " << stats.ringWaitCount
+		<< " wait(s) for staging space (" << stats.ringWaitMilliseconds << " ms), " << stats.releaseCount << " release(s) to "
+		<< (m_uploader.dedicatedTransfer() ? "the graphics queue in " : "the same queue in ") << stats.graphicsSubmitCount << " graphics submission(s)" << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Print the layout of the frame uniform ring
+//
+void VulkanModelViewer::printUniformStats() {
+	vkimpl::UniformRingStats stats = _uniformBuffers.frameUniforms.getStats();
+	std::cout << "Frame uniforms: " << stats.regionCount << " region(s) of " << stats.regionSize / 1024.0 << " KB, "
+		<< stats.reservedBytes << " bytes of slots per frame, " << stats.alignment << " bytes alignment" << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Print the cost of recording the object passes and the binds of the scene pass
+//
+void VulkanModelViewer::printDrawRecordStats() {
+	std::cout << "Draw recording: " << _drawRecordStats.recordMilliseconds << " ms, scene pass " << _drawRecordStats.draws << " draw(s) and one material set bind for "
+		<< _drawRecordStats.materialGroups << " material group(s) of " << _materialCache.size() << " material(s), "
+		<< _bindlessTextures.writtenCount << " of " << _bindlessTextures.capacity << " bindless texture(s)"
+		<< (_bindlessTextures.updateAfterBind ? ", updated after bind" : "") << std::endl;
+	std::cout << "Draw recording workers: " << _drawRecordStats.workers << " of " << _drawRecordPools.size() << " pool(s), "
+		<< _drawRecordStats.secondaryCommandBuffers << " secondary command buffer(s)" << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Measure the upload throughput: UPLOAD_BENCHMARK_BYTES go through the uploader to a device local
+// buffer, timed from the first copy until the device finished the last one
+//
+void VulkanModelViewer::benchmarkUploads() {
+	m_uploader.waitIdle();
+	BufferResource target{};
+	m_bufferUtil.createBuffer(UPLOAD_BENCHMARK_BYTES, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target.buffer, target.bufferMemory);
+	std::vector<char> chunk(static_cast<size_t>(UPLOAD_BENCHMARK_CHUNK_SIZE), 1);
+	vkimpl::UploadStats statsBefore = m_uploader.getStats();
+
+	auto benchmarkStartTime = std::chrono::high_resolution_clock::now();
+	for (VkDeviceSize offset = 0; offset < UPLOAD_BENCHMARK_BYTES; offset += UPLOAD_BENCHMARK_CHUNK_SIZE)
+		m_uploader.uploadBuffer(target.buffer, offset, chunk.data(), UPLOAD_BENCHMARK_CHUNK_SIZE);
+	m_uploader.wait(m_uploader.submit());
+	auto benchmarkEndTime = std::chrono::high_resolution_clock::now();
+	destroyBufferResource(target);
+
+	vkimpl::UploadStats stats = m_uploader.getStats();
+	_uploadBenchmarkStats.bytes = UPLOAD_BENCHMARK_BYTES;
+	_uploadBenchmarkStats.milliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(benchmarkEndTime - benchmarkStartTime).count();
+	_uploadBenchmarkStats.throughputMBs = UPLOAD_BENCHMARK_BYTES / (1024.0 * 1024.0) / (_uploadBenchmarkStats.milliseconds / 1000.0);
+	std::cout << "Upload benchmark: " << UPLOAD_BENCHMARK_BYTES / (1024.0 * 1024.0) << " MB in " << _uploadBenchmarkStats.milliseconds << " ms, "
+		<< _uploadBenchmarkStats.throughputMBs << " MB/s (" << stats.submitCount - statsBefore.submitCount << " submission(s), "
+		<< stats.ringWaitCount - statsBefore.ringWaitCount << " wait(s) for staging space)" << std::endl;
+}
 
-	VkImage textureImage;
-	VkDeviceMemory textureImageMemory;
-	VkImageView textureImageView;
+//--------------------------------------------------------------------------------------------------
+// Measure the cost of recording the object passes with 1 to every draw recording thread. Each count
+// records every pass for every image DRAW_RECORD_BENCHMARK_ROUNDS times, the fastest round is kept.
+// The passes are recorded again with the chosen thread count afterwards.
+//
+void VulkanModelViewer::benchmarkDrawRecording() {
+	if (_shapes.empty())
+		return;
+	//The primary and secondary command buffers of every image are recorded again
+	vkDeviceWaitIdle(m_device);
+	int recordThreadCount = _recordThreadCount;
+	_drawRecordBenchmarkStats.milliseconds.assign(_drawRecordPools.size(), 0.0);
+	_drawRecordBenchmarkStats.workers.assign(_drawRecordPools.size(), 0);
+	for (size_t threadCount = 1; threadCount <= _drawRecordPools.size(); threadCount++) {
+		_recordThreadCount = static_cast<int>(threadCount);
+		double fastest = 0.0;
+		for (int round = 0; round < DRAW_RECORD_BENCHMARK_ROUNDS; round++) {
+			beginObjectRenderPasses();
+			if (round == 0 || _drawRecordStats.recordMilliseconds < fastest)
+				fastest = _drawRecordStats.recordMilliseconds;
+		}
+		_drawRecordBenchmarkStats.milliseconds[threadCount - 1] = fastest;
+		_drawRecordBenchmarkStats.workers[threadCount - 1] = _drawRecordStats.workers;
+		std::cout << "Draw recording benchmark: " << threadCount << " thread(s), " << fastest << " ms, " << _drawRecordStats.workers << " worker(s) per pass, "
+			<< _drawRecordStats.secondaryCommandBuffers << " secondary command buffer(s), " << _drawRecordStats.draws << " draw(s) in the scene pass" << std::endl;
+	}
+	_recordThreadCount = recordThreadCount;
+	beginObjectRenderPasses();
+}
 
-	//Create the texture image and fill its data
-	vkimpl::VulkanImageInfo textureImageInfo = getImageInfo(TEXTURE_IMAGE);
-	textureImageInfo.extent.width = texWidth;
-	textureImageInfo.extent.height = texHeight;
-	textureImageInfo.mipLevels = mipLevels;
-	m_imageUtil.setOperationInfo(_commandPool, m_graphicsQueue, textureImageInfo);
-	m_imageUtil.createImage(textureImage, textureImageMemory);
-	m_imageUtil.fillImagePixels(textureImage, pixels, imageSize, VK_IMAGE_LAYOUT_UNDEFINED, textureImageInfo.aspectFlags);
-	stbi_image_free(pixels); // free image data after the filling the image
-	m_imageUtil.generateMipmaps(textureImage);
+//--------------------------------------------------------------------------------------------------
+// Upload the materials added since the last call and write the textures loaded since then into the
+// texture array of the material set. Textures that are still streamed in show the placeholder texture.
+//
+void VulkanModelViewer::updateMaterialDescriptors() {
+	loadPendingTextures();
+	updateMaterialBuffer();
+	if (_textureResources.size() > _bindlessTextures.capacity) {
+		throw std::runtime_error("failed to add textures, the bindless texture array is full!");
+	}
+	updateTextureDescriptors(_bindlessTextures.writtenCount, _textureResources.size() - _bindlessTextures.writtenCount);
+	_bindlessTextures.writtenCount = _textureResources.size();
+}
 
-	textureImageView = m_imageUtil.createImageView(textureImage);//Create the texture image view
+//--------------------------------------------------------------------------------------------------
+// Copy the MaterialUBOs of the materials added since the last call to the material buffer. A full
+// buffer is replaced by one of twice the capacity holding every material, the material set is
+// pointed at it.
+//
+void VulkanModelViewer::updateMaterialBuffer() {
+	if (_materialCache.size() > _materialBuffer.capacity) {
+		//Copies into the old buffer may still be recorded
+		m_uploader.waitIdle();
+		destroyBufferResource(_materialBuffer.buffer);
+		_materialBuffer.capacity = std::max<size_t>(_materialBuffer.capacity, MIN_MATERIAL_BUFFER_CAPACITY);
+		while (_materialBuffer.capacity < _materialCache.size())
+			_materialBuffer.capacity *= 2;
+		m_bufferUtil.createBuffer(sizeof(MaterialUBO) * _materialBuffer.capacity, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _materialBuffer.buffer.buffer, _materialBuffer.buffer.bufferMemory);
+		m_debugUtil.setObjectName(_materialBuffer.buffer.buffer, "MaterialBuffer");
+		_materialBuffer.uploadedCount = 0;
+		VkDescriptorBufferInfo bufferInfo = { _materialBuffer.buffer.buffer, 0, VK_WHOLE_SIZE };
+		m_descriptorUtil.updateBufferDescriptor(_descriptorSets.materialDescriptorSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferInfo);
+	}
+	if (_materialBuffer.uploadedCount == _materialCache.size())
+		return;
 
-	return ImageResource{ textureImage, textureImageMemory, textureImageView };
+	//The cache holds whole materials, their UBOs are gathered for one copy
+	std::vector<MaterialUBO> ubos;
+	ubos.reserve(_materialCache.size() - _materialBuffer.uploadedCount);
+	for (size_t i = _materialBuffer.uploadedCount; i < _materialCache.size(); i++)
+		ubos.push_back(_materialCache[i].ubo);
+	m_uploader.uploadBuffer(_materialBuffer.buffer.buffer, sizeof(MaterialUBO) * _materialBuffer.uploadedCount, ubos.data(), sizeof(MaterialUBO) * ubos.size());
+	m_uploader.submit();
+	_materialBuffer.uploadedCount = _materialCache.size();
 }
 
 
@@ -349,16 +1479,83 @@ void VulkanModelViewer::initSceneResources() {
 // Create the vertex and index buffer from model vertices and indices
 //
 void VulkanModelViewer::createModelBuffer() {
-	m_bufferUtil.m_commandPool = _commandPool;
-	m_bufferUtil.m_queue = m_graphicsQueue;
+	if (_modelVertexFormat == COMPACT_VERTEX_FORMAT)
+		createModelBuffer(_compactVertices.data(), sizeof(CompactVertex) * _compactVertices.size(), _indices.data(), sizeof(uint32_t) * _indices.size());
+	else
+		createModelBuffer(_vertices.data(), sizeof(Vertex) * _vertices.size(), _indices.data(), sizeof(uint32_t) * _indices.size());
+}
+
+//--------------------------------------------
+// Create the vertex and index buffer from raw vertex and index data, e.g. a mapped model cache.
+// The vertex records are split into the vertex streams on the way to the GPU. The data is staged
+// before this returns, the copies are submitted without waiting for them.
+//
+void VulkanModelViewer::createModelBuffer(const void* vertexData, VkDeviceSize vertexDataSize, const void* indexData, VkDeviceSize indexDataSize) {
 	//Create the vertex buffer
-	VkDeviceSize vertexBufferSize = sizeof(_vertices[0]) * _vertices.size();
+	size_t vertexCount = static_cast<size_t>(vertexDataSize / getVertexStride());
+	VkDeviceSize vertexBufferSize = layoutVertexStreams(findConstantStreams(vertexData, vertexCount), vertexCount);
 	m_bufferUtil.createBuffer(vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _vertexBuffer, _vertexBufferMemory);
-	m_bufferUtil.fillBufferData(_vertexBuffer, _vertices.data(), vertexBufferSize);
+	m_debugUtil.setObjectName(_vertexBuffer, "VertexBuffer");
+	if (vertexCount > 0)
+		uploadVertexStreams(vertexData, vertexCount, 0);
+	_modelLoadStats.vertexBufferBytes = vertexBufferSize;
 	//Create the index buffer
-	VkDeviceSize indexBufferSize = sizeof(_indices[0]) * _indices.size();
-	m_bufferUtil.createBuffer(indexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _indexBuffer, _indexBufferMemory);
-	m_bufferUtil.fillBufferData(_indexBuffer, _indices.data(), indexBufferSize);
+	m_bufferUtil.createBuffer(indexDataSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _indexBuffer, _indexBufferMemory);
+	m_debugUtil.setObjectName(_indexBuffer, "IndexBuffer");
+	m_uploader.uploadBuffer(_indexBuffer, 0, indexData, indexDataSize);
+	m_uploader.submit();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Create the buffers of the meshlet culling pass for the loaded meshlets. The cull items and draw
+// groups are written on the host whenever the object passes are recorded.
+//
+void VulkanModelViewer::createMeshletBuffers() {
+	if (_meshlets.empty())
+		return;
+
+	//Every level of detail of a shape may be drawn, so the capacity is the largest level of each shape
+	_meshletBuffers.drawGroupCapacity = 0;
+	for (const Shape& shape : _shapes) {
+		size_t groupCount = shape.materialGroups.size();
+		for (const ShapeLod& lod : shape.lods)
+			groupCount = std::max(groupCount, lod.materialGroups.size());
+		_meshletBuffers.drawGroupCapacity += static_cast<uint32_t>(groupCount);
+	}
+
+	VkDeviceSize meshletBufferSize = sizeof(Meshlet) * _meshlets.size();
+	m_bufferUtil.createBuffer(meshletBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		_meshletBuffers.meshlets.buffer, _meshletBuffers.meshlets.bufferMemory);
+	m_debugUtil.setObjectName(_meshletBuffers.meshlets.buffer, "MeshletBuffer");
+	m_uploader.uploadBuffer(_meshletBuffers.meshlets.buffer, 0, _meshlets.data(), meshletBufferSize);
+	m_uploader.submit();
+	m_bufferUtil.createBuffer(2 * sizeof(uint32_t) + sizeof(glm::uvec2) * _meshlets.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _meshletBuffers.cullItems.buffer, _meshletBuffers.cullItems.bufferMemory);
+	m_bufferUtil.createBuffer(sizeof(uint32_t) * std::max(_meshletBuffers.drawGroupCapacity, 1u), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _meshletBuffers.drawGroups.buffer, _meshletBuffers.drawGroups.bufferMemory);
+	m_debugUtil.setObjectName(_meshletBuffers.cullItems.buffer, "MeshletCullItemBuffer");
+	m_debugUtil.setObjectName(_meshletBuffers.drawGroups.buffer, "MeshletDrawGroupBuffer");
+	createMeshletDrawBuffers();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Create the draw command and draw count buffers of every swapchain image. The counts are host
+// visible for the statistics and start at zero.
+//
+void VulkanModelViewer::createMeshletDrawBuffers() {
+	destroyMeshletDrawBuffers();
+	_meshletBuffers.drawCommands.resize(m_swapchainImageNum);
+	_meshletBuffers.drawCounts.resize(m_swapchainImageNum);
+	VkDeviceSize drawCountBufferSize = sizeof(uint32_t) * (1 + _meshletBuffers.drawGroupCapacity);
+	for (int i = 0; i < m_swapchainImageNum; i++) {
+		m_bufferUtil.createBuffer(sizeof(VkDrawIndexedIndirectCommand) * _meshlets.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _meshletBuffers.drawCommands[i].buffer, _meshletBuffers.drawCommands[i].bufferMemory);
+		m_bufferUtil.createBuffer(drawCountBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _meshletBuffers.drawCounts[i].buffer, _meshletBuffers.drawCounts[i].bufferMemory);
+		m_debugUtil.setObjectName(_meshletBuffers.drawCommands[i].buffer, "MeshletDrawCommandBuffer[" + std::to_string(i) + "]");
+		m_debugUtil.setObjectName(_meshletBuffers.drawCounts[i].buffer, "MeshletDrawCountBuffer[" + std::to_string(i) + "]");
+		memset(_meshletBuffers.drawCounts[i].bufferMemory.mapped, 0, drawCountBufferSize);
+	}
 }
 
 
@@ -456,24 +1653,15 @@ void VulkanModelViewer::initUniformBuffers() {
 }
 
 //--------------------------------------------------------------------------------------------------
-// Initialize the uniform buffers used in presentation
+// Initialize the uniform buffers used in presentation. The camera and the light are written to slots
+// of the frame uniform ring, whose regions follow the swapchain images since the command buffers
+// recorded for an image bind that image's region.
 //
 void VulkanModelViewer::createPresentUniformBuffers() {
-	//Camera info ubo
-	createUniformBuffers(sizeof(CameraInfoUBO), _uniformBuffers.cameraUniformBuffers);
-
-	//Light info ubo
-	createUniformBuffers(sizeof(LightInfoUBO), _uniformBuffers.lightUniformBuffers);
-}
-
-//--------------------------------------------------------------------------------------------------
-// Initialize the uniform buffers of given size
-//
-void VulkanModelViewer::createUniformBuffers(VkDeviceSize bufferSize, std::vector<BufferResource>& uniformBuffers) {
-	uniformBuffers.resize(m_swapchainImages.size());
-	for (size_t i = 0; i < m_swapchainImages.size(); i++)
-		m_bufferUtil.createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i].buffer, uniformBuffers[i].bufferMemory);
-	
+	_uniformBuffers.frameUniforms.init(m_physicalDevice, m_device, &m_memoryAllocator, m_swapchainImageNum);
+	_uniformBuffers.cameraSlot = _uniformBuffers.frameUniforms.reserve(sizeof(CameraInfoUBO));
+	_uniformBuffers.lightSlot = _uniformBuffers.frameUniforms.reserve(sizeof(LightInfoUBO));
+	printUniformStats();
 }
 
 
@@ -487,6 +1675,7 @@ void VulkanModelViewer::initDescriptorSetLayouts() {
 	createCameraDescriptorSetLayout();
 	createMaterialDescriptorSetLayout();
 	createLightDescriptorSetLayout();
+	createMeshletCullingDescriptorSetLayout();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -496,10 +1685,10 @@ void VulkanModelViewer::createSceneDescriptorSetLayout() {
 	//Binding infos
 	std::vector<vkimpl::DescriptorSetLayoutBindingInfo> descriptorBindingInfos;
 	//Camera information uniform buffer binding
-	vkimpl::DescriptorSetLayoutBindingInfo cameraUboDescriptorInfo{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
+	vkimpl::DescriptorSetLayoutBindingInfo cameraUboDescriptorInfo{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
 	descriptorBindingInfos.push_back(cameraUboDescriptorInfo);
 	//Light information uniform buffer binding
-	vkimpl::DescriptorSetLayoutBindingInfo lightUboDescriptorInfo{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
+	vkimpl::DescriptorSetLayoutBindingInfo lightUboDescriptorInfo{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
 	descriptorBindingInfos.push_back(lightUboDescriptorInfo);
 	//Shadow texture
 	vkimpl::DescriptorSetLayoutBindingInfo shadowTextureEntry{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT };
@@ -518,7 +1707,7 @@ void VulkanModelViewer::createCameraDescriptorSetLayout() {
 	//Binding infos
 	std::vector<vkimpl::DescriptorSetLayoutBindingInfo> descriptorBindingInfos;
 	//Camera information uniform buffer binding
-	vkimpl::DescriptorSetLayoutBindingInfo cameraUboDescriptorInfo{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
+	vkimpl::DescriptorSetLayoutBindingInfo cameraUboDescriptorInfo{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
 	descriptorBindingInfos.push_back(cameraUboDescriptorInfo);
 
 	//Create layout
@@ -532,7 +1721,7 @@ void VulkanModelViewer::createCameraDescriptorSetLayout() {
 void VulkanModelViewer::createLightDescriptorSetLayout() {
 	//Binding infos
 	std::vector<vkimpl::DescriptorSetLayoutBindingInfo> descriptorBindingInfos;
-	vkimpl::DescriptorSetLayoutBindingInfo lightUboDescriptorInfo{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
+	vkimpl::DescriptorSetLayoutBindingInfo lightUboDescriptorInfo{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
 	descriptorBindingInfos.push_back(lightUboDescriptorInfo);
 
 
@@ -542,36 +1731,65 @@ void VulkanModelViewer::createLightDescriptorSetLayout() {
 }
 
 //--------------------------------------------------------------------------------------------------
-// create the descriptor set layouts used for material and textures it has
+// Create the descriptor set layout of the materials: the material buffer and an array of every
+// loaded texture, indexed in the shaders by the texture indices of the materials. Its size is
+// bounded by the device limits, one sampler is left for the shadow map of the scene set.
 //
 void VulkanModelViewer::createMaterialDescriptorSetLayout() {
+	VkPhysicalDeviceVulkan12Properties properties12{};
+	properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &properties12;
+	vkGetPhysicalDeviceProperties2(m_physicalDevice, &properties);
+
+	//Texture entries are written while the passes using the set are recorded if the device allows it
+	_bindlessTextures.updateAfterBind = m_deviceFeatures12.descriptorBindingSampledImageUpdateAfterBind;
+	uint32_t stageLimit = std::min(properties.properties.limits.maxPerStageDescriptorSamplers, properties.properties.limits.maxPerStageDescriptorSampledImages);
+	uint32_t setLimit = std::min(properties.properties.limits.maxDescriptorSetSamplers, properties.properties.limits.maxDescriptorSetSampledImages);
+	if (_bindlessTextures.updateAfterBind) {
+		stageLimit = std::min(properties12.maxPerStageDescriptorUpdateAfterBindSamplers, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages);
+		setLimit = std::min(properties12.maxDescriptorSetUpdateAfterBindSamplers, properties12.maxDescriptorSetUpdateAfterBindSampledImages);
+	}
+	_bindlessTextures.capacity = std::min({ MAX_BINDLESS_TEXTURES, stageLimit - 1, setLimit - 1 });
+
 	//Binding infos
 	std::vector<vkimpl::DescriptorSetLayoutBindingInfo> descriptorBindingInfos{};
-	//Material uniform buffer binding
-	vkimpl::DescriptorSetLayoutBindingInfo materialUboEntry{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT };
-	descriptorBindingInfos.push_back(materialUboEntry);
-	vkimpl::DescriptorSetLayoutBindingInfo ambientTextureEntry{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT };
-	descriptorBindingInfos.push_back(ambientTextureEntry);
-	vkimpl::DescriptorSetLayoutBindingInfo diffuseTextureEntry{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT };
-	descriptorBindingInfos.push_back(diffuseTextureEntry);
-	vkimpl::DescriptorSetLayoutBindingInfo specularTextureEntry{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT };
-	descriptorBindingInfos.push_back(specularTextureEntry);
-	vkimpl::DescriptorSetLayoutBindingInfo specularHighlightTextureEntry{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT };
-	descriptorBindingInfos.push_back(specularHighlightTextureEntry);
-	vkimpl::DescriptorSetLayoutBindingInfo bumpTextureEntry{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT };
-	descriptorBindingInfos.push_back(bumpTextureEntry);
-	vkimpl::DescriptorSetLayoutBindingInfo displacementTextureEntry{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT };
-	descriptorBindingInfos.push_back(displacementTextureEntry);
-	vkimpl::DescriptorSetLayoutBindingInfo alphaTextureEntry{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT };
-	descriptorBindingInfos.push_back(alphaTextureEntry);
-	vkimpl::DescriptorSetLayoutBindingInfo reflectionTextureEntry{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT };
-	descriptorBindingInfos.push_back(reflectionTextureEntry);
+	//Material storage buffer binding, every material of the model
+	vkimpl::DescriptorSetLayoutBindingInfo materialBufferEntry{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT };
+	descriptorBindingInfos.push_back(materialBufferEntry);
+	//Texture array binding, entries past the loaded textures are never written
+	VkDescriptorBindingFlags textureBindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+	if (_bindlessTextures.updateAfterBind)
+		textureBindingFlags |= VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+	vkimpl::DescriptorSetLayoutBindingInfo texturesEntry{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _bindlessTextures.capacity, VK_SHADER_STAGE_FRAGMENT_BIT, textureBindingFlags };
+	descriptorBindingInfos.push_back(texturesEntry);
 
 	//Create layout
 	_descriptorSetInfos.materialDescriptorInfo.bindingInfos = descriptorBindingInfos;
 	m_descriptorUtil.createDescriptorSetLayout(descriptorBindingInfos, _descriptorSetLayouts.materialDescriptorSetLayout);
 }
 
+//--------------------------------------------------------------------------------------------------
+// create the descriptor set layout of the meshlet culling pass
+//
+void VulkanModelViewer::createMeshletCullingDescriptorSetLayout() {
+	//Binding infos
+	std::vector<vkimpl::DescriptorSetLayoutBindingInfo> descriptorBindingInfos;
+	//Camera information uniform buffer binding
+	vkimpl::DescriptorSetLayoutBindingInfo cameraUboDescriptorInfo{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_COMPUTE_BIT };
+	descriptorBindingInfos.push_back(cameraUboDescriptorInfo);
+	//Meshlets, cull items, draw groups, draw commands and draw counts
+	for (int i = 0; i < 5; i++) {
+		vkimpl::DescriptorSetLayoutBindingInfo storageBufferDescriptorInfo{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT };
+		descriptorBindingInfos.push_back(storageBufferDescriptorInfo);
+	}
+
+	//Create layout
+	_descriptorSetInfos.meshletCullingDescriptorInfo.bindingInfos = descriptorBindingInfos;
+	m_descriptorUtil.createDescriptorSetLayout(descriptorBindingInfos, _descriptorSetLayouts.meshletCullingDescriptorSetLayout);
+}
+
 
 
 
@@ -592,60 +1810,63 @@ void VulkanModelViewer::createPresentDescriptorPools() {
 	createSceneDescriptorPool();
 	createCameraDescriptorPool();
 	createLightDescriptorPool();
+	createMeshletCullingDescriptorPool();
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create the scene rendering descriptor pool
+// Create the scene rendering descriptor pool, the sets with and without shadow are shared by every
+// swapchain image
 //
 void VulkanModelViewer::createSceneDescriptorPool() {
-	int maxPipelineNums = 3;
+	uint32_t maxSetNums = 2;
 	std::vector<VkDescriptorPoolSize> poolSizes = {
-		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxPipelineNums * m_swapchainImageNum},
-		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxPipelineNums * m_swapchainImageNum},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxPipelineNums * m_swapchainImageNum}
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2 * maxSetNums},
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxSetNums}
 	};
-	m_descriptorUtil.createDescriptorPool(maxPipelineNums * m_swapchainImageNum, poolSizes, _descriptorPools.sceneDescriptorPool);
+	m_descriptorUtil.createDescriptorPool(maxSetNums, poolSizes, _descriptorPools.sceneDescriptorPool);
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create the scene rendering descriptor pool
+// Create the camera descriptor pool
 //
 void VulkanModelViewer::createCameraDescriptorPool() {
 	std::vector<VkDescriptorPoolSize> poolSizes = {
-		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, m_swapchainImageNum},
-		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, m_swapchainImageNum},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_swapchainImageNum}
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1}
 	};
-	m_descriptorUtil.createDescriptorPool(m_swapchainImageNum, poolSizes, _descriptorPools.cameraDescriptorPool);
+	m_descriptorUtil.createDescriptorPool(1, poolSizes, _descriptorPools.cameraDescriptorPool);
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create the scene rendering descriptor pool
+// Create the light descriptor pool
 //
 void VulkanModelViewer::createLightDescriptorPool() {
 	std::vector<VkDescriptorPoolSize> poolSizes = {
-		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, m_swapchainImageNum}
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1}
 	};
-	m_descriptorUtil.createDescriptorPool(m_swapchainImageNum, poolSizes, _descriptorPools.lightDescriptorPool);
+	m_descriptorUtil.createDescriptorPool(1, poolSizes, _descriptorPools.lightDescriptorPool);
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create the material system descriptor pool
+// Create the material system descriptor pool, of the single material set
 //
 void VulkanModelViewer::createMaterialDescriptorPool() {
-	uint32_t maxMaterialNum = 1000;
 	std::vector<VkDescriptorPoolSize> poolSizes = {
-		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxMaterialNum},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxMaterialNum},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxMaterialNum},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxMaterialNum},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxMaterialNum},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxMaterialNum},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxMaterialNum},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxMaterialNum},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxMaterialNum},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1},
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _bindlessTextures.capacity},
+	};
+	VkDescriptorPoolCreateFlags flags = _bindlessTextures.updateAfterBind ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0;
+	m_descriptorUtil.createDescriptorPool(1, poolSizes, _descriptorPools.materialDescriptorPool, flags);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Create the meshlet culling descriptor pool, the sets are allocated again for every model
+//
+void VulkanModelViewer::createMeshletCullingDescriptorPool() {
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, m_swapchainImageNum},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * m_swapchainImageNum}
 	};
-	m_descriptorUtil.createDescriptorPool(maxMaterialNum, poolSizes, _descriptorPools.materialDescriptorPool);
+	m_descriptorUtil.createDescriptorPool(m_swapchainImageNum, poolSizes, _descriptorPools.meshletCullingDescriptorPool);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -748,6 +1969,14 @@ void VulkanModelViewer::createShadowSampler() {
 // Create the command pools for all kinds of command buffers
 //
 void VulkanModelViewer::initCommandPools() {
+	//The draw recording workers are threads started once, each recording from a pool of its own. The
+	//shared pool is created last to stay the pool of the command utility.
+	_drawRecordPools.resize(std::min<size_t>(default_thread_count(), MAX_DRAW_RECORD_WORKERS));
+	for (size_t i = 0; i < _drawRecordPools.size(); i++) {
+		_drawRecordPools[i] = m_commandUtil.createCommandPool(m_queueFamilyIndices.graphicsFamily.value(), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+		m_debugUtil.setObjectName(_drawRecordPools[i], "DrawRecordPool[" + std::to_string(i) + "]");
+	}
+	_drawRecordWorkers.init(_drawRecordPools.size());
 	_commandPool = m_commandUtil.createCommandPool(m_queueFamilyIndices.graphicsFamily.value(), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 }
 
@@ -758,6 +1987,7 @@ void VulkanModelViewer::initCommandPools() {
 void VulkanModelViewer::initPipelines() {
 	createPresentPipelines();
 	createShadowPipeline();
+	createMeshletCullingPipeline();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -773,7 +2003,7 @@ void VulkanModelViewer::createPresentPipelines() {
 // Create the pipelines for scene
 //
 void VulkanModelViewer::createScenePipeline() {
-	std::string vertexShaderPath = SCENE_VERT_SHADER_PATH;
+	std::string vertexShaderPath = _modelVertexFormat == COMPACT_VERTEX_FORMAT ? SCENE_COMPACT_VERT_SHADER_PATH : SCENE_VERT_SHADER_PATH;
 	std::string fragmentShaderPath = SCENE_FRAG_SHADER_PATH;
 
 	auto vertShaderCode = readFile(vertexShaderPath);
@@ -782,11 +2012,12 @@ void VulkanModelViewer::createScenePipeline() {
 	vkimpl::VulkanPipelineCreateInfo graphicsPipelineCreateInfo{};
 	graphicsPipelineCreateInfo.vertShaderCode = vertShaderCode;
 	graphicsPipelineCreateInfo.fragShaderCode = fragShaderCode;
-	graphicsPipelineCreateInfo.bindingDescription = Vertex::getBindingDescription();
-	graphicsPipelineCreateInfo.attributeDescriptions = Vertex::getAttributeDescriptions();
+	graphicsPipelineCreateInfo.attributeDescriptions = getVertexAttributeDescriptions(SCENE_VERTEX_STREAMS);
+	graphicsPipelineCreateInfo.bindingDescriptions = getVertexBindingDescriptions(graphicsPipelineCreateInfo.attributeDescriptions);
 	graphicsPipelineCreateInfo.extent = m_swapchainExtent;
 	graphicsPipelineCreateInfo.msaaSamples = m_msaaSamples;
 	graphicsPipelineCreateInfo.descriptorSetLayouts = { _descriptorSetLayouts.sceneDescriptorSetLayout, _descriptorSetLayouts.materialDescriptorSetLayout };
+	graphicsPipelineCreateInfo.pushConstantRanges = { { VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(int) } };
 	graphicsPipelineCreateInfo.renderPass = _renderPasses.sceneRenderPass;
 
 	m_pipelineUtil.initGraphicsPipelineCreateInfo(graphicsPipelineCreateInfo);
@@ -798,7 +2029,7 @@ void VulkanModelViewer::createScenePipeline() {
 // Create the pipelines for scene without lighting
 //
 void VulkanModelViewer::createSceneNoLightingPipeline() {
-	std::string vertexShaderPath = SCENE_NO_LIHGTING_VERT_SHADER_PATH;
+	std::string vertexShaderPath = _modelVertexFormat == COMPACT_VERTEX_FORMAT ? SCENE_NO_LIHGTING_COMPACT_VERT_SHADER_PATH : SCENE_NO_LIHGTING_VERT_SHADER_PATH;
 	std::string fragmentShaderPath = SCENE_NO_LIHGTING_FRAG_SHADER_PATH;
 
 	auto vertShaderCode = readFile(vertexShaderPath);
@@ -807,11 +2038,12 @@ void VulkanModelViewer::createSceneNoLightingPipeline() {
 	vkimpl::VulkanPipelineCreateInfo graphicsPipelineCreateInfo{};
 	graphicsPipelineCreateInfo.vertShaderCode = vertShaderCode;
 	graphicsPipelineCreateInfo.fragShaderCode = fragShaderCode;
-	graphicsPipelineCreateInfo.bindingDescription = Vertex::getBindingDescription();
-	graphicsPipelineCreateInfo.attributeDescriptions = Vertex::getAttributeDescriptions();
+	graphicsPipelineCreateInfo.attributeDescriptions = getVertexAttributeDescriptions(SCENE_VERTEX_STREAMS);
+	graphicsPipelineCreateInfo.bindingDescriptions = getVertexBindingDescriptions(graphicsPipelineCreateInfo.attributeDescriptions);
 	graphicsPipelineCreateInfo.extent = m_swapchainExtent;
 	graphicsPipelineCreateInfo.msaaSamples = m_msaaSamples;
 	graphicsPipelineCreateInfo.descriptorSetLayouts = { _descriptorSetLayouts.sceneDescriptorSetLayout, _descriptorSetLayouts.materialDescriptorSetLayout };
+	graphicsPipelineCreateInfo.pushConstantRanges = { { VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(int) } };
 	graphicsPipelineCreateInfo.renderPass = _renderPasses.sceneRenderPass;
 
 	m_pipelineUtil.initGraphicsPipelineCreateInfo(graphicsPipelineCreateInfo);
@@ -823,7 +2055,7 @@ void VulkanModelViewer::createSceneNoLightingPipeline() {
 // Create the pipelines for scene
 //
 void VulkanModelViewer::createWireframePipeline() {
-	std::string vertexShaderPath = SCENE_WIREFRAME_VERT_SHADER_PATH;
+	std::string vertexShaderPath = _modelVertexFormat == COMPACT_VERTEX_FORMAT ? SCENE_WIREFRAME_COMPACT_VERT_SHADER_PATH : SCENE_WIREFRAME_VERT_SHADER_PATH;
 	std::string fragmentShaderPath = SCENE_WIREFRAME_FRAG_SHADER_PATH;
 
 	auto vertShaderCode = readFile(vertexShaderPath);
@@ -832,8 +2064,8 @@ void VulkanModelViewer::createWireframePipeline() {
 	vkimpl::VulkanPipelineCreateInfo graphicsPipelineCreateInfo{};
 	graphicsPipelineCreateInfo.vertShaderCode = vertShaderCode;
 	graphicsPipelineCreateInfo.fragShaderCode = fragShaderCode;
-	graphicsPipelineCreateInfo.bindingDescription = Vertex::getBindingDescription();
-	graphicsPipelineCreateInfo.attributeDescriptions = Vertex::getAttributeDescriptions();
+	graphicsPipelineCreateInfo.attributeDescriptions = getVertexAttributeDescriptions(WIREFRAME_VERTEX_STREAMS);
+	graphicsPipelineCreateInfo.bindingDescriptions = getVertexBindingDescriptions(graphicsPipelineCreateInfo.attributeDescriptions);
 	graphicsPipelineCreateInfo.extent = m_swapchainExtent;
 	graphicsPipelineCreateInfo.msaaSamples = m_msaaSamples;
 	graphicsPipelineCreateInfo.descriptorSetLayouts = { _descriptorSetLayouts.cameraDescriptorSetLayout };
@@ -850,7 +2082,7 @@ void VulkanModelViewer::createWireframePipeline() {
 // Create the pipelines for shadow mapping
 //
 void VulkanModelViewer::createShadowPipeline() {
-	std::string vertexShaderPath = SHADOW_MAPPING_VERT_SHADER_PATH;
+	std::string vertexShaderPath = _modelVertexFormat == COMPACT_VERTEX_FORMAT ? SHADOW_MAPPING_COMPACT_VERT_SHADER_PATH : SHADOW_MAPPING_VERT_SHADER_PATH;
 	std::string fragmentShaderPath = SHADOW_MAPPING_FRAG_SHADER_PATH;
 
 	auto vertShaderCode = readFile(vertexShaderPath);
@@ -859,8 +2091,8 @@ void VulkanModelViewer::createShadowPipeline() {
 	vkimpl::VulkanPipelineCreateInfo graphicsPipelineCreateInfo{};
 	graphicsPipelineCreateInfo.vertShaderCode = vertShaderCode;
 	graphicsPipelineCreateInfo.fragShaderCode = fragShaderCode;
-	graphicsPipelineCreateInfo.bindingDescription = Vertex::getBindingDescription();
-	graphicsPipelineCreateInfo.attributeDescriptions = Vertex::getAttributeDescriptions();
+	graphicsPipelineCreateInfo.attributeDescriptions = getVertexAttributeDescriptions(SHADOW_VERTEX_STREAMS);
+	graphicsPipelineCreateInfo.bindingDescriptions = getVertexBindingDescriptions(graphicsPipelineCreateInfo.attributeDescriptions);
 	graphicsPipelineCreateInfo.extent = m_shadowMapExtent;
 	graphicsPipelineCreateInfo.msaaSamples = VK_SAMPLE_COUNT_1_BIT;
 	graphicsPipelineCreateInfo.descriptorSetLayouts = { _descriptorSetLayouts.lightDescriptorSetLayout };
@@ -871,6 +2103,15 @@ void VulkanModelViewer::createShadowPipeline() {
 	m_pipelineUtil.createGraphicsPipeline(_pipelines.shadowPipeline);
 }
 
+//--------------------------------------------------------------------------------------------------
+// Create the compute pipeline culling the meshlets
+//
+void VulkanModelViewer::createMeshletCullingPipeline() {
+	auto compShaderCode = readFile(MESHLET_CULLING_COMP_SHADER_PATH);
+	m_pipelineUtil.createComputePipeline(compShaderCode, { _descriptorSetLayouts.meshletCullingDescriptorSetLayout },
+		_pipelineLayouts.meshletCullingPipelineLayout, _pipelines.meshletCullingPipeline);
+}
+
 
 
 
@@ -881,94 +2122,92 @@ void VulkanModelViewer::createShadowPipeline() {
 //
 void VulkanModelViewer::initDescriptorSets() {
 	createPresentDescriptorSets();
+	m_descriptorUtil.allocateDescriptorSet(_descriptorPools.materialDescriptorPool, _descriptorSetLayouts.materialDescriptorSetLayout, _descriptorSets.materialDescriptorSet);
 }
 
 //--------------------------------------------------------------------------------------------------
 // Initialize the descriptor sets
 //
 void VulkanModelViewer::createPresentDescriptorSets() {
-	createNoShadowSceneDescriptorSets();
-	createSceneDescriptorSets();
-	createCameraDescriptorSets();
-	createLightDescriptorSets();
+	createNoShadowSceneDescriptorSet();
+	createSceneDescriptorSet();
+	createCameraDescriptorSet();
+	createLightDescriptorSet();
+	createMeshletCullingDescriptorSets();
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create the descriptor sets for scene information
-//
-void VulkanModelViewer::createSceneDescriptorSets() {
-	_descriptorSetInfos.sceneDescriptorInfo.bufferInfos.clear();
-	_descriptorSetInfos.sceneDescriptorInfo.imageInfos.clear();
-
-	std::vector<vkimpl::DescriptorSetInfo> descriptorSetInfos(m_swapchainImageNum, _descriptorSetInfos.sceneDescriptorInfo);
-	std::vector<VkDescriptorSetLayout> descriptorSetLayouts(m_swapchainImageNum, _descriptorSetLayouts.sceneDescriptorSetLayout);
-	for (int i = 0; i < m_swapchainImageNum; i++) {
-		VkDescriptorBufferInfo bufferInfo;
-		VkDescriptorImageInfo imageInfo;
-		bufferInfo = { _uniformBuffers.cameraUniformBuffers[i].buffer, 0, sizeof(CameraInfoUBO) };
-		descriptorSetInfos[i].bufferInfos.push_back(bufferInfo);
-		bufferInfo = { _uniformBuffers.lightUniformBuffers[i].buffer, 0, sizeof(LightInfoUBO) };
-		descriptorSetInfos[i].bufferInfos.push_back(bufferInfo);
-		imageInfo = { _samplers.shadowSampler, _imageResources.shadowDepth.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-		descriptorSetInfos[i].imageInfos.push_back(imageInfo);
-	}
-	m_descriptorUtil.createDescriptorSets(_descriptorPools.sceneDescriptorPool, descriptorSetLayouts, descriptorSetInfos, _descriptorSets.sceneDescriptorSets);
+// Create the descriptor set for scene information, the camera and the light are dynamic uniform
+// buffers in the frame uniform ring
+//
+void VulkanModelViewer::createSceneDescriptorSet() {
+	vkimpl::DescriptorSetInfo descriptorSetInfo = _descriptorSetInfos.sceneDescriptorInfo;
+	descriptorSetInfo.bufferInfos = {
+		_uniformBuffers.frameUniforms.descriptorInfo(sizeof(CameraInfoUBO)),
+		_uniformBuffers.frameUniforms.descriptorInfo(sizeof(LightInfoUBO))
+	};
+	descriptorSetInfo.imageInfos = { { _samplers.shadowSampler, _imageResources.shadowDepth.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL } };
+	m_descriptorUtil.createDescriptorSet(_descriptorPools.sceneDescriptorPool, _descriptorSetLayouts.sceneDescriptorSetLayout, descriptorSetInfo, _descriptorSets.sceneDescriptorSet);
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create the descriptor sets for scene information with no shadow (a default shadow depth imageview)
+// Create the descriptor set for scene information with no shadow (a default shadow depth imageview)
 //
-void VulkanModelViewer::createNoShadowSceneDescriptorSets() {
-	_descriptorSetInfos.sceneDescriptorInfo.bufferInfos.clear();
-	_descriptorSetInfos.sceneDescriptorInfo.imageInfos.clear();
-
-	std::vector<vkimpl::DescriptorSetInfo> descriptorSetInfos(m_swapchainImageNum, _descriptorSetInfos.sceneDescriptorInfo);
-	std::vector<VkDescriptorSetLayout> descriptorSetLayouts(m_swapchainImageNum, _descriptorSetLayouts.sceneDescriptorSetLayout);
-	for (int i = 0; i < m_swapchainImageNum; i++) {
-		VkDescriptorBufferInfo bufferInfo;
-		VkDescriptorImageInfo imageInfo;
-		bufferInfo = { _uniformBuffers.cameraUniformBuffers[i].buffer, 0, sizeof(CameraInfoUBO) };
-		descriptorSetInfos[i].bufferInfos.push_back(bufferInfo);
-		bufferInfo = { _uniformBuffers.lightUniformBuffers[i].buffer, 0, sizeof(LightInfoUBO) };
-		descriptorSetInfos[i].bufferInfos.push_back(bufferInfo);
-		imageInfo = { _samplers.shadowSampler, _imageResources.defaultShadowDepth.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-		descriptorSetInfos[i].imageInfos.push_back(imageInfo);
-	}
-	m_descriptorUtil.createDescriptorSets(_descriptorPools.sceneDescriptorPool, descriptorSetLayouts, descriptorSetInfos, _descriptorSets.sceneNoShadowDescriptorSets);
+void VulkanModelViewer::createNoShadowSceneDescriptorSet() {
+	vkimpl::DescriptorSetInfo descriptorSetInfo = _descriptorSetInfos.sceneDescriptorInfo;
+	descriptorSetInfo.bufferInfos = {
+		_uniformBuffers.frameUniforms.descriptorInfo(sizeof(CameraInfoUBO)),
+		_uniformBuffers.frameUniforms.descriptorInfo(sizeof(LightInfoUBO))
+	};
+	descriptorSetInfo.imageInfos = { { _samplers.shadowSampler, _imageResources.defaultShadowDepth.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL } };
+	m_descriptorUtil.createDescriptorSet(_descriptorPools.sceneDescriptorPool, _descriptorSetLayouts.sceneDescriptorSetLayout, descriptorSetInfo, _descriptorSets.sceneNoShadowDescriptorSet);
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create the descriptor sets for wireframe information
+// Create the descriptor set for wireframe information
 //
-void VulkanModelViewer::createCameraDescriptorSets() {
-	_descriptorSetInfos.cameraDescriptorInfo.bufferInfos.clear();
-	_descriptorSetInfos.cameraDescriptorInfo.imageInfos.clear();
+void VulkanModelViewer::createCameraDescriptorSet() {
+	vkimpl::DescriptorSetInfo descriptorSetInfo = _descriptorSetInfos.cameraDescriptorInfo;
+	descriptorSetInfo.bufferInfos = { _uniformBuffers.frameUniforms.descriptorInfo(sizeof(CameraInfoUBO)) };
+	descriptorSetInfo.imageInfos.clear();
+	m_descriptorUtil.createDescriptorSet(_descriptorPools.cameraDescriptorPool, _descriptorSetLayouts.cameraDescriptorSetLayout, descriptorSetInfo, _descriptorSets.cameraDescriptorSet);
+}
 
-	std::vector<vkimpl::DescriptorSetInfo> descriptorSetInfos(m_swapchainImageNum, _descriptorSetInfos.cameraDescriptorInfo);
-	std::vector<VkDescriptorSetLayout> descriptorSetLayouts(m_swapchainImageNum, _descriptorSetLayouts.cameraDescriptorSetLayout);
-	for (int i = 0; i < m_swapchainImageNum; i++) {
-		VkDescriptorBufferInfo bufferInfo;
-		bufferInfo = { _uniformBuffers.cameraUniformBuffers[i].buffer, 0, sizeof(CameraInfoUBO) };
-		descriptorSetInfos[i].bufferInfos.push_back(bufferInfo);
-	}
-	m_descriptorUtil.createDescriptorSets(_descriptorPools.cameraDescriptorPool, descriptorSetLayouts, descriptorSetInfos, _descriptorSets.cameraDescriptorSets);
+//--------------------------------------------------------------------------------------------------
+// Create the descriptor set for the shadow pass
+//
+void VulkanModelViewer::createLightDescriptorSet() {
+	vkimpl::DescriptorSetInfo descriptorSetInfo = _descriptorSetInfos.lightDescriptorInfo;
+	descriptorSetInfo.bufferInfos = { _uniformBuffers.frameUniforms.descriptorInfo(sizeof(LightInfoUBO)) };
+	descriptorSetInfo.imageInfos.clear();
+	m_descriptorUtil.createDescriptorSet(_descriptorPools.lightDescriptorPool, _descriptorSetLayouts.lightDescriptorSetLayout, descriptorSetInfo, _descriptorSets.lightDescriptorSet);
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create the descriptor sets for scene information
+// Create the descriptor sets of the meshlet culling pass, there are none without a meshlet
 //
-void VulkanModelViewer::createLightDescriptorSets() {
-	_descriptorSetInfos.lightDescriptorInfo.bufferInfos.clear();
-	_descriptorSetInfos.lightDescriptorInfo.imageInfos.clear();
+void VulkanModelViewer::createMeshletCullingDescriptorSets() {
+	_descriptorSets.meshletCullingDescriptorSets.clear();
+	vkResetDescriptorPool(m_device, _descriptorPools.meshletCullingDescriptorPool, 0);
+	if (_meshlets.empty())
+		return;
+
+	_descriptorSetInfos.meshletCullingDescriptorInfo.bufferInfos.clear();
+	_descriptorSetInfos.meshletCullingDescriptorInfo.imageInfos.clear();
 
-	std::vector<vkimpl::DescriptorSetInfo> descriptorSetInfos(m_swapchainImageNum, _descriptorSetInfos.lightDescriptorInfo);
-	std::vector<VkDescriptorSetLayout> descriptorSetLayouts(m_swapchainImageNum, _descriptorSetLayouts.lightDescriptorSetLayout);
+	std::vector<vkimpl::DescriptorSetInfo> descriptorSetInfos(m_swapchainImageNum, _descriptorSetInfos.meshletCullingDescriptorInfo);
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts(m_swapchainImageNum, _descriptorSetLayouts.meshletCullingDescriptorSetLayout);
 	for (int i = 0; i < m_swapchainImageNum; i++) {
-		VkDescriptorBufferInfo bufferInfo;
-		bufferInfo = { _uniformBuffers.lightUniformBuffers[i].buffer, 0, sizeof(LightInfoUBO) };
-		descriptorSetInfos[i].bufferInfos.push_back(bufferInfo);
+		descriptorSetInfos[i].bufferInfos = {
+			_uniformBuffers.frameUniforms.descriptorInfo(sizeof(CameraInfoUBO)),
+			{ _meshletBuffers.meshlets.buffer, 0, VK_WHOLE_SIZE },
+			{ _meshletBuffers.cullItems.buffer, 0, VK_WHOLE_SIZE },
+			{ _meshletBuffers.drawGroups.buffer, 0, VK_WHOLE_SIZE },
+			{ _meshletBuffers.drawCommands[i].buffer, 0, VK_WHOLE_SIZE },
+			{ _meshletBuffers.drawCounts[i].buffer, 0, VK_WHOLE_SIZE }
+		};
 	}
-	m_descriptorUtil.createDescriptorSets(_descriptorPools.lightDescriptorPool, descriptorSetLayouts, descriptorSetInfos, _descriptorSets.lightDescriptorSets);
+	m_descriptorUtil.createDescriptorSets(_descriptorPools.meshletCullingDescriptorPool, descriptorSetLayouts, descriptorSetInfos, _descriptorSets.meshletCullingDescriptorSets);
 }
 
 
@@ -996,6 +2235,9 @@ void VulkanModelViewer::createPresentCommandBuffers() {
 	createShadowCommandBuffers();
 	createWireframeCommandBuffers();
 	createGuiCommandBuffers();
+	createMeshletCullingCommandBuffers();
+	createObjectPassCommandBuffers();
+	createTimestampQueryPool();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -1071,6 +2313,60 @@ void VulkanModelViewer::createGuiCommandBuffers() {
 		m_debugUtil.setObjectName(_commandBuffers.guiCommandBuffers[i], "GuiCommandBuffer[" + std::to_string(i) + "]");
 }
 
+//--------------------------------------------------------------------------------------------------
+// Create the command buffers for meshlet culling
+//
+void VulkanModelViewer::createMeshletCullingCommandBuffers() {
+	_commandBuffers.meshletCullingCommandBuffers = m_commandUtil.createCommandBuffers(_commandPool, m_swapchainImageNum);
+	for (int i = 0; i < m_swapchainImageNum; i++)
+		m_debugUtil.setObjectName(_commandBuffers.meshletCullingCommandBuffers[i], "MeshletCullingCommandBuffer[" + std::to_string(i) + "]");
+}
+
+//--------------------------------------------------------------------------------------------------
+// Create the secondary command buffers the workers record the object passes into, from the pool of
+// each worker one per object pass and swapchain image
+//
+void VulkanModelViewer::createObjectPassCommandBuffers() {
+	_commandBuffers.objectPassCommandBuffers.resize(_drawRecordPools.size());
+	for (size_t worker = 0; worker < _drawRecordPools.size(); worker++) {
+		_commandBuffers.objectPassCommandBuffers[worker] = m_commandUtil.createCommandBuffers(_drawRecordPools[worker], OBJECT_PASS_COUNT * m_swapchainImageNum,
+			VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+		for (int i = 0; i < OBJECT_PASS_COUNT * m_swapchainImageNum; i++)
+			m_debugUtil.setObjectName(_commandBuffers.objectPassCommandBuffers[worker][i], "ObjectPassCommandBuffer[" + std::to_string(worker) + "][" + std::to_string(i) + "]");
+	}
+}
+
+
+
+
+//--------------------------------------------------------------------------------------------------
+// Create the query pool of the scene pass timestamps, two per swapchain image. It is not created if
+// the graphics queue does not write timestamps.
+//
+void VulkanModelViewer::createTimestampQueryPool() {
+	_imagesTimed.assign(m_swapchainImageNum, 0);
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, queueFamilies.data());
+	uint32_t timestampValidBits = queueFamilies[m_queueFamilyIndices.graphicsFamily.value()].timestampValidBits;
+	if (timestampValidBits == 0)
+		return;
+	_timestampMask = timestampValidBits < 64 ? (1ull << timestampValidBits) - 1 : ~0ull;
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+	_timestampPeriod = properties.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = 2 * m_swapchainImageNum;
+	if (vkCreateQueryPool(m_device, &queryPoolInfo, nullptr, &_timestampQueryPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create timestamp query pool!");
+	}
+}
+
 
 
 
@@ -1089,6 +2385,7 @@ void VulkanModelViewer::createPresentSyncObjects() {
 	_imageAvailableSemaphores.resize(_maxFramesInFlight);
 	_renderFinishedSemaphores.resize(_maxFramesInFlight);
 	_inFlightFences.resize(_maxFramesInFlight);
+	_inFlightFrameNumbers.resize(_maxFramesInFlight, 0);
 	_imagesInFlight.resize(m_swapchainImageNum, VK_NULL_HANDLE);
 
 	VkSemaphoreCreateInfo semaphoreInfo{};
@@ -1123,7 +2420,7 @@ void VulkanModelViewer::beginRenderPasses() {
 //
 void VulkanModelViewer::beginPresentRenderPasses() {
 	beginDefaultRenderPass();
-	if (_indices.size() > 0)
+	if (!_shapes.empty())
 		beginObjectRenderPasses();
 }
 
@@ -1169,334 +2466,530 @@ void VulkanModelViewer::beginDefaultRenderPass() {
 // Start the render passes for object rendering
 //
 void VulkanModelViewer::beginObjectRenderPasses() {
-	beginNoShadowSceneRenderPass();
-	beginSceneRenderPass();
-	beginNoShadowSceneBlankModelRenderPass();
-	beginSceneBlankModelRenderPass();
-	beginShadowRenderPass();
-	beginWireframeRenderPass();
+	auto recordStartTime = std::chrono::high_resolution_clock::now();
+	_meshletCullingRecorded = useMeshletCulling();
+	if (_meshletCullingRecorded) {
+		fillMeshletCullItems();
+		beginMeshletCullingPass();
+	}
+	buildDrawLists();
+	_drawRecordStats.workers = 0;
+	_drawRecordStats.secondaryCommandBuffers = 0;
+	_drawRecordStats.everyFrame = false;
+	for (size_t i = 0; i < static_cast<size_t>(m_swapchainImageNum); i++) {
+		beginNoShadowSceneRenderPass(i);
+		beginSceneRenderPass(i);
+		beginNoShadowSceneBlankModelRenderPass(i);
+		beginSceneBlankModelRenderPass(i);
+		beginShadowRenderPass(i);
+		beginWireframeRenderPass(i);
+	}
+	_objectPassesStale = false;
+	auto recordEndTime = std::chrono::high_resolution_clock::now();
+	_drawRecordStats.recordMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(recordEndTime - recordStartTime).count();
 }
 
 //--------------------------------------------------------------------------------------------------
-// Begin the scene render pass
-//
-void VulkanModelViewer::beginSceneRenderPass() {
-	for (size_t i = 0; i < _commandBuffers.sceneCommandBuffers.size(); i++) {
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0; // Optional
-		beginInfo.pInheritanceInfo = nullptr; // Optional
-
-		if (vkBeginCommandBuffer(_commandBuffers.sceneCommandBuffers[i], &beginInfo) != VK_SUCCESS) {
-			throw std::runtime_error("failed to begin recording command buffer!");
-		}
+// Record the object passes the frame of a swapchain image submits, from the levels of detail selected
+// now. The image is free, its last frame finished.
+//
+void VulkanModelViewer::recordFrameObjectPasses(uint32_t imageIndex) {
+	auto recordStartTime = std::chrono::high_resolution_clock::now();
+	buildDrawLists();
+	_drawRecordStats.workers = 0;
+	_drawRecordStats.secondaryCommandBuffers = 0;
+	_drawRecordStats.everyFrame = true;
+	if (_shadowOption == SHADOW_MAPPING)
+		beginShadowRenderPass(imageIndex);
+	if (_shaderOption == SCENE && _shadowOption == NO_SHADOW)
+		beginNoShadowSceneRenderPass(imageIndex);
+	else if (_shaderOption == SCENE && _shadowOption == SHADOW_MAPPING)
+		beginSceneRenderPass(imageIndex);
+	else if (_shaderOption == WIREFRAME_SOLID && _shadowOption == NO_SHADOW)
+		beginNoShadowSceneBlankModelRenderPass(imageIndex);
+	else if (_shaderOption == WIREFRAME_SOLID && _shadowOption == SHADOW_MAPPING)
+		beginSceneBlankModelRenderPass(imageIndex);
+	if (_shaderOption == WIREFRAME_HOLLOW || _shaderOption == WIREFRAME_SOLID)
+		beginWireframeRenderPass(imageIndex);
+	auto recordEndTime = std::chrono::high_resolution_clock::now();
+	_drawRecordStats.recordMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(recordEndTime - recordStartTime).count();
+}
 
-		//Begin the render pass
-		VkRenderPassBeginInfo renderPassInfoScene{};
-		renderPassInfoScene.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfoScene.renderPass = _renderPasses.sceneRenderPass;
-		renderPassInfoScene.framebuffer = _sceneFramebuffers[i];
-		renderPassInfoScene.renderArea.offset = { 0, 0 };
-		renderPassInfoScene.renderArea.extent = m_swapchainExtent;
+//--------------------------------------------------------------------------------------------------
+// Begin the scene render pass, no pass loads its multisampled targets after it
+//
+void VulkanModelViewer::beginSceneRenderPass(size_t imageIndex) {
+	VkCommandBuffer currentCommandBuffer = _commandBuffers.sceneCommandBuffers[imageIndex];
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = 0; // Optional
+	beginInfo.pInheritanceInfo = nullptr; // Optional
 
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { {1.0f, 1.0f, 1.0f, 1.0f} };
-		clearValues[1].depthStencil = { 1.0f, 0 };
+	if (vkBeginCommandBuffer(currentCommandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording command buffer!");
+	}
 
-		renderPassInfoScene.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfoScene.pClearValues = clearValues.data();
+	//Begin the render pass
+	VkRenderPassBeginInfo renderPassInfoScene{};
+	renderPassInfoScene.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfoScene.renderPass = _renderPasses.sceneLastRenderPass;
+	renderPassInfoScene.framebuffer = _sceneFramebuffers[imageIndex];
+	renderPassInfoScene.renderArea.offset = { 0, 0 };
+	renderPassInfoScene.renderArea.extent = m_swapchainExtent;
+
+	std::array<VkClearValue, 2> clearValues{};
+	clearValues[0].color = { {1.0f, 1.0f, 1.0f, 1.0f} };
+	clearValues[1].depthStencil = { 1.0f, 0 };
+
+	renderPassInfoScene.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderPassInfoScene.pClearValues = clearValues.data();
+
+	//The scene pass is timed on the GPU, from the start of the render pass to the end of its draws
+	if (_timestampQueryPool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(currentCommandBuffer, _timestampQueryPool, 2 * imageIndex, 2);
+		vkCmdWriteTimestamp(currentCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _timestampQueryPool, 2 * imageIndex);
+	}
 
-		vkCmdBeginRenderPass(_commandBuffers.sceneCommandBuffers[i], &renderPassInfoScene, VK_SUBPASS_CONTENTS_INLINE);
+	_drawRecordStats.draws = recordObjectPass(currentCommandBuffer, imageIndex, SCENE_OBJECT_PASS, renderPassInfoScene, [&](VkCommandBuffer commandBuffer) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.scenePipeline);
 
-		vkCmdBindPipeline(_commandBuffers.sceneCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.scenePipeline);
-		
-		VkBuffer vertexBuffers[] = { _vertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(_commandBuffers.sceneCommandBuffers[i], 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(_commandBuffers.sceneCommandBuffers[i], _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		bindVertexStreams(commandBuffer, SCENE_VERTEX_STREAMS);
+		vkCmdBindIndexBuffer(commandBuffer, _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
-		std::vector<VkDescriptorSet> descSets(2);
-		descSets[0] = _descriptorSets.sceneDescriptorSets[i];
-		for (Shape shape : _shapes) {
-			for (MaterialGroup matGroup : shape.materialGroups) {
-				int materialId = matGroup.materialId;
-				descSets[1] = _descriptorSets.materialDescriptorSets[materialId];
-				vkCmdBindDescriptorSets(_commandBuffers.sceneCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayouts.scenePipelineLayout, 0, descSets.size(), descSets.data(), 0, nullptr);
-				vkCmdDrawIndexed(_commandBuffers.sceneCommandBuffers[i], matGroup.indexCount, 1, matGroup.indexBase, 0, 0);
-			}
-		}
+		//The camera and the light of this image's region of the frame uniform ring, in binding order
+		std::array<uint32_t, 2> dynamicOffsets = { _uniformBuffers.frameUniforms.dynamicOffset(imageIndex, _uniformBuffers.cameraSlot),
+			_uniformBuffers.frameUniforms.dynamicOffset(imageIndex, _uniformBuffers.lightSlot) };
+		//The material set holds every material and texture, it is bound once for all draws
+		std::array<VkDescriptorSet, 2> descSets = { _descriptorSets.sceneDescriptorSet, _descriptorSets.materialDescriptorSet };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayouts.scenePipelineLayout, 0, descSets.size(), descSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+		int materialOverride = NO_MATERIAL_OVERRIDE;
+		vkCmdPushConstants(commandBuffer, _pipelineLayouts.scenePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(int), &materialOverride);
+	}, true);
 
-		vkCmdEndRenderPass(_commandBuffers.sceneCommandBuffers[i]);
+	if (_timestampQueryPool != VK_NULL_HANDLE)
+		vkCmdWriteTimestamp(currentCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _timestampQueryPool, 2 * imageIndex + 1);
 
 
-		if (vkEndCommandBuffer(_commandBuffers.sceneCommandBuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to record command buffer!");
-		}
+	if (vkEndCommandBuffer(currentCommandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record command buffer!");
 	}
 }
 
 //--------------------------------------------------------------------------------------------------
-// Begin the scene render pass
+// Begin the scene render pass, no pass loads its multisampled targets after it
 //
-void VulkanModelViewer::beginNoShadowSceneRenderPass() {
-	for (size_t i = 0; i < _commandBuffers.sceneNoShadowCommandBuffers.size(); i++) {
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0; // Optional
-		beginInfo.pInheritanceInfo = nullptr; // Optional
-
-		if (vkBeginCommandBuffer(_commandBuffers.sceneNoShadowCommandBuffers[i], &beginInfo) != VK_SUCCESS) {
-			throw std::runtime_error("failed to begin recording command buffer!");
-		}
-
-		//Begin the render pass
-		VkRenderPassBeginInfo renderPassInfoScene{};
-		renderPassInfoScene.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfoScene.renderPass = _renderPasses.sceneRenderPass;
-		renderPassInfoScene.framebuffer = _sceneFramebuffers[i];
-		renderPassInfoScene.renderArea.offset = { 0, 0 };
-		renderPassInfoScene.renderArea.extent = m_swapchainExtent;
-
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { {1.0f, 1.0f, 1.0f, 1.0f} };
-		clearValues[1].depthStencil = { 1.0f, 0 };
+void VulkanModelViewer::beginNoShadowSceneRenderPass(size_t imageIndex) {
+	VkCommandBuffer currentCommandBuffer = _commandBuffers.sceneNoShadowCommandBuffers[imageIndex];
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = 0; // Optional
+	beginInfo.pInheritanceInfo = nullptr; // Optional
 
-		renderPassInfoScene.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfoScene.pClearValues = clearValues.data();
+	if (vkBeginCommandBuffer(currentCommandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording command buffer!");
+	}
 
-		vkCmdBeginRenderPass(_commandBuffers.sceneNoShadowCommandBuffers[i], &renderPassInfoScene, VK_SUBPASS_CONTENTS_INLINE);
+	//Begin the render pass
+	VkRenderPassBeginInfo renderPassInfoScene{};
+	renderPassInfoScene.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfoScene.renderPass = _renderPasses.sceneLastRenderPass;
+	renderPassInfoScene.framebuffer = _sceneFramebuffers[imageIndex];
+	renderPassInfoScene.renderArea.offset = { 0, 0 };
+	renderPassInfoScene.renderArea.extent = m_swapchainExtent;
+
+	std::array<VkClearValue, 2> clearValues{};
+	clearValues[0].color = { {1.0f, 1.0f, 1.0f, 1.0f} };
+	clearValues[1].depthStencil = { 1.0f, 0 };
+
+	renderPassInfoScene.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderPassInfoScene.pClearValues = clearValues.data();
+
+	//The scene pass is timed on the GPU, from the start of the render pass to the end of its draws
+	if (_timestampQueryPool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(currentCommandBuffer, _timestampQueryPool, 2 * imageIndex, 2);
+		vkCmdWriteTimestamp(currentCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _timestampQueryPool, 2 * imageIndex);
+	}
 
-		vkCmdBindPipeline(_commandBuffers.sceneNoShadowCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.scenePipeline);
+	_drawRecordStats.draws = recordObjectPass(currentCommandBuffer, imageIndex, SCENE_NO_SHADOW_OBJECT_PASS, renderPassInfoScene, [&](VkCommandBuffer commandBuffer) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.scenePipeline);
 
-		VkBuffer vertexBuffers[] = { _vertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(_commandBuffers.sceneNoShadowCommandBuffers[i], 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(_commandBuffers.sceneNoShadowCommandBuffers[i], _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		bindVertexStreams(commandBuffer, SCENE_VERTEX_STREAMS);
+		vkCmdBindIndexBuffer(commandBuffer, _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
-		std::vector<VkDescriptorSet> descSets(2);
-		descSets[0] = _descriptorSets.sceneNoShadowDescriptorSets[i];
-		for (Shape shape : _shapes) {
-			for (MaterialGroup matGroup : shape.materialGroups) {
-				int materialId = matGroup.materialId;
-				descSets[1] = _descriptorSets.materialDescriptorSets[materialId];
-				vkCmdBindDescriptorSets(_commandBuffers.sceneNoShadowCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayouts.scenePipelineLayout, 0, descSets.size(), descSets.data(), 0, nullptr);
-				vkCmdDrawIndexed(_commandBuffers.sceneNoShadowCommandBuffers[i], matGroup.indexCount, 1, matGroup.indexBase, 0, 0);
-			}
-		}
+		//The camera and the light of this image's region of the frame uniform ring, in binding order
+		std::array<uint32_t, 2> dynamicOffsets = { _uniformBuffers.frameUniforms.dynamicOffset(imageIndex, _uniformBuffers.cameraSlot),
+			_uniformBuffers.frameUniforms.dynamicOffset(imageIndex, _uniformBuffers.lightSlot) };
+		//The material set holds every material and texture, it is bound once for all draws
+		std::array<VkDescriptorSet, 2> descSets = { _descriptorSets.sceneNoShadowDescriptorSet, _descriptorSets.materialDescriptorSet };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayouts.scenePipelineLayout, 0, descSets.size(), descSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+		int materialOverride = NO_MATERIAL_OVERRIDE;
+		vkCmdPushConstants(commandBuffer, _pipelineLayouts.scenePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(int), &materialOverride);
+	}, true);
 
-		vkCmdEndRenderPass(_commandBuffers.sceneNoShadowCommandBuffers[i]);
+	if (_timestampQueryPool != VK_NULL_HANDLE)
+		vkCmdWriteTimestamp(currentCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _timestampQueryPool, 2 * imageIndex + 1);
 
 
-		if (vkEndCommandBuffer(_commandBuffers.sceneNoShadowCommandBuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to record command buffer!");
-		}
+	if (vkEndCommandBuffer(currentCommandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record command buffer!");
 	}
 }
 
 //--------------------------------------------------------------------------------------------------
 // Begin the scene render pass with all models blank
 //
-void VulkanModelViewer::beginSceneBlankModelRenderPass() {
-	for (size_t i = 0; i < _commandBuffers.sceneBlankModelCommandBuffers.size(); i++) {
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0; // Optional
-		beginInfo.pInheritanceInfo = nullptr; // Optional
-
-		if (vkBeginCommandBuffer(_commandBuffers.sceneBlankModelCommandBuffers[i], &beginInfo) != VK_SUCCESS) {
-			throw std::runtime_error("failed to begin recording command buffer!");
-		}
+void VulkanModelViewer::beginSceneBlankModelRenderPass(size_t imageIndex) {
+	VkCommandBuffer currentCommandBuffer = _commandBuffers.sceneBlankModelCommandBuffers[imageIndex];
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = 0; // Optional
+	beginInfo.pInheritanceInfo = nullptr; // Optional
 
-		//Begin the render pass
-		VkRenderPassBeginInfo renderPassInfoScene{};
-		renderPassInfoScene.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfoScene.renderPass = _renderPasses.sceneRenderPass;
-		renderPassInfoScene.framebuffer = _sceneFramebuffers[i];
-		renderPassInfoScene.renderArea.offset = { 0, 0 };
-		renderPassInfoScene.renderArea.extent = m_swapchainExtent;
+	if (vkBeginCommandBuffer(currentCommandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording command buffer!");
+	}
 
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { {1.0f, 1.0f, 1.0f, 1.0f} };
-		clearValues[1].depthStencil = { 1.0f, 0 };
+	//Begin the render pass
+	VkRenderPassBeginInfo renderPassInfoScene{};
+	renderPassInfoScene.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfoScene.renderPass = _renderPasses.sceneRenderPass;
+	renderPassInfoScene.framebuffer = _sceneFramebuffers[imageIndex];
+	renderPassInfoScene.renderArea.offset = { 0, 0 };
+	renderPassInfoScene.renderArea.extent = m_swapchainExtent;
 
-		renderPassInfoScene.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfoScene.pClearValues = clearValues.data();
+	std::array<VkClearValue, 2> clearValues{};
+	clearValues[0].color = { {1.0f, 1.0f, 1.0f, 1.0f} };
+	clearValues[1].depthStencil = { 1.0f, 0 };
 
-		vkCmdBeginRenderPass(_commandBuffers.sceneBlankModelCommandBuffers[i], &renderPassInfoScene, VK_SUBPASS_CONTENTS_INLINE);
+	renderPassInfoScene.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderPassInfoScene.pClearValues = clearValues.data();
 
-		vkCmdBindPipeline(_commandBuffers.sceneBlankModelCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.scenePipeline);
+	recordObjectPass(currentCommandBuffer, imageIndex, SCENE_BLANK_MODEL_OBJECT_PASS, renderPassInfoScene, [&](VkCommandBuffer commandBuffer) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.scenePipeline);
 
-		VkBuffer vertexBuffers[] = { _vertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(_commandBuffers.sceneBlankModelCommandBuffers[i], 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(_commandBuffers.sceneBlankModelCommandBuffers[i], _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		bindVertexStreams(commandBuffer, SCENE_VERTEX_STREAMS);
+		vkCmdBindIndexBuffer(commandBuffer, _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
+		//The camera and the light of this image's region of the frame uniform ring, in binding order
+		std::array<uint32_t, 2> dynamicOffsets = { _uniformBuffers.frameUniforms.dynamicOffset(imageIndex, _uniformBuffers.cameraSlot),
+			_uniformBuffers.frameUniforms.dynamicOffset(imageIndex, _uniformBuffers.lightSlot) };
 		std::vector<VkDescriptorSet> descSets(2);
-		descSets[0] = _descriptorSets.sceneDescriptorSets[i];
-		descSets[1] = _descriptorSets.materialDescriptorSets[0];
+		descSets[0] = _descriptorSets.sceneDescriptorSet;
+		descSets[1] = _descriptorSets.materialDescriptorSet;
 
-		vkCmdBindDescriptorSets(_commandBuffers.sceneBlankModelCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayouts.sceneNoLightingPipelineLayout, 0, descSets.size(), descSets.data(), 0, nullptr);
-		vkCmdDrawIndexed(_commandBuffers.sceneBlankModelCommandBuffers[i], _indices.size(), 1, 0, 0, 0);
-		vkCmdEndRenderPass(_commandBuffers.sceneBlankModelCommandBuffers[i]);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayouts.sceneNoLightingPipelineLayout, 0, descSets.size(), descSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+		//Every vertex shows the default material
+		int materialOverride = 0;
+		vkCmdPushConstants(commandBuffer, _pipelineLayouts.sceneNoLightingPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(int), &materialOverride);
+	}, true);
 
-		if (vkEndCommandBuffer(_commandBuffers.sceneBlankModelCommandBuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to record command buffer!");
-		}
+	if (vkEndCommandBuffer(currentCommandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record command buffer!");
 	}
 }
 
 //--------------------------------------------------------------------------------------------------
 // Begin the scene render pass with all models blank
 //
-void VulkanModelViewer::beginNoShadowSceneBlankModelRenderPass() {
-	for (size_t i = 0; i < _commandBuffers.sceneNoShadowBlankModelCommandBuffers.size(); i++) {
-		VkCommandBuffer currentCommandBuffer = _commandBuffers.sceneNoShadowBlankModelCommandBuffers[i];
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0; // Optional
-		beginInfo.pInheritanceInfo = nullptr; // Optional
-
-		if (vkBeginCommandBuffer(currentCommandBuffer, &beginInfo) != VK_SUCCESS) {
-			throw std::runtime_error("failed to begin recording command buffer!");
-		}
+void VulkanModelViewer::beginNoShadowSceneBlankModelRenderPass(size_t imageIndex) {
+	VkCommandBuffer currentCommandBuffer = _commandBuffers.sceneNoShadowBlankModelCommandBuffers[imageIndex];
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = 0; // Optional
+	beginInfo.pInheritanceInfo = nullptr; // Optional
 
-		//Begin the render pass
-		VkRenderPassBeginInfo renderPassInfoScene{};
-		renderPassInfoScene.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfoScene.renderPass = _renderPasses.sceneRenderPass;
-		renderPassInfoScene.framebuffer = _sceneFramebuffers[i];
-		renderPassInfoScene.renderArea.offset = { 0, 0 };
-		renderPassInfoScene.renderArea.extent = m_swapchainExtent;
+	if (vkBeginCommandBuffer(currentCommandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording command buffer!");
+	}
 
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { {1.0f, 1.0f, 1.0f, 1.0f} };
-		clearValues[1].depthStencil = { 1.0f, 0 };
+	//Begin the render pass
+	VkRenderPassBeginInfo renderPassInfoScene{};
+	renderPassInfoScene.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfoScene.renderPass = _renderPasses.sceneRenderPass;
+	renderPassInfoScene.framebuffer = _sceneFramebuffers[imageIndex];
+	renderPassInfoScene.renderArea.offset = { 0, 0 };
+	renderPassInfoScene.renderArea.extent = m_swapchainExtent;
 
-		renderPassInfoScene.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfoScene.pClearValues = clearValues.data();
+	std::array<VkClearValue, 2> clearValues{};
+	clearValues[0].color = { {1.0f, 1.0f, 1.0f, 1.0f} };
+	clearValues[1].depthStencil = { 1.0f, 0 };
 
-		vkCmdBeginRenderPass(currentCommandBuffer, &renderPassInfoScene, VK_SUBPASS_CONTENTS_INLINE);
+	renderPassInfoScene.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderPassInfoScene.pClearValues = clearValues.data();
 
-		vkCmdBindPipeline(currentCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.sceneNoLightingPipeline);
+	recordObjectPass(currentCommandBuffer, imageIndex, SCENE_NO_SHADOW_BLANK_MODEL_OBJECT_PASS, renderPassInfoScene, [&](VkCommandBuffer commandBuffer) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.sceneNoLightingPipeline);
 
-		VkBuffer vertexBuffers[] = { _vertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(currentCommandBuffer, 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(currentCommandBuffer, _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		bindVertexStreams(commandBuffer, SCENE_VERTEX_STREAMS);
+		vkCmdBindIndexBuffer(commandBuffer, _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
+		//The camera and the light of this image's region of the frame uniform ring, in binding order
+		std::array<uint32_t, 2> dynamicOffsets = { _uniformBuffers.frameUniforms.dynamicOffset(imageIndex, _uniformBuffers.cameraSlot),
+			_uniformBuffers.frameUniforms.dynamicOffset(imageIndex, _uniformBuffers.lightSlot) };
 		std::vector<VkDescriptorSet> descSets(2);
-		descSets[0] = _descriptorSets.sceneNoShadowDescriptorSets[i];
-		descSets[1] = _descriptorSets.materialDescriptorSets[0];
+		descSets[0] = _descriptorSets.sceneNoShadowDescriptorSet;
+		descSets[1] = _descriptorSets.materialDescriptorSet;
 
-		vkCmdBindDescriptorSets(currentCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayouts.sceneNoLightingPipelineLayout, 0, descSets.size(), descSets.data(), 0, nullptr);
-		vkCmdDrawIndexed(currentCommandBuffer, _indices.size(), 1, 0, 0, 0);
-		vkCmdEndRenderPass(currentCommandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayouts.sceneNoLightingPipelineLayout, 0, descSets.size(), descSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+		//Every vertex shows the default material
+		int materialOverride = 0;
+		vkCmdPushConstants(commandBuffer, _pipelineLayouts.sceneNoLightingPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(int), &materialOverride);
+	}, true);
 
-		if (vkEndCommandBuffer(currentCommandBuffer) != VK_SUCCESS) {
-			throw std::runtime_error("failed to record command buffer!");
-		}
+	if (vkEndCommandBuffer(currentCommandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record command buffer!");
 	}
 }
 
 //--------------------------------------------------------------------------------------------------
 // Begin the wireframe render pass
 //
-void VulkanModelViewer::beginWireframeRenderPass() {
-	for (size_t i = 0; i < _commandBuffers.wireframeCommandBuffers.size(); i++) {
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0; // Optional
-		beginInfo.pInheritanceInfo = nullptr; // Optional
-
-		if (vkBeginCommandBuffer(_commandBuffers.wireframeCommandBuffers[i], &beginInfo) != VK_SUCCESS) {
-			throw std::runtime_error("failed to begin recording command buffer!");
-		}
+void VulkanModelViewer::beginWireframeRenderPass(size_t imageIndex) {
+	VkCommandBuffer currentCommandBuffer = _commandBuffers.wireframeCommandBuffers[imageIndex];
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = 0; // Optional
+	beginInfo.pInheritanceInfo = nullptr; // Optional
 
-		//Begin the render pass
-		VkRenderPassBeginInfo renderPassInfoScene{};
-		renderPassInfoScene.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfoScene.renderPass = _renderPasses.wireframeRenderPass;
-		renderPassInfoScene.framebuffer = _sceneFramebuffers[i];
-		renderPassInfoScene.renderArea.offset = { 0, 0 };
-		renderPassInfoScene.renderArea.extent = m_swapchainExtent;
+	if (vkBeginCommandBuffer(currentCommandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording command buffer!");
+	}
 
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { {1.0f, 1.0f, 1.0f, 1.0f} };
-		clearValues[1].depthStencil = { 1.0f, 0 };
+	//Begin the render pass
+	VkRenderPassBeginInfo renderPassInfoScene{};
+	renderPassInfoScene.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfoScene.renderPass = _renderPasses.wireframeRenderPass;
+	renderPassInfoScene.framebuffer = _sceneFramebuffers[imageIndex];
+	renderPassInfoScene.renderArea.offset = { 0, 0 };
+	renderPassInfoScene.renderArea.extent = m_swapchainExtent;
 
-		renderPassInfoScene.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfoScene.pClearValues = clearValues.data();
+	std::array<VkClearValue, 2> clearValues{};
+	clearValues[0].color = { {1.0f, 1.0f, 1.0f, 1.0f} };
+	clearValues[1].depthStencil = { 1.0f, 0 };
 
-		vkCmdBeginRenderPass(_commandBuffers.wireframeCommandBuffers[i], &renderPassInfoScene, VK_SUBPASS_CONTENTS_INLINE);
+	renderPassInfoScene.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderPassInfoScene.pClearValues = clearValues.data();
 
-		vkCmdBindPipeline(_commandBuffers.wireframeCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.wireframePipeline);
+	recordObjectPass(currentCommandBuffer, imageIndex, WIREFRAME_OBJECT_PASS, renderPassInfoScene, [&](VkCommandBuffer commandBuffer) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.wireframePipeline);
 
-		VkBuffer vertexBuffers[] = { _vertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(_commandBuffers.wireframeCommandBuffers[i], 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(_commandBuffers.wireframeCommandBuffers[i], _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		bindVertexStreams(commandBuffer, WIREFRAME_VERTEX_STREAMS);
+		vkCmdBindIndexBuffer(commandBuffer, _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
-		VkDescriptorSet descSet = _descriptorSets.cameraDescriptorSets[i];
-		vkCmdBindDescriptorSets(_commandBuffers.wireframeCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayouts.wireframePipelineLayout, 0, 1, &descSet, 0, nullptr);
-		vkCmdDrawIndexed(_commandBuffers.wireframeCommandBuffers[i], _indices.size(), 1, 0, 0, 0);
-		vkCmdEndRenderPass(_commandBuffers.wireframeCommandBuffers[i]);
+		uint32_t cameraOffset = _uniformBuffers.frameUniforms.dynamicOffset(imageIndex, _uniformBuffers.cameraSlot);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayouts.wireframePipelineLayout, 0, 1, &_descriptorSets.cameraDescriptorSet, 1, &cameraOffset);
+	}, false);
 
-		if (vkEndCommandBuffer(_commandBuffers.wireframeCommandBuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to record command buffer!");
-		}
+	if (vkEndCommandBuffer(currentCommandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record command buffer!");
 	}
 }
 
 //--------------------------------------------------------------------------------------------------
 // Begin the scene render pass
 //
-void VulkanModelViewer::beginShadowRenderPass() {
-	for (size_t i = 0; i < _commandBuffers.shadowCommandBuffers.size(); i++) {
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0; // Optional
-		beginInfo.pInheritanceInfo = nullptr; // Optional
+void VulkanModelViewer::beginShadowRenderPass(size_t imageIndex) {
+	VkCommandBuffer currentCommandBuffer = _commandBuffers.shadowCommandBuffers[imageIndex];
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = 0; // Optional
+	beginInfo.pInheritanceInfo = nullptr; // Optional
 
-		if (vkBeginCommandBuffer(_commandBuffers.shadowCommandBuffers[i], &beginInfo) != VK_SUCCESS) {
-			throw std::runtime_error("failed to begin recording command buffer!");
+	if (vkBeginCommandBuffer(currentCommandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording command buffer!");
+	}
+
+	//Begin the render pass
+	VkRenderPassBeginInfo renderPassInfoShadow{};
+	renderPassInfoShadow.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfoShadow.renderPass = _renderPasses.shadowRenderPass;
+	renderPassInfoShadow.framebuffer = _shadowFramebuffers[imageIndex];
+	renderPassInfoShadow.renderArea.offset = { 0, 0 };
+	renderPassInfoShadow.renderArea.extent = m_shadowMapExtent;
+
+	VkClearValue clearValue{};
+	clearValue.depthStencil = { 1.0f, 0 };
+
+	renderPassInfoShadow.clearValueCount = 1;
+	renderPassInfoShadow.pClearValues = &clearValue;
+
+	recordObjectPass(currentCommandBuffer, imageIndex, SHADOW_OBJECT_PASS, renderPassInfoShadow, [&](VkCommandBuffer commandBuffer) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.shadowPipeline);
+
+		bindVertexStreams(commandBuffer, SHADOW_VERTEX_STREAMS);
+		vkCmdBindIndexBuffer(commandBuffer, _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+
+		uint32_t lightOffset = _uniformBuffers.frameUniforms.dynamicOffset(imageIndex, _uniformBuffers.lightSlot);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayouts.shadowPipelineLayout, 0, 1, &_descriptorSets.lightDescriptorSet, 1, &lightOffset);
+	}, false);
+
+
+	if (vkEndCommandBuffer(currentCommandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record command buffer!");
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Build the draw lists of the selected level of detail of every shape. The fragments read their
+// material and textures by the material id of the vertices, so adjacent index ranges are drawn
+// together whatever their material and a model drawn at one level takes a single draw per level.
+// With the meshlet culling recorded the scene passes draw every material group from its meshlets.
+//
+void VulkanModelViewer::buildDrawLists() {
+	_drawLists.ranges.clear();
+	_drawLists.culledGroups.clear();
+	_drawRecordStats.materialGroups = 0;
+	int32_t drawGroup = 0;
+	for (const Shape& shape : _shapes) {
+		for (const MaterialGroup& group : getLodMaterialGroups(shape)) {
+			_drawRecordStats.materialGroups++;
+			if (_meshletCullingRecorded)
+				_drawLists.culledGroups.push_back({ uint32_t(group.indexBase), uint32_t(group.indexCount), drawGroup++ });
+			DrawListItem* range = _drawLists.ranges.empty() ? nullptr : &_drawLists.ranges.back();
+			if (range && range->indexBase + range->indexCount == uint32_t(group.indexBase))
+				range->indexCount += group.indexCount;
+			else
+				_drawLists.ranges.push_back({ uint32_t(group.indexBase), uint32_t(group.indexCount), -1 });
 		}
+	}
+}
 
-		//Begin the render pass
-		VkRenderPassBeginInfo renderPassInfoShadow{};
-		renderPassInfoShadow.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfoShadow.renderPass = _renderPasses.shadowRenderPass;
-		renderPassInfoShadow.framebuffer = _shadowFramebuffers[i];
-		renderPassInfoShadow.renderArea.offset = { 0, 0 };
-		renderPassInfoShadow.renderArea.extent = m_shadowMapExtent;
+//--------------------------------------------------------------------------------------------------
+// Record an object pass of a swapchain image into the primary command buffer, returns the number of
+// draws. bindState binds the pipeline and its resources in a command buffer drawing the pass; culled
+// passes draw the culled meshlets if the culling is recorded. A large draw list is split across the
+// draw recording workers, each recording its slice into a secondary command buffer from its own
+// pool, which the primary executes in order.
+//
+uint32_t VulkanModelViewer::recordObjectPass(VkCommandBuffer commandBuffer, size_t imageIndex, ObjectPass pass, const VkRenderPassBeginInfo& renderPassInfo,
+	const std::function<void(VkCommandBuffer)>& bindState, bool culled) {
+	const std::vector<DrawListItem>& items = culled && _meshletCullingRecorded ? _drawLists.culledGroups : _drawLists.ranges;
+	size_t workerCount = getDrawRecordWorkerCount(items.size());
+	_drawRecordStats.workers = std::max(_drawRecordStats.workers, workerCount);
+	if (workerCount <= 1) {
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		bindState(commandBuffer);
+		recordDrawItems(commandBuffer, imageIndex, items, 0, items.size());
+		vkCmdEndRenderPass(commandBuffer);
+		return static_cast<uint32_t>(items.size());
+	}
 
-		VkClearValue clearValue{};
-		clearValue.depthStencil = { 1.0f, 0 };
+	std::vector<VkCommandBuffer> secondaryCommandBuffers(workerCount);
+	for (size_t worker = 0; worker < workerCount; worker++)
+		secondaryCommandBuffers[worker] = _commandBuffers.objectPassCommandBuffers[worker][pass * m_swapchainImageNum + imageIndex];
 
-		renderPassInfoShadow.clearValueCount = 1;
-		renderPassInfoShadow.pClearValues = &clearValue;
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderPassInfo.renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = renderPassInfo.framebuffer;
 
-		vkCmdBeginRenderPass(_commandBuffers.shadowCommandBuffers[i], &renderPassInfoShadow, VK_SUBPASS_CONTENTS_INLINE);
+	//Workers only touch their own secondary command buffer and pool, failures are reported after all of them finished
+	std::vector<uint8_t> failed(workerCount, 0);
+	_drawRecordWorkers.run(workerCount, [&](size_t worker) {
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+		if (vkBeginCommandBuffer(secondaryCommandBuffers[worker], &beginInfo) != VK_SUCCESS) {
+			failed[worker] = 1;
+			return;
+		}
+		bindState(secondaryCommandBuffers[worker]);
+		recordDrawItems(secondaryCommandBuffers[worker], imageIndex, items, items.size() * worker / workerCount, items.size() * (worker + 1) / workerCount);
+		if (vkEndCommandBuffer(secondaryCommandBuffers[worker]) != VK_SUCCESS)
+			failed[worker] = 1;
+	});
+	if (std::find(failed.begin(), failed.end(), 1) != failed.end())
+		throw std::runtime_error("failed to record secondary command buffer!");
 
-		vkCmdBindPipeline(_commandBuffers.shadowCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.shadowPipeline);
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+	vkCmdEndRenderPass(commandBuffer);
+	_drawRecordStats.secondaryCommandBuffers += workerCount;
+	return static_cast<uint32_t>(items.size());
+}
 
-		VkBuffer vertexBuffers[] = { _vertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(_commandBuffers.shadowCommandBuffers[i], 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(_commandBuffers.shadowCommandBuffers[i], _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+//--------------------------------------------------------------------------------------------------
+// Get the number of workers recording a draw list, one records it inline
+//
+size_t VulkanModelViewer::getDrawRecordWorkerCount(size_t drawCount) {
+	size_t threadCount = _recordThreadCount > 0 ? static_cast<size_t>(_recordThreadCount) : default_thread_count();
+	size_t workerCount = std::min({ threadCount, _drawRecordPools.size(), drawCount / DRAW_RECORD_MIN_WORKER_DRAWS });
+	return std::max<size_t>(workerCount, 1);
+}
 
+//--------------------------------------------------------------------------------------------------
+// Record the draws [begin, end) of a draw list
+//
+void VulkanModelViewer::recordDrawItems(VkCommandBuffer commandBuffer, size_t imageIndex, const std::vector<DrawListItem>& items, size_t begin, size_t end) {
+	for (size_t i = begin; i < end; i++) {
+		if (items[i].drawGroup >= 0)
+			drawMaterialGroup(commandBuffer, imageIndex, static_cast<uint32_t>(items[i].drawGroup));
+		else
+			vkCmdDrawIndexed(commandBuffer, items[i].indexCount, 1, items[i].indexBase, 0, 0);
+	}
+}
 
-		vkCmdBindDescriptorSets(_commandBuffers.shadowCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayouts.shadowPipelineLayout, 0, 1, &_descriptorSets.lightDescriptorSets[i], 0, nullptr);
-		vkCmdDrawIndexed(_commandBuffers.shadowCommandBuffers[i], _indices.size(), 1, 0, 0, 0);
+//--------------------------------------------------------------------------------------------------
+// Record the meshlet culling pass of every swapchain image: clear the draw counts, cull the meshlets
+// of the drawn groups into the draw commands and make them visible to the indirect draws and to the
+// host, which reads the counts back for the statistics.
+//
+void VulkanModelViewer::beginMeshletCullingPass() {
+	for (size_t i = 0; i < _commandBuffers.meshletCullingCommandBuffers.size(); i++) {
+		VkCommandBuffer currentCommandBuffer = _commandBuffers.meshletCullingCommandBuffers[i];
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = 0; // Optional
+		beginInfo.pInheritanceInfo = nullptr; // Optional
 
-		vkCmdEndRenderPass(_commandBuffers.shadowCommandBuffers[i]);
+		if (vkBeginCommandBuffer(currentCommandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
 
+		vkCmdFillBuffer(currentCommandBuffer, _meshletBuffers.drawCounts[i].buffer, 0, VK_WHOLE_SIZE, 0);
+		VkMemoryBarrier clearBarrier{};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(currentCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(currentCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelines.meshletCullingPipeline);
+		uint32_t cameraOffset = _uniformBuffers.frameUniforms.dynamicOffset(i, _uniformBuffers.cameraSlot);
+		vkCmdBindDescriptorSets(currentCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayouts.meshletCullingPipelineLayout, 0, 1, &_descriptorSets.meshletCullingDescriptorSets[i], 1, &cameraOffset);
+		uint32_t itemCount = static_cast<uint32_t>(_meshletCullingStats.drawnMeshlets);
+		vkCmdDispatch(currentCommandBuffer, (itemCount + MESHLET_CULLING_WORKGROUP_SIZE - 1) / MESHLET_CULLING_WORKGROUP_SIZE, 1, 1);
+
+		VkMemoryBarrier cullBarrier{};
+		cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(currentCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
 
-		if (vkEndCommandBuffer(_commandBuffers.shadowCommandBuffers[i]) != VK_SUCCESS) {
+		if (vkEndCommandBuffer(currentCommandBuffer) != VK_SUCCESS) {
 			throw std::runtime_error("failed to record command buffer!");
 		}
 	}
 }
 
+//--------------------------------------------------------------------------------------------------
+// Draw a material group from its culled meshlets, drawGroup counts the groups of the selected levels
+// in shape order. The draws of its meshlets are read from the draw commands of the swapchain image: up
+// to the culled count with drawIndirectCount, otherwise every meshlet with culled ones drawing no
+// instance, which needs multiDrawIndirect.
+//
+void VulkanModelViewer::drawMaterialGroup(VkCommandBuffer commandBuffer, size_t imageIndex, uint32_t drawGroup) {
+	const MeshletDrawGroup& meshletDrawGroup = _meshletDrawGroups[drawGroup];
+	VkDeviceSize drawOffset = sizeof(VkDrawIndexedIndirectCommand) * meshletDrawGroup.drawBase;
+	if (m_deviceFeatures12.drawIndirectCount)
+		vkCmdDrawIndexedIndirectCount(commandBuffer, _meshletBuffers.drawCommands[imageIndex].buffer, drawOffset, _meshletBuffers.drawCounts[imageIndex].buffer,
+			sizeof(uint32_t) * (1 + drawGroup), meshletDrawGroup.meshletCount, sizeof(VkDrawIndexedIndirectCommand));
+	else
+		vkCmdDrawIndexedIndirect(commandBuffer, _meshletBuffers.drawCommands[imageIndex].buffer, drawOffset, meshletDrawGroup.meshletCount, sizeof(VkDrawIndexedIndirectCommand));
+}
+
 //--------------------------------------------------------------------------------------------------
 // Begin the gui render pass
 //
@@ -1581,6 +3074,8 @@ void VulkanModelViewer::initGuiBackend() {
 //
 void VulkanModelViewer::drawFrame() {
 	vkWaitForFences(m_device, 1, &_inFlightFences[_currentFrame], VK_TRUE, UINT64_MAX);
+	_finishedFrameCount = std::max(_finishedFrameCount, _inFlightFrameNumbers[_currentFrame]);
+	destroyRetiredTextureResources();
 	uint32_t imageIndex;
 	VkResult result = vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX, _imageAvailableSemaphores[_currentFrame], VK_NULL_HANDLE, &imageIndex);
 
@@ -1591,14 +3086,23 @@ void VulkanModelViewer::drawFrame() {
 	}
 	
 	beginGuiRenderPass(imageIndex);
-	updateUniformBuffer(imageIndex);
 
 	// Check if a previous frame is using this image (i.e. there is its fence to wait on)
 	if (_imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
 		vkWaitForFences(m_device, 1, &_imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
 	}
+	//The region of the image in the frame uniform ring is free once its last frame finished
+	updateUniformBuffer(imageIndex);
 	// Mark the image as now being in use by this frame
+	if (_imagesInFlight[imageIndex] != VK_NULL_HANDLE && _meshletCullingRecorded)
+		readMeshletCullingStats(imageIndex);
+	if (_imagesInFlight[imageIndex] != VK_NULL_HANDLE && _imagesTimed[imageIndex])
+		readFrameTimestamps(imageIndex);
+	//The object passes of the image are free as well, passes recorded every frame draw the levels selected now
+	if (_recordEveryFrame && !_shapes.empty())
+		recordFrameObjectPasses(imageIndex);
 	_imagesInFlight[imageIndex] = _inFlightFences[_currentFrame];
+	_imagesTimed[imageIndex] = _timestampQueryPool != VK_NULL_HANDLE && _shaderOption == SCENE;
 
 	//Submit command buffers
 	std::vector<VkCommandBuffer> submitCommandBuffers = getDrawSubmitCommandBuffers(imageIndex);
@@ -1620,6 +3124,7 @@ void VulkanModelViewer::drawFrame() {
 	if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, _inFlightFences[_currentFrame]) != VK_SUCCESS) {
 		throw std::runtime_error("failed to submit draw command buffer!");
 	}
+	_inFlightFrameNumbers[_currentFrame] = ++_submittedFrameCount;
 
 	//Present image
 	VkPresentInfoKHR presentInfo{};
@@ -1648,6 +3153,8 @@ void VulkanModelViewer::drawFrame() {
 //
 std::vector<VkCommandBuffer> VulkanModelViewer::getDrawSubmitCommandBuffers(uint32_t imageIndex) {
 	std::vector<VkCommandBuffer> submitCommandBuffers{};
+	if (_meshletCullingRecorded && (_shaderOption == SCENE || _shaderOption == WIREFRAME_SOLID))
+		submitCommandBuffers.push_back(_commandBuffers.meshletCullingCommandBuffers[imageIndex]);
 	if (_shadowOption == SHADOW_MAPPING)
 		submitCommandBuffers.push_back(_commandBuffers.shadowCommandBuffers[imageIndex]);
 
@@ -1701,27 +3208,24 @@ void VulkanModelViewer::updateUniformBuffer(uint32_t currentImage) {
 	CameraInfoUBO cameraInfo{};
 	cameraInfo.model = _repositionMatrix;
 	cameraInfo.view = glm::lookAt(_camera.pos, _camera.pos + _camera.lookDir, _camera.upDir);;
-	cameraInfo.proj = glm::perspective(glm::radians(60.0f), m_swapchainExtent.width / (float)m_swapchainExtent.height, 0.1f, _initialDis * 10);
+	cameraInfo.proj = glm::perspective(glm::radians(CAMERA_FOV_DEGREES), m_swapchainExtent.width / (float)m_swapchainExtent.height, 0.1f, _initialDis * 10);
 	cameraInfo.proj[1][1] *= -1;
 	cameraInfo.cameraPos = _camera.pos;
+	cameraInfo.dequantize = _vertexQuantization.getDequantizeMatrix();
 
 	LightInfoUBO lightInfo{};
 	lightInfo.lightColor = _lightSource.color;
 	lightInfo.lightPos = _lightSource.pos;
-	glm::mat4 lightModel = glm::mat4(1.0f);
+	glm::mat4 lightModel = _vertexQuantization.getDequantizeMatrix();
 	glm::mat4 lightView = glm::lookAt(_lightSource.pos, _modelCenter, glm::vec3(0.0f, 0.0f, 1.0f));
 	glm::mat4 lightProj = glm::perspective(glm::radians(60.0f), m_shadowMapExtent.width / (float)m_shadowMapExtent.height, 0.1f, _initialDis * 100);
 	glm::mat4 lightMvp = lightProj * lightView * lightModel;
 	lightInfo.lightMvp = lightMvp;
 
-	void* data;
-	vkMapMemory(m_device, _uniformBuffers.cameraUniformBuffers[currentImage].bufferMemory, 0, sizeof(cameraInfo), 0, &data);
-	memcpy(data, &cameraInfo, sizeof(cameraInfo));
-	vkUnmapMemory(m_device, _uniformBuffers.cameraUniformBuffers[currentImage].bufferMemory);
-
-	vkMapMemory(m_device, _uniformBuffers.lightUniformBuffers[currentImage].bufferMemory, 0, sizeof(lightInfo), 0, &data);
-	memcpy(data, &lightInfo, sizeof(lightInfo));
-	vkUnmapMemory(m_device, _uniformBuffers.lightUniformBuffers[currentImage].bufferMemory);
+	vkimpl::VulkanUniformRing& frameUniforms = _uniformBuffers.frameUniforms;
+	frameUniforms.beginRegion(currentImage);
+	*reinterpret_cast<CameraInfoUBO*>(frameUniforms.data(currentImage, _uniformBuffers.cameraSlot)) = cameraInfo;
+	*reinterpret_cast<LightInfoUBO*>(frameUniforms.data(currentImage, _uniformBuffers.lightSlot)) = lightInfo;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -1782,6 +3286,8 @@ void VulkanModelViewer::cleanupVulkanBackend() {
 	
 	cleanupGuiVulkanBackend();
 	destroySamplers();
+	vkDestroyPipeline(m_device, _pipelines.meshletCullingPipeline, nullptr);
+	vkDestroyPipelineLayout(m_device, _pipelineLayouts.meshletCullingPipelineLayout, nullptr);
 	destroyDescriptorSetLayouts();
 	destroySceneResources();
 
@@ -1792,9 +3298,14 @@ void VulkanModelViewer::cleanupVulkanBackend() {
 	}
 
 	vkDestroyCommandPool(m_device, _commandPool, nullptr);
+	_drawRecordWorkers.destroy();
+	for (VkCommandPool drawRecordPool : _drawRecordPools)
+		vkDestroyCommandPool(m_device, drawRecordPool, nullptr);
 
 	vkimpl::VulkanDebugUtil::DestroyDebugUtilsMessengerEXT(m_instance, m_debugMessenger, nullptr);
 
+	m_uploader.destroy();
+	m_memoryAllocator.destroy();
 	vkDestroyDevice(m_device, nullptr);
 	vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
 	vkDestroyInstance(m_instance, nullptr);
@@ -1828,6 +3339,9 @@ void VulkanModelViewer::cleanupSwapchain() {
 void VulkanModelViewer::destroyPresentImageResources() {
 	destroyImageResource(_imageResources.sceneColor);
 	destroyImageResource(_imageResources.sceneDepth);
+	for (vkimpl::MemoryAllocation& memory : _presentAttachmentMemory)
+		m_memoryAllocator.free(memory);
+	_presentAttachmentMemory.clear();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -1852,6 +3366,12 @@ void VulkanModelViewer::destroyPresentCommandBuffers() {
 	vkFreeCommandBuffers(m_device, _commandPool, static_cast<uint32_t>(_commandBuffers.wireframeCommandBuffers.size()), _commandBuffers.wireframeCommandBuffers.data());
 	vkFreeCommandBuffers(m_device, _commandPool, static_cast<uint32_t>(_commandBuffers.guiCommandBuffers.size()), _commandBuffers.guiCommandBuffers.data());
 	vkFreeCommandBuffers(m_device, _commandPool, static_cast<uint32_t>(_commandBuffers.shadowCommandBuffers.size()), _commandBuffers.shadowCommandBuffers.data());
+	vkFreeCommandBuffers(m_device, _commandPool, static_cast<uint32_t>(_commandBuffers.meshletCullingCommandBuffers.size()), _commandBuffers.meshletCullingCommandBuffers.data());
+	for (size_t worker = 0; worker < _commandBuffers.objectPassCommandBuffers.size(); worker++)
+		vkFreeCommandBuffers(m_device, _drawRecordPools[worker], static_cast<uint32_t>(_commandBuffers.objectPassCommandBuffers[worker].size()),
+			_commandBuffers.objectPassCommandBuffers[worker].data());
+	vkDestroyQueryPool(m_device, _timestampQueryPool, nullptr);
+	_timestampQueryPool = VK_NULL_HANDLE;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -1873,6 +3393,7 @@ void VulkanModelViewer::destroyPresentPipelines() {
 //
 void VulkanModelViewer::destroyPresentRenderPasses() {
 	vkDestroyRenderPass(m_device, _renderPasses.sceneRenderPass, nullptr);
+	vkDestroyRenderPass(m_device, _renderPasses.sceneLastRenderPass, nullptr);
 	vkDestroyRenderPass(m_device, _renderPasses.wireframeRenderPass, nullptr);
 	vkDestroyRenderPass(m_device, _renderPasses.guiRenderPass, nullptr);
 }
@@ -1881,8 +3402,7 @@ void VulkanModelViewer::destroyPresentRenderPasses() {
 // Clean up uniform buffers used for present
 //
 void VulkanModelViewer::destroyPresentUniformBuffers() {
-	destroyBufferResources(_uniformBuffers.cameraUniformBuffers);
-	destroyBufferResources(_uniformBuffers.lightUniformBuffers);
+	_uniformBuffers.frameUniforms.destroy();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -1892,6 +3412,7 @@ void VulkanModelViewer::destroyPresentDescriptorPools() {
 	vkDestroyDescriptorPool(m_device, _descriptorPools.sceneDescriptorPool, nullptr);
 	vkDestroyDescriptorPool(m_device, _descriptorPools.cameraDescriptorPool, nullptr);
 	vkDestroyDescriptorPool(m_device, _descriptorPools.lightDescriptorPool, nullptr);
+	vkDestroyDescriptorPool(m_device, _descriptorPools.meshletCullingDescriptorPool, nullptr);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -1911,10 +3432,14 @@ void VulkanModelViewer::cleanupOffscreenRenderingResources() {
 // Clean up offscreen image resources
 //
 void VulkanModelViewer::destroyOffscreenImageResources() {
+	stopTextureStreaming();
 	destroyImageResource(_imageResources.shadowDepth);
 	destroyImageResource(_imageResources.defaultShadowDepth);
-	for (auto textureImasgeResource : _textureResources)
-		destroyImageResource(textureImasgeResource);
+	destroyImageResource(_imageResources.placeholderTexture);
+	for (size_t i = 0; i < _textureResources.size(); i++) {
+		if (_textureImageOwners[i] == static_cast<int>(i))
+			destroyImageResource(_textureResources[i]);
+	}
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -1952,7 +3477,7 @@ void VulkanModelViewer::destroyOffscreenRenderPasses() {
 // Clean up uniform buffers used for present
 //
 void VulkanModelViewer::destroyOffscreenUniformBuffers() {
-	destroyBufferResources(_uniformBuffers.materialUniformBuffers);
+	destroyBufferResource(_materialBuffer.buffer);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -1988,6 +3513,7 @@ void VulkanModelViewer::destroyDescriptorSetLayouts() {
 	vkDestroyDescriptorSetLayout(m_device, _descriptorSetLayouts.cameraDescriptorSetLayout, nullptr);
 	vkDestroyDescriptorSetLayout(m_device, _descriptorSetLayouts.lightDescriptorSetLayout, nullptr);
 	vkDestroyDescriptorSetLayout(m_device, _descriptorSetLayouts.materialDescriptorSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(m_device, _descriptorSetLayouts.meshletCullingDescriptorSetLayout, nullptr);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -2001,10 +3527,25 @@ void VulkanModelViewer::destroySceneResources() {
 // Desctroy vertex and index buffers
 //
 void VulkanModelViewer::destroyModelBuffers() {
-	vkDestroyBuffer(m_device, _vertexBuffer, nullptr);
-	vkFreeMemory(m_device, _vertexBufferMemory, nullptr);
-	vkDestroyBuffer(m_device, _indexBuffer, nullptr);
-	vkFreeMemory(m_device, _indexBufferMemory, nullptr);
+	m_bufferUtil.destroyBuffer(_vertexBuffer, _vertexBufferMemory);
+	m_bufferUtil.destroyBuffer(_indexBuffer, _indexBufferMemory);
+	destroyBufferResource(_meshletBuffers.meshlets);
+	destroyBufferResource(_meshletBuffers.cullItems);
+	destroyBufferResource(_meshletBuffers.drawGroups);
+	_meshletBuffers.meshlets = {};
+	_meshletBuffers.cullItems = {};
+	_meshletBuffers.drawGroups = {};
+	destroyMeshletDrawBuffers();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Desctroy the draw command and draw count buffers of the swapchain images
+//
+void VulkanModelViewer::destroyMeshletDrawBuffers() {
+	destroyBufferResources(_meshletBuffers.drawCommands);
+	destroyBufferResources(_meshletBuffers.drawCounts);
+	_meshletBuffers.drawCommands.clear();
+	_meshletBuffers.drawCounts.clear();
 }
 
 
@@ -2015,7 +3556,7 @@ void VulkanModelViewer::destroyModelBuffers() {
 void VulkanModelViewer::destroyImageResource(ImageResource image) {
 	vkDestroyImageView(m_device, image.imageView, nullptr);
 	vkDestroyImage(m_device, image.image, nullptr);
-	vkFreeMemory(m_device, image.imageMemory, nullptr);
+	m_memoryAllocator.free(image.imageMemory);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -2030,8 +3571,7 @@ void VulkanModelViewer::destroyBufferResources(std::vector<BufferResource> buffe
 // Clean up resources of buffers
 //
 void VulkanModelViewer::destroyBufferResource(BufferResource bufferResource) {
-	vkDestroyBuffer(m_device, bufferResource.buffer, nullptr);
-	vkFreeMemory(m_device, bufferResource.bufferMemory, nullptr);
+	m_bufferUtil.destroyBuffer(bufferResource.buffer, bufferResource.bufferMemory);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -2057,6 +3597,8 @@ void VulkanModelViewer::recreateSwapchain() {
 	createPresentCommandBuffers();
 	createPresentImageResources();
 	createPresentFramebuffers();
+	if (!_meshlets.empty())
+		createMeshletDrawBuffers();
 	createPresentDescriptorSets();
 	
 	beginPresentRenderPasses();
@@ -2179,6 +3721,27 @@ void VulkanModelViewer::setGuiComponents() {
 	ImGui::ListBox("Shadow options", &_shadowOption, shadowOptions, 2);
 	const char* shaderOptions[4] = { "default", "scene", "wireframe_hollow", "wireframe_solid"};
 	ImGui::ListBox("Shader options", &_shaderOption, shaderOptions, 4);
+	const char* objLoaderOptions[3] = { "parallel", "tinyobj", "streaming" };
+	ImGui::ListBox("OBJ loader", &_objLoaderOption, objLoaderOptions, 3);
+	ImGui::SliderInt("Streaming memory (MB)", &_streamingMemoryBudgetMB, 64, 4096);
+	ImGui::SliderInt("Texture budget (MB, 0 auto)", &_textureBudgetMB, 0, 16384);
+	ImGui::Checkbox("Optimize mesh", &_optimizeMesh);
+	ImGui::Checkbox("Generate LODs", &_generateLods);
+	ImGui::Checkbox("Pack scalar textures", &_packScalarTextures);
+	ImGui::SliderFloat("LOD pixel error", &_lodPixelError, 0.f, 16.f);
+	ImGui::SliderInt("LOD triangle budget (K)", &_lodTriangleBudgetK, 0, 10000);
+	ImGui::Checkbox("Meshlet culling", &_meshletCulling);
+	ImGui::Checkbox("Record draws every frame", &_recordEveryFrame);
+	ImGui::SliderInt("Draw recording threads (0 all)", &_recordThreadCount, 0, static_cast<int>(MAX_DRAW_RECORD_WORKERS));
+	const char* vertexFormatOptions[2] = { "full (48 bytes)", "compact (20 bytes)" };
+	ImGui::ListBox("Vertex format", &_vertexFormatOption, vertexFormatOptions, 2);
+	ImGui::Checkbox("Use model cache", &_useModelCache);
+	if (ImGui::Button("Benchmark uploads"))
+		_benchmarkUploads = true;
+	if (ImGui::Button("Benchmark draw recording"))
+		_benchmarkDrawRecording = true;
+	if (ImGui::Button("Export memory report"))
+		_exportMemoryReport = true;
 	ImGui::End();
 
 	//Information window
@@ -2188,7 +3751,123 @@ void VulkanModelViewer::setGuiComponents() {
 	ImGui::Text("Camera position: (%.4f, %.4f, %.4f)", _camera.pos.x, _camera.pos.y, _camera.pos.z);
 	ImGui::Text("Camera look dir: (%.4f, %.4f, %.4f)", _camera.lookDir.x, _camera.lookDir.y, _camera.lookDir.z);
 	ImGui::Text("Light source: (%.4f, %.4f, %.4f)", _lightSource.pos.x, _lightSource.pos.y, _lightSource.pos.z);
-	ImGui::Text("FPS: %.2f", _frameRate);
+	ImGui::Text("FPS: %.2f (%.3f ms)", _frameRate, 1000.0f / _frameRate);
+	ImGui::Text("OBJ parse: %.2f ms (%.1f MB/s, %u thread(s))", _modelLoadStats.objParseMilliseconds, _modelLoadStats.objParseThroughputMBs, _modelLoadStats.objParseThreads);
+	ImGui::Text("Mesh build: %.2f ms", _modelLoadStats.meshBuildMilliseconds);
+	ImGui::Text("Mesh optimize: %.2f ms (ACMR %.3f -> %.3f, ATVR %.3f -> %.3f)", _modelLoadStats.meshOptimizeMilliseconds,
+		_modelLoadStats.vertexCacheBefore.acmr(), _modelLoadStats.vertexCacheAfter.acmr(), _modelLoadStats.vertexCacheBefore.atvr(), _modelLoadStats.vertexCacheAfter.atvr());
+	ImGui::Text("Model load: %.2f ms (%s, %zu vertices, %zu triangles)", _modelLoadStats.modelLoadMilliseconds,
+		_modelLoadStats.modelCacheHit ? "cache hit" : _modelLoadStats.modelStreamed ? "streamed" : "parsed", _modelLoadStats.vertexCount, _modelLoadStats.indexCount / 3);
+	ImGui::Text("Vertex buffer: %.1f MB (%s, %zu constant stream(s), %.1f MB as full vertices)", _modelLoadStats.vertexBufferBytes / (1024.0 * 1024.0),
+		_modelVertexFormat == COMPACT_VERTEX_FORMAT ? "compact" : "full", std::bitset<VERTEX_STREAM_COUNT>(_vertexStreamLayout.constantStreams).count(),
+		sizeof(Vertex) * _modelLoadStats.vertexCount / (1024.0 * 1024.0));
+	ImGui::Text("Load memory: %.1f MB peak resident (%.1f MB before)", _modelLoadStats.peakResidentMemory / (1024.0 * 1024.0),
+		_modelLoadStats.residentMemoryBefore / (1024.0 * 1024.0));
+	ImGui::Text("Materials: %zu unique of %zu loaded (%.3f ms lookup), %zu texture(s) for %zu reference(s)", _materialCache.size() - 1,
+		_modelLoadStats.materialLookups, _modelLoadStats.materialLookupMilliseconds, _textureResources.size() - 1, _modelLoadStats.textureLookups);
+	ImGui::Text("Textures: %.2f ms decode, %.2f ms upload, %.2f ms to full resolution (%zu texture(s), %.1f MB, %zu batch(es))",
+		_modelLoadStats.textureDecodeMilliseconds, _modelLoadStats.textureUploadMilliseconds, _modelLoadStats.textureStreamMilliseconds,
+		_modelLoadStats.textureCount, _modelLoadStats.textureBytes / (1024.0 * 1024.0), _modelLoadStats.textureUploadBatches);
+	size_t residentMips = 0, totalMips = 0, streamingCount = _texturesDecoding;
+	for (const StreamingTexture& streaming : _streamingTextures) {
+		residentMips += streaming.imageInfo.mipLevels - streaming.viewLevel;
+		totalMips += streaming.imageInfo.mipLevels;
+		streamingCount += streaming.viewLevel > 0 ? 1 : 0;
+	}
+	ImGui::Text("Texture streaming: %zu of %zu mip level(s) shown, %zu texture(s) streaming", residentMips, totalMips, streamingCount);
+	ImGui::Text("Texture residency: %.1f MB selected of %.1f MB budget (%.1f MB pinned), %.1f MB needed, %.1f MB resident (%.2f ms select)",
+		(_textureResidencyStats.selectedBytes + _textureResidencyStats.pinnedBytes) / (1024.0 * 1024.0), _textureResidencyStats.budget / (1024.0 * 1024.0),
+		_textureResidencyStats.pinnedBytes / (1024.0 * 1024.0), _textureResidencyStats.neededBytes / (1024.0 * 1024.0),
+		_textureResidencyStats.residentBytes / (1024.0 * 1024.0), _textureResidencyStats.selectMilliseconds);
+	ImGui::Text("Texture residency: %zu of %zu cooked texture(s) below the needed level, %llu eviction(s), %llu restream(s)", _textureResidencyStats.reducedCount,
+		_textureResidencyStats.managedCount, static_cast<unsigned long long>(_textureResidencyStats.evictions), static_cast<unsigned long long>(_textureResidencyStats.restreams));
+	if (!_streamingTextures.empty() && ImGui::TreeNode("Resident mips per texture")) {
+		for (const StreamingTexture& streaming : _streamingTextures)
+			ImGui::Text("%u/%u (%u selected) %s", streaming.imageInfo.mipLevels - streaming.viewLevel, streaming.imageInfo.mipLevels,
+				streaming.imageInfo.mipLevels - streaming.targetLevel, _texturePaths[streaming.textureIndex].c_str());
+		ImGui::TreePop();
+	}
+	ImGui::Text("Texture memory: %.1f MB, %.1f MB as RGBA8 (%zu cooked, %zu channel, %zu packed texture(s))", _modelLoadStats.textureImageBytes / (1024.0 * 1024.0),
+		_modelLoadStats.textureRGBA8Bytes / (1024.0 * 1024.0), _modelLoadStats.cookedTextureCount, _modelLoadStats.channelTextureCount,
+		_modelLoadStats.packedTextureCount);
+	ImGui::Text("Texture dedup: %zu duplicate(s), %.1f MB saved (%.2f ms hash)", _modelLoadStats.duplicateTextureCount,
+		_modelLoadStats.duplicateTextureBytes / (1024.0 * 1024.0), _modelLoadStats.textureHashMilliseconds);
+	ImGui::Text("LOD build: %.2f ms (%zu level(s), %zu extra triangles)", _modelLoadStats.lodGenerateMilliseconds,
+		_modelLoadStats.lodLevelCount, _modelLoadStats.lodIndexCount / 3);
+	ImGui::Text("LOD draw: %zu of %zu triangles (%zu shape(s) reduced, %.2f px error)", _lodSelectionStats.drawnTriangles,
+		_lodSelectionStats.fullTriangles, _lodSelectionStats.reducedShapes, _lodSelectionStats.pixelError);
+	ImGui::Text("Meshlet build: %.2f ms (%zu meshlets)", _modelLoadStats.meshletBuildMilliseconds, _meshletCullingStats.meshletCount);
+	ImGui::Text("Meshlet culling: %zu of %zu meshlets, %zu of %zu triangles visible", _meshletCullingStats.visibleMeshlets,
+		_meshletCullingStats.drawnMeshlets, _meshletCullingStats.visibleTriangles, _meshletCullingStats.drawnTriangles);
+	vkimpl::MemoryAllocatorStats memoryStats = m_memoryAllocator.getStats();
+	ImGui::Text("GPU memory: %.1f MB used of %.1f MB reserved, %u of %u VkDeviceMemory object(s)", memoryStats.usedBytes / (1024.0 * 1024.0),
+		memoryStats.reservedBytes / (1024.0 * 1024.0), memoryStats.deviceMemoryCount, memoryStats.maxDeviceMemoryCount);
+	ImGui::Text("GPU allocations: %zu slot, %zu TLSF, %zu linear, %u dedicated (%u block(s), %llu vkAllocateMemory call(s) in %.2f ms)",
+		memoryStats.slabAllocationCount, memoryStats.tlsfAllocationCount, memoryStats.linearAllocationCount, memoryStats.dedicatedCount,
+		memoryStats.blockCount, static_cast<unsigned long long>(memoryStats.deviceAllocateCount), memoryStats.deviceAllocateMilliseconds);
+	vkimpl::MemoryReport memoryReport = m_memoryAllocator.m_tracker.getReport();
+	for (size_t i = 0; i < memoryReport.heaps.size(); i++) {
+		const vkimpl::MemoryHeapReport& heap = memoryReport.heaps[i];
+		if (memoryReport.budgetSupported) {
+			ImGui::Text("GPU heap %zu%s: %.1f MB tracked, %.1f MB reserved, process usage %.1f of %.1f MB budget", i, (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "",
+				heap.trackedBytes / (1024.0 * 1024.0), heap.reservedBytes / (1024.0 * 1024.0), heap.usage / (1024.0 * 1024.0), heap.budget / (1024.0 * 1024.0));
+		}
+		else {
+			ImGui::Text("GPU heap %zu%s: %.1f MB tracked, %.1f MB reserved of %.1f MB (no budget query)", i, (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "",
+				heap.trackedBytes / (1024.0 * 1024.0), heap.reservedBytes / (1024.0 * 1024.0), heap.size / (1024.0 * 1024.0));
+		}
+	}
+	ImGui::Text("GPU memory: textures %.1f MB, geometry %.1f MB, attachments %.1f MB, shadow maps %.1f MB, staging %.1f MB, uniforms %.1f MB, other %.1f MB",
+		memoryReport.categoryBytes[static_cast<size_t>(vkimpl::MemoryCategory::Textures)] / (1024.0 * 1024.0),
+		memoryReport.categoryBytes[static_cast<size_t>(vkimpl::MemoryCategory::Geometry)] / (1024.0 * 1024.0),
+		memoryReport.categoryBytes[static_cast<size_t>(vkimpl::MemoryCategory::Attachments)] / (1024.0 * 1024.0),
+		memoryReport.categoryBytes[static_cast<size_t>(vkimpl::MemoryCategory::ShadowMaps)] / (1024.0 * 1024.0),
+		memoryReport.categoryBytes[static_cast<size_t>(vkimpl::MemoryCategory::Staging)] / (1024.0 * 1024.0),
+		memoryReport.categoryBytes[static_cast<size_t>(vkimpl::MemoryCategory::Uniforms)] / (1024.0 * 1024.0),
+		memoryReport.categoryBytes[static_cast<size_t>(vkimpl::MemoryCategory::Other)] / (1024.0 * 1024.0));
+	ImGui::Text("Scene targets: %.1f MB committed in %zu allocation(s), %.1f MB lazily allocated, %.1f MB in separate allocations",
+		_presentAttachmentReport.committedBytes / (1024.0 * 1024.0), _presentAttachmentReport.groupCount,
+		_presentAttachmentReport.lazyBytes / (1024.0 * 1024.0), _presentAttachmentReport.separateBytes / (1024.0 * 1024.0));
+	if (ImGui::TreeNode("Frame attachment memory by resolution")) {
+		for (const AttachmentMemoryReport& report : _attachmentMemoryReports)
+			ImGui::Text("%ux%u: %.1f MB committed (%.1f MB lazily allocated), %.1f MB in separate allocations, %.1f MB saved", report.extent.width, report.extent.height,
+				report.committedBytes / (1024.0 * 1024.0), report.lazyBytes / (1024.0 * 1024.0), report.separateBytes / (1024.0 * 1024.0),
+				(report.separateBytes - report.committedBytes) / (1024.0 * 1024.0));
+		ImGui::TreePop();
+	}
+	if (ImGui::TreeNode("Largest GPU allocations")) {
+		for (size_t i = 0; i < std::min(memoryReport.allocations.size(), MEMORY_REPORT_GUI_ALLOCATIONS); i++) {
+			const vkimpl::TrackedAllocation& allocation = memoryReport.allocations[i];
+			ImGui::Text("%.2f MB %s, %s, heap %u", allocation.size / (1024.0 * 1024.0), allocation.name.empty() ? "(unnamed)" : allocation.name.c_str(),
+				vkimpl::VulkanMemoryTracker::categoryName(allocation.category), allocation.heapIndex);
+		}
+		ImGui::TreePop();
+	}
+	vkimpl::UploadStats uploadStats = m_uploader.getStats();
+	ImGui::Text("Uploads: %.1f MB in %llu copies, %llu submission(s), %llu split, %llu staging wait(s) (%.2f ms)", uploadStats.uploadedBytes / (1024.0 * 1024.0),
+		static_cast<unsigned long long>(uploadStats.copyCount), static_cast<unsigned long long>(uploadStats.submitCount),
+		static_cast<unsigned long long>(uploadStats.splitCount), static_cast<unsigned long long>(uploadStats.ringWaitCount), uploadStats.ringWaitMilliseconds);
+	ImGui::Text("Upload queue: %s, %llu release(s), %llu graphics submission(s)", m_uploader.dedicatedTransfer() ? "dedicated transfer" : "graphics",
+		static_cast<unsigned long long>(uploadStats.releaseCount), static_cast<unsigned long long>(uploadStats.graphicsSubmitCount));
+	ImGui::Text("Upload benchmark: %.1f MB/s (%.1f MB in %.2f ms)", _uploadBenchmarkStats.throughputMBs, _uploadBenchmarkStats.bytes / (1024.0 * 1024.0),
+		_uploadBenchmarkStats.milliseconds);
+	vkimpl::UniformRingStats uniformStats = _uniformBuffers.frameUniforms.getStats();
+	ImGui::Text("Frame uniforms: %llu of %llu bytes per frame (peak %llu), %u region(s), %llu frame(s) written", static_cast<unsigned long long>(uniformStats.usedBytes),
+		static_cast<unsigned long long>(uniformStats.regionSize), static_cast<unsigned long long>(uniformStats.peakBytes), uniformStats.regionCount,
+		static_cast<unsigned long long>(uniformStats.frameCount));
+	ImGui::Text("Draw recording: %.2f ms, %zu draw(s) and one material set bind for %zu material group(s) of %zu material(s)",
+		_drawRecordStats.recordMilliseconds, _drawRecordStats.draws, _drawRecordStats.materialGroups, _materialCache.size());
+	ImGui::Text("Draw recording workers: %zu, %zu secondary command buffer(s), %s", _drawRecordStats.workers, _drawRecordStats.secondaryCommandBuffers,
+		_drawRecordStats.everyFrame ? "every frame" : "once for every image");
+	for (size_t i = 0; i < _drawRecordBenchmarkStats.milliseconds.size(); i++)
+		ImGui::Text("Draw recording benchmark, %zu thread(s): %.2f ms, %zu worker(s) per pass", i + 1, _drawRecordBenchmarkStats.milliseconds[i],
+			_drawRecordBenchmarkStats.workers[i]);
+	ImGui::Text("Bindless textures: %zu of %u%s", _bindlessTextures.writtenCount, _bindlessTextures.capacity,
+		_bindlessTextures.updateAfterBind ? ", updated after bind" : "");
+	if (_timestampQueryPool != VK_NULL_HANDLE)
+		ImGui::Text("Scene pass GPU time: %.3f ms", _drawRecordStats.gpuMilliseconds);
+	else
+		ImGui::Text("Scene pass GPU time: no timestamp support");
 	ImGui::End();
 
 	//Render call
@@ -2209,6 +3888,37 @@ void VulkanModelViewer::update() {
 		updateModel();
 		_modelUpdated = false;
 	}
+	if (_benchmarkUploads) {
+		benchmarkUploads();
+		_benchmarkUploads = false;
+	}
+	if (_benchmarkDrawRecording) {
+		benchmarkDrawRecording();
+		_benchmarkDrawRecording = false;
+	}
+	if (_exportMemoryReport) {
+		exportMemoryReport();
+		_exportMemoryReport = false;
+	}
+	m_uploader.poll();
+	streamTextures();
+
+	//The object passes are recorded once, so a shape changing its level of detail or toggling the meshlet
+	//culling records them again. Passes recorded every frame pick up new levels by themselves, unless the
+	//culling pass recorded for every image reads them; the other passes are recorded once it is turned off.
+	bool lodsChanged = selectShapeLods();
+	bool lodsRecordedPerFrame = lodsChanged && _recordEveryFrame && !_meshletCullingRecorded;
+	if (lodsRecordedPerFrame)
+		_objectPassesStale = true;
+	if ((lodsChanged && !lodsRecordedPerFrame) || (!_shapes.empty() && useMeshletCulling() != _meshletCullingRecorded)
+		|| (!_shapes.empty() && !_recordEveryFrame && _objectPassesStale)) {
+		vkDeviceWaitIdle(m_device);
+		beginObjectRenderPasses();
+	}
+	if (lodsChanged)
+		std::cout << "LOD selection: " << _lodSelectionStats.drawnTriangles << " of " << _lodSelectionStats.fullTriangles << " triangles, "
+			<< _lodSelectionStats.reducedShapes << " shape(s) reduced, " << _lodSelectionStats.pixelError << " px error, frame time "
+			<< 1000.0f / _frameRate << " ms" << std::endl;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -2216,10 +3926,89 @@ void VulkanModelViewer::update() {
 //
 void VulkanModelViewer::updateModel() {
 	clearCurrentModel();
-
-	loadOBJModel(_modelPath);
-	createModelBuffer();
+	_modelLoadStats = {};
+	_loadMemoryTracker.reset();
+	int pipelineVertexFormat = _modelVertexFormat;
+	uint32_t pipelineConstantStreams = _vertexStreamLayout.constantStreams;
+	_modelVertexFormat = FULL_VERTEX_FORMAT;
+	_vertexQuantization = {};
+
+	//Load from the model cache if it is still valid, otherwise parse the model and refresh the cache
+	auto loadStartTime = std::chrono::high_resolution_clock::now();
+	_modelLoadStats.modelCacheHit = _useModelCache && loadModelCache(_modelPath);
+	if (!_modelLoadStats.modelCacheHit && _objLoaderOption == STREAMING_OBJ_LOADER) {
+		streamOBJModel(_modelPath);
+		_modelLoadStats.modelStreamed = true;
+	}
+	else if (!_modelLoadStats.modelCacheHit) {
+		loadOBJModel(_modelPath);
+		if (_generateLods)
+			generateShapeLods();
+		if (_optimizeMesh)
+			optimizeMesh(_vertices, _indices, getIndexRangeGroups());
+		computeModelBounds();
+		_modelVertexFormat = selectVertexFormat(_materialCache.size());
+		if (_modelVertexFormat == COMPACT_VERTEX_FORMAT) {
+			_vertexQuantization = VertexQuantization::fromBounds(_modelBounds.min, _modelBounds.max);
+			packCompactVertices(_vertices, _compactVertices);
+		}
+		generateMeshlets();
+		createModelBuffer();
+		_modelLoadStats.vertexCount = _vertices.size();
+		_modelLoadStats.indexCount = _indices.size();
+	}
+	updateMaterialDescriptors();
+	size_t shapeIndexCount = 0;
+	for (const Shape& shape : _shapes) {
+		shapeIndexCount += shape.indexCount;
+		_modelLoadStats.lodLevelCount = std::max(_modelLoadStats.lodLevelCount, shape.lods.size());
+	}
+	_modelLoadStats.lodIndexCount = _modelLoadStats.indexCount - shapeIndexCount;
+	_lodSelectionStats = {};
+	_textureResidencyStats = {};
+	createMeshletBuffers();
+	createMeshletCullingDescriptorSets();
+	//The first frame of the model reads its buffers, the graphics queue acquires them before it
+	m_uploader.finishTransfers();
+	_meshletCullingStats = {};
+	_meshletCullingStats.meshletCount = _meshlets.size();
+	_loadMemoryTracker.sample();
+	auto loadEndTime = std::chrono::high_resolution_clock::now();
+	_modelLoadStats.modelLoadMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(loadEndTime - loadStartTime).count();
+	_modelLoadStats.residentMemoryBefore = _loadMemoryTracker.m_startBytes;
+	_modelLoadStats.peakResidentMemory = _loadMemoryTracker.m_peakBytes;
+	std::cout << "Loaded model in " << _modelLoadStats.modelLoadMilliseconds << " ms ("
+		<< (_modelLoadStats.modelCacheHit ? "model cache" : _modelLoadStats.modelStreamed ? "streamed" : "parsed") << "), peak resident memory "
+		<< _modelLoadStats.peakResidentMemory / (1024.0 * 1024.0) << " MB" << std::endl;
+	std::cout << "Vertex buffer " << _modelLoadStats.vertexBufferBytes / (1024.0 * 1024.0) << " MB ("
+		<< (_modelVertexFormat == COMPACT_VERTEX_FORMAT ? "compact" : "full") << " vertices, "
+		<< std::bitset<VERTEX_STREAM_COUNT>(_vertexStreamLayout.constantStreams).count() << " constant stream(s), "
+		<< sizeof(Vertex) * _modelLoadStats.vertexCount / (1024.0 * 1024.0) << " MB as full vertices)" << std::endl;
+	if (_modelLoadStats.materialLookups > 0)
+		std::cout << "Materials: " << _materialCache.size() - 1 << " unique of " << _modelLoadStats.materialLookups << " loaded, lookup "
+			<< _modelLoadStats.materialLookupMilliseconds << " ms, " << _textureResources.size() - 1 << " texture(s) for "
+			<< _modelLoadStats.textureLookups << " reference(s)" << std::endl;
+	if (_modelLoadStats.lodLevelCount > 0)
+		std::cout << "Levels of detail: " << _modelLoadStats.lodLevelCount << " level(s), " << _modelLoadStats.lodIndexCount / 3
+			<< " extra triangles" << std::endl;
+	if (_modelLoadStats.vertexCacheBefore.triangleCount > 0)
+		std::cout << "Optimized mesh in " << _modelLoadStats.meshOptimizeMilliseconds << " ms: ACMR " << _modelLoadStats.vertexCacheBefore.acmr()
+			<< " -> " << _modelLoadStats.vertexCacheAfter.acmr() << ", ATVR " << _modelLoadStats.vertexCacheBefore.atvr()
+			<< " -> " << _modelLoadStats.vertexCacheAfter.atvr() << std::endl;
+	if (!_meshlets.empty())
+		std::cout << "Meshlets: " << _meshlets.size() << " built in " << _modelLoadStats.meshletBuildMilliseconds << " ms" << std::endl;
+	printMemoryStats();
+	printUploadStats();
+
+	//A streamed model is not kept on the CPU, so there is nothing to write the cache from
+	if (_useModelCache && !_modelLoadStats.modelCacheHit && !_modelLoadStats.modelStreamed)
+		writeModelCache(_modelPath);
+
+	//The pipelines read the vertex format and the constant streams of the model
+	if (_modelVertexFormat != pipelineVertexFormat || _vertexStreamLayout.constantStreams != pipelineConstantStreams)
+		recreateModelPipelines();
 	beginObjectRenderPasses();
+	printDrawRecordStats();
 	_shaderOption = SCENE;
 
 	updateModelInfo();
@@ -2229,19 +4018,9 @@ void VulkanModelViewer::updateModel() {
 // Update the information of the model
 //
 void VulkanModelViewer::updateModelInfo() {
-	glm::vec3 ub{ -INFINITY, -INFINITY , -INFINITY };
-	glm::vec3 lb{ INFINITY, INFINITY , INFINITY };
-	_modelCenterOfGravity = { 0.0f, 0.0f, 0.0f };
-	int counter{ 0 };
-	for (Vertex vertex : _vertices) {
-		ub = glm::max(vertex.pos, ub);
-		lb = glm::min(vertex.pos, lb);
-		if (counter > 0)
-			_modelCenterOfGravity = _modelCenterOfGravity / float(counter + 1) * float(counter) + vertex.pos / float(counter + 1);
-		else
-			_modelCenterOfGravity = vertex.pos;
-		counter++;
-	}
+	glm::vec3 ub = _modelBounds.max;
+	glm::vec3 lb = _modelBounds.min;
+	_modelCenterOfGravity = _modelBounds.centerOfGravity;
 	_modelCenter = (ub + lb) / 2.f;
 	ub = ub - _modelCenter;
 	float dis = std::max(ub[0], ub[1]);
@@ -2259,29 +4038,538 @@ void VulkanModelViewer::updateModelInfo() {
 }
 
 //--------------------------------------------------------------------------------------------------
-// Function to clear the current model
+// Compute the bounds and the center of gravity of the loaded vertices
 //
-void VulkanModelViewer::clearCurrentModel() {
-	vkDeviceWaitIdle(m_device);
-	_vertices.clear();
-	_indices.clear();
-	_shapes.clear();
-
-	_materialCache = { _materialCache[0] };
-	for (int i = 1; i < _uniformBuffers.materialUniformBuffers.size(); i++)
-		destroyBufferResource(_uniformBuffers.materialUniformBuffers[i]);
-	_uniformBuffers.materialUniformBuffers = { _uniformBuffers.materialUniformBuffers[0] };
-	_descriptorSets.materialDescriptorSets = { _descriptorSets.materialDescriptorSets[0] };
-
-	_texturePaths = { _texturePaths[0] };
-	for (int i = 1; i < _textureResources.size(); i++)
-		destroyImageResource(_textureResources[i]);
-	_textureResources = { _textureResources[0] };
-	destroyModelBuffers();
+void VulkanModelViewer::computeModelBounds() {
+	glm::vec3 ub{ -INFINITY, -INFINITY , -INFINITY };
+	glm::vec3 lb{ INFINITY, INFINITY , INFINITY };
+	glm::dvec3 sum{ 0.0, 0.0, 0.0 };
+	for (const Vertex& vertex : _vertices) {
+		ub = glm::max(vertex.pos, ub);
+		lb = glm::min(vertex.pos, lb);
+		sum += glm::dvec3(vertex.pos);
+	}
+	_modelBounds.max = ub;
+	_modelBounds.min = lb;
+	_modelBounds.centerOfGravity = _vertices.empty() ? glm::vec3(0.0f) : glm::vec3(sum / double(_vertices.size()));
 }
 
 //--------------------------------------------------------------------------------------------------
-// Handle inputs
+// Vertex format for a model with the given number of materials, the compact format only holds
+// 16-bit material ids
+//
+int VulkanModelViewer::selectVertexFormat(size_t materialCount) {
+	if (_vertexFormatOption != COMPACT_VERTEX_FORMAT)
+		return FULL_VERTEX_FORMAT;
+	if (materialCount > size_t(UINT16_MAX) + 1) {
+		std::cout << "Compact vertices not used: " << materialCount << " materials" << std::endl;
+		return FULL_VERTEX_FORMAT;
+	}
+	return COMPACT_VERTEX_FORMAT;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Pack vertices into the compact format with the current quantization, in parallel blocks
+//
+void VulkanModelViewer::packCompactVertices(const std::vector<Vertex>& vertices, std::vector<CompactVertex>& compactVertices) {
+	const size_t blockSize = 1 << 16;
+	compactVertices.resize(vertices.size());
+	parallel_for((vertices.size() + blockSize - 1) / blockSize, [&](size_t block) {
+		size_t end = std::min(vertices.size(), (block + 1) * blockSize);
+		for (size_t i = block * blockSize; i < end; i++)
+			compactVertices[i] = CompactVertex::pack(vertices[i], _vertexQuantization);
+	});
+}
+
+//--------------------------------------------------------------------------------------------------
+// Size of one vertex in the vertex buffer
+//
+VkDeviceSize VulkanModelViewer::getVertexStride() {
+	return _modelVertexFormat == COMPACT_VERTEX_FORMAT ? sizeof(CompactVertex) : sizeof(Vertex);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Stream layout of a vertex record in the current vertex format
+//
+std::array<VulkanModelViewer::VertexStreamInfo, VulkanModelViewer::VERTEX_STREAM_COUNT> VulkanModelViewer::getVertexStreamInfos() {
+	return _modelVertexFormat == COMPACT_VERTEX_FORMAT ? CompactVertex::getStreamInfos() : Vertex::getStreamInfos();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Attributes of the given streams in the current vertex format
+//
+std::vector<VkVertexInputAttributeDescription> VulkanModelViewer::getVertexAttributeDescriptions(uint32_t streamMask) {
+	return _modelVertexFormat == COMPACT_VERTEX_FORMAT ? CompactVertex::getAttributeDescriptions(streamMask) : Vertex::getAttributeDescriptions(streamMask);
+}
+
+//--------------------------------------------------------------------------------------------------
+// One binding per stream the attributes read from, constant streams have a zero stride
+//
+std::vector<VkVertexInputBindingDescription> VulkanModelViewer::getVertexBindingDescriptions(const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions) {
+	auto streamInfos = getVertexStreamInfos();
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+	for (const VkVertexInputAttributeDescription& attributeDescription : attributeDescriptions) {
+		uint32_t stream = attributeDescription.binding;
+		auto sameBinding = [&](const VkVertexInputBindingDescription& bindingDescription) { return bindingDescription.binding == stream; };
+		if (std::any_of(bindingDescriptions.begin(), bindingDescriptions.end(), sameBinding))
+			continue;
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = stream;
+		bindingDescription.stride = _vertexStreamLayout.constantStreams & (1u << stream) ? 0 : streamInfos[stream].size;
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		bindingDescriptions.push_back(bindingDescription);
+	}
+	return bindingDescriptions;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Find the streams whose value is the same in every vertex record
+//
+uint32_t VulkanModelViewer::findConstantStreams(const void* vertexData, size_t vertexCount) {
+	if (vertexCount == 0)
+		return 0;
+	const char* records = static_cast<const char*>(vertexData);
+	size_t recordSize = static_cast<size_t>(getVertexStride());
+	const size_t blockSize = 1 << 16;
+	auto streamInfos = getVertexStreamInfos();
+	uint32_t constantStreams = 0;
+	for (uint32_t stream = 0; stream < VERTEX_STREAM_COUNT; stream++) {
+		const VertexStreamInfo& streamInfo = streamInfos[stream];
+		if (streamInfo.size == 0)
+			continue;
+		std::atomic<bool> varying{ false };
+		parallel_for((vertexCount + blockSize - 1) / blockSize, [&](size_t block) {
+			size_t end = std::min(vertexCount, (block + 1) * blockSize);
+			for (size_t i = block * blockSize; i < end && !varying; i++) {
+				if (memcmp(records + i * recordSize + streamInfo.recordOffset, records + streamInfo.recordOffset, streamInfo.size) != 0)
+					varying = true;
+			}
+		});
+		if (!varying)
+			constantStreams |= 1u << stream;
+	}
+	return constantStreams;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Place the streams of the current vertex format one after another for vertexCapacity vertices,
+// constant streams take a single element. Returns the size of the vertex buffer.
+//
+VkDeviceSize VulkanModelViewer::layoutVertexStreams(uint32_t constantStreams, size_t vertexCapacity) {
+	_vertexStreamLayout.streams = getVertexStreamInfos();
+	_vertexStreamLayout.constantStreams = constantStreams;
+	VkDeviceSize size = 0;
+	for (uint32_t stream = 0; stream < VERTEX_STREAM_COUNT; stream++) {
+		const VertexStreamInfo& streamInfo = _vertexStreamLayout.streams[stream];
+		_vertexStreamLayout.offsets[stream] = size;
+		size += VkDeviceSize(streamInfo.size) * (constantStreams & (1u << stream) ? 1 : vertexCapacity);
+		size = (size + 15) / 16 * 16;
+	}
+	return size;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Upload vertex records to the streams of the vertex buffer, starting at firstVertex. The records
+// are gathered stream by stream into the staging ring, in chunks of the uploader, and the copies are
+// recorded into the open upload batch. Constant streams are written with the first vertex.
+//
+void VulkanModelViewer::uploadVertexStreams(const void* vertexData, size_t vertexCount, size_t firstVertex) {
+	const char* records = static_cast<const char*>(vertexData);
+	size_t recordSize = static_cast<size_t>(getVertexStride());
+	const size_t blockSize = 1 << 16;
+	for (uint32_t stream = 0; stream < VERTEX_STREAM_COUNT; stream++) {
+		const VertexStreamInfo& streamInfo = _vertexStreamLayout.streams[stream];
+		bool constant = _vertexStreamLayout.constantStreams & (1u << stream);
+		if (streamInfo.size == 0 || (constant && firstVertex > 0))
+			continue;
+		size_t count = constant ? std::min<size_t>(vertexCount, 1) : vertexCount;
+		size_t roundSize = static_cast<size_t>(m_uploader.chunkSize() / streamInfo.size);
+		for (size_t roundBegin = 0; roundBegin < count; roundBegin += roundSize) {
+			size_t roundCount = std::min(roundSize, count - roundBegin);
+			vkimpl::StagingRange staging = m_uploader.allocateStaging(VkDeviceSize(roundCount) * streamInfo.size);
+			char* staged = staging.data;
+			parallel_for((roundCount + blockSize - 1) / blockSize, [&](size_t block) {
+				size_t end = std::min(roundCount, (block + 1) * blockSize);
+				for (size_t i = block * blockSize; i < end; i++)
+					memcpy(staged + i * streamInfo.size, records + (roundBegin + i) * recordSize + streamInfo.recordOffset, streamInfo.size);
+			});
+			m_uploader.copyBuffer(staging, _vertexBuffer, _vertexStreamLayout.offsets[stream] + VkDeviceSize(firstVertex + roundBegin) * streamInfo.size);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Bind the given vertex streams, each to the binding of its index
+//
+void VulkanModelViewer::bindVertexStreams(VkCommandBuffer commandBuffer, uint32_t streamMask) {
+	for (uint32_t stream = 0; stream < VERTEX_STREAM_COUNT; stream++) {
+		if ((streamMask & (1u << stream)) && _vertexStreamLayout.streams[stream].size > 0)
+			vkCmdBindVertexBuffers(commandBuffer, stream, 1, &_vertexBuffer, &_vertexStreamLayout.offsets[stream]);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Recreate the pipelines that read the model vertex buffer, after its vertex input changed
+//
+void VulkanModelViewer::recreateModelPipelines() {
+	vkDeviceWaitIdle(m_device);
+	destroyPresentPipelines();
+	destroyOffscreenPipelines();
+	createPresentPipelines();
+	createShadowPipeline();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reorder the triangles of every material group for the post-transform vertex cache and then for
+// overdraw, in parallel across groups, and finally the vertices for fetch locality. The group
+// ranges stay valid. ACMR/ATVR before and after are added to the load statistics.
+//
+void VulkanModelViewer::optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<MaterialGroup>& groups) {
+	if (indices.empty())
+		return;
+	auto optimizeStartTime = std::chrono::high_resolution_clock::now();
+	_modelLoadStats.vertexCacheBefore += analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+	//Largest groups first, so one big group does not end up last on a single thread
+	std::vector<size_t> groupOrder(groups.size());
+	for (size_t i = 0; i < groupOrder.size(); i++)
+		groupOrder[i] = i;
+	std::sort(groupOrder.begin(), groupOrder.end(), [&](size_t a, size_t b) { return groups[a].indexCount > groups[b].indexCount; });
+	parallel_for(groupOrder.size(), [&](size_t i) {
+		const MaterialGroup& group = groups[groupOrder[i]];
+		uint32_t* groupIndices = indices.data() + group.indexBase;
+		optimizeVertexCache(groupIndices, group.indexCount);
+		optimizeOverdraw(groupIndices, group.indexCount, &vertices[0].pos.x, sizeof(Vertex));
+	});
+	optimizeVertexFetch(vertices, indices.data(), indices.size());
+
+	_modelLoadStats.vertexCacheAfter += analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+	auto optimizeEndTime = std::chrono::high_resolution_clock::now();
+	_modelLoadStats.meshOptimizeMilliseconds += std::chrono::duration<double, std::chrono::milliseconds::period>(optimizeEndTime - optimizeStartTime).count();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Distinct index ranges of the material groups of every shape and level of detail, ordered by their
+// first index. Levels of detail share the ranges of the groups they could not simplify any further.
+//
+std::vector<VulkanModelViewer::MaterialGroup> VulkanModelViewer::getIndexRangeGroups() {
+	std::vector<MaterialGroup> groups;
+	for (const Shape& shape : _shapes) {
+		groups.insert(groups.end(), shape.materialGroups.begin(), shape.materialGroups.end());
+		for (const ShapeLod& lod : shape.lods)
+			groups.insert(groups.end(), lod.materialGroups.begin(), lod.materialGroups.end());
+	}
+	std::sort(groups.begin(), groups.end(), [](const MaterialGroup& a, const MaterialGroup& b) { return a.indexBase < b.indexBase; });
+	groups.erase(std::unique(groups.begin(), groups.end(), [](const MaterialGroup& a, const MaterialGroup& b) { return a.indexBase == b.indexBase; }), groups.end());
+	return groups;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Split every index range into meshlets of consecutive triangles with their culling bounds, one
+// worker per range. The meshlets are ranges of the index buffer ordered by their first index, so the
+// meshlets of a material group are found by its range.
+//
+void VulkanModelViewer::generateMeshlets() {
+	_meshlets.clear();
+	if (_indices.empty())
+		return;
+	auto meshletStartTime = std::chrono::high_resolution_clock::now();
+
+	//Compact vertices move by up to half a quantization step, the spheres grow by a step to still cover them
+	float radiusPadding = _modelVertexFormat == COMPACT_VERTEX_FORMAT ? glm::length(_vertexQuantization.scale) / 65535.0f : 0.0f;
+	std::vector<MaterialGroup> groups = getIndexRangeGroups();
+	std::vector<std::vector<Meshlet>> groupMeshlets(groups.size());
+	parallel_for(groups.size(), [&](size_t i) {
+		const MaterialGroup& group = groups[i];
+		std::vector<MeshletBounds> bounds;
+		buildMeshlets(bounds, _indices.data() + group.indexBase, group.indexCount, &_vertices[0].pos.x, sizeof(Vertex), MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+		groupMeshlets[i].reserve(bounds.size());
+		for (const MeshletBounds& b : bounds) {
+			Meshlet meshlet{};
+			meshlet.sphere = glm::vec4(b.center[0], b.center[1], b.center[2], b.radius + radiusPadding);
+			meshlet.cone = glm::vec4(b.coneAxis[0], b.coneAxis[1], b.coneAxis[2], b.coneCutoff);
+			meshlet.indexBase = group.indexBase + b.indexOffset;
+			meshlet.indexCount = b.indexCount;
+			groupMeshlets[i].push_back(meshlet);
+		}
+	});
+	for (const std::vector<Meshlet>& meshlets : groupMeshlets)
+		_meshlets.insert(_meshlets.end(), meshlets.begin(), meshlets.end());
+
+	auto meshletEndTime = std::chrono::high_resolution_clock::now();
+	_modelLoadStats.meshletBuildMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(meshletEndTime - meshletStartTime).count();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Build the levels of detail of every shape with the quadric simplifier, one worker per shape. Each
+// material group is simplified on its own so the group borders stay closed, a group that can't be
+// reduced any further keeps its range of the level before. The levels are appended to the index
+// buffer level after level and index the vertices of the full shapes.
+//
+void VulkanModelViewer::generateShapeLods() {
+	if (_indices.empty())
+		return;
+	auto lodStartTime = std::chrono::high_resolution_clock::now();
+
+	//Indices of every group of every level, empty where the group keeps the range of the level before
+	struct LodLevel {
+		std::vector<std::vector<uint32_t>> groupIndices;
+		float error;
+	};
+	std::vector<std::vector<LodLevel>> shapeLevels(_shapes.size());
+
+	//Largest shapes first, so one big shape does not end up last on a single thread
+	std::vector<size_t> shapeOrder(_shapes.size());
+	for (size_t i = 0; i < shapeOrder.size(); i++)
+		shapeOrder[i] = i;
+	std::sort(shapeOrder.begin(), shapeOrder.end(), [&](size_t a, size_t b) { return _shapes[a].indexCount > _shapes[b].indexCount; });
+	parallel_for(shapeOrder.size(), [&](size_t i) {
+		Shape& shape = _shapes[shapeOrder[i]];
+		std::vector<LodLevel>& levels = shapeLevels[shapeOrder[i]];
+
+		//Bounding sphere of the shape for the level selection
+		glm::vec3 ub{ -INFINITY, -INFINITY , -INFINITY };
+		glm::vec3 lb{ INFINITY, INFINITY , INFINITY };
+		for (int index = shape.indexBase; index < shape.indexBase + shape.indexCount; index++) {
+			lb = glm::min(lb, _vertices[_indices[index]].pos);
+			ub = glm::max(ub, _vertices[_indices[index]].pos);
+		}
+		shape.center = (lb + ub) / 2.f;
+		shape.radius = glm::length(ub - lb) / 2.f;
+
+		std::vector<std::vector<uint32_t>> currentIndices;
+		size_t currentTriangleCount = 0;
+		for (const MaterialGroup& group : shape.materialGroups) {
+			currentIndices.emplace_back(_indices.begin() + group.indexBase, _indices.begin() + group.indexBase + group.indexCount);
+			currentTriangleCount += group.indexCount / 3;
+		}
+		float currentError = 0.0f;
+		while (levels.size() < MAX_SHAPE_LOD_LEVELS) {
+			LodLevel level{ std::vector<std::vector<uint32_t>>(currentIndices.size()), currentError };
+			size_t levelTriangleCount = 0;
+			float stepError = 0.0f;
+			for (size_t g = 0; g < currentIndices.size(); g++) {
+				const std::vector<uint32_t>& source = currentIndices[g];
+				if (source.size() / 3 >= LOD_MIN_GROUP_TRIANGLES) {
+					std::vector<uint32_t> simplified(source.size());
+					float groupError = 0.0f;
+					size_t simplifiedCount = simplifyMesh(simplified.data(), source.data(), source.size(), &_vertices[0].pos.x,
+						&_vertices[0].color.x, 8, sizeof(Vertex), source.size() / 2, &groupError);
+					if (simplifiedCount < source.size() * LOD_MIN_REDUCTION) {
+						simplified.resize(simplifiedCount);
+						level.groupIndices[g] = std::move(simplified);
+						stepError = std::max(stepError, groupError);
+					}
+				}
+				levelTriangleCount += (level.groupIndices[g].empty() ? source.size() : level.groupIndices[g].size()) / 3;
+			}
+			if (levelTriangleCount >= currentTriangleCount * LOD_MIN_REDUCTION)
+				break;
+
+			//The error of a level adds up the errors of the simplification steps leading to it
+			level.error = currentError + stepError;
+			for (size_t g = 0; g < currentIndices.size(); g++) {
+				if (!level.groupIndices[g].empty())
+					currentIndices[g] = level.groupIndices[g];
+			}
+			currentTriangleCount = levelTriangleCount;
+			currentError = level.error;
+			levels.push_back(std::move(level));
+		}
+	});
+
+	//Append level after level, so shapes drawn at the same level have adjacent index ranges
+	size_t levelCount = 0;
+	size_t lodIndexCount = 0;
+	for (const auto& levels : shapeLevels) {
+		levelCount = std::max(levelCount, levels.size());
+		for (const LodLevel& level : levels) {
+			for (const auto& groupIndices : level.groupIndices)
+				lodIndexCount += groupIndices.size();
+		}
+	}
+	_indices.reserve(_indices.size() + lodIndexCount);
+	for (size_t level = 0; level < levelCount; level++) {
+		for (size_t i = 0; i < _shapes.size(); i++) {
+			if (level >= shapeLevels[i].size())
+				continue;
+			Shape& shape = _shapes[i];
+			const LodLevel& lodLevel = shapeLevels[i][level];
+			ShapeLod lod{ {}, lodLevel.error };
+			for (size_t g = 0; g < shape.materialGroups.size(); g++) {
+				if (lodLevel.groupIndices[g].empty()) {
+					lod.materialGroups.push_back(level == 0 ? shape.materialGroups[g] : shape.lods.back().materialGroups[g]);
+					continue;
+				}
+				lod.materialGroups.push_back({ static_cast<int>(_indices.size()), static_cast<int>(lodLevel.groupIndices[g].size()), shape.materialGroups[g].materialId });
+				_indices.insert(_indices.end(), lodLevel.groupIndices[g].begin(), lodLevel.groupIndices[g].end());
+			}
+			shape.lods.push_back(lod);
+		}
+	}
+
+	_loadMemoryTracker.sample();
+	auto lodEndTime = std::chrono::high_resolution_clock::now();
+	_modelLoadStats.lodGenerateMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(lodEndTime - lodStartTime).count();
+	std::cout << "Generated " << levelCount << " level(s) of detail in " << _modelLoadStats.lodGenerateMilliseconds << " ms" << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Material groups of the selected level of detail of a shape
+//
+const std::vector<VulkanModelViewer::MaterialGroup>& VulkanModelViewer::getLodMaterialGroups(const Shape& shape) {
+	return shape.lodLevel == 0 ? shape.materialGroups : shape.lods[shape.lodLevel - 1].materialGroups;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Select the level of detail of every shape from its projected size: the coarsest level whose error
+// covers at most _lodPixelError pixels at the distance of the shape. Above the triangle budget the
+// allowed error is doubled until the selection fits. Returns true if any shape changed its level.
+//
+bool VulkanModelViewer::selectShapeLods() {
+	if (_shapes.empty())
+		return false;
+
+	//Pixels covered by one model unit at distance one, the model is drawn around _modelCenter
+	float pixelsPerUnit = m_swapchainExtent.height / (2.0f * std::tan(glm::radians(CAMERA_FOV_DEGREES) / 2.0f));
+	std::vector<float> distances(_shapes.size());
+	size_t fullTriangles = 0;
+	for (size_t i = 0; i < _shapes.size(); i++) {
+		distances[i] = std::max(glm::length(_camera.pos - (_shapes[i].center - _modelCenter)) - _shapes[i].radius, 0.1f);
+		fullTriangles += _shapes[i].indexCount / 3;
+	}
+
+	size_t triangleBudget = size_t(_lodTriangleBudgetK) * 1000;
+	float pixelError = _lodPixelError;
+	std::vector<int> levels(_shapes.size());
+	size_t drawnTriangles = 0;
+	for (int step = 0; step < LOD_MAX_BUDGET_STEPS; step++) {
+		drawnTriangles = 0;
+		for (size_t i = 0; i < _shapes.size(); i++) {
+			const Shape& shape = _shapes[i];
+			int level = 0;
+			while (level < int(shape.lods.size()) && shape.lods[level].error * pixelsPerUnit / distances[i] <= pixelError)
+				level++;
+			levels[i] = level;
+			for (const MaterialGroup& group : level == 0 ? shape.materialGroups : shape.lods[level - 1].materialGroups)
+				drawnTriangles += group.indexCount / 3;
+		}
+		if (triangleBudget == 0 || drawnTriangles <= triangleBudget)
+			break;
+		pixelError = std::max(pixelError * 2.0f, 1.0f);
+	}
+
+	bool changed = false;
+	_lodSelectionStats.reducedShapes = 0;
+	for (size_t i = 0; i < _shapes.size(); i++) {
+		changed = changed || _shapes[i].lodLevel != levels[i];
+		_shapes[i].lodLevel = levels[i];
+		_lodSelectionStats.reducedShapes += levels[i] > 0 ? 1 : 0;
+	}
+	_lodSelectionStats.drawnTriangles = drawnTriangles;
+	_lodSelectionStats.fullTriangles = fullTriangles;
+	_lodSelectionStats.pixelError = pixelError;
+	return changed;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Meshlet culling needs meshlets of the model and indirect draws of several commands
+//
+bool VulkanModelViewer::useMeshletCulling() {
+	return _meshletCulling && !_meshlets.empty() && (m_deviceFeatures12.drawIndirectCount || m_deviceFeatures.multiDrawIndirect);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Write the meshlets of the material groups of the selected levels of detail as cull items, with a
+// draw group per material group in draw order. The draws of a group start at the first item of the
+// group.
+//
+void VulkanModelViewer::fillMeshletCullItems() {
+	std::vector<glm::uvec2> items;
+	_meshletDrawGroups.clear();
+	_meshletCullingStats.drawnTriangles = 0;
+	for (const Shape& shape : _shapes) {
+		for (const MaterialGroup& group : getLodMaterialGroups(shape)) {
+			MeshletDrawGroup drawGroup{ static_cast<uint32_t>(items.size()), 0 };
+			auto meshlet = std::lower_bound(_meshlets.begin(), _meshlets.end(), group.indexBase,
+				[](const Meshlet& m, uint32_t indexBase) { return m.indexBase < indexBase; });
+			for (; meshlet != _meshlets.end() && meshlet->indexBase < group.indexBase + group.indexCount; ++meshlet) {
+				items.push_back(glm::uvec2(static_cast<uint32_t>(meshlet - _meshlets.begin()), static_cast<uint32_t>(_meshletDrawGroups.size())));
+				_meshletCullingStats.drawnTriangles += meshlet->indexCount / 3;
+				drawGroup.meshletCount++;
+			}
+			_meshletDrawGroups.push_back(drawGroup);
+		}
+	}
+	_meshletCullingStats.drawnMeshlets = items.size();
+
+	uint32_t header[2] = { static_cast<uint32_t>(items.size()), m_deviceFeatures12.drawIndirectCount ? 1u : 0u };
+	char* data = static_cast<char*>(_meshletBuffers.cullItems.bufferMemory.mapped);
+	memcpy(data, header, sizeof(header));
+	memcpy(data + sizeof(header), items.data(), sizeof(glm::uvec2) * items.size());
+
+	uint32_t* drawGroupBases = static_cast<uint32_t*>(_meshletBuffers.drawGroups.bufferMemory.mapped);
+	for (size_t i = 0; i < _meshletDrawGroups.size(); i++)
+		drawGroupBases[i] = _meshletDrawGroups[i].drawBase;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Read the visible meshlets and triangles back from the draw counts of a swapchain image whose last
+// frame has finished
+//
+void VulkanModelViewer::readMeshletCullingStats(uint32_t imageIndex) {
+	const uint32_t* counts = static_cast<const uint32_t*>(_meshletBuffers.drawCounts[imageIndex].bufferMemory.mapped);
+	_meshletCullingStats.visibleTriangles = counts[0];
+	_meshletCullingStats.visibleMeshlets = 0;
+	for (size_t i = 0; i < _meshletDrawGroups.size(); i++)
+		_meshletCullingStats.visibleMeshlets += counts[1 + i];
+}
+
+//--------------------------------------------------------------------------------------------------
+// Read the GPU time of the scene pass from the timestamps of a swapchain image whose last frame has
+// finished
+//
+void VulkanModelViewer::readFrameTimestamps(uint32_t imageIndex) {
+	std::array<uint64_t, 2> timestamps{};
+	if (vkGetQueryPoolResults(m_device, _timestampQueryPool, 2 * imageIndex, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		return;
+	_drawRecordStats.gpuMilliseconds = ((timestamps[1] - timestamps[0]) & _timestampMask) * static_cast<double>(_timestampPeriod) / 1e6;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Function to clear the current model
+//
+void VulkanModelViewer::clearCurrentModel() {
+	vkDeviceWaitIdle(m_device);
+	m_uploader.waitIdle();
+	_vertices.clear();
+	_indices.clear();
+	_compactVertices.clear();
+	_shapes.clear();
+	_meshlets.clear();
+	_meshletDrawGroups.clear();
+	_modelSourceFiles.clear();
+	stopTextureStreaming();
+
+	_materialCache = { _materialCache[0] };
+	_materialIndices = { { _materialCache[0].hash(), 0 } };
+	_materialBuffer.uploadedCount = 1;
+	_bindlessTextures.writtenCount = 1;
+
+	_texturePaths = { _texturePaths[0] };
+	for (int i = 1; i < _textureResources.size(); i++) {
+		if (_textureImageOwners[i] == i)
+			destroyImageResource(_textureResources[i]);
+	}
+	_textureResources = { _textureResources[0] };
+	_textureImageOwners = { 0 };
+	_textureIndices.clear();
+	_textureContents.clear();
+	destroyModelBuffers();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Handle inputs
 //
 void VulkanModelViewer::handleInput() {
 	ImGuiIO& io = ImGui::GetIO();
@@ -2358,129 +4646,591 @@ void VulkanModelViewer::loadOBJModel(std::string path) {
 	std::vector<tinyobj::material_t> materials;
 	std::string warn, err;
 
-	std::string directory;
-	const size_t last_slash_idx = path.rfind('\\');
-	if (std::string::npos != last_slash_idx)
-	{
-		directory = path.substr(0, last_slash_idx);
+	std::string directory = getDirectory(path);
+
+	//Parse the file, the tinyobj path is kept to compare load times on the same model
+	auto parseStartTime = std::chrono::high_resolution_clock::now();
+	bool loaded{ false };
+	unsigned parseThreads{ 1 };
+	if (_objLoaderOption == PARALLEL_OBJ_LOADER) {
+		ObjParser objParser{};
+		loaded = objParser.load(&attrib, &shapes, &materials, &warn, &err, path, directory);
+		parseThreads = objParser.m_stats.threadCount;
+		_modelSourceFiles = objParser.m_materialFilenames;
 	}
-
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str(), directory.c_str())) {
+	else {
+		loaded = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str(), directory.c_str());
+	}
+	if (!loaded) {
 		throw std::runtime_error(warn + err);
 	}
+	_modelSourceFiles.insert(_modelSourceFiles.begin(), path);
 	std::cout << warn + err << std::endl;
 
-	//Process materials
-	std::map<int, int> materialIndexMap;
-	
+	auto parseEndTime = std::chrono::high_resolution_clock::now();
+	double fileSizeMB = std::filesystem::file_size(path) / (1024.0 * 1024.0);
+	_modelLoadStats.objParseMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(parseEndTime - parseStartTime).count();
+	_modelLoadStats.objParseThroughputMBs = fileSizeMB / std::max(_modelLoadStats.objParseMilliseconds / 1000.0, 1e-6);
+	_modelLoadStats.objParseThreads = parseThreads;
+	std::cout << "Parsed " << fileSizeMB << " MB in " << _modelLoadStats.objParseMilliseconds << " ms ("
+		<< _modelLoadStats.objParseThroughputMBs << " MB/s, " << parseThreads << " thread(s))" << std::endl;
+
+	_loadMemoryTracker.sample();
+
+	//Map the .mtl material ids to material cache ids, materials are loaded on first use
+	auto meshBuildStartTime = std::chrono::high_resolution_clock::now();
+	std::vector<int> materialIndexMap(materials.size(), -1);
+
+	//Populate per vertex information
+	auto getVertex = [&](const tinyobj::index_t& index, int materialId) {
+		Vertex vertex{};
+		vertex.pos = {
+			attrib.vertices[3 * index.vertex_index + 0],
+			attrib.vertices[3 * index.vertex_index + 1],
+			attrib.vertices[3 * index.vertex_index + 2]
+		};
+
+		if (index.texcoord_index >= 0 && attrib.texcoords.size() > 0)
+			vertex.texCoord = {
+				attrib.texcoords[2 * index.texcoord_index + 0],
+				1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+			};
+
+		if (attrib.colors.size() > 0)
+			vertex.color = {
+				attrib.colors[3 * index.vertex_index + 0],
+				attrib.colors[3 * index.vertex_index + 1],
+				attrib.colors[3 * index.vertex_index + 2]
+			};
+
+		if (index.normal_index >= 0 && attrib.normals.size() > 0)
+			vertex.normal = {
+				attrib.normals[3 * index.normal_index + 0],
+				attrib.normals[3 * index.normal_index + 1],
+				attrib.normals[3 * index.normal_index + 2]
+			};
+
+		vertex.materialId = materialId;
+		return vertex;
+	};
+
 	//Preallocation of memory
-	int ind_count = 0;
+	size_t ind_count = 0;
 	for (const auto& shape : shapes)
 		ind_count += shape.mesh.indices.size();
-	_indices.reserve(ind_count);
-	_vertices.reserve(ind_count / 3 + 1);
+	MeshBuilder<Vertex> meshBuilder(_vertices, _indices);
+	meshBuilder.reserve(ind_count, _materialCache.size() + materials.size());
 
-	//Process shapes
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+	//Process shapes, deduplicating vertices and grouping the triangles of each shape by material
+	std::vector<MeshBuilder<Vertex>::Group> groups;
 	for (const auto& shape : shapes) {
 		if (shape.mesh.indices.size() <= 0)
 			continue;
 		Shape currentShape{};
 		currentShape.indexBase = _indices.size();
-		std::map<int, std::vector<uint32_t>> matGroupIndMap{};
-		int face = 0;
-		int num_face_vertices = shape.mesh.num_face_vertices[face];
-		int materialIdLocal = shape.mesh.material_ids[face];
-		int vertexCount = 0;
-		for (const auto& index : shape.mesh.indices) {
-			//Update face information
-			if (vertexCount == num_face_vertices) {
-				face++;
-				num_face_vertices = shape.mesh.num_face_vertices[face];
-				materialIdLocal = shape.mesh.material_ids[face];
-				vertexCount = 0;
+		meshBuilder.beginShape();
+
+		size_t indexOffset = 0;
+		for (size_t face = 0; face < shape.mesh.num_face_vertices.size(); face++) {
+			size_t num_face_vertices = shape.mesh.num_face_vertices[face];
+			if (num_face_vertices == 3) {
+				int materialId = getMaterialIndex(directory, materials, materialIndexMap, shape.mesh.material_ids[face]);
+				Vertex corners[3] = {
+					getVertex(shape.mesh.indices[indexOffset + 0], materialId),
+					getVertex(shape.mesh.indices[indexOffset + 1], materialId),
+					getVertex(shape.mesh.indices[indexOffset + 2], materialId)
+				};
+				meshBuilder.addTriangle(corners, materialId);
 			}
+			indexOffset += num_face_vertices;
+		}
 
-			Vertex vertex{};
+		//Build the material groups of the shape
+		meshBuilder.endShape(groups);
+		for (const auto& group : groups)
+			currentShape.materialGroups.push_back({ static_cast<int>(group.indexBase), static_cast<int>(group.indexCount), group.materialId });
 
-			//Populate per vertex information
-			vertex.pos = {
-				attrib.vertices[3 * index.vertex_index + 0],
-				attrib.vertices[3 * index.vertex_index + 1],
-				attrib.vertices[3 * index.vertex_index + 2]
-			};
+		currentShape.indexCount = _indices.size() - currentShape.indexBase;
+		_shapes.push_back(currentShape);
+	}
 
-			if (index.texcoord_index >= 0 && attrib.texcoords.size() > 0)
-				vertex.texCoord = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-				};
-			else
-				vertex.texCoord = { 0.0f, 0.0f };
+	_loadMemoryTracker.sample();
 
-			if (attrib.colors.size() > 0)
-				vertex.color = {
-					attrib.colors[3 * index.vertex_index + 0],
-					attrib.colors[3 * index.vertex_index + 1],
-					attrib.colors[3 * index.vertex_index + 2]
-				};
-			else
-				vertex.color = { 0.0f, 0.0f, 0.0f };
+	auto meshBuildEndTime = std::chrono::high_resolution_clock::now();
+	_modelLoadStats.meshBuildMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(meshBuildEndTime - meshBuildStartTime).count();
+	std::cout << "Built " << _vertices.size() << " unique vertices and " << _indices.size() / 3 << " triangles in "
+		<< _modelLoadStats.meshBuildMilliseconds << " ms" << std::endl;
+}
 
-			if (index.normal_index >= 0 && attrib.normals.size() > 0)
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-			};
-			else
-				vertex.normal = { 0.0f, 0.0f, 0.0f };
-
-			//Populate material information
-			if (materialIndexMap.find(materialIdLocal) == materialIndexMap.end()) {
-				if (materialIdLocal >= 0) {
-					Material mat = loadMaterial(directory, materials[materialIdLocal]);
-					auto matIt = std::find(_materialCache.begin(), _materialCache.end(), mat);
-					materialIndexMap.insert({ materialIdLocal, matIt - _materialCache.begin() });
-					if (matIt == _materialCache.end()) {
-						_materialCache.push_back(mat);
-						_uniformBuffers.materialUniformBuffers.push_back(getMaterialUniformBuffer(mat));
-						_descriptorSets.materialDescriptorSets.push_back(getMaterialDescriptorSet(mat, _uniformBuffers.materialUniformBuffers.back().buffer));
-					}
-				}
-				else {
-					materialIndexMap.insert({ materialIdLocal, 0 });
-				}
-				
+//--------------------------------------------------------------------------------------------------
+// Load a .obj file with bounded memory, for models larger than the system memory.
+// The file is parsed in windows, and the faces of every window are deduplicated, grouped and
+// uploaded on their own through the staging ring of the uploader, so the mesh never exists as a
+// whole on the CPU. _streamingMemoryBudgetMB sets the window size. Vertices are
+// only shared inside a window, the vertex and index buffers are created here.
+//
+void VulkanModelViewer::streamOBJModel(std::string path) {
+	std::string directory = getDirectory(path);
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+
+	//The staging ring counts against the budget, up to half of it; parsed faces and the mesh built from
+	//them take up to twelve times the size of the text they come from
+	VkDeviceSize memoryBudget = VkDeviceSize(std::max(_streamingMemoryBudgetMB, 16)) << 20;
+	VkDeviceSize stagingSize = std::min(m_uploader.m_ringSize, memoryBudget / 2);
+	ObjParser objParser{};
+	objParser.m_windowSize = static_cast<size_t>((memoryBudget - stagingSize) / 12);
+
+	//The index count is known after the first pass, the vertex buffer grows if the estimate is short.
+	//Compact vertices are quantized in the bounds of all positions of the file, materials are only
+	//known once the faces are read. Streams of attributes the file does not have are constant.
+	ObjStreamAttributes attributes{};
+	_modelVertexFormat = selectVertexFormat(0);
+	size_t vertexCapacity = 0;
+	VkDeviceSize vertexBufferSize = 0;
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+	auto beginFaces = [&](const ObjStreamAttributes& streamAttributes) {
+		attributes = streamAttributes;
+		if (_modelVertexFormat == COMPACT_VERTEX_FORMAT) {
+			glm::vec3 max{ -INFINITY, -INFINITY , -INFINITY };
+			glm::vec3 min{ INFINITY, INFINITY , INFINITY };
+			for (size_t i = 0; i < attributes.positionCount; i++) {
+				glm::vec3 position{ attributes.positions[3 * i + 0], attributes.positions[3 * i + 1], attributes.positions[3 * i + 2] };
+				max = glm::max(position, max);
+				min = glm::min(position, min);
 			}
-			vertex.materialId = materialIndexMap[materialIdLocal];
+			if (attributes.positionCount > 0)
+				_vertexQuantization = VertexQuantization::fromBounds(min, max);
+		}
+		VkDeviceSize indexBufferSize = std::max<VkDeviceSize>(sizeof(uint32_t) * 3 * attributes.triangleCount, sizeof(uint32_t));
+		m_bufferUtil.createBuffer(indexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _indexBuffer, _indexBufferMemory);
+		m_debugUtil.setObjectName(_indexBuffer, "IndexBuffer");
+		uint32_t constantStreams = 0;
+		if (attributes.colorCount == 0)
+			constantStreams |= 1u << COLOR_STREAM;
+		if (attributes.texcoordCount == 0)
+			constantStreams |= 1u << TEXCOORD_STREAM;
+		if (attributes.normalCount == 0)
+			constantStreams |= 1u << NORMAL_STREAM;
+		vertexCapacity = std::max<size_t>(attributes.positionCount + attributes.positionCount / 4, 1);
+		vertexBufferSize = layoutVertexStreams(constantStreams, vertexCapacity);
+		m_bufferUtil.createBuffer(vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _vertexBuffer, _vertexBufferMemory);
+		m_debugUtil.setObjectName(_vertexBuffer, "VertexBuffer");
+	};
+	auto reserveVertices = [&](size_t count) {
+		if (count <= vertexCapacity)
+			return;
+		size_t newCapacity = std::max(count, vertexCapacity + vertexCapacity / 2);
+		VertexStreamLayout oldLayout = _vertexStreamLayout;
+		vertexBufferSize = layoutVertexStreams(oldLayout.constantStreams, newCapacity);
+		VkBuffer newBuffer;
+		vkimpl::MemoryAllocation newBufferMemory;
+		m_bufferUtil.createBuffer(vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, newBuffer, newBufferMemory);
+		m_debugUtil.setObjectName(newBuffer, "VertexBuffer");
+
+		//The graphics queue owns what was uploaded to the old buffer, so it copies the buffer once it
+		//acquired the copies of the open batch. The old buffer is destroyed once that batch finished.
+		VkCommandBuffer graphicsCommandBuffer = m_uploader.getGraphicsCommandBuffer();
+		for (uint32_t stream = 0; stream < VERTEX_STREAM_COUNT && vertexCount > 0; stream++) {
+			size_t streamCount = oldLayout.constantStreams & (1u << stream) ? 1 : vertexCount;
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = oldLayout.offsets[stream];
+			copyRegion.dstOffset = _vertexStreamLayout.offsets[stream];
+			copyRegion.size = VkDeviceSize(oldLayout.streams[stream].size) * streamCount;
+			if (copyRegion.size > 0)
+				vkCmdCopyBuffer(graphicsCommandBuffer, _vertexBuffer, newBuffer, 1, &copyRegion);
+		}
+		VkBuffer oldBuffer = _vertexBuffer;
+		vkimpl::MemoryAllocation oldBufferMemory = _vertexBufferMemory;
+		m_uploader.submit([this, oldBuffer, oldBufferMemory]() mutable {
+			m_bufferUtil.destroyBuffer(oldBuffer, oldBufferMemory);
+		});
+		_vertexBuffer = newBuffer;
+		_vertexBufferMemory = newBufferMemory;
+		vertexCapacity = newCapacity;
+	};
 
-			//Count vertex
-			vertexCount++;
+	//Populate per vertex information
+	auto getVertex = [&](const tinyobj::index_t& index, int materialId) {
+		Vertex vertex{};
+		const float* position = attributes.positions + 3 * size_t(index.vertex_index);
+		const float* color = attributes.colors + 3 * size_t(index.vertex_index);
+		vertex.pos = { position[0], position[1], position[2] };
+		vertex.color = { color[0], color[1], color[2] };
+		if (index.texcoord_index >= 0) {
+			const float* texcoord = attributes.texcoords + 2 * size_t(index.texcoord_index);
+			vertex.texCoord = { texcoord[0], 1.0f - texcoord[1] };
+		}
+		if (index.normal_index >= 0) {
+			const float* normal = attributes.normals + 3 * size_t(index.normal_index);
+			vertex.normal = { normal[0], normal[1], normal[2] };
+		}
+		vertex.materialId = materialId;
+		return vertex;
+	};
 
-			//Check the uniqueness of the vertex id and update the unique vertex map
-			if (uniqueVertices.count(vertex) == 0) {
-				uniqueVertices[vertex] = static_cast<uint32_t>(_vertices.size());
-				_vertices.push_back(vertex);
+	//Build, upload and forget every window
+	std::vector<Vertex> windowVertices;
+	std::vector<CompactVertex> windowCompactVertices;
+	std::vector<uint32_t> windowIndices;
+	MeshBuilder<Vertex> meshBuilder(windowVertices, windowIndices);
+	std::vector<MeshBuilder<Vertex>::Group> groups;
+	std::vector<int> materialIndexMap;
+	std::vector<Shape> shapes;
+	size_t openShape = SIZE_MAX;
+	glm::vec3 ub{ -INFINITY, -INFINITY , -INFINITY };
+	glm::vec3 lb{ INFINITY, INFINITY , INFINITY };
+	glm::dvec3 sum{ 0.0, 0.0, 0.0 };
+
+	std::vector<MaterialGroup> windowGroups;
+	auto processWindow = [&](const ObjStreamWindow& window) {
+		materialIndexMap.resize(materials.size(), -1);
+		windowGroups.clear();
+		meshBuilder.clear();
+		meshBuilder.reserve(window.faceCount * 3, _materialCache.size() + materials.size());
+
+		//Runs of one shape are built together, so each shape gets one group per material and window
+		auto endShape = [&](size_t shapeIndex) {
+			size_t shapeIndexBase = indexCount + windowIndices.size();
+			meshBuilder.endShape(groups);
+			if (shapeIndex != openShape) {
+				shapes.push_back(Shape{ int(shapeIndexBase), 0 });
+				openShape = shapeIndex;
+			}
+			Shape& shape = shapes.back();
+			for (const auto& group : groups) {
+				windowGroups.push_back({ int(group.indexBase), int(group.indexCount), group.materialId });
+				MaterialGroup materialGroup{ int(indexCount + group.indexBase), int(group.indexCount), group.materialId };
+				MaterialGroup* last = shape.materialGroups.empty() ? nullptr : &shape.materialGroups.back();
+				if (last && last->materialId == materialGroup.materialId && last->indexBase + last->indexCount == materialGroup.indexBase)
+					last->indexCount += materialGroup.indexCount;
+				else
+					shape.materialGroups.push_back(materialGroup);
+			}
+		};
+		size_t currentShape = window.runs[0].shape;
+		meshBuilder.beginShape();
+		for (size_t r = 0; r < window.runCount; r++) {
+			const ObjStreamRun& run = window.runs[r];
+			if (run.shape != currentShape) {
+				endShape(currentShape);
+				currentShape = run.shape;
+				meshBuilder.beginShape();
+			}
+			int materialId = getMaterialIndex(directory, materials, materialIndexMap, run.materialId);
+			if (_modelVertexFormat == COMPACT_VERTEX_FORMAT && materialId > UINT16_MAX) {
+				throw std::runtime_error("failed to stream the model, too many materials for compact vertices!");
 			}
+			for (size_t face = run.faceBegin; face < run.faceEnd; face++) {
+				Vertex corners[3] = {
+					getVertex(window.indices[face * 3 + 0], materialId),
+					getVertex(window.indices[face * 3 + 1], materialId),
+					getVertex(window.indices[face * 3 + 2], materialId)
+				};
+				meshBuilder.addTriangle(corners, materialId);
+			}
+		}
+		endShape(currentShape);
+		if (_optimizeMesh)
+			optimizeMesh(windowVertices, windowIndices, windowGroups);
+
+		for (const Vertex& vertex : windowVertices) {
+			ub = glm::max(vertex.pos, ub);
+			lb = glm::min(vertex.pos, lb);
+			sum += glm::dvec3(vertex.pos);
+		}
+		for (uint32_t& index : windowIndices)
+			index += static_cast<uint32_t>(vertexCount);
+
+		//Upload through the staging ring, the window is released once it is staged
+		reserveVertices(vertexCount + windowVertices.size());
+		const void* vertexData = windowVertices.data();
+		if (_modelVertexFormat == COMPACT_VERTEX_FORMAT) {
+			packCompactVertices(windowVertices, windowCompactVertices);
+			vertexData = windowCompactVertices.data();
+		}
+		uploadVertexStreams(vertexData, windowVertices.size(), vertexCount);
+		m_uploader.uploadBuffer(_indexBuffer, sizeof(uint32_t) * indexCount, windowIndices.data(), sizeof(uint32_t) * windowIndices.size());
+		m_uploader.submit();
+		vertexCount += windowVertices.size();
+		indexCount += windowIndices.size();
+		_loadMemoryTracker.sample();
+	};
 
-			//Save the index in the material group
-			if (matGroupIndMap.find(vertex.materialId) == matGroupIndMap.end())
-				matGroupIndMap[vertex.materialId] = { uniqueVertices[vertex] };
-			else
-				matGroupIndMap[vertex.materialId].push_back(uniqueVertices[vertex]);
+	auto streamStartTime = std::chrono::high_resolution_clock::now();
+	bool loaded = objParser.stream(path, directory, &materials, &warn, &err, beginFaces, processWindow);
+	m_uploader.submit();
+	if (!loaded) {
+		throw std::runtime_error(warn + err);
+	}
+	std::cout << warn + err << std::endl;
+	auto streamEndTime = std::chrono::high_resolution_clock::now();
+
+	//Shapes are contiguous and in file order, each one ends where the next one starts
+	for (size_t i = 0; i < shapes.size(); i++) {
+		int indexEnd = i + 1 < shapes.size() ? shapes[i + 1].indexBase : static_cast<int>(indexCount);
+		shapes[i].indexCount = indexEnd - shapes[i].indexBase;
+		_shapes.push_back(shapes[i]);
+	}
+	_modelBounds.max = ub;
+	_modelBounds.min = lb;
+	_modelBounds.centerOfGravity = vertexCount == 0 ? glm::vec3(0.0f) : glm::vec3(sum / double(vertexCount));
+	_modelSourceFiles = objParser.m_materialFilenames;
+	_modelSourceFiles.insert(_modelSourceFiles.begin(), path);
+
+	double fileSizeMB = objParser.m_stats.fileSize / (1024.0 * 1024.0);
+	double streamMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(streamEndTime - streamStartTime).count();
+	_modelLoadStats.objParseMilliseconds = objParser.m_stats.totalMilliseconds;
+	_modelLoadStats.objParseThroughputMBs = objParser.m_stats.throughputMBs();
+	_modelLoadStats.objParseThreads = objParser.m_stats.threadCount;
+	_modelLoadStats.meshBuildMilliseconds = streamMilliseconds - objParser.m_stats.totalMilliseconds - _modelLoadStats.meshOptimizeMilliseconds;
+	_modelLoadStats.vertexCount = vertexCount;
+	_modelLoadStats.indexCount = indexCount;
+	_modelLoadStats.vertexBufferBytes = vertexBufferSize;
+	std::cout << "Streamed " << fileSizeMB << " MB in " << objParser.m_stats.windowCount << " window(s): parsed in "
+		<< _modelLoadStats.objParseMilliseconds << " ms, built and uploaded " << vertexCount << " vertices and " << indexCount / 3
+		<< " triangles in " << _modelLoadStats.meshBuildMilliseconds << " ms, spilled " << objParser.m_stats.spillBytes / (1024.0 * 1024.0)
+		<< " MB of attributes" << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Load the model from its binary cache, returns false if there is no valid cache.
+// Vertices and indices are uploaded straight from the mapped file and are not kept on the CPU.
+//
+bool VulkanModelViewer::loadModelCache(std::string path) {
+	BinaryCacheReader cacheReader;
+	bool cacheOpened = false;
+	for (const std::string& cachePath : getModelCachePaths(path)) {
+		if (cacheReader.open(cachePath, getModelCacheVersion())) {
+			cacheOpened = true;
+			break;
+		}
+	}
+	if (!cacheOpened) {
+		std::cout << "Model cache not used: " << cacheReader.m_rejectReason << std::endl;
+		return false;
+	}
+
+	//Compact caches carry their quantization, the vertex records are in the format of the cache
+	size_t vertexDataSize, indexCount, shapeCount, lodCount, groupCount, materialCount, texturePathSize, boundsCount, quantizationCount, meshletCount;
+	const VertexQuantization* quantization = cacheReader.sectionArray<VertexQuantization>(CACHE_VERTEX_QUANTIZATION, quantizationCount);
+	_modelVertexFormat = quantizationCount == 1 ? COMPACT_VERTEX_FORMAT : FULL_VERTEX_FORMAT;
+	const void* vertices = cacheReader.sectionData(CACHE_VERTICES, vertexDataSize);
+	size_t vertexCount = vertexDataSize / getVertexStride();
+	const uint32_t* indices = cacheReader.sectionArray<uint32_t>(CACHE_INDICES, indexCount);
+	const CachedShape* shapes = cacheReader.sectionArray<CachedShape>(CACHE_SHAPES, shapeCount);
+	const CachedShapeLod* lods = cacheReader.sectionArray<CachedShapeLod>(CACHE_SHAPE_LODS, lodCount);
+	const MaterialGroup* groups = cacheReader.sectionArray<MaterialGroup>(CACHE_MATERIAL_GROUPS, groupCount);
+	const Material* materials = cacheReader.sectionArray<Material>(CACHE_MATERIALS, materialCount);
+	const char* texturePaths = cacheReader.sectionArray<char>(CACHE_TEXTURE_PATHS, texturePathSize);
+	const ModelBounds* bounds = cacheReader.sectionArray<ModelBounds>(CACHE_BOUNDS, boundsCount);
+	const Meshlet* meshlets = cacheReader.sectionArray<Meshlet>(CACHE_MESHLETS, meshletCount);
+	if (!vertices || vertexDataSize % getVertexStride() != 0 || !indices || !shapes || !lods || !groups || !materials || !texturePaths || boundsCount != 1 || !meshlets) {
+		std::cout << "Model cache not used: missing sections" << std::endl;
+		return false;
+	}
+
+	//Validate the tables before any resource is created
+	std::vector<std::string> relativeTexturePaths;
+	for (const char* texturePath = texturePaths; texturePath < texturePaths + texturePathSize;) {
+		const char* texturePathEnd = static_cast<const char*>(memchr(texturePath, '\0', texturePaths + texturePathSize - texturePath));
+		if (!texturePathEnd)
+			return false;
+		relativeTexturePaths.push_back(std::string(texturePath, texturePathEnd));
+		texturePath = texturePathEnd + 1;
+	}
+	for (size_t i = 0; i < shapeCount; i++) {
+		if (size_t(shapes[i].materialGroupBase) + shapes[i].materialGroupCount > groupCount || size_t(shapes[i].lodBase) + shapes[i].lodCount > lodCount)
+			return false;
+	}
+	for (size_t i = 0; i < lodCount; i++) {
+		if (size_t(lods[i].materialGroupBase) + lods[i].materialGroupCount > groupCount)
+			return false;
+	}
+	for (size_t i = 0; i < groupCount; i++) {
+		if (groups[i].indexBase < 0 || size_t(groups[i].indexBase) + groups[i].indexCount > indexCount || size_t(groups[i].materialId) > materialCount)
+			return false;
+	}
+	for (size_t i = 0; i < meshletCount; i++) {
+		if (size_t(meshlets[i].indexBase) + meshlets[i].indexCount > indexCount)
+			return false;
+	}
+	const int Material::* textureIndexFields[] = {
+		&Material::ambient_texture_ind, &Material::diffuse_texture_ind, &Material::specular_texture_ind, &Material::specular_highlight_texture_ind,
+		&Material::bump_texture_ind, &Material::displacement_texture_ind, &Material::alpha_texture_ind, &Material::reflection_texture_ind,
+		&Material::roughness_texture_ind, &Material::metallic_texture_ind, &Material::sheen_texture_ind, &Material::emissive_texture_ind,
+		&Material::normal_texture_ind
+	};
+	for (size_t i = 0; i < materialCount; i++) {
+		for (auto textureIndexField : textureIndexFields) {
+			if (size_t(materials[i].*textureIndexField) > relativeTexturePaths.size())
+				return false;
 		}
+	}
 
-		//Build the material group in the shape and insert its indices to the indices array
-		for (auto matGroupInds : matGroupIndMap) {
-			MaterialGroup currenMaterialGroup {_indices.size(), matGroupInds.second.size(), matGroupInds.first};
-			currentShape.materialGroups.push_back(currenMaterialGroup);
-			_indices.insert(_indices.end(), matGroupInds.second.begin(), matGroupInds.second.end());
+	//Textures in cache order, so the texture indices of the cached materials stay valid
+	std::string directory = getDirectory(path);
+	for (const std::string& relativeTexturePath : relativeTexturePaths)
+		loadTexture(directory, relativeTexturePath);
+
+	//Materials in cache order, so the material ids of the cached vertices and groups stay valid
+	for (size_t i = 0; i < materialCount; i++)
+		addMaterial(materials[i]);
+
+	//Shapes
+	for (size_t i = 0; i < shapeCount; i++) {
+		Shape shape{ shapes[i].indexBase, shapes[i].indexCount };
+		shape.materialGroups.assign(groups + shapes[i].materialGroupBase, groups + shapes[i].materialGroupBase + shapes[i].materialGroupCount);
+		for (const CachedShapeLod* lod = lods + shapes[i].lodBase; lod < lods + shapes[i].lodBase + shapes[i].lodCount; lod++) {
+			ShapeLod shapeLod{ {}, lod->error };
+			shapeLod.materialGroups.assign(groups + lod->materialGroupBase, groups + lod->materialGroupBase + lod->materialGroupCount);
+			shape.lods.push_back(shapeLod);
 		}
+		shape.center = shapes[i].center;
+		shape.radius = shapes[i].radius;
+		_shapes.push_back(shape);
+	}
 
-		currentShape.indexCount = _indices.size() - currentShape.indexBase;
-		_shapes.push_back(currentShape);
+	_meshlets.assign(meshlets, meshlets + meshletCount);
+	_modelBounds = *bounds;
+	if (_modelVertexFormat == COMPACT_VERTEX_FORMAT)
+		_vertexQuantization = *quantization;
+	createModelBuffer(vertices, vertexDataSize, indices, sizeof(uint32_t) * indexCount);
+	_modelLoadStats.vertexCount = vertexCount;
+	_modelLoadStats.indexCount = indexCount;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Write the loaded model to its binary cache, next to the model or in the temp directory
+//
+void VulkanModelViewer::writeModelCache(std::string path) {
+	std::string directory = getDirectory(path);
+
+	//Flatten the material groups of all shapes and their levels of detail
+	std::vector<CachedShape> cachedShapes;
+	std::vector<CachedShapeLod> cachedLods;
+	std::vector<MaterialGroup> cachedGroups;
+	for (const Shape& shape : _shapes) {
+		cachedShapes.push_back({ shape.indexBase, shape.indexCount, uint32_t(cachedGroups.size()), uint32_t(shape.materialGroups.size()),
+			uint32_t(cachedLods.size()), uint32_t(shape.lods.size()), shape.center, shape.radius });
+		cachedGroups.insert(cachedGroups.end(), shape.materialGroups.begin(), shape.materialGroups.end());
+		for (const ShapeLod& lod : shape.lods) {
+			cachedLods.push_back({ uint32_t(cachedGroups.size()), uint32_t(lod.materialGroups.size()), lod.error });
+			cachedGroups.insert(cachedGroups.end(), lod.materialGroups.begin(), lod.materialGroups.end());
+		}
+	}
+
+	//Texture keys with image paths relative to the model directory, null terminated, without the
+	//empty texture. Every other part of a channel texture key is an image path.
+	std::string texturePaths;
+	for (size_t i = 1; i < _texturePaths.size(); i++) {
+		const std::string& textureKey = _texturePaths[i];
+		for (size_t begin = 0, part = 0; begin <= textureKey.size(); part++) {
+			size_t end = std::min(textureKey.find('|', begin), textureKey.size());
+			std::string keyPart = textureKey.substr(begin, end - begin);
+			if (part % 2 == 0 && keyPart.compare(0, directory.size() + 1, directory + "\\") == 0)
+				keyPart = keyPart.substr(directory.size() + 1);
+			texturePaths += keyPart;
+			if (end < textureKey.size())
+				texturePaths.push_back('|');
+			begin = end + 1;
+		}
+		texturePaths.push_back('\0');
+	}
+
+	for (const std::string& cachePath : getModelCachePaths(path)) {
+		try {
+			BinaryCacheWriter cacheWriter(getModelCacheVersion());
+			for (const std::string& sourceFile : _modelSourceFiles)
+				cacheWriter.addDependency(sourceFile);
+			if (_modelVertexFormat == COMPACT_VERTEX_FORMAT) {
+				cacheWriter.addSection(CACHE_VERTICES, _compactVertices.data(), _compactVertices.size());
+				cacheWriter.addSection(CACHE_VERTEX_QUANTIZATION, &_vertexQuantization, 1);
+			}
+			else
+				cacheWriter.addSection(CACHE_VERTICES, _vertices.data(), _vertices.size());
+			cacheWriter.addSection(CACHE_INDICES, _indices.data(), _indices.size());
+			cacheWriter.addSection(CACHE_SHAPES, cachedShapes.data(), cachedShapes.size());
+			cacheWriter.addSection(CACHE_MATERIAL_GROUPS, cachedGroups.data(), cachedGroups.size());
+			cacheWriter.addSection(CACHE_SHAPE_LODS, cachedLods.data(), cachedLods.size());
+			cacheWriter.addSection(CACHE_MATERIALS, _materialCache.data() + 1, _materialCache.size() - 1);
+			cacheWriter.addSection(CACHE_TEXTURE_PATHS, texturePaths.data(), texturePaths.size());
+			cacheWriter.addSection(CACHE_BOUNDS, &_modelBounds, 1);
+			cacheWriter.addSection(CACHE_MESHLETS, _meshlets.data(), _meshlets.size());
+			std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path());
+			cacheWriter.write(cachePath);
+			std::cout << "Wrote model cache " << cachePath << std::endl;
+			return;
+		}
+		catch (const std::exception& e) {
+			std::cout << "Failed to write model cache " << cachePath << ": " << e.what() << std::endl;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Version of the cached content for the current load options
+//
+uint32_t VulkanModelViewer::getModelCacheVersion() {
+	return MODEL_CACHE_VERSION << 8 | (_packScalarTextures ? 8u : 0u) | (_generateLods ? 4u : 0u) | (_vertexFormatOption == COMPACT_VERTEX_FORMAT ? 2u : 0u) | (_optimizeMesh ? 1u : 0u);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Candidate locations of the model cache, in the order they are tried
+//
+std::vector<std::string> VulkanModelViewer::getModelCachePaths(std::string path) {
+	std::string cacheFilename = std::to_string(std::hash<std::string>()(path)) + "_" + std::filesystem::path(path).filename().string() + ".vmvcache";
+	std::error_code errorCode;
+	std::filesystem::path tempDirectory = std::filesystem::temp_directory_path(errorCode);
+	if (errorCode)
+		return { path + ".vmvcache" };
+	return { path + ".vmvcache", (tempDirectory / "VulkanModelViewer" / cacheFilename).string() };
+}
+
+//--------------------------------------------------------------------------------------------------
+// Map a .mtl material id to its material cache id, the material is loaded on first use.
+// Invalid ids map to the default material.
+//
+int VulkanModelViewer::getMaterialIndex(std::string directory, const std::vector<tinyobj::material_t>& materials, std::vector<int>& materialIndexMap, int materialIdLocal) {
+	if (materialIdLocal < 0 || materialIdLocal >= static_cast<int>(materials.size()))
+		return 0;
+	int& materialIndex = materialIndexMap[materialIdLocal];
+	if (materialIndex < 0) {
+		Material mat = loadMaterial(directory, materials[materialIdLocal]);
+		auto lookupStartTime = std::chrono::high_resolution_clock::now();
+		materialIndex = findMaterial(mat);
+		auto lookupEndTime = std::chrono::high_resolution_clock::now();
+		_modelLoadStats.materialLookupMilliseconds += std::chrono::duration<double, std::chrono::milliseconds::period>(lookupEndTime - lookupStartTime).count();
+		_modelLoadStats.materialLookups++;
+		if (materialIndex < 0)
+			materialIndex = addMaterial(mat);
+	}
+	return materialIndex;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Find a material equal to mat in the material cache, returns -1 if there is none
+//
+int VulkanModelViewer::findMaterial(const Material& mat) {
+	auto range = _materialIndices.equal_range(mat.hash());
+	for (auto it = range.first; it != range.second; ++it) {
+		if (_materialCache[it->second] == mat)
+			return it->second;
 	}
+	return -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Append a material to the material cache, returns its material cache id. It is uploaded to the
+// material buffer and its textures written to the material set by updateMaterialDescriptors.
+//
+int VulkanModelViewer::addMaterial(const Material& mat) {
+	int materialIndex = static_cast<int>(_materialCache.size());
+	_materialCache.push_back(mat);
+	_materialIndices.emplace(mat.hash(), materialIndex);
+	return materialIndex;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -2507,20 +5257,14 @@ VulkanModelViewer::Material VulkanModelViewer::loadMaterial(std::string director
 	mat.anisotropy = material.anisotropy;
 	mat.anisotropy_rotation = material.anisotropy_rotation;
 
-	//Texuture settings
+	//Texuture settings, color maps are sRGB RGBA8 and normal maps keep their two tangent space channels
 	mat.ambient_texture_ind = loadTexture(directory, material.ambient_texname);
 	mat.diffuse_texture_ind = loadTexture(directory, material.diffuse_texname);
 	mat.specular_texture_ind = loadTexture(directory, material.specular_texname);
-	mat.specular_highlight_texture_ind = loadTexture(directory, material.specular_highlight_texname);
-	mat.bump_texture_ind = loadTexture(directory, material.bump_texname);
-	mat.displacement_texture_ind = loadTexture(directory, material.displacement_texname);
-	mat.alpha_texture_ind = loadTexture(directory, material.alpha_texname);
 	mat.reflection_texture_ind = loadTexture(directory, material.reflection_texname);
-	mat.roughness_texture_ind = loadTexture(directory, material.roughness_texname);
-	mat.metallic_texture_ind = loadTexture(directory, material.metallic_texname);
-	mat.sheen_texture_ind = loadTexture(directory, material.sheen_texname);
 	mat.emissive_texture_ind = loadTexture(directory, material.emissive_texname);
-	mat.normal_texture_ind = loadTexture(directory, material.normal_texname);
+	mat.normal_texture_ind = material.normal_texname.empty() ? 0 : loadTexture(directory, material.normal_texname + "|rg");
+	loadScalarTextures(directory, material, mat);
 
 	updateMaterialUbo(mat);
 
@@ -2528,6 +5272,60 @@ VulkanModelViewer::Material VulkanModelViewer::loadMaterial(std::string director
 }
 
 
+//--------------------------------------------------------------------------------------------------
+// Load the scalar maps of a material as single channel textures, or with _packScalarTextures pack
+// up to four of them into the channels of one texture. The channel of every map in its texture is
+// recorded in mat.texture_channels, maps of the same image channel share it.
+//
+void VulkanModelViewer::loadScalarTextures(std::string directory, const tinyobj::material_t& material, Material& mat) {
+	struct ScalarMap {
+		TextureSlot slot;
+		int Material::* textureIndex;
+		const std::string& texname;
+		const tinyobj::texture_option_t& option;
+	};
+	const ScalarMap scalarMaps[] = {
+		{ SPECULAR_HIGHLIGHT_TEXTURE, &Material::specular_highlight_texture_ind, material.specular_highlight_texname, material.specular_highlight_texopt },
+		{ BUMP_TEXTURE, &Material::bump_texture_ind, material.bump_texname, material.bump_texopt },
+		{ DISPLACEMENT_TEXTURE, &Material::displacement_texture_ind, material.displacement_texname, material.displacement_texopt },
+		{ ALPHA_TEXTURE, &Material::alpha_texture_ind, material.alpha_texname, material.alpha_texopt },
+		{ ROUGHNESS_TEXTURE, &Material::roughness_texture_ind, material.roughness_texname, material.roughness_texopt },
+		{ METALLIC_TEXTURE, &Material::metallic_texture_ind, material.metallic_texname, material.metallic_texopt },
+		{ SHEEN_TEXTURE, &Material::sheen_texture_ind, material.sheen_texname, material.sheen_texopt }
+	};
+
+	//Distinct image channels, -imfchan picks the channel and defaults to 'l' for bump maps and 'm' otherwise
+	std::vector<std::string> channelKeys;
+	std::vector<std::vector<const ScalarMap*>> channelMaps;
+	for (const ScalarMap& scalarMap : scalarMaps) {
+		if (scalarMap.texname.empty())
+			continue;
+		char channel = scalarMap.option.imfchan == 'z' ? 'l' : scalarMap.option.imfchan;
+		std::string channelKey = preprocessPath(scalarMap.texname) + "|" + std::string(1, channel != '\0' && strchr("rgbml", channel) ? channel : 'm');
+		size_t channelIndex = std::find(channelKeys.begin(), channelKeys.end(), channelKey) - channelKeys.begin();
+		if (channelIndex == channelKeys.size()) {
+			channelKeys.push_back(channelKey);
+			channelMaps.emplace_back();
+		}
+		channelMaps[channelIndex].push_back(&scalarMap);
+	}
+
+	size_t channelsPerTexture = _packScalarTextures ? 4 : 1;
+	for (size_t first = 0; first < channelKeys.size(); first += channelsPerTexture) {
+		size_t channelCount = std::min(channelsPerTexture, channelKeys.size() - first);
+		std::string textureKey = channelKeys[first];
+		for (size_t channel = 1; channel < channelCount; channel++)
+			textureKey += "|" + channelKeys[first + channel];
+		int textureIndex = loadTexture(directory, textureKey);
+		for (size_t channel = 0; channel < channelCount; channel++) {
+			for (const ScalarMap* scalarMap : channelMaps[first + channel]) {
+				mat.*(scalarMap->textureIndex) = textureIndex;
+				mat.texture_channels |= int(channel) << (2 * scalarMap->slot);
+			}
+		}
+	}
+}
+
 //--------------------------------------------------------------------------------------------------
 // Update the ubo according to the material information
 //
@@ -2561,84 +5359,79 @@ void VulkanModelViewer::updateMaterialUbo(Material& mat) {
 	mat.ubo.sheen_texture_ind = mat.sheen_texture_ind;
 	mat.ubo.emissive_texture_ind = mat.emissive_texture_ind;
 	mat.ubo.normal_texture_ind = mat.normal_texture_ind;
+	mat.ubo.texture_channels = mat.texture_channels;
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create the uniform buffer and copy data from material information
+// Write the current views of textureCount textures from firstTexture on into the texture array of the
+// material set, at their texture index
 //
-VulkanModelViewer::BufferResource VulkanModelViewer::getMaterialUniformBuffer(Material mat) {
-	BufferResource uniformBuffer;
-	m_bufferUtil.createBuffer(sizeof(MaterialUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffer.buffer, uniformBuffer.bufferMemory);
-
-	void* data;
-	vkMapMemory(m_device, uniformBuffer.bufferMemory, 0, sizeof(mat.ubo), 0, &data);
-	memcpy(data, &mat.ubo, sizeof(mat.ubo));
-	vkUnmapMemory(m_device, uniformBuffer.bufferMemory);
-
-	return uniformBuffer;
+void VulkanModelViewer::updateTextureDescriptors(size_t firstTexture, size_t textureCount) {
+	std::vector<VkDescriptorImageInfo> imageInfos;
+	imageInfos.reserve(textureCount);
+	for (size_t i = firstTexture; i < firstTexture + textureCount; i++)
+		imageInfos.push_back({ _samplers.textureSampler, _textureResources[i].imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+	m_descriptorUtil.updateImageDescriptors(_descriptorSets.materialDescriptorSet, 1, static_cast<uint32_t>(firstTexture), VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageInfos);
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create the descriptor set for given material
-//
-VkDescriptorSet VulkanModelViewer::getMaterialDescriptorSet(Material mat, VkBuffer matUniformBuffer){
-	//Initialization
-	VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
-	_descriptorSetInfos.materialDescriptorInfo.bufferInfos.clear();
-	_descriptorSetInfos.materialDescriptorInfo.imageInfos.clear();
-
-	//Uniform buffer
-	VkDescriptorBufferInfo bufferInfo = { matUniformBuffer, 0, sizeof(MaterialUBO) };
-	_descriptorSetInfos.materialDescriptorInfo.bufferInfos.push_back(bufferInfo);
-	//Images
-	VkDescriptorImageInfo imageInfo{};
-	imageInfo = { _samplers.textureSampler, _textureResources[mat.ambient_texture_ind].imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-	_descriptorSetInfos.materialDescriptorInfo.imageInfos.push_back(imageInfo);
-	imageInfo = { _samplers.textureSampler, _textureResources[mat.diffuse_texture_ind].imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-	_descriptorSetInfos.materialDescriptorInfo.imageInfos.push_back(imageInfo);
-	imageInfo = { _samplers.textureSampler, _textureResources[mat.specular_texture_ind].imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-	_descriptorSetInfos.materialDescriptorInfo.imageInfos.push_back(imageInfo);
-	imageInfo = { _samplers.textureSampler, _textureResources[mat.specular_highlight_texture_ind].imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-	_descriptorSetInfos.materialDescriptorInfo.imageInfos.push_back(imageInfo);
-	imageInfo = { _samplers.textureSampler, _textureResources[mat.bump_texture_ind].imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-	_descriptorSetInfos.materialDescriptorInfo.imageInfos.push_back(imageInfo);
-	imageInfo = { _samplers.textureSampler, _textureResources[mat.displacement_texture_ind].imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-	_descriptorSetInfos.materialDescriptorInfo.imageInfos.push_back(imageInfo);
-	imageInfo = { _samplers.textureSampler, _textureResources[mat.alpha_texture_ind].imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-	_descriptorSetInfos.materialDescriptorInfo.imageInfos.push_back(imageInfo);
-	imageInfo = { _samplers.textureSampler, _textureResources[mat.reflection_texture_ind].imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-	_descriptorSetInfos.materialDescriptorInfo.imageInfos.push_back(imageInfo);
-
-	m_descriptorUtil.createDescriptorSet(_descriptorPools.materialDescriptorPool, _descriptorSetLayouts.materialDescriptorSetLayout, _descriptorSetInfos.materialDescriptorInfo, descriptorSet);
-
-	return descriptorSet;
-}
-
-//--------------------------------------------------------------------------------------------------
-// Return the index of the texture in the texture cache,
-// and load the texture image if its path is not already in the cache.
-// 
-//
-int VulkanModelViewer::loadTexture(std::string directory, std::string relativePath) {
-	int ind;
-	auto texPathBeginIt = _texturePaths.begin();
-	auto texPathEndIt = _texturePaths.end();
-	if (relativePath.size() > 0) {
-		relativePath = preprocessPath(relativePath);
-		std::string fullPath = directory + "\\" + relativePath;
-		auto texPathFindIt = std::find(texPathBeginIt, texPathEndIt, fullPath);
-		if (texPathFindIt == texPathEndIt) {
-			_textureResources.push_back(createTextureImageResource(fullPath));
-			_texturePaths.push_back(fullPath);
-			ind = _textureResources.size() - 1;
-		}
-		else {
-			ind = texPathFindIt - texPathBeginIt;
-		}	
+// Return the index of the texture in the texture cache, and queue the texture image for
+// loadPendingTextures if its key is not already in the cache. The key of a color texture is its
+// image path, it is loaded as sRGB RGBA8. Channel textures are keyed by pairs of image path and
+// channels separated by '|', e.g. "rough.png|l|metal.png|b", and are loaded as R8, R8G8 or
+// R8G8B8A8 UNORM by their channel count.
+//
+int VulkanModelViewer::loadTexture(std::string directory, std::string relativeKey) {
+	if (relativeKey.empty())
+		return 0;
+	std::vector<std::string> keyParts(1);
+	for (char c : relativeKey) {
+		if (c == '|')
+			keyParts.emplace_back();
+		else
+			keyParts.back().push_back(c);
 	}
-	else {
-		ind = 0;
+	std::vector<TextureChannelSource> channelSources;
+	for (size_t i = 0; i + 1 < keyParts.size(); i += 2)
+		channelSources.push_back({ directory + "\\" + preprocessPath(keyParts[i]), keyParts[i + 1] });
+	std::string fullPath = channelSources.empty() ? directory + "\\" + preprocessPath(relativeKey) : std::string();
+	for (const TextureChannelSource& source : channelSources)
+		fullPath += (fullPath.empty() ? "" : "|") + source.path + "|" + source.channels;
+
+	_modelLoadStats.textureLookups++;
+	auto texIndexIt = _textureIndices.find(fullPath);
+	if (texIndexIt != _textureIndices.end())
+		return texIndexIt->second;
+
+	//Prefer a cooked KTX2 file next to the image unless it is older, it needs BC support. Channel
+	//textures only use it if they start at the red channel of a single image.
+	std::string cookedPath;
+	std::string imagePath = fullPath;
+	if (!channelSources.empty()) {
+		const std::string& channels = channelSources[0].channels;
+		bool cookable = channelSources.size() == 1 && (channels == "r" || channels == "l" || channels == "rg");
+		imagePath = cookable ? channelSources[0].path : std::string();
+	}
+	std::filesystem::path texturePath(imagePath);
+	if (!imagePath.empty() && texturePath.extension() == ".ktx2") {
+		cookedPath = imagePath;
+	}
+	else if (!imagePath.empty() && m_deviceFeatures.textureCompressionBC) {
+		std::filesystem::path siblingPath = std::filesystem::path(texturePath).replace_extension(".ktx2");
+		std::error_code errorCode;
+		if (std::filesystem::exists(siblingPath, errorCode)
+			&& std::filesystem::last_write_time(siblingPath, errorCode) >= std::filesystem::last_write_time(texturePath, errorCode))
+			cookedPath = siblingPath.string();
 	}
+
+	int ind = static_cast<int>(_textureResources.size());
+	_textureResources.push_back(ImageResource{ VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE });
+	_textureImageOwners.push_back(ind);
+	_pendingTextures.push_back({ ind, fullPath, cookedPath, channelSources });
+	_texturePaths.push_back(fullPath);
+	_textureIndices.emplace(fullPath, ind);
+	_modelLoadStats.channelTextureCount += channelSources.empty() ? 0 : 1;
+	_modelLoadStats.packedTextureCount += channelSources.size() > 1 ? 1 : 0;
 	return ind;
 }
 
@@ -2675,10 +5468,31 @@ void VulkanModelViewer::glfwCursorPositionCallback(GLFWwindow* window, double xp
 */
 
 //--------------------------------------------------------------------------------------------------
-// Preprocess a file path string to unify its format
+// Preprocess a file path string to unify its format: forward slashes become backslashes and
+// repeated separators are collapsed into one
 //
 std::string VulkanModelViewer::preprocessPath(std::string path) {
-	std::regex reg("\\\\\\\\");
-	path = std::regex_replace(path.c_str(), reg, "\\");
-	return path;
+	std::string normalizedPath;
+	normalizedPath.reserve(path.size());
+	for (char c : path) {
+		if (c == '/')
+			c = '\\';
+		if (c == '\\' && !normalizedPath.empty() && normalizedPath.back() == '\\')
+			continue;
+		normalizedPath.push_back(c);
+	}
+	return normalizedPath;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Get the directory part of a file path
+//
+std::string VulkanModelViewer::getDirectory(std::string path) {
+	std::string directory;
+	const size_t last_slash_idx = path.rfind('\\');
+	if (std::string::npos != last_slash_idx)
+	{
+		directory = path.substr(0, last_slash_idx);
+	}
+	return directory;
 }
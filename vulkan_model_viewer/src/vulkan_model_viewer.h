@@ -7,12 +7,35 @@
 #include <backends/imgui_impl_vulkan.h>
 #include <backends/imgui_impl_glfw.h>
 
+#include <glm/gtc/packing.hpp>
+
 #include <array>
+#include <bitset>
 #include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
 #include <chrono>
-#include <regex>
+#include <filesystem>
+#include <fstream>
+#include <memory>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "obj_parser.h"
+#include "mesh_builder.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "meshlet_builder.h"
+#include "binary_cache.h"
+#include "ktx2_file.h"
+#include "texture_compression.h"
+#include "process_memory.h"
+#include "texture_residency.h"
+#include "attachment_planner.h"
+#include "worker_pool.h"
 
 #include "configFile.h"
 
@@ -22,6 +45,23 @@
 class VulkanModelViewer : public VulkanAppBase {
 public:
 
+	//Vertex attributes are stored as separate streams, the stream index is the binding and the
+	//shader location of the attribute
+	enum VertexStream {
+		POSITION_STREAM = 0,
+		COLOR_STREAM = 1,
+		TEXCOORD_STREAM = 2,
+		NORMAL_STREAM = 3,
+		MATERIAL_STREAM = 4,
+		VERTEX_STREAM_COUNT = 5
+	};
+
+	//Where the elements of a stream are in a vertex record, a stream of size 0 lives in another stream
+	struct VertexStreamInfo {
+		uint32_t recordOffset;
+		uint32_t size;
+	};
+
 	//Vertex
 	struct Vertex {
 		glm::vec3 pos;
@@ -30,47 +70,107 @@ public:
 		glm::vec3 normal;
 		int materialId;
 
-		static VkVertexInputBindingDescription getBindingDescription() {
-			VkVertexInputBindingDescription bindingDescription{};
-			bindingDescription.binding = 0;
-			bindingDescription.stride = sizeof(Vertex);
-			bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-			return bindingDescription;
+		static std::array<VertexStreamInfo, VERTEX_STREAM_COUNT> getStreamInfos() {
+			std::array<VertexStreamInfo, VERTEX_STREAM_COUNT> streamInfos{};
+			streamInfos[POSITION_STREAM] = { offsetof(Vertex, pos), sizeof(glm::vec3) };
+			streamInfos[COLOR_STREAM] = { offsetof(Vertex, color), sizeof(glm::vec3) };
+			streamInfos[TEXCOORD_STREAM] = { offsetof(Vertex, texCoord), sizeof(glm::vec2) };
+			streamInfos[NORMAL_STREAM] = { offsetof(Vertex, normal), sizeof(glm::vec3) };
+			streamInfos[MATERIAL_STREAM] = { offsetof(Vertex, materialId), sizeof(int) };
+			return streamInfos;
 		}
 
-		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() {
-			std::vector<VkVertexInputAttributeDescription> attributeDescriptions(5);
-
-			attributeDescriptions[0].binding = 0;
-			attributeDescriptions[0].location = 0;
-			attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-			attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-			attributeDescriptions[1].binding = 0;
-			attributeDescriptions[1].location = 1;
-			attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-			attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-			attributeDescriptions[2].binding = 0;
-			attributeDescriptions[2].location = 2;
-			attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-			attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-			attributeDescriptions[3].binding = 0;
-			attributeDescriptions[3].location = 3;
-			attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-			attributeDescriptions[3].offset = offsetof(Vertex, normal);
-
-			attributeDescriptions[4].binding = 0;
-			attributeDescriptions[4].location = 4;
-			attributeDescriptions[4].format = VK_FORMAT_R32_SINT;
-			attributeDescriptions[4].offset = offsetof(Vertex, materialId);
+		//Attributes of the given streams, every attribute is read from the binding of its stream
+		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(uint32_t streamMask) {
+			const VkFormat formats[VERTEX_STREAM_COUNT] = { VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+				VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32_SINT };
+			std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+			for (uint32_t stream = 0; stream < VERTEX_STREAM_COUNT; stream++) {
+				if (streamMask & (1u << stream))
+					attributeDescriptions.push_back({ stream, stream, formats[stream], 0 });
+			}
 			return attributeDescriptions;
 		}
 
 		bool operator==(const Vertex& other) const {
-			return pos == other.pos && color == other.color && texCoord == other.texCoord && materialId == other.materialId;
+			return pos == other.pos && color == other.color && texCoord == other.texCoord && normal == other.normal && materialId == other.materialId;
+		}
+	};
+
+	//Maps the model bounds to the unit cube the compact positions are quantized in
+	struct VertexQuantization {
+		glm::vec3 offset{ 0.f, 0.f, 0.f };
+		glm::vec3 scale{ 1.f, 1.f, 1.f };
+
+		//Any scale works along a flat axis, all positions are at the offset
+		static VertexQuantization fromBounds(const glm::vec3& min, const glm::vec3& max) {
+			return VertexQuantization{ min, glm::max(max - min, glm::vec3(1e-20f)) };
+		}
+
+		glm::mat4 getDequantizeMatrix() const {
+			return glm::scale(glm::translate(glm::mat4(1.0f), offset), scale);
+		}
+	};
+
+	//Compact vertex, 20 bytes instead of 48. Positions are 16-bit fixed point inside the model bounds
+	//and the material id takes the fourth 16-bit lane of the position. Normals are octahedral encoded,
+	//texture coordinates are half floats and colors are 8-bit.
+	struct CompactVertex {
+		uint16_t pos[3];
+		uint16_t materialId;
+		uint32_t normal;
+		uint32_t texCoord;
+		uint32_t color;
+
+		//The material id is read from the position stream
+		static std::array<VertexStreamInfo, VERTEX_STREAM_COUNT> getStreamInfos() {
+			std::array<VertexStreamInfo, VERTEX_STREAM_COUNT> streamInfos{};
+			streamInfos[POSITION_STREAM] = { offsetof(CompactVertex, pos), 4 * sizeof(uint16_t) };
+			streamInfos[COLOR_STREAM] = { offsetof(CompactVertex, color), sizeof(uint32_t) };
+			streamInfos[TEXCOORD_STREAM] = { offsetof(CompactVertex, texCoord), sizeof(uint32_t) };
+			streamInfos[NORMAL_STREAM] = { offsetof(CompactVertex, normal), sizeof(uint32_t) };
+			streamInfos[MATERIAL_STREAM] = { offsetof(CompactVertex, materialId), 0 };
+			return streamInfos;
+		}
+
+		//Three component 16-bit formats are not required for vertex buffers, the position reads the
+		//material id as its unused fourth component
+		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(uint32_t streamMask) {
+			const VkFormat formats[VERTEX_STREAM_COUNT] = { VK_FORMAT_R16G16B16A16_UNORM, VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R16G16_SFLOAT,
+				VK_FORMAT_R16G16_SNORM, VK_FORMAT_R16_UINT };
+			std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+			for (uint32_t stream = 0; stream < VERTEX_STREAM_COUNT; stream++) {
+				if (!(streamMask & (1u << stream)))
+					continue;
+				if (stream == MATERIAL_STREAM)
+					attributeDescriptions.push_back({ stream, POSITION_STREAM, formats[stream], offsetof(CompactVertex, materialId) });
+				else
+					attributeDescriptions.push_back({ stream, stream, formats[stream], 0 });
+			}
+			return attributeDescriptions;
+		}
+
+		static CompactVertex pack(const Vertex& vertex, const VertexQuantization& quantization) {
+			CompactVertex compactVertex{};
+			glm::vec3 pos = glm::clamp((vertex.pos - quantization.offset) / quantization.scale, 0.0f, 1.0f);
+			for (int i = 0; i < 3; i++)
+				compactVertex.pos[i] = static_cast<uint16_t>(pos[i] * 65535.0f + 0.5f);
+			compactVertex.materialId = static_cast<uint16_t>(vertex.materialId);
+
+			//Project the normal on the octahedron and fold the lower half over the diagonals
+			glm::vec2 octahedral{ 0.0f, 0.0f };
+			float length = std::abs(vertex.normal.x) + std::abs(vertex.normal.y) + std::abs(vertex.normal.z);
+			if (length > 0.0f) {
+				octahedral = glm::vec2(vertex.normal) / length;
+				if (vertex.normal.z < 0.0f) {
+					glm::vec2 signs{ octahedral.x >= 0.0f ? 1.0f : -1.0f, octahedral.y >= 0.0f ? 1.0f : -1.0f };
+					octahedral = (1.0f - glm::abs(glm::vec2(octahedral.y, octahedral.x))) * signs;
+				}
+			}
+			compactVertex.normal = glm::packSnorm2x16(octahedral);
+			compactVertex.texCoord = glm::packHalf2x16(vertex.texCoord);
+			compactVertex.color = glm::packUnorm4x8(glm::vec4(vertex.color, 1.0f));
+			return compactVertex;
 		}
 	};
 
@@ -106,6 +206,30 @@ private:
 		SHADOW_MAPPING = 1
 	};
 
+	//Type of .obj loader in use
+	enum ObjLoaderType {
+		PARALLEL_OBJ_LOADER = 0,
+		TINYOBJ_LOADER = 1,
+		STREAMING_OBJ_LOADER = 2
+	};
+
+	//Layout of the model vertex buffer
+	enum VertexFormatType {
+		FULL_VERTEX_FORMAT = 0,
+		COMPACT_VERTEX_FORMAT = 1
+	};
+
+	//Render passes drawing the model, recorded for every swapchain image
+	enum ObjectPass {
+		SCENE_OBJECT_PASS = 0,
+		SCENE_NO_SHADOW_OBJECT_PASS = 1,
+		SCENE_BLANK_MODEL_OBJECT_PASS = 2,
+		SCENE_NO_SHADOW_BLANK_MODEL_OBJECT_PASS = 3,
+		WIREFRAME_OBJECT_PASS = 4,
+		SHADOW_OBJECT_PASS = 5,
+		OBJECT_PASS_COUNT = 6
+	};
+
 	//App info structs
 	struct Camera {
 		glm::vec3 pos;
@@ -120,13 +244,80 @@ private:
 
 	struct ImageResource {
 		VkImage image;
-		VkDeviceMemory imageMemory;
+		vkimpl::MemoryAllocation imageMemory;
 		VkImageView imageView;
+		uint32_t baseLevel{ 0 };   //Level of the full mip chain held by the first level of the image
 	};
 
 	struct BufferResource {
 		VkBuffer buffer;
-		VkDeviceMemory bufferMemory;
+		vkimpl::MemoryAllocation bufferMemory;
+	};
+
+	//Render target whose memory is placed by planAttachmentMemory, in use from firstPass to lastPass
+	//of the frame. The image memory of resource stays empty, the planned memory holds it.
+	struct FrameAttachment {
+		ImageResource* resource;   //nullptr for attachments only planned
+		vkimpl::VulkanImageInfo imageInfo;
+		uint32_t firstPass;
+		uint32_t lastPass;
+		std::string name;
+	};
+
+	//Render target memory of a frame at a resolution
+	struct AttachmentMemoryReport {
+		VkExtent2D extent;
+		VkDeviceSize separateBytes;    //Every render target and the full size default shadow map in memory of their own
+		VkDeviceSize committedBytes;   //Planned memory, lazily allocated groups excluded
+		VkDeviceSize lazyBytes;        //Lazily allocated groups, only backed where a tiler needs them
+		size_t groupCount;
+	};
+
+	//Channels of a channel texture taken from one image, one character per channel: 'r', 'g', 'b',
+	//'a', 'l' for the luminance or 'm' for the alpha if the image is translucent and the luminance
+	//otherwise
+	struct TextureChannelSource {
+		std::string path;
+		std::string channels;
+	};
+
+	//Texture queued by loadTexture, decoded by loadPendingTextures and streamed in by streamTextures
+	struct PendingTexture {
+		int textureIndex;
+		std::string path;         //Texture key, see loadTexture
+		std::string cookedPath;   //Block compressed KTX2 file loaded instead of the image, empty if none
+		std::vector<TextureChannelSource> channelSources;   //Empty for RGBA color textures
+	};
+
+	//Texels or the cooked mip levels of a pending texture, both empty if it could not be read
+	struct DecodedTexture {
+		size_t pendingIndex;      //Index in _decodingTextures
+		std::shared_ptr<uint8_t> pixels;
+		size_t pixelBytes;
+		std::shared_ptr<Ktx2Reader> cooked;
+		int width;
+		int height;
+		VkFormat format;
+		VkDeviceSize stagingSize;
+	};
+
+	//Texture whose image is filled from its coarsest mip levels on. Its view in _textureResources
+	//shows the resident levels and is replaced as finer ones arrive. The image of a cooked texture
+	//holds the levels selected by updateTextureResidency, it is replaced by a larger or smaller one
+	//when the selection changes. Levels are numbered in the full mip chain of imageInfo.
+	struct StreamingTexture {
+		int textureIndex;
+		DecodedTexture texture;   //Texels released once every level is submitted, cooked levels kept for restreaming
+		vkimpl::VulkanImageInfo imageInfo;
+		ImageResource image;          //VK_NULL_HANDLE until the residency selected the levels of a cooked texture
+		ImageResource retiredImage;   //Image replaced by image, shown until the view of image replaces it
+		VkDeviceSize memorySize;
+		std::vector<VkDeviceSize> chainBytes;   //Bytes of the levels from each level on
+		uint32_t tailLevel;        //Finest level of the first upload step, always resident
+		uint32_t targetLevel;      //Finest level selected by the residency
+		uint32_t submittedLevel;   //Finest level submitted for upload, mipLevels if none
+		uint32_t residentLevel;    //Finest level whose upload finished
+		uint32_t viewLevel;        //Finest level of the image view, mipLevels while the placeholder is shown
 	};
 
 	// Uniform buffer structs
@@ -135,6 +326,7 @@ private:
 		alignas(16) glm::mat4 view;
 		alignas(16) glm::mat4 proj;
 		alignas(16) glm::vec3 cameraPos;
+		alignas(16) glm::mat4 dequantize;
 	};
 
 	struct LightInfoUBO {
@@ -176,6 +368,7 @@ private:
 		alignas(4) int sheen_texture_ind;
 		alignas(4) int emissive_texture_ind;
 		alignas(4) int normal_texture_ind;
+		alignas(4) int texture_channels;
 	};
 
 	//Material group
@@ -185,11 +378,98 @@ private:
 		int materialId;
 	};
 
+	//Simplified level of detail of a shape, its groups index the vertices of the full shape.
+	//error bounds the distance between the level and the full shape in model units.
+	struct ShapeLod {
+		std::vector<MaterialGroup> materialGroups;
+		float error;
+	};
+
 	//Shape
 	struct Shape {
 		int indexBase;
 		int indexCount;
 		std::vector<MaterialGroup> materialGroups;
+		std::vector<ShapeLod> lods;   //Coarser with every level, empty for streamed models
+		glm::vec3 center{ 0.f, 0.f, 0.f };
+		float radius{ 0.f };
+		int lodLevel{ 0 };            //Drawn level, 0 is the full shape
+	};
+
+	//Meshlet of the culling pass, a range of a material group index range. std430 layout of
+	//meshlet_culling.comp.glsl, also the cached record.
+	struct Meshlet {
+		glm::vec4 sphere;      //xyz center, w radius, in model space
+		glm::vec4 cone;        //xyz axis, w cutoff
+		uint32_t indexBase;
+		uint32_t indexCount;
+		uint32_t padding[2];
+	};
+
+	//Draw of an object pass: an index range, or the culled meshlets of the material group drawGroup
+	//when it is not negative
+	struct DrawListItem {
+		uint32_t indexBase;
+		uint32_t indexCount;
+		int32_t drawGroup;
+	};
+
+	//Draws of a drawn material group in the indirect draw buffers
+	struct MeshletDrawGroup {
+		uint32_t drawBase;
+		uint32_t meshletCount;
+	};
+
+	//Axis aligned bounds and center of gravity of the model vertices
+	struct ModelBounds {
+		glm::vec3 min{ 0.f, 0.f, 0.f };
+		glm::vec3 max{ 0.f, 0.f, 0.f };
+		glm::vec3 centerOfGravity{ 0.f, 0.f, 0.f };
+	};
+
+	//Model cache records, the material groups of all shapes are stored in one section
+	enum ModelCacheSection {
+		CACHE_VERTICES = 0,
+		CACHE_INDICES = 1,
+		CACHE_SHAPES = 2,
+		CACHE_MATERIAL_GROUPS = 3,
+		CACHE_MATERIALS = 4,
+		CACHE_TEXTURE_PATHS = 5,
+		CACHE_BOUNDS = 6,
+		CACHE_VERTEX_QUANTIZATION = 7,
+		CACHE_SHAPE_LODS = 8,
+		CACHE_MESHLETS = 9
+	};
+
+	//Streams of the vertex buffer. A stream with the same value for every vertex, like the colors of
+	//a file without vertex colors, stores that value once and is read with a zero stride.
+	struct VertexStreamLayout {
+		std::array<VertexStreamInfo, VERTEX_STREAM_COUNT> streams{};
+		std::array<VkDeviceSize, VERTEX_STREAM_COUNT> offsets{};
+		uint32_t constantStreams{ 0 };
+	};
+
+	struct CachedShape {
+		int indexBase;
+		int indexCount;
+		uint32_t materialGroupBase;
+		uint32_t materialGroupCount;
+		uint32_t lodBase;
+		uint32_t lodCount;
+		glm::vec3 center;
+		float radius;
+	};
+
+	struct CachedShapeLod {
+		uint32_t materialGroupBase;
+		uint32_t materialGroupCount;
+		float error;
+	};
+
+	//Texture slots of a material in the order of its texture index fields
+	enum TextureSlot {
+		AMBIENT_TEXTURE, DIFFUSE_TEXTURE, SPECULAR_TEXTURE, SPECULAR_HIGHLIGHT_TEXTURE, BUMP_TEXTURE, DISPLACEMENT_TEXTURE, ALPHA_TEXTURE,
+		REFLECTION_TEXTURE, ROUGHNESS_TEXTURE, METALLIC_TEXTURE, SHEEN_TEXTURE, EMISSIVE_TEXTURE, NORMAL_TEXTURE
 	};
 
 	//Material
@@ -230,6 +510,10 @@ private:
 		int emissive_texture_ind{ 0 };   // map_Ke
 		int normal_texture_ind{ 0 };     // norm. For normal mapping.
 
+		//Channel of every scalar map in its texture, two bits per texture slot in the order above.
+		//Scalar maps are single channel textures unless they are packed into one texture.
+		int texture_channels{ 0 };
+
 		MaterialUBO ubo{};
 
 		bool operator==(const Material& other) const {
@@ -243,7 +527,26 @@ private:
 				&& clearcoat_thickness == other.clearcoat_thickness && clearcoat_roughness == other.clearcoat_roughness && anisotropy == other.anisotropy
 				&& anisotropy_rotation == other.anisotropy_rotation && roughness_texture_ind == other.roughness_texture_ind
 				&& metallic_texture_ind == other.metallic_texture_ind && sheen_texture_ind == other.sheen_texture_ind 
-				&& emissive_texture_ind == other.emissive_texture_ind && normal_texture_ind == other.normal_texture_ind;
+				&& emissive_texture_ind == other.emissive_texture_ind && normal_texture_ind == other.normal_texture_ind
+				&& texture_channels == other.texture_channels;
+		}
+
+		//Hash of the fields compared by operator==, -0 is hashed as 0 since they compare equal
+		uint64_t hash() const {
+			struct {
+				std::array<float, 25> floats;
+				std::array<int, 15> ints;
+			} key{ {
+				ambient.x + 0.f, ambient.y + 0.f, ambient.z + 0.f, diffuse.x + 0.f, diffuse.y + 0.f, diffuse.z + 0.f,
+				specular.x + 0.f, specular.y + 0.f, specular.z + 0.f, transmittance.x + 0.f, transmittance.y + 0.f, transmittance.z + 0.f,
+				emission.x + 0.f, emission.y + 0.f, emission.z + 0.f, shininess + 0.f, ior + 0.f, dissolve + 0.f, roughness + 0.f,
+				metallic + 0.f, sheen + 0.f, clearcoat_thickness + 0.f, clearcoat_roughness + 0.f, anisotropy + 0.f, anisotropy_rotation + 0.f
+			}, {
+				illumModelIndex, ambient_texture_ind, diffuse_texture_ind, specular_texture_ind, specular_highlight_texture_ind,
+				bump_texture_ind, displacement_texture_ind, alpha_texture_ind, reflection_texture_ind, roughness_texture_ind,
+				metallic_texture_ind, sheen_texture_ind, emissive_texture_ind, normal_texture_ind, texture_channels
+			} };
+			return hash_bytes(key);
 		}
 	};
 
@@ -271,10 +574,44 @@ private:
 
 	void initImageResources();
 	void createPresentImageResources();
-	ImageResource createTextureImageResource(std::string texPath);
+	vkimpl::VulkanImageInfo getShadowDepthInfo();
+	std::vector<FrameAttachment> getPresentAttachments(VkExtent2D extent);
+	AttachmentPlan planFrameAttachments(const std::vector<FrameAttachment>& attachments, std::vector<VkImage>& images);
+	AttachmentPlan createFrameAttachments(const std::vector<FrameAttachment>& attachments, std::vector<vkimpl::MemoryAllocation>& memory);
+	void reportAttachmentMemory();
+	void loadPendingTextures();
+	uint64_t hashTextureContents(const PendingTexture& pending);
+	bool sameTextureContents(const PendingTexture& pending0, const PendingTexture& pending1);
+	DecodedTexture decodeTexture(size_t decodingIndex);
+	void decodeChannelTexture(const std::vector<TextureChannelSource>& sources, DecodedTexture& texture);
+	void streamTextures();
+	void createStreamingTexture(DecodedTexture& texture);
+	uint32_t getTextureStreamLevel(const StreamingTexture& streaming, VkDeviceSize& stagingSize);
+	void submitTextureUploads(const std::vector<size_t>& streamingIndices);
+	void updateStreamedTextureViews();
+	void destroyRetiredTextureResources();
+	vkimpl::VulkanImageInfo getStreamingImageInfo(const StreamingTexture& streaming, uint32_t baseLevel);
+	std::vector<float> getTextureScreenTexels();
+	VkDeviceSize getTextureBudget();
+	void updateTextureResidency();
+	uint32_t resizeStreamingTexture(size_t streamingIndex, uint32_t baseLevel);
+	void stopTextureStreaming();
+	void printTextureStats();
+	void printMemoryStats();
+	void exportMemoryReport();
+	void printUploadStats();
+	void printUniformStats();
+	void printDrawRecordStats();
+	void benchmarkUploads();
+	void benchmarkDrawRecording();
+	void updateMaterialDescriptors();
+	void updateMaterialBuffer();
 
 	void initSceneResources();
 	void createModelBuffer();
+	void createModelBuffer(const void* vertexData, VkDeviceSize vertexDataSize, const void* indexData, VkDeviceSize indexDataSize);
+	void createMeshletBuffers();
+	void createMeshletDrawBuffers();
 
 	void initFramebuffers();
 	void createPresentFramebuffers();
@@ -285,13 +622,13 @@ private:
 
 	void initUniformBuffers();
 	void createPresentUniformBuffers();
-	void createUniformBuffers(VkDeviceSize bufferSize, std::vector<BufferResource>& uniformBuffers);
 
 	void initDescriptorSetLayouts();
 	void createSceneDescriptorSetLayout();
 	void createCameraDescriptorSetLayout();
 	void createLightDescriptorSetLayout();
 	void createMaterialDescriptorSetLayout();
+	void createMeshletCullingDescriptorSetLayout();
 
 	void initDescriptorPools();
 	void createPresentDescriptorPools();
@@ -299,6 +636,7 @@ private:
 	void createCameraDescriptorPool();
 	void createLightDescriptorPool();
 	void createMaterialDescriptorPool();
+	void createMeshletCullingDescriptorPool();
 	void createGuiDescriptorPool();
 
 	void createSamplers();
@@ -313,13 +651,15 @@ private:
 	void createSceneNoLightingPipeline();
 	void createWireframePipeline();
 	void createShadowPipeline();
+	void createMeshletCullingPipeline();
 
 	void initDescriptorSets();
 	void createPresentDescriptorSets();
-	void createSceneDescriptorSets();
-	void createNoShadowSceneDescriptorSets();
-	void createCameraDescriptorSets();
-	void createLightDescriptorSets();
+	void createSceneDescriptorSet();
+	void createNoShadowSceneDescriptorSet();
+	void createCameraDescriptorSet();
+	void createLightDescriptorSet();
+	void createMeshletCullingDescriptorSets();
 
 	void initCommandBuffers();
 	void createPresentCommandBuffers();
@@ -331,6 +671,9 @@ private:
 	void createNoShadowSceneBlankModelCommandBuffers();
 	void createWireframeCommandBuffers();
 	void createGuiCommandBuffers();
+	void createMeshletCullingCommandBuffers();
+	void createObjectPassCommandBuffers();
+	void createTimestampQueryPool();
 
 	void initSyncObjects();
 	void createPresentSyncObjects();
@@ -339,12 +682,21 @@ private:
 	void beginPresentRenderPasses();
 	void beginDefaultRenderPass();
 	void beginObjectRenderPasses();
-	void beginSceneRenderPass();
-	void beginNoShadowSceneRenderPass();
-	void beginSceneBlankModelRenderPass();
-	void beginNoShadowSceneBlankModelRenderPass();
-	void beginWireframeRenderPass();
-	void beginShadowRenderPass();
+	void recordFrameObjectPasses(uint32_t imageIndex);
+	void beginSceneRenderPass(size_t imageIndex);
+	void beginNoShadowSceneRenderPass(size_t imageIndex);
+	void beginSceneBlankModelRenderPass(size_t imageIndex);
+	void beginNoShadowSceneBlankModelRenderPass(size_t imageIndex);
+	void beginWireframeRenderPass(size_t imageIndex);
+	void beginShadowRenderPass(size_t imageIndex);
+	void buildDrawLists();
+	uint32_t recordObjectPass(VkCommandBuffer commandBuffer, size_t imageIndex, ObjectPass pass, const VkRenderPassBeginInfo& renderPassInfo,
+		const std::function<void(VkCommandBuffer)>& bindState, bool culled);
+	size_t getDrawRecordWorkerCount(size_t drawCount);
+	void recordDrawItems(VkCommandBuffer commandBuffer, size_t imageIndex, const std::vector<DrawListItem>& items, size_t begin, size_t end);
+	void beginMeshletCullingPass();
+	void drawMaterialGroup(VkCommandBuffer commandBuffer, size_t imageIndex, uint32_t drawGroup);
+	void readFrameTimestamps(uint32_t imageIndex);
 	void beginGuiRenderPass(uint32_t imageIndex);
 
 	void initGuiBackend();
@@ -372,6 +724,7 @@ private:
 	void destroyDescriptorSetLayouts();
 	void destroySceneResources();
 	void destroyModelBuffers();
+	void destroyMeshletDrawBuffers();
 	void destroyImageResource(ImageResource imageResource);
 	void destroyBufferResources(std::vector<BufferResource> bufferResources);
 	void destroyBufferResource(BufferResource bufferResource);
@@ -393,18 +746,48 @@ private:
 	void updateModel();
 	void clearCurrentModel();
 	void updateModelInfo();
+	void computeModelBounds();
+	int selectVertexFormat(size_t materialCount);
+	void packCompactVertices(const std::vector<Vertex>& vertices, std::vector<CompactVertex>& compactVertices);
+	VkDeviceSize getVertexStride();
+	std::array<VertexStreamInfo, VERTEX_STREAM_COUNT> getVertexStreamInfos();
+	std::vector<VkVertexInputAttributeDescription> getVertexAttributeDescriptions(uint32_t streamMask);
+	std::vector<VkVertexInputBindingDescription> getVertexBindingDescriptions(const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions);
+	uint32_t findConstantStreams(const void* vertexData, size_t vertexCount);
+	VkDeviceSize layoutVertexStreams(uint32_t constantStreams, size_t vertexCapacity);
+	void uploadVertexStreams(const void* vertexData, size_t vertexCount, size_t firstVertex);
+	void bindVertexStreams(VkCommandBuffer commandBuffer, uint32_t streamMask);
+	void recreateModelPipelines();
+	void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<MaterialGroup>& groups);
+	void generateShapeLods();
+	std::vector<MaterialGroup> getIndexRangeGroups();
+	void generateMeshlets();
+	bool useMeshletCulling();
+	void fillMeshletCullItems();
+	void readMeshletCullingStats(uint32_t imageIndex);
+	const std::vector<MaterialGroup>& getLodMaterialGroups(const Shape& shape);
+	bool selectShapeLods();
 	void loadOBJModel(std::string path);
+	void streamOBJModel(std::string path);
+	bool loadModelCache(std::string path);
+	void writeModelCache(std::string path);
+	std::vector<std::string> getModelCachePaths(std::string path);
+	uint32_t getModelCacheVersion();
 	Material loadMaterial(std::string directory, tinyobj::material_t material);
+	int getMaterialIndex(std::string directory, const std::vector<tinyobj::material_t>& materials, std::vector<int>& materialIndexMap, int materialIdLocal);
+	int findMaterial(const Material& mat);
+	int addMaterial(const Material& mat);
 	void updateMaterialUbo(Material& mat);
-	int loadTexture(std::string directory, std::string relativePath);
-	BufferResource getMaterialUniformBuffer(Material mat);
-	VkDescriptorSet getMaterialDescriptorSet(Material mat, VkBuffer matUniformBuffer);
+	int loadTexture(std::string directory, std::string relativeKey);
+	void loadScalarTextures(std::string directory, const tinyobj::material_t& material, Material& mat);
+	void updateTextureDescriptors(size_t firstTexture, size_t textureCount);
 	static void glfwScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 	static void glfwMouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 	static void glfwCursorPositionCallback(GLFWwindow* window, double xpos, double ypos);
 
 	//General helpers
 	std::string preprocessPath(std::string path);
+	std::string getDirectory(std::string path);
 	
 	//Settings
 	VkFormat _defaultDepthFormat;
@@ -414,6 +797,7 @@ private:
 	//render passes
 	struct{
 		VkRenderPass sceneRenderPass;
+		VkRenderPass sceneLastRenderPass;   //Scene pass no other pass follows, the multisampled targets are not stored
 		VkRenderPass wireframeRenderPass;
 		VkRenderPass shadowRenderPass;
 		VkRenderPass guiRenderPass;
@@ -425,7 +809,11 @@ private:
 		ImageResource sceneDepth;
 		ImageResource shadowDepth;
 		ImageResource defaultShadowDepth;
+		ImageResource placeholderTexture;   //Shown by textures until their first mip levels are streamed in
 	} _imageResources;
+	std::vector<vkimpl::MemoryAllocation> _presentAttachmentMemory;   //Groups of the plan of sceneColor and sceneDepth
+	AttachmentMemoryReport _presentAttachmentReport{};
+	std::vector<AttachmentMemoryReport> _attachmentMemoryReports;     //At ATTACHMENT_REPORT_RESOLUTIONS
 	
 	//Framebuffers
 	std::vector<VkFramebuffer> _sceneFramebuffers;
@@ -435,26 +823,83 @@ private:
 	//3D Resources
 	std::vector<Vertex> _vertices;
 	std::vector<uint32_t> _indices;
+	std::vector<CompactVertex> _compactVertices;
+	int _modelVertexFormat{ FULL_VERTEX_FORMAT };   //Format of the vertex buffer and the pipelines
+	VertexQuantization _vertexQuantization{};
+	VertexStreamLayout _vertexStreamLayout{};
 	VkBuffer _vertexBuffer;
-	VkDeviceMemory _vertexBufferMemory;
+	vkimpl::MemoryAllocation _vertexBufferMemory;
 	VkBuffer _indexBuffer;
-	VkDeviceMemory _indexBufferMemory;
+	vkimpl::MemoryAllocation _indexBufferMemory;
+	std::vector<Meshlet> _meshlets;   //Sorted by index base, empty for streamed models
+	std::vector<MeshletDrawGroup> _meshletDrawGroups;
+
+	//Meshlet culling buffers, the draw commands and counts are written by the culling pass of each swapchain image
+	struct {
+		BufferResource meshlets{};
+		BufferResource cullItems{};
+		BufferResource drawGroups{};
+		std::vector<BufferResource> drawCommands;
+		std::vector<BufferResource> drawCounts;
+		uint32_t drawGroupCapacity{ 0 };   //Most material groups drawn at once
+	} _meshletBuffers;
 	
 
 	//Texture resources
 	std::vector<std::string> _texturePaths;
 	std::vector<ImageResource> _textureResources;
+	std::unordered_map<std::string, int> _textureIndices;   //Texture ids by normalized path
+	std::unordered_multimap<uint64_t, PendingTexture> _textureContents;   //Files of the textures owning an image by content hash
+	std::vector<int> _textureImageOwners;   //Texture whose image a texture uses, itself unless its files duplicate another one, 0 for the placeholder
+	std::vector<PendingTexture> _pendingTextures;
+
+	//Texture streaming: textures are decoded on _textureDecodeThread and their levels are uploaded by
+	//streamTextures over the following frames
+	std::vector<PendingTexture> _decodingTextures;
+	std::thread _textureDecodeThread;
+	std::mutex _decodedTextureMutex;
+	std::vector<DecodedTexture> _decodedTextures;   //Decoded, not yet taken by streamTextures
+	std::chrono::high_resolution_clock::time_point _textureDecodeEndTime;
+	std::atomic<bool> _cancelTextureDecode{ false };
+	size_t _texturesDecoding{ 0 };
+	std::vector<StreamingTexture> _streamingTextures;
+	size_t _textureUploadsInFlight{ 0 };
+	bool _texturesStreaming{ false };
+	std::chrono::high_resolution_clock::time_point _textureStreamStartTime;
+	std::chrono::high_resolution_clock::time_point _textureViewUpdateTime;
+	std::chrono::high_resolution_clock::time_point _textureResidencyTime;
+	bool _textureResidencyPending{ false };   //Textures without an image wait for the residency
+	std::vector<std::pair<uint64_t, ImageResource>> _retiredTextureResources;   //Views and images no longer shown, by the number of frames submitted before
 
 	//Scene informations and resources
 	std::vector<Shape> _shapes;
 	std::vector<Material> _materialCache;
+	std::unordered_multimap<uint64_t, int> _materialIndices;   //Material cache ids by material hash
+	ModelBounds _modelBounds{};
+	std::vector<std::string> _modelSourceFiles;
 
 	//Uniform buffers
 	struct {
-		std::vector<BufferResource> cameraUniformBuffers;
-		std::vector<BufferResource> lightUniformBuffers;
-		std::vector<BufferResource> materialUniformBuffers;
-	} _uniformBuffers;;
+		vkimpl::VulkanUniformRing frameUniforms;	//A region per swapchain image, bound as dynamic uniform buffers
+		VkDeviceSize cameraSlot{ 0 };
+		VkDeviceSize lightSlot{ 0 };
+	} _uniformBuffers;
+
+	//The MaterialUBO of every cached material in one storage buffer, indexed by the material id of the
+	//vertices. It grows by doubling, materials are uploaded once unless it grows.
+	struct {
+		BufferResource buffer{};
+		size_t capacity{ 0 };
+		size_t uploadedCount{ 0 };
+	} _materialBuffer;
+
+	//The texture array of the material set, its first writtenCount entries are the views of the
+	//textures. With update after bind, entries change without recording the passes again.
+	struct {
+		uint32_t capacity{ 0 };
+		size_t writtenCount{ 0 };
+		bool updateAfterBind{ false };
+	} _bindlessTextures;
 
 	//Descriptor informations
 	struct {
@@ -462,6 +907,7 @@ private:
 		vkimpl::DescriptorSetInfo cameraDescriptorInfo{};
 		vkimpl::DescriptorSetInfo lightDescriptorInfo{};
 		vkimpl::DescriptorSetInfo materialDescriptorInfo{};
+		vkimpl::DescriptorSetInfo meshletCullingDescriptorInfo{};
 		vkimpl::DescriptorSetInfo guiDescriptorInfo{};
 	} _descriptorSetInfos;
 
@@ -471,7 +917,7 @@ private:
 		VkDescriptorSetLayout cameraDescriptorSetLayout;
 		VkDescriptorSetLayout materialDescriptorSetLayout;
 		VkDescriptorSetLayout lightDescriptorSetLayout;
-		
+		VkDescriptorSetLayout meshletCullingDescriptorSetLayout;
 	} _descriptorSetLayouts;
 
 	//Descriptor pools
@@ -480,16 +926,18 @@ private:
 		VkDescriptorPool cameraDescriptorPool;
 		VkDescriptorPool lightDescriptorPool;
 		VkDescriptorPool materialDescriptorPool;
+		VkDescriptorPool meshletCullingDescriptorPool;
 		VkDescriptorPool guiDescriptorPool;
 	} _descriptorPools;
 
 	//Descriptor sets
 	struct {
-		std::vector<VkDescriptorSet> sceneDescriptorSets;
-		std::vector<VkDescriptorSet> sceneNoShadowDescriptorSets;
-		std::vector<VkDescriptorSet> cameraDescriptorSets;
-		std::vector<VkDescriptorSet> lightDescriptorSets;
-		std::vector<VkDescriptorSet> materialDescriptorSets;
+		VkDescriptorSet sceneDescriptorSet;
+		VkDescriptorSet sceneNoShadowDescriptorSet;
+		VkDescriptorSet cameraDescriptorSet;
+		VkDescriptorSet lightDescriptorSet;
+		VkDescriptorSet materialDescriptorSet;		//Shared by every material
+		std::vector<VkDescriptorSet> meshletCullingDescriptorSets;
 	} _descriptorSets;
 
 	//Samplers
@@ -504,6 +952,7 @@ private:
 		VkPipelineLayout sceneNoLightingPipelineLayout;
 		VkPipelineLayout wireframePipelineLayout;
 		VkPipelineLayout shadowPipelineLayout;
+		VkPipelineLayout meshletCullingPipelineLayout;
 	} _pipelineLayouts;
 
 	struct {
@@ -511,11 +960,14 @@ private:
 		VkPipeline sceneNoLightingPipeline;
 		VkPipeline wireframePipeline;
 		VkPipeline shadowPipeline;
+		VkPipeline meshletCullingPipeline;
 	} _pipelines;
 	
 
 	//Command Pools
 	VkCommandPool _commandPool;
+	std::vector<VkCommandPool> _drawRecordPools;   //One per draw recording worker, only used by its worker
+	WorkerPool _drawRecordWorkers;                 //Worker i records with _drawRecordPools[i]
 
 	//Pipelines
 
@@ -529,6 +981,9 @@ private:
 		std::vector<VkCommandBuffer> wireframeCommandBuffers;
 		std::vector<VkCommandBuffer> shadowCommandBuffers;
 		std::vector<VkCommandBuffer> guiCommandBuffers;
+		std::vector<VkCommandBuffer> meshletCullingCommandBuffers;
+		//Secondary command buffers of the object passes, per draw record pool OBJECT_PASS_COUNT per swapchain image
+		std::vector<std::vector<VkCommandBuffer>> objectPassCommandBuffers;
 	} _commandBuffers;
 	
 
@@ -537,8 +992,11 @@ private:
 	std::vector<VkSemaphore> _imageAvailableSemaphores;
 	std::vector<VkSemaphore> _renderFinishedSemaphores;
 	std::vector<VkFence> _inFlightFences;
+	std::vector<uint64_t> _inFlightFrameNumbers;   //Number of the frame last submitted with each in flight fence
 	std::vector<VkFence> _imagesInFlight;
 	size_t _currentFrame = 0;
+	uint64_t _submittedFrameCount = 0;
+	uint64_t _finishedFrameCount = 0;   //Frames up to this number finished
 
 	//Draw control
 	bool _swapchainRebuild;
@@ -549,9 +1007,136 @@ private:
 	//Control layer
 	std::string _modelPath;
 	bool _modelUpdated;
+	bool _benchmarkUploads{ false };
+	bool _benchmarkDrawRecording{ false };
+	bool _exportMemoryReport{ false };
 
 	int _shadowOption{ 0 };
 	int _shaderOption{ 0 };
+	int _objLoaderOption{ PARALLEL_OBJ_LOADER };
+	bool _useModelCache{ true };
+	int _streamingMemoryBudgetMB{ 512 };
+	int _textureBudgetMB{ 0 };          //Image memory of the textures, 0 for a share of the device local heap
+	bool _optimizeMesh{ true };
+	int _vertexFormatOption{ FULL_VERTEX_FORMAT };
+	bool _generateLods{ true };
+	bool _packScalarTextures{ false };   //Pack the scalar maps of a material into the channels of one texture
+	float _lodPixelError{ 1.0f };       //Largest screen space error of a drawn level in pixels
+	int _lodTriangleBudgetK{ 0 };       //Thousands of triangles drawn at most, 0 for no budget
+	bool _meshletCulling{ true };
+	bool _meshletCullingRecorded{ false };   //Whether the recorded object passes draw the culled meshlets
+	bool _recordEveryFrame{ false };         //Record the submitted object passes of a frame before submitting it
+	bool _objectPassesStale{ false };        //Levels of detail changed since every object pass was recorded
+	int _recordThreadCount{ 0 };             //Threads recording the draws of a pass, 0 for every core
+
+	//Model loading statistics
+	struct {
+		double objParseMilliseconds{ 0.0 };
+		double objParseThroughputMBs{ 0.0 };
+		unsigned objParseThreads{ 0 };
+		double meshBuildMilliseconds{ 0.0 };
+		double meshOptimizeMilliseconds{ 0.0 };
+		double lodGenerateMilliseconds{ 0.0 };
+		size_t lodLevelCount{ 0 };
+		size_t lodIndexCount{ 0 };
+		double meshletBuildMilliseconds{ 0.0 };
+		double materialLookupMilliseconds{ 0.0 };
+		size_t materialLookups{ 0 };
+		size_t textureLookups{ 0 };
+		size_t textureCount{ 0 };
+		size_t textureUploadBatches{ 0 };
+		VkDeviceSize textureBytes{ 0 };
+		size_t cookedTextureCount{ 0 };
+		VkDeviceSize textureImageBytes{ 0 };    //Texture images with their mip chains
+		VkDeviceSize textureRGBA8Bytes{ 0 };    //The same images as uncompressed RGBA8
+		size_t channelTextureCount{ 0 };        //Textures with fewer channels or in UNORM
+		size_t packedTextureCount{ 0 };         //Channel textures made of several maps
+		size_t duplicateTextureCount{ 0 };      //Textures sharing the image of one with the same file contents
+		VkDeviceSize duplicateTextureBytes{ 0 };   //Image memory not allocated for them
+		double textureHashMilliseconds{ 0.0 };
+		double textureDecodeMilliseconds{ 0.0 };   //Until the last texture is decoded
+		double textureUploadMilliseconds{ 0.0 };   //Main thread time spent streaming textures in
+		double textureStreamMilliseconds{ 0.0 };   //Until every texture is resident at full resolution
+		VertexCacheStats vertexCacheBefore{};
+		VertexCacheStats vertexCacheAfter{};
+		double modelLoadMilliseconds{ 0.0 };
+		bool modelCacheHit{ false };
+		bool modelStreamed{ false };
+		size_t vertexCount{ 0 };
+		size_t indexCount{ 0 };
+		VkDeviceSize vertexBufferBytes{ 0 };
+		size_t residentMemoryBefore{ 0 };
+		size_t peakResidentMemory{ 0 };
+	} _modelLoadStats;
+	ResidentMemoryTracker _loadMemoryTracker;
+
+	//Triangles of the levels of detail drawn in the last selection
+	struct {
+		size_t drawnTriangles{ 0 };
+		size_t fullTriangles{ 0 };
+		size_t reducedShapes{ 0 };
+		float pixelError{ 0.0f };
+	} _lodSelectionStats;
+
+	//Texture memory selected by the last residency update. Cooked textures are managed, the others
+	//keep every level and are pinned.
+	struct {
+		VkDeviceSize budget{ 0 };
+		VkDeviceSize pinnedBytes{ 0 };
+		VkDeviceSize selectedBytes{ 0 };   //Levels selected for the managed textures
+		VkDeviceSize neededBytes{ 0 };     //Levels needed on screen by the managed textures
+		VkDeviceSize residentBytes{ 0 };   //Images of the managed textures, replaced ones included
+		size_t managedCount{ 0 };
+		size_t reducedCount{ 0 };          //Managed textures selected coarser than needed
+		uint64_t evictions{ 0 };           //Images replaced by smaller ones
+		uint64_t restreams{ 0 };           //Images replaced by larger ones
+		double selectMilliseconds{ 0.0 };
+	} _textureResidencyStats;
+
+	//Meshlets and triangles left by the culling pass, read back when the swapchain image is reused
+	struct {
+		size_t meshletCount{ 0 };      //Of every level of detail
+		size_t drawnMeshlets{ 0 };     //Of the selected levels, culled or not
+		size_t drawnTriangles{ 0 };
+		size_t visibleMeshlets{ 0 };
+		size_t visibleTriangles{ 0 };
+	} _meshletCullingStats;
+
+	//Throughput of the last upload benchmark, from the first copy until the device finished the last one
+	struct {
+		VkDeviceSize bytes{ 0 };
+		double milliseconds{ 0.0 };
+		double throughputMBs{ 0.0 };
+	} _uploadBenchmarkStats;
+
+	//Fastest recording of every object pass of the last draw recording benchmark, by thread count from 1
+	struct {
+		std::vector<double> milliseconds;
+		std::vector<size_t> workers;		//Most workers recording a pass
+	} _drawRecordBenchmarkStats;
+
+	//Draws of the object passes, in the order of the shapes: the adjacent index ranges of the selected
+	//levels, and a draw per material group when the meshlet culling is recorded
+	struct {
+		std::vector<DrawListItem> ranges;
+		std::vector<DrawListItem> culledGroups;
+	} _drawLists;
+
+	//Recording of the object passes and GPU time of the scene pass, measured with timestamps of the
+	//swapchain image read back when it is reused
+	struct {
+		double recordMilliseconds{ 0.0 };
+		size_t materialGroups{ 0 };		//Drawn by a scene pass
+		size_t draws{ 0 };				//Of a scene pass, adjacent index ranges are one draw without culling
+		size_t workers{ 0 };			//Most workers recording a pass, 1 when every pass is recorded inline
+		size_t secondaryCommandBuffers{ 0 };
+		bool everyFrame{ false };		//Recorded for the last frame only
+		double gpuMilliseconds{ 0.0 };
+	} _drawRecordStats;
+	VkQueryPool _timestampQueryPool{ VK_NULL_HANDLE };	//Two timestamps per swapchain image, none without timestamp support
+	float _timestampPeriod{ 1.0f };	//Nanoseconds per tick
+	uint64_t _timestampMask{ ~0ull };	//Valid bits of the timestamps
+	std::vector<char> _imagesTimed;		//Whether the last frame of the swapchain image wrote its timestamps
 
 	//App info
 	float _frameRate{ 0.0f };
@@ -601,9 +1186,7 @@ private:
 namespace std {
 	template<> struct hash<VulkanModelViewer::Vertex> {
 		size_t operator()(VulkanModelViewer::Vertex const& vertex) const {
-			return ((hash<glm::vec3>()(vertex.pos) ^
-				(hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-				(hash<glm::vec2>()(vertex.texCoord) << 1);
+			return static_cast<size_t>(hash_bytes(vertex));
 		}
 	};
 }
\ No newline at end of file